@@ -43,12 +43,12 @@ main(int argc, char *argv[]) {
 	for (currentNet = workingImage->netlist; currentNet; currentNet = currentNet->next){	
 		/* check if the net aperture is a circle and has diameter < 0.060 inches */
 		if ((currentNet->aperture_state != GERBV_APERTURE_STATE_OFF) &&
-				(workingImage->aperture[currentNet->aperture] != NULL) &&
-				(workingImage->aperture[currentNet->aperture]->type == GERBV_APTYPE_CIRCLE) &&
-				(workingImage->aperture[currentNet->aperture]->parameter[0] < 0.060)){
+				(gerbv_image_get_aperture (workingImage, currentNet->aperture) != NULL) &&
+				(gerbv_image_get_aperture (workingImage, currentNet->aperture)->type == GERBV_APTYPE_CIRCLE) &&
+				(gerbv_image_get_aperture (workingImage, currentNet->aperture)->parameter[0] < 0.060)){
 			/* we found a path which meets the criteria, so delete the net for
 			   demostration purposes */
-			gerbv_image_delete_net (currentNet);
+			gerbv_image_delete_net_from_image (workingImage, currentNet);
 		}
 	}
 
@@ -123,6 +123,7 @@ parse_aperture_macro(gerb_file_t *fd)
     int neg = 0; /* negative numbers succeding , */
     unsigned char continueLoop = 1;
     int equate = 0;
+    gerb_file_slice_t comment;
 
     amacro = new_amacro();
 
@@ -254,7 +255,7 @@ parse_aperture_macro(gerb_file_t *fd)
 	     */
 	    if (!found_primitive && (primitive == 0)) {
 		/* Comment continues 'til next *, just throw it away */
-		gerb_fgetstring(fd, '*');
+		gerb_fgetslice(fd, '*', &comment);
 		c = gerb_fgetc(fd); /* Read the '*' */
 		break;
 	    }
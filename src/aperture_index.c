@@ -0,0 +1,197 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * aperture_index.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file aperture_index.c
+    \brief Per-image index of apertures by content
+    \ingroup libgerbv
+
+    Copying and merging images looks up every incoming aperture among
+    the apertures of the destination, which used to compare it against
+    every aperture there.  The index keeps the aperture numbers bucketed
+    by a hash of the aperture type, unit, macro and parameters.  Buckets
+    only hold candidates: every hit is compared against the live
+    aperture, so an aperture changed in place is simply not matched.
+*/
+
+#include "gerbv.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "aperture_index.h"
+#include "aperture_table.h"
+
+#define dprintf if(DEBUG) printf
+
+typedef struct {
+	GHashTable *buckets;	/*!< content hash to GArray of aperture numbers */
+} aperture_index_t;
+
+static void
+aperture_index_bucket_free (gpointer data)
+{
+	g_array_free ((GArray *) data, TRUE);
+}
+
+static guint
+aperture_index_hash (const gerbv_aperture_t *aperture)
+{
+	guint hash = aperture->type * 31 + aperture->unit;
+	gint i;
+
+	hash = hash * 31 + GPOINTER_TO_UINT (aperture->amacro);
+	for (i = 0; i < APERTURE_PARAMETERS_MAX; i++) {
+		gdouble parameter = aperture->parameter[i];
+		guint32 words[2];
+
+		/* 0.0 and -0.0 compare equal, so they must hash equal */
+		if (parameter == 0.0)
+			parameter = 0.0;
+		memcpy (words, &parameter, sizeof (words));
+		hash = hash * 31 + (words[0] ^ words[1]);
+	}
+
+	return hash;
+}
+
+static gboolean
+aperture_index_matches (const gerbv_aperture_t *aperture,
+		const gerbv_aperture_t *checkAperture)
+{
+	gint i;
+
+	if ((aperture->type != checkAperture->type)
+			|| (aperture->simplified != NULL)
+			|| (aperture->unit != checkAperture->unit)
+			|| (aperture->amacro != checkAperture->amacro))
+		return FALSE;
+
+	for (i = 0; i < APERTURE_PARAMETERS_MAX; i++) {
+		if (aperture->parameter[i] != checkAperture->parameter[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+aperture_index_add (aperture_index_t *index, gint number,
+		const gerbv_aperture_t *aperture)
+{
+	guint hash;
+	GArray *bucket;
+
+	/* flattened macros never match, see aperture_index_matches() */
+	if (aperture->simplified != NULL)
+		return;
+
+	hash = aperture_index_hash (aperture);
+	bucket = g_hash_table_lookup (index->buckets, GUINT_TO_POINTER (hash));
+	if (bucket == NULL) {
+		bucket = g_array_sized_new (FALSE, FALSE, sizeof (gint), 1);
+		g_hash_table_insert (index->buckets, GUINT_TO_POINTER (hash),
+				bucket);
+	}
+	g_array_append_val (bucket, number);
+}
+
+static aperture_index_t *
+aperture_index_get (gerbv_image_t *image)
+{
+	aperture_index_t *index = image->apertureIndex;
+	gerbv_aperture_t *aperture;
+	gint i, number;
+
+	if (index != NULL)
+		return index;
+
+	index = g_new0 (aperture_index_t, 1);
+	index->buckets = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+			NULL, aperture_index_bucket_free);
+	for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+		aperture = gerbv_image_get_nth_aperture (image, i, &number);
+		aperture_index_add (index, number, aperture);
+	}
+	dprintf ("aperture index built with %u buckets\n",
+			g_hash_table_size (index->buckets));
+	image->apertureIndex = index;
+
+	return index;
+}
+
+gint
+aperture_index_find_match (gerbv_image_t *image,
+		const gerbv_aperture_t *aperture)
+{
+	aperture_index_t *index = aperture_index_get (image);
+	gerbv_aperture_t *liveAperture;
+	GArray *bucket;
+	gint match = 0;
+	guint i;
+
+	bucket = g_hash_table_lookup (index->buckets,
+			GUINT_TO_POINTER (aperture_index_hash (aperture)));
+	if (bucket == NULL)
+		return 0;
+
+	for (i = 0; i < bucket->len; i++) {
+		gint number = g_array_index (bucket, gint, i);
+
+		if ((match != 0) && (number > match))
+			continue;
+		liveAperture = gerbv_image_get_aperture (image, number);
+		if ((liveAperture != NULL)
+				&& aperture_index_matches (liveAperture, aperture))
+			match = number;
+	}
+
+	return match;
+}
+
+gint
+aperture_index_find_unused (gerbv_image_t *image, gint startIndex)
+{
+	return aperture_table_find_unused (image, startIndex);
+}
+
+void
+aperture_index_update (gerbv_image_t *image, gint number,
+		gerbv_aperture_t *aperture)
+{
+	aperture_index_t *index = image->apertureIndex;
+
+	/* a removed or replaced aperture stays in its bucket until it fails
+	   the comparison in aperture_index_find_match() */
+	if ((index != NULL) && (aperture != NULL))
+		aperture_index_add (index, number, aperture);
+}
+
+void
+aperture_index_invalidate (gerbv_image_t *image)
+{
+	aperture_index_t *index = image->apertureIndex;
+
+	if (index == NULL)
+		return;
+
+	image->apertureIndex = NULL;
+	g_hash_table_destroy (index->buckets);
+	g_free (index);
+}
@@ -0,0 +1,53 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * aperture_index.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file aperture_index.h
+    \brief Header info for the content index over the apertures of an image
+    \ingroup libgerbv
+*/
+
+#ifndef APERTURE_INDEX_H
+#define APERTURE_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the lowest number of an aperture of image with the type, unit,
+   macro and parameters of aperture, or 0 if there is none */
+gint aperture_index_find_match (gerbv_image_t *image,
+		const gerbv_aperture_t *aperture);
+
+/* Returns the lowest free aperture number of image not below startIndex */
+gint aperture_index_find_unused (gerbv_image_t *image, gint startIndex);
+
+/* Tells the index of image that aperture number is now aperture, or
+   is removed if aperture is NULL.  Called by gerbv_image_set_aperture() */
+void aperture_index_update (gerbv_image_t *image, gint number,
+		gerbv_aperture_t *aperture);
+
+/* Frees the index of image, it is rebuilt when next needed */
+void aperture_index_invalidate (gerbv_image_t *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APERTURE_INDEX_H */
@@ -0,0 +1,263 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * aperture_table.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file aperture_table.c
+    \brief Sparse table of the apertures of an image by number
+    \ingroup libgerbv
+
+    Images used to embed an array of 9999 aperture pointers, about
+    80 kB per image even for a drill file with a dozen tools, which
+    every report and export walked slot by slot.  The table keeps the
+    used numbers and their apertures in two parallel arrays sorted by
+    number, for iterating over the used apertures only, and a direct
+    array of slots, grown to a power of two above the highest number,
+    for looking up a number in constant time.  Numbers too large for a
+    reasonable slot array are kept in a hash table instead, so there is
+    no upper limit on the aperture numbers.
+*/
+
+#include "gerbv.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "aperture_table.h"
+#include "aperture_index.h"
+
+#define dprintf if(DEBUG) printf
+
+/* Numbers from here on go to the hash table instead of the slots */
+#define APERTURE_TABLE_DIRECT_MAX 65536
+/* Smallest slot array */
+#define APERTURE_TABLE_DIRECT_MIN 32
+
+struct gerbv_aperture_table {
+	gerbv_aperture_t **slots;	/*!< aperture by number, for numbers below size */
+	gint size;
+	GHashTable *overflow;	/*!< aperture by number, for numbers from size on */
+	GArray *numbers;	/*!< the used numbers, ascending */
+	GPtrArray *apertures;	/*!< the aperture of each entry of numbers */
+};
+
+/* ------------------------------------------------------------------ */
+/* Returns the index of the first entry of numbers not below number */
+static guint
+aperture_table_lower_bound (const gerbv_aperture_table_t *table, gint number)
+{
+	guint low = 0, high = table->numbers->len;
+
+	/* apertures are nearly always added in ascending order */
+	if ((high > 0) && (g_array_index (table->numbers, gint, high - 1) < number))
+		return high;
+
+	while (low < high) {
+		guint middle = low + (high - low) / 2;
+
+		if (g_array_index (table->numbers, gint, middle) < number)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+/* ------------------------------------------------------------------ */
+static gerbv_aperture_table_t *
+aperture_table_new (void)
+{
+	gerbv_aperture_table_t *table = g_new0 (gerbv_aperture_table_t, 1);
+
+	table->numbers = g_array_new (FALSE, FALSE, sizeof (gint));
+	table->apertures = g_ptr_array_new ();
+
+	return table;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+aperture_table_grow (gerbv_aperture_table_t *table, gint number)
+{
+	gint size = MAX (table->size, APERTURE_TABLE_DIRECT_MIN);
+
+	while (size <= number)
+		size *= 2;
+	size = MIN (size, APERTURE_TABLE_DIRECT_MAX);
+
+	table->slots = g_renew (gerbv_aperture_t *, table->slots, size);
+	memset (table->slots + table->size, 0,
+			(size - table->size) * sizeof (gerbv_aperture_t *));
+	table->size = size;
+	dprintf ("aperture table grown to %d slots\n", size);
+}
+
+/* ------------------------------------------------------------------ */
+gerbv_aperture_t *
+gerbv_image_get_aperture (const gerbv_image_t *image, gint number)
+{
+	const gerbv_aperture_table_t *table = image->apertures;
+
+	if ((table == NULL) || (number < 0))
+		return NULL;
+	if (number < table->size)
+		return table->slots[number];
+	if (table->overflow != NULL)
+		return g_hash_table_lookup (table->overflow,
+				GINT_TO_POINTER (number));
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+void
+gerbv_image_set_aperture (gerbv_image_t *image, gint number,
+		gerbv_aperture_t *aperture)
+{
+	gerbv_aperture_table_t *table = image->apertures;
+	guint index;
+
+	g_return_if_fail (number >= 0);
+
+	if (table == NULL) {
+		if (aperture == NULL)
+			return;
+		table = image->apertures = aperture_table_new ();
+	}
+
+	if ((number >= table->size) && (number < APERTURE_TABLE_DIRECT_MAX)
+			&& (aperture != NULL))
+		aperture_table_grow (table, number);
+
+	if (number < table->size) {
+		table->slots[number] = aperture;
+	} else if (aperture != NULL) {
+		if (table->overflow == NULL)
+			table->overflow = g_hash_table_new (g_direct_hash,
+					g_direct_equal);
+		g_hash_table_insert (table->overflow, GINT_TO_POINTER (number),
+				aperture);
+	} else if (table->overflow != NULL) {
+		g_hash_table_remove (table->overflow, GINT_TO_POINTER (number));
+	}
+
+	index = aperture_table_lower_bound (table, number);
+	if ((index < table->numbers->len)
+	&& (g_array_index (table->numbers, gint, index) == number)) {
+		if (aperture != NULL) {
+			g_ptr_array_index (table->apertures, index) = aperture;
+		} else {
+			g_array_remove_index (table->numbers, index);
+			g_ptr_array_remove_index (table->apertures, index);
+		}
+	} else if (aperture != NULL) {
+		if (index == table->numbers->len) {
+			g_array_append_val (table->numbers, number);
+			g_ptr_array_add (table->apertures, aperture);
+		} else {
+			/* GLib has no g_ptr_array_insert() before 2.40 */
+			g_array_insert_val (table->numbers, index, number);
+			g_ptr_array_add (table->apertures, NULL);
+			memmove (&g_ptr_array_index (table->apertures, index + 1),
+				&g_ptr_array_index (table->apertures, index),
+				(table->apertures->len - index - 1)
+					* sizeof (gpointer));
+			g_ptr_array_index (table->apertures, index) = aperture;
+		}
+	}
+
+	aperture_index_update (image, number, aperture);
+}
+
+/* ------------------------------------------------------------------ */
+gint
+gerbv_image_get_aperture_count (const gerbv_image_t *image)
+{
+	const gerbv_aperture_table_t *table = image->apertures;
+
+	return (table != NULL) ? (gint) table->numbers->len : 0;
+}
+
+/* ------------------------------------------------------------------ */
+gerbv_aperture_t *
+gerbv_image_get_nth_aperture (const gerbv_image_t *image, gint index,
+		gint *number)
+{
+	const gerbv_aperture_table_t *table = image->apertures;
+
+	if ((table == NULL) || (index < 0)
+			|| (index >= (gint) table->numbers->len))
+		return NULL;
+
+	if (number != NULL)
+		*number = g_array_index (table->numbers, gint, index);
+
+	return g_ptr_array_index (table->apertures, index);
+}
+
+/* ------------------------------------------------------------------ */
+gint
+aperture_table_find_unused (const gerbv_image_t *image, gint startIndex)
+{
+	const gerbv_aperture_table_t *table = image->apertures;
+	gint number = MAX (startIndex, 0);
+	guint index;
+
+	if (table == NULL)
+		return number;
+
+	/* skip the run of used numbers starting at startIndex */
+	for (index = aperture_table_lower_bound (table, number);
+			index < table->numbers->len
+			&& g_array_index (table->numbers, gint, index) == number;
+			index++)
+		number++;
+
+	return number;
+}
+
+/* ------------------------------------------------------------------ */
+gint
+aperture_table_last_number (const gerbv_image_t *image)
+{
+	const gerbv_aperture_table_t *table = image->apertures;
+
+	if ((table == NULL) || (table->numbers->len == 0))
+		return -1;
+
+	return g_array_index (table->numbers, gint, table->numbers->len - 1);
+}
+
+/* ------------------------------------------------------------------ */
+void
+aperture_table_destroy (gerbv_image_t *image)
+{
+	gerbv_aperture_table_t *table = image->apertures;
+
+	if (table == NULL)
+		return;
+
+	image->apertures = NULL;
+	g_free (table->slots);
+	if (table->overflow != NULL)
+		g_hash_table_destroy (table->overflow);
+	g_array_free (table->numbers, TRUE);
+	g_ptr_array_free (table->apertures, TRUE);
+	g_free (table);
+}
@@ -0,0 +1,48 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * aperture_table.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file aperture_table.h
+    \brief Header info for the sparse table of the apertures of an image
+    \ingroup libgerbv
+*/
+
+#ifndef APERTURE_TABLE_H
+#define APERTURE_TABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the lowest aperture number of image which is not used and not
+   below startIndex */
+gint aperture_table_find_unused (const gerbv_image_t *image, gint startIndex);
+
+/* Returns the highest aperture number used in image, or -1 if there is
+   no aperture */
+gint aperture_table_last_number (const gerbv_image_t *image);
+
+/* Frees the table of image, but not the apertures in it */
+void aperture_table_destroy (gerbv_image_t *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APERTURE_TABLE_H */
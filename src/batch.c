@@ -0,0 +1,548 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * batch.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file batch.c
+    \brief Batch export mode of the command line
+    \ingroup gerbv
+
+    With --batch, gerbv stays running and reads export jobs, one per
+    line, from the standard input or from the clients of a UNIX socket.
+    A job is a list of key=value words, quoted like shell arguments:
+
+	export=png dpi=600 output=top.png layer=top.gbr layer=top.drl
+
+    The keys are export, output, layer (once per layer, bottom layer
+    first), dpi, origin, window, window_inch, border, antialias and
+    background, with the formats of the matching command line options,
+    which also give the defaults.  Every job is answered by a line
+    "ok <output>" or "error <reason>".  A line "quit" stops the server.
+
+    An output key is only accepted when --batch-output named the
+    directory the jobs may write to, and must name a file inside of it;
+    relative names are taken from that directory.  The socket is only
+    readable and writable by its owner.
+
+    Every layer file is parsed only once, and parsed again only when it
+    changed on disk, so the jobs only pay for the rendering.  The jobs
+    never open a display.
+*/
+
+#include "gerbv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifndef WIN32
+# include <sys/socket.h>
+# include <sys/un.h>
+#endif
+
+#include "common.h"
+#include "main.h"
+#include "batch.h"
+#include "lrealpath.h"
+
+#define dprintf if(DEBUG) printf
+
+/* A layer file parsed by an earlier job */
+typedef struct {
+	gint firstIndex, lastIndex;	/* files of the cache project, two for
+					   pick and place files */
+	time_t mtime;
+	off_t size;
+} batch_layer_t;
+
+/* The project holding every layer parsed so far */
+static gerbv_project_t *batchCache = NULL;
+/* Absolute filename to batch_layer_t */
+static GHashTable *batchLayers = NULL;
+/* Canonical directory of the output files, or NULL if the jobs may
+   not name one */
+static gchar *batchOutputDir = NULL;
+
+/* ------------------------------------------------------------------ */
+/* Returns the absolute name of the directory path, with the symbolic
+   links and the . and .. components resolved, or NULL if there is no
+   such directory.  Free it with g_free() */
+static gchar *
+batch_canonical_dir (const gchar *path)
+{
+	gchar *resolved, *canonical;
+
+	if (!g_file_test (path, G_FILE_TEST_IS_DIR))
+		return NULL;
+	resolved = lrealpath (path);
+	if (resolved == NULL)
+		return NULL;
+	canonical = g_strdup (resolved);
+	free (resolved);
+
+	return canonical;
+}
+
+/* ------------------------------------------------------------------ */
+/* Checks that the output file given by a job is inside the output
+   directory, and returns its canonical filename in filename.  Returns
+   an error message, or NULL */
+static const gchar *
+batch_check_output (const gchar *value, gchar **filename)
+{
+	gchar *path, *dirname, *basename, *realDir;
+	const gchar *error = NULL;
+	gsize length;
+	struct stat fileStat;
+
+	*filename = NULL;
+	if (batchOutputDir == NULL)
+		return _("output files are only allowed with --batch-output");
+
+	if (g_path_is_absolute (value))
+		path = g_strdup (value);
+	else
+		path = g_build_filename (batchOutputDir, value, NULL);
+	dirname = g_path_get_dirname (path);
+	basename = g_path_get_basename (path);
+	realDir = batch_canonical_dir (dirname);
+
+	length = strlen (batchOutputDir);
+	if ((strcmp (basename, ".") == 0) || (strcmp (basename, "..") == 0)
+			|| (strcmp (basename, G_DIR_SEPARATOR_S) == 0)) {
+		error = _("output is not a file name");
+	} else if (realDir == NULL) {
+		error = _("output directory does not exist");
+	} else if ((strncmp (realDir, batchOutputDir, length) != 0)
+			|| ((realDir[length] != '\0')
+			 && (realDir[length] != G_DIR_SEPARATOR)
+			 && !G_IS_DIR_SEPARATOR (batchOutputDir[length - 1]))) {
+		error = _("output is outside of the output directory");
+	} else {
+		*filename = g_build_filename (realDir, basename, NULL);
+		/* don't follow a link out of the directory */
+		if ((g_lstat (*filename, &fileStat) == 0)
+				&& !S_ISREG (fileStat.st_mode)) {
+			error = _("output is not a regular file");
+			g_free (*filename);
+			*filename = NULL;
+		}
+	}
+
+	g_free (realDir);
+	g_free (basename);
+	g_free (dirname);
+	g_free (path);
+
+	return error;
+}
+
+/* ------------------------------------------------------------------ */
+/* Returns the cached layer of filename, parsing it if it is new or
+   changed on disk since it was parsed.  Returns NULL if it can't be
+   read */
+static batch_layer_t *
+batch_get_layer (const gchar *filename)
+{
+	batch_layer_t *layer;
+	struct stat fileStat;
+	gint i;
+
+	if (g_stat (filename, &fileStat) != 0)
+		return NULL;
+
+	layer = g_hash_table_lookup (batchLayers, filename);
+	if (layer != NULL) {
+		if ((layer->mtime == fileStat.st_mtime)
+				&& (layer->size == fileStat.st_size))
+			return layer;
+
+		dprintf ("batch: %s changed, parsing it again\n", filename);
+		for (i = layer->firstIndex; i <= layer->lastIndex; i++)
+			gerbv_revert_file (batchCache, i);
+	} else {
+		gint firstIndex = batchCache->last_loaded + 1;
+
+		gerbv_open_layer_from_filename (batchCache, (gchar *) filename);
+		/* pick and place files are added as two layers */
+		if ((batchCache->last_loaded < firstIndex)
+				|| (batchCache->file[firstIndex] == NULL))
+			return NULL;
+
+		layer = g_new (batch_layer_t, 1);
+		layer->firstIndex = firstIndex;
+		layer->lastIndex = firstIndex;
+		if ((firstIndex + 1 < batchCache->max_files)
+				&& batchCache->file[firstIndex + 1])
+			layer->lastIndex = firstIndex + 1;
+		batchCache->last_loaded = layer->lastIndex;
+		g_hash_table_insert (batchLayers, g_strdup (filename), layer);
+	}
+
+	layer->mtime = fileStat.st_mtime;
+	layer->size = fileStat.st_size;
+
+	return layer;
+}
+
+/* ------------------------------------------------------------------ */
+/* Parses one key=value word of a job into export.  Returns an error
+   message, or NULL */
+static const gchar *
+batch_parse_option (const gchar *key, const gchar *value,
+		main_export_t *export, GdkColor *background)
+{
+	int r, g, b;
+
+	if (strcmp (key, "export") == 0) {
+		export->type = main_export_type_from_name (value);
+		if (export->type == EXP_TYPE_NONE)
+			return _("unrecognized export type");
+	} else if (strcmp (key, "dpi") == 0) {
+		if (strchr (value, 'x') != NULL) {
+			if (sscanf (value, "%fx%f", &export->dpiX,
+					&export->dpiY) != 2)
+				return _("resolution is not recognized");
+		} else {
+			if (sscanf (value, "%f", &export->dpiX) != 1)
+				return _("resolution is not recognized");
+			export->dpiY = export->dpiX;
+		}
+		if ((export->dpiX <= 0) || (export->dpiY <= 0))
+			return _("resolution should be greater than 0");
+		export->userSuppliedDpi = TRUE;
+	} else if (strcmp (key, "origin") == 0) {
+		if (sscanf (value, "%fx%f", &export->originX,
+				&export->originY) != 2)
+			return _("origin is not recognized");
+		export->userSuppliedOrigin = TRUE;
+	} else if ((strcmp (key, "window") == 0)
+			|| (strcmp (key, "window_inch") == 0)) {
+		if (sscanf (value, "%fx%f", &export->width,
+				&export->height) != 2)
+			return _("window size is not recognized");
+		if ((export->width < 0.001) || (export->height < 0.001)
+				|| (export->width > 2000) || (export->height > 2000))
+			return _("window size is out of bounds");
+		export->userSuppliedWindow = TRUE;
+		export->userSuppliedWindowInPixels =
+			(strcmp (key, "window") == 0);
+	} else if (strcmp (key, "border") == 0) {
+		if ((sscanf (value, "%f", &export->border) != 1)
+				|| (export->border < 0))
+			return _("border is not recognized");
+		export->border /= 100.0;
+	} else if (strcmp (key, "antialias") == 0) {
+		export->antiAlias = (strcmp (value, "0") != 0);
+	} else if (strcmp (key, "background") == 0) {
+		r = g = b = -1;
+		if ((strlen (value) != 7) || (value[0] != '#')
+				|| (sscanf (value, "#%2x%2x%2x", &r, &g, &b) != 3))
+			return _("background color is not recognized");
+		background->red = r*257;
+		background->green = g*257;
+		background->blue = b*257;
+	} else {
+		return _("unknown option");
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Runs the job of one input line, and writes the answer to out */
+static void
+batch_run_job (const gchar *line, main_export_t *defaults, FILE *out)
+{
+	main_export_t export = *defaults;
+	gerbv_project_t jobProject = *batchCache;
+	GArray *files;
+	gchar **argv = NULL;
+	gchar *outputFilename = NULL;
+	const gchar *error = NULL;
+	gint argc = 0, i, j;
+
+	if (!g_shell_parse_argv (line, &argc, &argv, NULL)) {
+		fprintf (out, "error %s\n", _("job is not recognized"));
+		fflush (out);
+		return;
+	}
+
+	/* the job only sees its own layers, in its own order */
+	files = g_array_new (FALSE, FALSE, sizeof (gerbv_fileinfo_t *));
+	for (i = 0; (i < argc) && (error == NULL); i++) {
+		gchar *value = strchr (argv[i], '=');
+
+		if (value == NULL) {
+			error = _("options must be given as key=value");
+			break;
+		}
+		*value++ = '\0';
+
+		if (strcmp (argv[i], "layer") == 0) {
+			gchar *filename;
+			batch_layer_t *layer;
+
+			if (!g_path_is_absolute (value)) {
+				gchar *currentDir = g_get_current_dir ();
+
+				filename = g_build_filename (currentDir, value, NULL);
+				g_free (currentDir);
+			} else {
+				filename = g_strdup (value);
+			}
+			layer = batch_get_layer (filename);
+			g_free (filename);
+			if (layer == NULL) {
+				error = _("layer could not be read");
+				break;
+			}
+			for (j = layer->firstIndex; j <= layer->lastIndex; j++)
+				g_array_append_val (files, batchCache->file[j]);
+		} else if (strcmp (argv[i], "output") == 0) {
+			g_free (outputFilename);
+			error = batch_check_output (value, &outputFilename);
+			export.filename = outputFilename;
+		} else {
+			error = batch_parse_option (argv[i], value, &export,
+					&jobProject.background);
+		}
+	}
+	if ((error == NULL) && (files->len == 0))
+		error = _("no layer given");
+	if ((error == NULL) && (export.type == EXP_TYPE_NONE))
+		error = _("no export type given");
+
+	if (error == NULL) {
+		jobProject.file = (gerbv_fileinfo_t **) files->data;
+		jobProject.max_files = files->len;
+		jobProject.last_loaded = files->len - 1;
+		export.transformations = g_new (gerbv_user_transformation_t,
+				files->len);
+		for (i = 0; i < (gint) files->len; i++) {
+			gerbv_user_transformation_t identity =
+					{0, 0, 1, 1, 0, FALSE, FALSE, FALSE};
+
+			main_set_default_layer_color (jobProject.file[i], i);
+			jobProject.file[i]->isVisible = TRUE;
+			export.transformations[i] = identity;
+		}
+
+		if (!main_export_project (&jobProject, &export))
+			error = _("export failed");
+		g_free (export.transformations);
+	}
+
+	if (error != NULL)
+		fprintf (out, "error %s\n", error);
+	else
+		fprintf (out, "ok %s\n", export.filename ? export.filename :
+				_("default output file"));
+	fflush (out);
+
+	g_array_free (files, TRUE);
+	g_free (outputFilename);
+	g_strfreev (argv);
+}
+
+/* ------------------------------------------------------------------ */
+/* Answers the jobs read from in, until in ends or a job line is "quit".
+   Returns FALSE if the server should stop */
+static gboolean
+batch_serve (FILE *in, FILE *out, main_export_t *defaults)
+{
+	GString *line = g_string_new (NULL);
+	gchar buffer[1024];
+	gboolean keepRunning = TRUE;
+
+	while (fgets (buffer, sizeof (buffer), in) != NULL) {
+		g_string_append (line, buffer);
+		if ((line->len == 0) || (line->str[line->len - 1] != '\n'))
+			continue;
+
+		g_strstrip (line->str);
+		if (strcmp (line->str, "quit") == 0) {
+			keepRunning = FALSE;
+			break;
+		}
+		if ((line->str[0] != '\0') && (line->str[0] != '#'))
+			batch_run_job (line->str, defaults, out);
+		g_string_truncate (line, 0);
+	}
+
+	g_string_free (line, TRUE);
+
+	return keepRunning;
+}
+
+#ifndef WIN32
+/* ------------------------------------------------------------------ */
+/* Removes the socket left at source by an earlier server.  Returns
+   FALSE if source is anything else than a socket */
+static gboolean
+batch_remove_socket (const gchar *source)
+{
+	struct stat fileStat;
+
+	if (lstat (source, &fileStat) != 0)
+		return (errno == ENOENT);
+	if (!S_ISSOCK (fileStat.st_mode)) {
+		errno = EEXIST;
+		return FALSE;
+	}
+
+	return (unlink (source) == 0);
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+gboolean
+batch_run (const gchar *source, const gchar *outputDir,
+		main_export_t *defaults)
+{
+	gboolean success = TRUE;
+
+	/* there is no GUI to collect the messages */
+	g_log_set_handler (NULL,
+		    G_LOG_FLAG_FATAL | G_LOG_FLAG_RECURSION | G_LOG_LEVEL_MASK,
+		    g_log_default_handler, NULL);
+
+	batchCache = gerbv_create_project ();
+	batchCache->background = mainProject->background;
+	batchLayers = g_hash_table_new_full (g_str_hash, g_str_equal,
+			g_free, g_free);
+	if (outputDir != NULL) {
+		batchOutputDir = batch_canonical_dir (outputDir);
+		if (batchOutputDir == NULL) {
+			fprintf (stderr, _("Output directory %s does not exist.\n"),
+					outputDir);
+			success = FALSE;
+			goto cleanup;
+		}
+	}
+
+	if (strcmp (source, "-") == 0) {
+		batch_serve (stdin, stdout, defaults);
+	} else {
+#ifndef WIN32
+		struct sockaddr_un address;
+		int listenSocket;
+		mode_t oldMask;
+
+		memset (&address, 0, sizeof (address));
+		address.sun_family = AF_UNIX;
+		if (strlen (source) >= sizeof (address.sun_path)) {
+			fprintf (stderr, _("Socket path %s is too long.\n"), source);
+			success = FALSE;
+			goto cleanup;
+		}
+		strcpy (address.sun_path, source);
+
+		if (!batch_remove_socket (source)) {
+			fprintf (stderr, _("Can't replace %s: %s\n"),
+					source, strerror (errno));
+			success = FALSE;
+			goto cleanup;
+		}
+
+		/* the jobs read and write files as this user, so nobody else
+		   may connect */
+		listenSocket = socket (AF_UNIX, SOCK_STREAM, 0);
+		oldMask = umask (077);
+		if ((listenSocket < 0)
+		 || (bind (listenSocket, (struct sockaddr *) &address,
+				 sizeof (address)) != 0)) {
+			umask (oldMask);
+			fprintf (stderr, _("Can't listen on socket %s: %s\n"),
+					source, strerror (errno));
+			if (listenSocket >= 0)
+				close (listenSocket);
+			success = FALSE;
+			goto cleanup;
+		}
+		umask (oldMask);
+		if ((chmod (source, S_IRUSR | S_IWUSR) != 0)
+		 || (listen (listenSocket, 8) != 0)) {
+			fprintf (stderr, _("Can't listen on socket %s: %s\n"),
+					source, strerror (errno));
+			close (listenSocket);
+			batch_remove_socket (source);
+			success = FALSE;
+			goto cleanup;
+		}
+
+		/* one client at a time, until one of them says quit */
+		for (;;) {
+			int clientSocket = accept (listenSocket, NULL, NULL);
+			FILE *in, *out;
+			gboolean keepRunning;
+
+			if (clientSocket < 0) {
+				if (errno == EINTR)
+					continue;
+				fprintf (stderr, _("Can't accept on socket %s: %s\n"),
+						source, strerror (errno));
+				success = FALSE;
+				break;
+			}
+
+			in = fdopen (dup (clientSocket), "r");
+			out = fdopen (clientSocket, "w");
+			if ((in == NULL) || (out == NULL)) {
+				if (in != NULL)
+					fclose (in);
+				if (out != NULL)
+					fclose (out);
+				else
+					close (clientSocket);
+				continue;
+			}
+			keepRunning = batch_serve (in, out, defaults);
+			fclose (in);
+			fclose (out);
+			if (!keepRunning)
+				break;
+		}
+
+		close (listenSocket);
+		batch_remove_socket (source);
+#else
+		fprintf (stderr, _("Batch jobs can only be read from the standard input.\n"));
+		success = FALSE;
+		goto cleanup;
+#endif
+	}
+
+cleanup:
+	g_free (batchOutputDir);
+	batchOutputDir = NULL;
+	g_hash_table_destroy (batchLayers);
+	batchLayers = NULL;
+	gerbv_destroy_project (batchCache);
+	batchCache = NULL;
+
+	return success;
+}
@@ -0,0 +1,37 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * batch.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file batch.h
+    \brief Header info for the batch export mode of the command line
+    \ingroup gerbv
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Runs the export jobs read from the UNIX socket at source, or from the
+   standard input if source is "-".  The command line options give the
+   defaults of every job.  The jobs may only name output files inside
+   outputDir, or none if it is NULL.  Returns FALSE if the jobs could not
+   be read */
+gboolean batch_run (const gchar *source, const gchar *outputDir,
+		main_export_t *defaults);
+
+#endif /* BATCH_H */
@@ -0,0 +1,907 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * benchmark.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file benchmark.c
+    \brief Reproducible benchmark of libgerbv
+    \ingroup gerbv
+
+    gerbv-benchmark times every stage of libgerbv on a corpus of layer
+    files: parsing (with an empty and with a filled image cache), the
+    bounding box, the Gerber and drill reports, every render type at the
+    zoom-to-fit view and at 5x zoom, the PNG, PDF and SVG exports and the
+    RS-274X re-export of every layer.
+
+    Every file named on the command line is one case, and so is every
+    directory holding layer files below a directory named there, with
+    its files loaded as the layers of one project.  Each stage runs once
+    untimed, to fill the caches of libgerbv, and then a fixed number of
+    times, each timed with a monotonic clock.  The minimum, mean,
+    percentiles and maximum of every stage, and the peak resident set
+    size of the process, are written as JSON.
+
+    "make benchmark" runs it on example/ and test/inputs/.  The GDK
+    render types need a display and are reported as null without one.
+*/
+
+#include "gerbv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_RESOURCE_H
+# include <sys/time.h>
+# include <sys/resource.h>
+#endif
+
+#define BENCHMARK_DEFAULT_ITERATIONS 10
+#define BENCHMARK_DEFAULT_WIDTH 1024
+#define BENCHMARK_DEFAULT_HEIGHT 768
+/* The zoom of the second view of every render stage */
+#define BENCHMARK_ZOOM 5.0
+
+/* Percentiles reported for every stage */
+static const gint benchmark_percentiles[] = {50, 90, 95, 99};
+
+typedef struct {
+	gchar *name;		/* the directory or file, as given */
+	GPtrArray *filenames;	/* the layer files, bottom layer first */
+} benchmark_case_t;
+
+typedef struct {
+	gchar *name;
+	GArray *samples;	/* gint64 nanoseconds, or NULL if skipped */
+} benchmark_stage_t;
+
+typedef enum {
+	BENCHMARK_EXPORT_PNG,
+	BENCHMARK_EXPORT_PDF,
+	BENCHMARK_EXPORT_SVG,
+	BENCHMARK_EXPORT_RS274X
+} benchmark_export_t;
+
+static gint iterations = BENCHMARK_DEFAULT_ITERATIONS;
+static gint width = BENCHMARK_DEFAULT_WIDTH;
+static gint height = BENCHMARK_DEFAULT_HEIGHT;
+static gboolean verbose = FALSE;
+static gboolean haveDisplay = FALSE;
+/* Holds the image cache and the exported files */
+static gchar *scratchDir = NULL;
+static gchar *imageCacheDir = NULL;
+
+/* ------------------------------------------------------------------ */
+/* Returns the time of a monotonic clock, in nanoseconds */
+static gint64
+benchmark_now (void)
+{
+	return g_get_monotonic_time () * 1000;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_add_sample (GArray *samples, gint64 start)
+{
+	gint64 elapsed = benchmark_now () - start;
+
+	g_array_append_val (samples, elapsed);
+}
+
+/* ------------------------------------------------------------------ */
+/* Returns the peak resident set size of the process in kB, or -1 if it
+   is not known */
+static glong
+benchmark_peak_rss (void)
+{
+#if defined(HAVE_GETRUSAGE) && defined(HAVE_SYS_RESOURCE_H)
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) == 0) {
+# ifdef __APPLE__
+		return usage.ru_maxrss / 1024;	/* in bytes there */
+# else
+		return usage.ru_maxrss;
+# endif
+	}
+#endif
+	return -1;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_remove_tree (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	if (g_file_test (path, G_FILE_TEST_IS_DIR)
+	&& !g_file_test (path, G_FILE_TEST_IS_SYMLINK)) {
+		dir = g_dir_open (path, 0, NULL);
+		if (dir != NULL) {
+			while ((name = g_dir_read_name (dir)) != NULL) {
+				gchar *child = g_build_filename (path, name, NULL);
+
+				benchmark_remove_tree (child);
+				g_free (child);
+			}
+			g_dir_close (dir);
+		}
+		g_rmdir (path);
+	} else {
+		g_remove (path);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* Forgets every parsed image, so the next parse starts from the files */
+static void
+benchmark_empty_image_cache (void)
+{
+	benchmark_remove_tree (imageCacheDir);
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+benchmark_make_scratch_dir (void)
+{
+	scratchDir = g_dir_make_tmp ("gerbv-benchmark-XXXXXX", NULL);
+	if (scratchDir == NULL)
+		return FALSE;
+
+	imageCacheDir = g_build_filename (scratchDir, "gerbv", NULL);
+	gerbv_set_image_cache (imageCacheDir, 0);
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+benchmark_is_layer_file (const gchar *name)
+{
+	static const gchar *skippedSuffixes[] = {
+		".am", ".in", ".jpg", ".list", ".pdf", ".png", ".ps",
+		".gvp", ".sh", NULL
+	};
+	gchar *lowerName;
+	gboolean isLayer = TRUE;
+	gint i;
+
+	if (name[0] == '.' || g_str_has_prefix (name, "Makefile")
+	|| g_str_has_prefix (name, "README"))
+		return FALSE;
+
+	lowerName = g_ascii_strdown (name, -1);
+	for (i = 0; skippedSuffixes[i] != NULL; i++) {
+		if (g_str_has_suffix (lowerName, skippedSuffixes[i])) {
+			isLayer = FALSE;
+			break;
+		}
+	}
+	g_free (lowerName);
+
+	return isLayer;
+}
+
+/* ------------------------------------------------------------------ */
+static gint
+benchmark_compare_names (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* ------------------------------------------------------------------ */
+static benchmark_case_t *
+benchmark_case_new (const gchar *name)
+{
+	benchmark_case_t *benchCase = g_new (benchmark_case_t, 1);
+
+	benchCase->name = g_strdup (name);
+	benchCase->filenames = g_ptr_array_new ();
+
+	return benchCase;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_case_free (benchmark_case_t *benchCase)
+{
+	g_ptr_array_foreach (benchCase->filenames, (GFunc) g_free, NULL);
+	g_ptr_array_free (benchCase->filenames, TRUE);
+	g_free (benchCase->name);
+	g_free (benchCase);
+}
+
+/* ------------------------------------------------------------------ */
+/* Adds a case for path, if it holds layer files, and for every
+   directory below it.  The names are sorted so the cases and their
+   layers are always in the same order */
+static void
+benchmark_add_directory (GPtrArray *cases, const gchar *path)
+{
+	GPtrArray *names = g_ptr_array_new ();
+	benchmark_case_t *benchCase = benchmark_case_new (path);
+	const gchar *name;
+	GDir *dir;
+	guint i;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL) {
+		fprintf (stderr, "Could not read directory %s\n", path);
+		benchmark_case_free (benchCase);
+		g_ptr_array_free (names, TRUE);
+		return;
+	}
+	while ((name = g_dir_read_name (dir)) != NULL)
+		g_ptr_array_add (names, g_strdup (name));
+	g_dir_close (dir);
+	g_ptr_array_sort (names, benchmark_compare_names);
+
+	for (i = 0; i < names->len; i++) {
+		gchar *child = g_build_filename (path,
+				g_ptr_array_index (names, i), NULL);
+
+		if (g_file_test (child, G_FILE_TEST_IS_DIR)) {
+			g_free (child);
+			continue;
+		}
+		if (benchmark_is_layer_file (g_ptr_array_index (names, i)))
+			g_ptr_array_add (benchCase->filenames, child);
+		else
+			g_free (child);
+	}
+
+	if (benchCase->filenames->len > 0)
+		g_ptr_array_add (cases, benchCase);
+	else
+		benchmark_case_free (benchCase);
+
+	for (i = 0; i < names->len; i++) {
+		gchar *child = g_build_filename (path,
+				g_ptr_array_index (names, i), NULL);
+
+		if (g_file_test (child, G_FILE_TEST_IS_DIR))
+			benchmark_add_directory (cases, child);
+		g_free (child);
+	}
+
+	g_ptr_array_foreach (names, (GFunc) g_free, NULL);
+	g_ptr_array_free (names, TRUE);
+}
+
+/* ------------------------------------------------------------------ */
+static gerbv_project_t *
+benchmark_load_case (benchmark_case_t *benchCase, gerbv_layer_file_t *layerFiles)
+{
+	gerbv_project_t *project = gerbv_create_project ();
+	guint i;
+
+	for (i = 0; i < benchCase->filenames->len; i++) {
+		layerFiles[i].filename = g_ptr_array_index (benchCase->filenames, i);
+		layerFiles[i].attr_list = NULL;
+		layerFiles[i].n_attr = 0;
+	}
+	gerbv_open_layers_from_filenames (project, layerFiles,
+			benchCase->filenames->len);
+
+	return project;
+}
+
+/* ------------------------------------------------------------------ */
+/* Drops the files of benchCase which are not layer files, so they do
+   not count in the parse times.  Returns the number of files left */
+static guint
+benchmark_prune_case (benchmark_case_t *benchCase)
+{
+	gerbv_layer_file_t *layerFiles = g_new (gerbv_layer_file_t,
+			benchCase->filenames->len);
+	gerbv_project_t *project;
+	guint i;
+
+	benchmark_empty_image_cache ();
+	project = benchmark_load_case (benchCase, layerFiles);
+	for (i = benchCase->filenames->len; i-- > 0;) {
+		if (layerFiles[i].fileIndex == -1) {
+			g_free (g_ptr_array_index (benchCase->filenames, i));
+			g_ptr_array_remove_index (benchCase->filenames, i);
+		}
+	}
+	gerbv_destroy_project (project);
+	g_free (layerFiles);
+
+	return benchCase->filenames->len;
+}
+
+/* ------------------------------------------------------------------ */
+static GArray *
+benchmark_add_stage (GPtrArray *stages, const gchar *name, gboolean skipped)
+{
+	benchmark_stage_t *stage = g_new (benchmark_stage_t, 1);
+
+	stage->name = g_strdup (name);
+	stage->samples = skipped ? NULL
+		: g_array_sized_new (FALSE, FALSE, sizeof (gint64), iterations);
+	g_ptr_array_add (stages, stage);
+
+	return stage->samples;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_stage_free (benchmark_stage_t *stage)
+{
+	if (stage->samples != NULL)
+		g_array_free (stage->samples, TRUE);
+	g_free (stage->name);
+	g_free (stage);
+}
+
+/* ------------------------------------------------------------------ */
+/* Times loading all files of benchCase into a new project, each time
+   with an empty image cache unless useCache is set */
+static void
+benchmark_parse (benchmark_case_t *benchCase, gboolean useCache,
+		GArray *samples)
+{
+	gerbv_layer_file_t *layerFiles = g_new (gerbv_layer_file_t,
+			benchCase->filenames->len);
+	gerbv_project_t *project;
+	gint64 start;
+	gint i;
+
+	for (i = -1; i < iterations; i++) {
+		if (!useCache)
+			benchmark_empty_image_cache ();
+		start = benchmark_now ();
+		project = benchmark_load_case (benchCase, layerFiles);
+		if (i >= 0)
+			benchmark_add_sample (samples, start);
+		gerbv_destroy_project (project);
+	}
+	g_free (layerFiles);
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_boundingbox (gerbv_project_t *project, GArray *samples)
+{
+	gerbv_render_size_t bb;
+	gint64 start;
+	gint i;
+
+	for (i = -1; i < iterations; i++) {
+		start = benchmark_now ();
+		gerbv_render_get_boundingbox (project, &bb);
+		if (i >= 0)
+			benchmark_add_sample (samples, start);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* Times compiling the report of all layers of layertype, as the
+   analysis dialogs do */
+static void
+benchmark_stats (gerbv_project_t *project, gerbv_layertype_t layertype,
+		GArray *samples)
+{
+	gint64 start;
+	gint i, j;
+
+	for (i = -1; i < iterations; i++) {
+		gerbv_stats_t *stats = NULL;
+		gerbv_drill_stats_t *drillStats = NULL;
+
+		start = benchmark_now ();
+		if (layertype == GERBV_LAYERTYPE_RS274X)
+			stats = gerbv_stats_new ();
+		else
+			drillStats = gerbv_drill_stats_new ();
+		for (j = 0; j <= project->last_loaded; j++) {
+			gerbv_image_t *image = project->file[j]->image;
+
+			if (image->layertype != layertype)
+				continue;
+			if (stats != NULL)
+				gerbv_stats_add_layer (stats, image->gerbv_stats, j + 1);
+			else
+				gerbv_drill_stats_add_layer (drillStats,
+						image->drill_stats, j + 1);
+		}
+		if (i >= 0)
+			benchmark_add_sample (samples, start);
+
+		if (stats != NULL)
+			gerbv_stats_destroy (stats);
+		if (drillStats != NULL)
+			gerbv_drill_stats_destroy (drillStats);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_render (gerbv_project_t *project, gerbv_render_info_t *renderInfo,
+		GArray *samples)
+{
+	gint64 start;
+	gint i;
+
+	if ((renderInfo->renderType == GERBV_RENDER_TYPE_GDK)
+	|| (renderInfo->renderType == GERBV_RENDER_TYPE_GDK_XOR)) {
+		GdkPixmap *pixmap = gdk_pixmap_new (NULL,
+				renderInfo->displayWidth,
+				renderInfo->displayHeight, 24);
+
+		for (i = -1; i < iterations; i++) {
+			start = benchmark_now ();
+			gerbv_render_to_pixmap_using_gdk (project, pixmap,
+					renderInfo, NULL, NULL);
+			/* wait for the X server to draw it */
+			gdk_flush ();
+			if (i >= 0)
+				benchmark_add_sample (samples, start);
+		}
+		gdk_pixmap_unref (pixmap);
+		return;
+	}
+
+#ifndef RENDER_USING_GDK
+	for (i = -1; i < iterations; i++) {
+		cairo_surface_t *surface = cairo_image_surface_create (
+				CAIRO_FORMAT_ARGB32, renderInfo->displayWidth,
+				renderInfo->displayHeight);
+		cairo_t *cr = cairo_create (surface);
+
+		start = benchmark_now ();
+		gerbv_render_all_layers_to_cairo_target (project, cr, renderInfo);
+		cairo_surface_flush (surface);
+		if (i >= 0)
+			benchmark_add_sample (samples, start);
+
+		cairo_destroy (cr);
+		cairo_surface_destroy (surface);
+	}
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_export (gerbv_project_t *project, gerbv_render_info_t *renderInfo,
+		benchmark_export_t type, GArray *samples)
+{
+	gchar *filename;
+	gint64 start;
+	gint i, j;
+
+	for (i = -1; i < iterations; i++) {
+		start = benchmark_now ();
+		switch (type) {
+		case BENCHMARK_EXPORT_PNG:
+			filename = g_build_filename (scratchDir, "export.png", NULL);
+			gerbv_export_png_file_from_project (project, renderInfo,
+					filename);
+			break;
+		case BENCHMARK_EXPORT_PDF:
+			filename = g_build_filename (scratchDir, "export.pdf", NULL);
+			gerbv_export_pdf_file_from_project (project, renderInfo,
+					filename);
+			break;
+		case BENCHMARK_EXPORT_SVG:
+			filename = g_build_filename (scratchDir, "export.svg", NULL);
+			gerbv_export_svg_file_from_project (project, renderInfo,
+					filename);
+			break;
+		case BENCHMARK_EXPORT_RS274X:
+		default:
+			filename = g_build_filename (scratchDir, "export.gbx", NULL);
+			for (j = 0; j <= project->last_loaded; j++) {
+				if (project->file[j]->image->layertype
+						== GERBV_LAYERTYPE_RS274X)
+					gerbv_export_rs274x_file_from_image (filename,
+						project->file[j]->image,
+						&project->file[j]->transform);
+			}
+			break;
+		}
+		if (i >= 0)
+			benchmark_add_sample (samples, start);
+		g_remove (filename);
+		g_free (filename);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+benchmark_has_layertype (gerbv_project_t *project, gerbv_layertype_t layertype)
+{
+	gint i;
+
+	for (i = 0; i <= project->last_loaded; i++) {
+		if (project->file[i]->image->layertype == layertype)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------ */
+/* Runs every stage on benchCase.  Returns the stages, or NULL if none
+   of its files could be loaded */
+static GPtrArray *
+benchmark_run_case (benchmark_case_t *benchCase)
+{
+	static const struct {
+		const gchar *name;
+		gerbv_render_types_t type;
+	} renderTypes[] = {
+		{"gdk", GERBV_RENDER_TYPE_GDK},
+		{"gdk_xor", GERBV_RENDER_TYPE_GDK_XOR},
+		{"cairo_normal", GERBV_RENDER_TYPE_CAIRO_NORMAL},
+		{"cairo_high_quality", GERBV_RENDER_TYPE_CAIRO_HIGH_QUALITY}
+	};
+	static const struct {
+		const gchar *name;
+		benchmark_export_t type;
+	} exportTypes[] = {
+		{"export_png", BENCHMARK_EXPORT_PNG},
+		{"export_pdf", BENCHMARK_EXPORT_PDF},
+		{"export_svg", BENCHMARK_EXPORT_SVG},
+		{"export_rs274x", BENCHMARK_EXPORT_RS274X}
+	};
+	gerbv_render_info_t fitInfo = {1.0, 1.0, 0, 0,
+		GERBV_RENDER_TYPE_CAIRO_NORMAL, width, height};
+	gerbv_render_info_t renderInfo;
+	gerbv_layer_file_t *layerFiles;
+	gerbv_project_t *project;
+	GPtrArray *stages;
+	gboolean skipped;
+	guint i;
+
+	if (benchmark_prune_case (benchCase) == 0)
+		return NULL;
+
+	stages = g_ptr_array_new ();
+	if (verbose)
+		fprintf (stderr, "Benchmarking %s\n", benchCase->name);
+
+	benchmark_parse (benchCase, FALSE,
+			benchmark_add_stage (stages, "parse", FALSE));
+	benchmark_parse (benchCase, TRUE,
+			benchmark_add_stage (stages, "parse_cached", FALSE));
+
+	/* the rest of the stages all work on one project */
+	layerFiles = g_new (gerbv_layer_file_t, benchCase->filenames->len);
+	project = benchmark_load_case (benchCase, layerFiles);
+	g_free (layerFiles);
+
+	benchmark_boundingbox (project,
+			benchmark_add_stage (stages, "boundingbox", FALSE));
+	benchmark_stats (project, GERBV_LAYERTYPE_RS274X,
+			benchmark_add_stage (stages, "stats_gerber",
+				!benchmark_has_layertype (project,
+					GERBV_LAYERTYPE_RS274X)));
+	benchmark_stats (project, GERBV_LAYERTYPE_DRILL,
+			benchmark_add_stage (stages, "stats_drill",
+				!benchmark_has_layertype (project,
+					GERBV_LAYERTYPE_DRILL)));
+
+	gerbv_render_zoom_to_fit_display (project, &fitInfo);
+	for (i = 0; i < G_N_ELEMENTS (renderTypes); i++) {
+		gchar *name;
+
+		skipped = ((renderTypes[i].type == GERBV_RENDER_TYPE_GDK)
+			|| (renderTypes[i].type == GERBV_RENDER_TYPE_GDK_XOR))
+			? !haveDisplay : FALSE;
+#ifdef RENDER_USING_GDK
+		if (!skipped)
+			skipped = (renderTypes[i].type
+				!= GERBV_RENDER_TYPE_GDK)
+				&& (renderTypes[i].type
+				!= GERBV_RENDER_TYPE_GDK_XOR);
+#endif
+		renderInfo = fitInfo;
+		renderInfo.renderType = renderTypes[i].type;
+		/* the render stages stand for the screen, the exports don't */
+		renderInfo.allowCoarseNets = TRUE;
+		name = g_strconcat ("render_", renderTypes[i].name, "_fit", NULL);
+		if (!skipped)
+			benchmark_render (project, &renderInfo,
+					benchmark_add_stage (stages, name, FALSE));
+		else
+			benchmark_add_stage (stages, name, TRUE);
+		g_free (name);
+
+		/* zoom in on the middle of the board */
+		renderInfo.lowerLeftX += (width / renderInfo.scaleFactorX)
+			* (1.0 - 1.0 / BENCHMARK_ZOOM) / 2.0;
+		renderInfo.lowerLeftY += (height / renderInfo.scaleFactorY)
+			* (1.0 - 1.0 / BENCHMARK_ZOOM) / 2.0;
+		renderInfo.scaleFactorX *= BENCHMARK_ZOOM;
+		renderInfo.scaleFactorY *= BENCHMARK_ZOOM;
+		name = g_strconcat ("render_", renderTypes[i].name, "_zoom", NULL);
+		if (!skipped)
+			benchmark_render (project, &renderInfo,
+					benchmark_add_stage (stages, name, FALSE));
+		else
+			benchmark_add_stage (stages, name, TRUE);
+		g_free (name);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (exportTypes); i++) {
+		skipped = (exportTypes[i].type == BENCHMARK_EXPORT_RS274X)
+			&& !benchmark_has_layertype (project,
+					GERBV_LAYERTYPE_RS274X);
+#ifdef RENDER_USING_GDK
+		if (exportTypes[i].type != BENCHMARK_EXPORT_RS274X)
+			skipped = TRUE;
+#endif
+		if (!skipped)
+			benchmark_export (project, &fitInfo, exportTypes[i].type,
+				benchmark_add_stage (stages, exportTypes[i].name,
+					FALSE));
+		else
+			benchmark_add_stage (stages, exportTypes[i].name, TRUE);
+	}
+
+	gerbv_destroy_project (project);
+
+	return stages;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_write_string (FILE *fd, const gchar *string)
+{
+	const guchar *c;
+
+	fputc ('"', fd);
+	for (c = (const guchar *) string; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\')
+			fprintf (fd, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf (fd, "\\u%04x", *c);
+		else
+			fputc (*c, fd);
+	}
+	fputc ('"', fd);
+}
+
+/* ------------------------------------------------------------------ */
+/* Writes nanoseconds as milliseconds, always with a decimal point */
+static void
+benchmark_write_ms (FILE *fd, const gchar *key, gdouble nanoseconds)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+	fprintf (fd, "\"%s\": %s", key,
+			g_ascii_formatd (buffer, sizeof (buffer), "%.4f",
+				nanoseconds / 1e6));
+}
+
+/* ------------------------------------------------------------------ */
+static gint
+benchmark_compare_samples (gconstpointer a, gconstpointer b)
+{
+	gint64 sampleA = *(const gint64 *) a, sampleB = *(const gint64 *) b;
+
+	return (sampleA > sampleB) - (sampleA < sampleB);
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_write_stage (FILE *fd, benchmark_stage_t *stage)
+{
+	GArray *samples = stage->samples;
+	gdouble sum = 0;
+	gchar key[8];
+	guint i, rank;
+
+	fprintf (fd, "        ");
+	benchmark_write_string (fd, stage->name);
+	if (samples == NULL || samples->len == 0) {
+		fprintf (fd, ": null");
+		return;
+	}
+
+	g_array_sort (samples, benchmark_compare_samples);
+	for (i = 0; i < samples->len; i++)
+		sum += g_array_index (samples, gint64, i);
+
+	fprintf (fd, ": {\"samples\": %u, ", samples->len);
+	benchmark_write_ms (fd, "min_ms", g_array_index (samples, gint64, 0));
+	fprintf (fd, ", ");
+	benchmark_write_ms (fd, "mean_ms", sum / samples->len);
+	for (i = 0; i < G_N_ELEMENTS (benchmark_percentiles); i++) {
+		/* nearest rank */
+		rank = (guint) ceil (benchmark_percentiles[i] / 100.0
+				* samples->len);
+		g_snprintf (key, sizeof (key), "p%d_ms", benchmark_percentiles[i]);
+		fprintf (fd, ", ");
+		benchmark_write_ms (fd, key,
+				g_array_index (samples, gint64, MAX (rank, 1) - 1));
+	}
+	fprintf (fd, ", ");
+	benchmark_write_ms (fd, "max_ms",
+			g_array_index (samples, gint64, samples->len - 1));
+	fprintf (fd, "}");
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_write_rss (FILE *fd, glong peakRss)
+{
+	if (peakRss < 0)
+		fprintf (fd, "\"peak_rss_kb\": null");
+	else
+		fprintf (fd, "\"peak_rss_kb\": %ld", peakRss);
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_quiet_log (const gchar *domain, GLogLevelFlags level,
+		const gchar *message, gpointer data)
+{
+}
+
+/* ------------------------------------------------------------------ */
+static void
+benchmark_usage (void)
+{
+	fprintf (stderr, "Usage: gerbv-benchmark [OPTIONS] FILE|DIRECTORY...\n");
+	fprintf (stderr, "Times parsing, rendering and exporting of every file, and of\n"
+			"every directory of layer files, and writes the times as JSON.\n\n");
+	fprintf (stderr, "  -n <count>  Timed runs of every stage (default %d)\n",
+			BENCHMARK_DEFAULT_ITERATIONS);
+	fprintf (stderr, "  -W <pixels> Width of the rendered view (default %d)\n",
+			BENCHMARK_DEFAULT_WIDTH);
+	fprintf (stderr, "  -H <pixels> Height of the rendered view (default %d)\n",
+			BENCHMARK_DEFAULT_HEIGHT);
+	fprintf (stderr, "  -o <file>   Write the JSON to file instead of stdout\n");
+	fprintf (stderr, "  -v          Show the progress and the parser messages\n");
+}
+
+/* ------------------------------------------------------------------ */
+int
+main (int argc, char *argv[])
+{
+	const gchar *outputFilename = NULL;
+	GPtrArray *cases;
+	FILE *fd = stdout;
+	gboolean firstCase = TRUE;
+	guint i, j;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "n:W:H:o:vh")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = atoi (optarg);
+			break;
+		case 'W':
+			width = atoi (optarg);
+			break;
+		case 'H':
+			height = atoi (optarg);
+			break;
+		case 'o':
+			outputFilename = optarg;
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			benchmark_usage ();
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
+	if (optind >= argc || iterations < 1 || width < 1 || height < 1) {
+		benchmark_usage ();
+		return 1;
+	}
+
+	if (!benchmark_make_scratch_dir ()) {
+		fprintf (stderr, "Could not create a temporary directory\n");
+		return 1;
+	}
+
+	/* the GDK render types are timed only if there is a display */
+	haveDisplay = gdk_init_check (&argc, &argv);
+
+	if (!verbose) {
+		g_log_set_handler (NULL, G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING
+				| G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_INFO
+				| G_LOG_LEVEL_DEBUG, benchmark_quiet_log, NULL);
+	}
+
+	cases = g_ptr_array_new ();
+	for (i = optind; i < (guint) argc; i++) {
+		if (g_file_test (argv[i], G_FILE_TEST_IS_DIR)) {
+			benchmark_add_directory (cases, argv[i]);
+		} else if (g_file_test (argv[i], G_FILE_TEST_EXISTS)) {
+			benchmark_case_t *benchCase = benchmark_case_new (argv[i]);
+
+			g_ptr_array_add (benchCase->filenames, g_strdup (argv[i]));
+			g_ptr_array_add (cases, benchCase);
+		} else {
+			fprintf (stderr, "%s does not exist\n", argv[i]);
+		}
+	}
+
+	if (outputFilename != NULL) {
+		fd = g_fopen (outputFilename, "w");
+		if (fd == NULL) {
+			fprintf (stderr, "Could not open %s for writing\n",
+					outputFilename);
+			benchmark_remove_tree (scratchDir);
+			return 1;
+		}
+	}
+
+	fprintf (fd, "{\n  \"version\": ");
+	benchmark_write_string (fd, VERSION);
+	fprintf (fd, ",\n  \"iterations\": %d,\n  \"width\": %d,\n"
+			"  \"height\": %d,\n  \"display\": %s,\n  \"cases\": [",
+			iterations, width, height, haveDisplay ? "true" : "false");
+
+	for (i = 0; i < cases->len; i++) {
+		benchmark_case_t *benchCase = g_ptr_array_index (cases, i);
+		GPtrArray *stages = benchmark_run_case (benchCase);
+
+		if (stages == NULL) {
+			if (verbose)
+				fprintf (stderr, "Skipping %s, no layer files\n",
+						benchCase->name);
+			benchmark_case_free (benchCase);
+			continue;
+		}
+
+		fprintf (fd, "%s\n    {\"name\": ", firstCase ? "" : ",");
+		firstCase = FALSE;
+		benchmark_write_string (fd, benchCase->name);
+		fprintf (fd, ", \"layers\": %u, ", benchCase->filenames->len);
+		/* the peak so far, so a case raising it shows its own size */
+		benchmark_write_rss (fd, benchmark_peak_rss ());
+		fprintf (fd, ",\n      \"stages\": {\n");
+		for (j = 0; j < stages->len; j++) {
+			benchmark_write_stage (fd, g_ptr_array_index (stages, j));
+			fprintf (fd, "%s\n", (j + 1 < stages->len) ? "," : "");
+			benchmark_stage_free (g_ptr_array_index (stages, j));
+		}
+		fprintf (fd, "      }\n    }");
+		fflush (fd);
+
+		g_ptr_array_free (stages, TRUE);
+		benchmark_case_free (benchCase);
+	}
+	g_ptr_array_free (cases, TRUE);
+
+	fprintf (fd, "\n  ],\n  ");
+	benchmark_write_rss (fd, benchmark_peak_rss ());
+	fprintf (fd, "\n}\n");
+	if (fd != stdout)
+		fclose (fd);
+
+	benchmark_remove_tree (scratchDir);
+	g_free (imageCacheDir);
+	g_free (scratchDir);
+
+	return 0;
+}
@@ -89,7 +89,7 @@ static void show_no_layers_warning (void);
 static double screen_units(double);
 static double line_length(double, double, double, double);
 static double arc_length(double, double);
-static void aperture_report(gerbv_aperture_t *[], int);
+static void aperture_report(gerbv_image_t *, int);
 static void update_selected_object_message (gboolean userTriedToSelect);
 
 
@@ -140,6 +140,7 @@ callbacks_new_project_activate (GtkMenuItem *menuitem, gpointer user_data)
 			return;
 	}
 	/* Unload all layers and then clear layer window */
+	render_wait_for_tile_workers ();
 	gerbv_unload_all_layers (mainProject);
 	callbacks_update_layer_tree ();
 	selection_clear (&screen.selectionInfo);
@@ -209,6 +210,7 @@ callbacks_open_project_activate               (GtkMenuItem     *menuitem,
 	gtk_widget_destroy (screen.win.gerber);
 
 	if (filename) {
+		render_wait_for_tile_workers ();
 		gerbv_unload_all_layers (mainProject);
 		main_open_project_from_filename (mainProject, filename);
 	}
@@ -271,6 +273,7 @@ callbacks_open_layer_activate                 (GtkMenuItem     *menuitem,
 void
 callbacks_revert_activate (GtkMenuItem *menuitem, gpointer user_data)
 {
+	render_wait_for_tile_workers ();
 	gerbv_revert_all_files (mainProject);
 	selection_clear (&screen.selectionInfo);
 	update_selected_object_message (FALSE);
@@ -314,25 +317,19 @@ callbacks_save_layer_activate                       (GtkMenuItem     *menuitem,
   callbacks_update_layer_tree();
   return;
 }
-struct l_image_info {
-	gerbv_image_t *image;
-	gerbv_user_transformation_t *transform;
-};
-
 /* --------------------------------------------------------- */
 /**Go through each file and look at visibility, then type.
 Make sure we have at least 2 files.
 */
 gerbv_image_t *merge_images (int type)
 {
-	gint i, filecount, img;
+	gint i, filecount;
 	gerbv_image_t *out;
-	struct l_image_info {
-		gerbv_image_t *image;
-		gerbv_user_transformation_t *transform;
-	} *images;
+	gerbv_image_t **images;
+	gerbv_user_transformation_t **transforms;
 	
-	images=(struct l_image_info *)g_new0(struct l_image_info,1);
+	images = g_new (gerbv_image_t *, mainProject->max_files);
+	transforms = g_new (gerbv_user_transformation_t *, mainProject->max_files);
 	out = NULL;
 	switch(type){
 		case CALLBACKS_SAVE_FILE_DRILLM:
@@ -346,14 +343,12 @@ gerbv_image_t *merge_images (int type)
 			goto err;
 	}
 	dprintf("Looking for matching files\n");
-	for (i = img = filecount = 0; i < mainProject->max_files; ++i) {
+	for (i = filecount = 0; i < mainProject->max_files; ++i) {
 		if (mainProject->file[i] &&  mainProject->file[i]->isVisible &&
 		(mainProject->file[i]->image->layertype == type)) {
-			++filecount;
 			dprintf("Adding '%s'\n", mainProject->file[i]->name);
-			images[img].image=mainProject->file[i]->image;
-			images[img++].transform=&mainProject->file[i]->transform;
-			images = (struct l_image_info *)g_renew(struct l_image_info, images, img+1);
+			images[filecount] = mainProject->file[i]->image;
+			transforms[filecount++] = &mainProject->file[i]->transform;
 		}
 	}
 	if (filecount < 2) {
@@ -361,19 +356,10 @@ gerbv_image_t *merge_images (int type)
 		goto err;
 	}
 	dprintf("Now merging files\n");
-	for (i = 0; i < img; ++i) {
-		gerbv_user_transformation_t *thisTransform;
-		gerbv_user_transformation_t identityTransform = {0,0,1,1,0,FALSE,FALSE,FALSE};
-		thisTransform=images[i].transform;
-		if (NULL == thisTransform)
-			thisTransform = &identityTransform;
-		if (0 == i)
-			out = gerbv_image_duplicate_image(images[i].image, thisTransform);
-		else
-			gerbv_image_copy_image(images[i].image, thisTransform, out);
-	}
+	out = gerbv_image_merge_images (images, transforms, filecount);
 err:
 	g_free(images);
+	g_free(transforms);
 	return out;
 }
 
@@ -742,7 +728,7 @@ callbacks_fit_to_window_activate              (GtkMenuItem     *menuitem,
                                         gpointer         user_data)
 {
 	gerbv_render_zoom_to_fit_display (mainProject, &screenRenderInfo);
-	render_refresh_rendered_image_on_screen();
+	render_refresh_view_on_screen();
 }
 
 /* --------------------------------------------------------- */
@@ -1476,6 +1462,7 @@ callbacks_quit_activate                       (GtkMenuItem     *menuitem,
     return TRUE; // stop propagation of the delete_event.
 	// this would destroy the gui but not return from the gtk event loop.
   }
+  render_wait_for_tile_workers ();
   gerbv_unload_all_layers (mainProject);
   gtk_main_quit();
   return FALSE; // more or less... meaningless :)
@@ -1764,7 +1751,7 @@ callbacks_scrollbar_button_released (GtkWidget *widget, GdkEventButton *event){
 	screen.off_x = 0;
 	screen.off_y = 0;
 	screen.state = NORMAL;
-	render_refresh_rendered_image_on_screen();
+	render_refresh_view_on_screen();
 	return FALSE;
 }
 
@@ -2045,6 +2032,7 @@ callbacks_remove_layer_button_clicked (GtkButton *button, gpointer user_data)
 		render_remove_selected_objects_belonging_to_layer (&screen.selectionInfo, mainProject->file[index]->image);
 		update_selected_object_message (FALSE);
 
+		render_wait_for_tile_workers ();
 		gerbv_unload_layer (mainProject, index);
 		callbacks_update_layer_tree ();
 		callbacks_select_row (0);
@@ -2240,6 +2228,7 @@ callbacks_reload_layer_clicked (GtkButton *button, gpointer user_data)
 			&screen.selectionInfo, mainProject->file[index]->image);
 	update_selected_object_message (FALSE);
 
+	render_wait_for_tile_workers ();
 	gerbv_revert_file (mainProject, index);
 	render_refresh_rendered_image_on_screen ();
 	callbacks_update_layer_tree();
@@ -2343,6 +2332,7 @@ callbacks_change_layer_format_clicked  (GtkButton *button, gpointer   user_data)
     }
 
     dprintf ("%s(): reloading layer\n", __func__);
+    render_wait_for_tile_workers ();
     gerbv_revert_file (mainProject, index);
 
     for (i = 0; i < n; i++)
@@ -2595,7 +2585,8 @@ callbacks_display_object_properties_clicked (GtkButton *button, gpointer user_da
 		gboolean show_length;
 
 		/* get the aperture definition for the selected item */
-		if (net->aperture > 0) {
+		if ((net->aperture > 0)
+		&& (gerbv_image_get_aperture (image, net->aperture) != NULL)) {
 			validAperture = TRUE;
 		} else {
 			validAperture = FALSE;
@@ -2654,7 +2645,7 @@ callbacks_display_object_properties_clicked (GtkButton *button, gpointer user_da
 					}
 					g_message (_("    Exposure: On"));
 					if (validAperture) {
-						aperture_report(image->aperture, net->aperture);
+						aperture_report(image, net->aperture);
 					}
 
 					x = net->start_x;
@@ -2705,7 +2696,7 @@ callbacks_display_object_properties_clicked (GtkButton *button, gpointer user_da
 					if (i != 0) g_message (" ");  /* Spacing for a pretty display */
 					g_message (_("Object type: Flashed aperture"));
 					if (validAperture) {
-						aperture_report(image->aperture, net->aperture);
+						aperture_report(image, net->aperture);
 					}
 
 					x = net->stop_x;
@@ -2725,35 +2716,34 @@ callbacks_display_object_properties_clicked (GtkButton *button, gpointer user_da
 	g_message ("---------------------------------------");
 }
 
+/* Redraws timed by each benchmark run.  gerbv-benchmark (see benchmark.c)
+   times everything else, and reproducibly */
+#define BENCHMARK_REDRAWS 20
+
 void
 callbacks_support_benchmark (gerbv_render_info_t *renderInfo) {
 	int i;
-	time_t start, now;
+	gdouble elapsed;
+	GTimer *timer = g_timer_new ();
 	GdkPixmap *renderedPixmap = gdk_pixmap_new (NULL, renderInfo->displayWidth,
 								renderInfo->displayHeight, 24);
 								
 	// start by running the GDK (fast) rendering test
-	i = 0;
-	start = time(NULL);
-	now = start;
-	while( now - 30 < start) {
-		i++;
+	g_timer_start (timer);
+	for (i = 0; i < BENCHMARK_REDRAWS; i++) {
 		dprintf("Benchmark():  Starting redraw #%d\n", i);
 		gerbv_render_to_pixmap_using_gdk (mainProject, renderedPixmap, renderInfo, NULL, NULL);
-		now = time(NULL);
-		dprintf("Elapsed time = %ld seconds\n", (long int) (now - start));
 	}
-	g_message(_("FAST (=GDK) mode benchmark: %d redraws in %ld seconds (%g redraws/second)\n"),
-		      i, (long int) (now - start), (double) i / (double)(now - start));
+	gdk_flush ();
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_message(_("FAST (=GDK) mode benchmark: %d redraws in %.3f seconds (%g ms/redraw)\n"),
+		      i, elapsed, elapsed * 1000.0 / i);
 	gdk_pixmap_unref(renderedPixmap);
 	
 	// run the cairo (normal) render mode
-	i = 0;
-	start = time(NULL);
-	now = start;
 	renderInfo->renderType = GERBV_RENDER_TYPE_CAIRO_NORMAL;
-	while( now - 30 < start) {
-		i++;
+	g_timer_start (timer);
+	for (i = 0; i < BENCHMARK_REDRAWS; i++) {
 		dprintf("Benchmark():  Starting redraw #%d\n", i);
 		cairo_surface_t *cSurface = cairo_image_surface_create  (CAIRO_FORMAT_ARGB32,
 	                              renderInfo->displayWidth, renderInfo->displayHeight);
@@ -2761,11 +2751,11 @@ callbacks_support_benchmark (gerbv_render_info_t *renderInfo) {
 		gerbv_render_all_layers_to_cairo_target (mainProject, cairoTarget, renderInfo);
 		cairo_destroy (cairoTarget);
 		cairo_surface_destroy (cSurface);
-		now = time(NULL);
-		dprintf("Elapsed time = %ld seconds\n", (long int) (now - start));
 	}
-	g_message(_("NORMAL (=Cairo) mode benchmark: %d redraws in %ld seconds (%g redraws/second)\n"),
-		      i, (long int) (now - start), (double) i / (double)(now - start));
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_message(_("NORMAL (=Cairo) mode benchmark: %d redraws in %.3f seconds (%g ms/redraw)\n"),
+		      i, elapsed, elapsed * 1000.0 / i);
+	g_timer_destroy (timer);
 }
 
 /* --------------------------------------------------------------------------- */
@@ -2800,22 +2790,37 @@ callbacks_edit_object_properties_clicked (GtkButton *button, gpointer   user_dat
 /* --------------------------------------------------------------------------- */
 void
 callbacks_move_objects_clicked (GtkButton *button, gpointer   user_data){
+	GArray *dirtyBoxes = g_array_new (FALSE, FALSE,
+			sizeof (render_dirty_box_t));
+
+	/* redraw where the objects were and where they went */
+	render_dirty_boxes_add_selection (dirtyBoxes, &screen.selectionInfo);
 	/* for testing, just hard code in some translations here */
+	render_wait_for_tile_workers ();
 	gerbv_image_move_selected_objects (screen.selectionInfo.selectedNodeArray, -0.050, 0.050);
+	render_dirty_boxes_add_selection (dirtyBoxes, &screen.selectionInfo);
 	callbacks_update_layer_tree();
 	selection_clear (&screen.selectionInfo);
 	update_selected_object_message (FALSE);
-	render_refresh_rendered_image_on_screen ();
+	render_refresh_dirty_boxes_on_screen (dirtyBoxes);
+	g_array_free (dirtyBoxes, TRUE);
 }
 
 /* --------------------------------------------------------------------------- */
 void
 callbacks_reduce_object_area_clicked  (GtkButton *button, gpointer user_data){
+	GArray *dirtyBoxes = g_array_new (FALSE, FALSE,
+			sizeof (render_dirty_box_t));
+
+	/* the panes replacing an object stay inside its old area */
+	render_dirty_boxes_add_selection (dirtyBoxes, &screen.selectionInfo);
 	/* for testing, just hard code in some parameters */
+	render_wait_for_tile_workers ();
 	gerbv_image_reduce_area_of_selected_objects (screen.selectionInfo.selectedNodeArray, 0.20, 3, 3, 0.01);
 	selection_clear (&screen.selectionInfo);
 	update_selected_object_message (FALSE);
-	render_refresh_rendered_image_on_screen ();
+	render_refresh_dirty_boxes_on_screen (dirtyBoxes);
+	g_array_free (dirtyBoxes, TRUE);
 }
 
 /* --------------------------------------------------------------------------- */
@@ -2850,7 +2855,11 @@ callbacks_delete_objects_clicked (GtkButton *button, gpointer user_data)
 		}
 	}
 
+	GArray *dirtyBoxes = g_array_new (FALSE, FALSE,
+			sizeof (render_dirty_box_t));
 	guint i;
+
+	render_wait_for_tile_workers ();
 	for (i = 0; i < selection_length (&screen.selectionInfo);) {
 		gerbv_selection_item_t sel_item =
 			selection_get_item_by_index (&screen.selectionInfo, i);
@@ -2864,12 +2873,16 @@ callbacks_delete_objects_clicked (GtkButton *button, gpointer user_data)
 		}
 
 		file_info->layer_dirty = TRUE;
+		render_dirty_boxes_add_net (dirtyBoxes, sel_item.image,
+				sel_item.net);
 		selection_clear_item_by_index (&screen.selectionInfo, i);
-		gerbv_image_delete_net (sel_item.net);
+		gerbv_image_delete_net_from_image (sel_item.image,
+				sel_item.net);
 	}
 	update_selected_object_message (FALSE);
 
-	render_refresh_rendered_image_on_screen ();
+	render_refresh_dirty_boxes_on_screen (dirtyBoxes);
+	g_array_free (dirtyBoxes, TRUE);
 	callbacks_update_layer_tree();
 }
 
@@ -2916,7 +2929,7 @@ callbacks_drawingarea_configure_event (GtkWidget *widget, GdkEventConfigure *eve
 	if ((screenRenderInfo.scaleFactorX < 0.001)||(screenRenderInfo.scaleFactorY < 0.001)) {
 		gerbv_render_zoom_to_fit_display (mainProject, &screenRenderInfo);
 	}
-	render_refresh_rendered_image_on_screen();
+	render_refresh_view_on_screen();
 	return TRUE;
 }
 
@@ -3420,7 +3433,7 @@ callbacks_drawingarea_button_release_event (GtkWidget *widget, GdkEventButton *e
 	case IN_MOVE:
 		screen.off_x = 0;
 		screen.off_y = 0;
-		render_refresh_rendered_image_on_screen ();
+		render_refresh_view_on_screen ();
 		callbacks_switch_to_normal_tool_cursor (screen.tool);
 		break;
 
@@ -3645,6 +3658,22 @@ callbacks_clear_messages_button_clicked  (GtkButton *button, gpointer   user_dat
 	gtk_text_buffer_delete (textbuffer, &start, &end);
 }
             
+/* --------------------------------------------------------- */
+/* Shows a message logged from a worker thread once the main loop is idle */
+static gboolean
+callbacks_handle_deferred_log_message (gpointer data)
+{
+	struct log_struct *item = data;
+
+	callbacks_handle_log_messages (item->domain, item->level,
+			item->message, NULL);
+	g_free (item->domain);
+	g_free (item->message);
+	g_free (item);
+
+	return FALSE;
+}
+
 /* --------------------------------------------------------- */
 void
 callbacks_handle_log_messages(const gchar *log_domain, GLogLevelFlags log_level,
@@ -3657,6 +3686,17 @@ callbacks_handle_log_messages(const gchar *log_domain, GLogLevelFlags log_level,
 	GtkTextIter StartIter, StopIter;
 	GtkWidget *dialog, *label;
 
+	/* the widgets may only be touched from the main thread */
+	if (screen.mainThread && g_thread_self () != screen.mainThread) {
+		struct log_struct *item = g_new (struct log_struct, 1);
+
+		item->domain = g_strdup (log_domain);
+		item->level = log_level;
+		item->message = g_strdup (message);
+		g_idle_add (callbacks_handle_deferred_log_message, item);
+		return;
+	}
+
 	if (!screen.win.messageTextView)
 		return;
 		
@@ -3819,16 +3859,16 @@ static double arc_length(double dia, double angle) {
 	return M_PI*dia*(angle/360.0);
 }
 
-static void aperture_report(gerbv_aperture_t *apertures[], int aperture_num)
+static void aperture_report(gerbv_image_t *image, int aperture_num)
 {
-	gerbv_aperture_type_t type = apertures[aperture_num]->type;
-	double *params = apertures[aperture_num]->parameter;
+	gerbv_aperture_t *aperture = gerbv_image_get_aperture (image, aperture_num);
+	gerbv_aperture_type_t type = aperture->type;
+	double *params = aperture->parameter;
 
 	g_message (_("    Aperture used: D%d"), aperture_num);
 	g_message (_("    Aperture type: %s"),
 		(type == GERBV_APTYPE_MACRO)?
-			_(aperture_names[apertures[
-					aperture_num]->simplified->type]):
+			_(aperture_names[aperture->simplified->type]):
 			_(aperture_names[type]));
 
 	switch (type) {
@@ -42,6 +42,8 @@
 #include "gerbv.h"
 #include "draw-gdk.h"
 #include "common.h"
+#include "selection.h"
+#include "net_index.h"
 
 #undef round
 #define round(x) ceil((double)(x))
@@ -719,91 +721,32 @@ gerbv_gdk_draw_arc(GdkPixmap *pixmap, GdkGC *gc,
 } /* gerbv_gdk_draw_arc */
 
 void
-draw_gdk_render_polygon_object (gerbv_net_t *oldNet, gerbv_image_t *image, double sr_x, double sr_y,
-			cairo_matrix_t *fullMatrix, cairo_matrix_t *scaleMatrix, GdkGC *gc, GdkGC *pgc,
+draw_gdk_render_polygon_object (const net_index_polygon_t *polygon, double sr_x, double sr_y,
+			cairo_matrix_t *fullMatrix, GdkGC *gc, GdkGC *pgc,
 			GdkPixmap **pixmap) {
-	gerbv_net_t *currentNet;
-	gint x2,y2,cp_x=0,cp_y=0,cir_width=0;
-	GdkPoint *points = NULL;
-	int pointArraySize=0;
-	int curr_point_idx = 0;
-	int steps,i;
-	gdouble angleDiff, tempX, tempY;
-
-	/* save the first net in the polygon as the "ID" net pointer
-	in case we are saving this net to the selection array */
-	curr_point_idx = 0;
-	pointArraySize = 0;
-
-	for (currentNet = oldNet->next; currentNet!=NULL; currentNet = currentNet->next){	
-		tempX = currentNet->stop_x + sr_x;
-		tempY = currentNet->stop_y + sr_y;
-		cairo_matrix_transform_point (fullMatrix, &tempX, &tempY);
-		x2 = (int)round(tempX);
-		y2 = (int)round(tempY);
-		
-		/* 
-		* If circle segment, scale and translate that one too
-		*/
-		if (currentNet->cirseg) {
-			tempX = currentNet->cirseg->width;
-			tempY = currentNet->cirseg->height;
-			cairo_matrix_transform_point (scaleMatrix, &tempX, &tempY);
-			cir_width = (int)round(tempX);
-
-			tempX = currentNet->cirseg->cp_x + sr_x;
-			tempY = currentNet->cirseg->cp_y + sr_y;
-			cairo_matrix_transform_point (fullMatrix, &tempX, &tempY);
-			cp_x = (int)round(tempX);
-			cp_y = (int)round(tempY);
-		}
+	GdkPoint *points;
+	guint i;
+	gdouble tempX, tempY;
 
-		switch (currentNet->interpolation) {
-			case GERBV_INTERPOLATION_x10 :
-			case GERBV_INTERPOLATION_LINEARx01 :
-			case GERBV_INTERPOLATION_LINEARx001 :
-			case GERBV_INTERPOLATION_LINEARx1 :
-				if (pointArraySize < (curr_point_idx + 1)) {
-					points = (GdkPoint *)g_realloc(points,sizeof(GdkPoint) *  (curr_point_idx + 1));
-					pointArraySize = (curr_point_idx + 1);
-				}
-				points[curr_point_idx].x = x2;
-				points[curr_point_idx].y = y2;
-				curr_point_idx++;
-				break;
-			case GERBV_INTERPOLATION_CW_CIRCULAR :
-			case GERBV_INTERPOLATION_CCW_CIRCULAR :
-				/* we need to chop up the arc into small lines for rendering
-				with GDK */
-				angleDiff = currentNet->cirseg->angle2 - currentNet->cirseg->angle1;
-				steps = (int) abs(angleDiff);
-				if (pointArraySize < (curr_point_idx + steps)) {
-					points = (GdkPoint *)g_realloc(points,sizeof(GdkPoint) *  (curr_point_idx + steps));
-					pointArraySize = (curr_point_idx + steps);
-				}
-				for (i=0; i<steps; i++){
-					points[curr_point_idx].x = cp_x + cir_width / 2.0 * cos (DEG2RAD(currentNet->cirseg->angle1 +
-									      (angleDiff * i) / steps));
-					points[curr_point_idx].y = cp_y - cir_width / 2.0 * sin (DEG2RAD(currentNet->cirseg->angle1 +
-									      (angleDiff * i) / steps));
-					curr_point_idx++;
-				}
-				break;
-			case GERBV_INTERPOLATION_PAREA_END :
-				gdk_gc_copy(pgc, gc); 
-				gdk_gc_set_line_attributes(pgc, 1, 
-				       GDK_LINE_SOLID, 
-				       GDK_CAP_PROJECTING, 
-				       GDK_JOIN_MITER);
-				gdk_draw_polygon(*pixmap, pgc, 1, points, curr_point_idx);
-				g_free(points);
-				points = NULL;
-				return;
-			default:
-				break;
-		}
+	if (polygon->count == 0)
+		return;
+
+	points = g_new (GdkPoint, polygon->count);
+	for (i = 0; i < polygon->count; i++) {
+		tempX = polygon->points[2*i] + sr_x;
+		tempY = polygon->points[2*i + 1] + sr_y;
+		cairo_matrix_transform_point (fullMatrix, &tempX, &tempY);
+		points[i].x = (int)round(tempX);
+		points[i].y = (int)round(tempY);
 	}
-	return;
+
+	gdk_gc_copy(pgc, gc); 
+	gdk_gc_set_line_attributes(pgc, 1, 
+	       GDK_LINE_SOLID, 
+	       GDK_CAP_PROJECTING, 
+	       GDK_JOIN_MITER);
+	gdk_draw_polygon(*pixmap, pgc, 1, points, polygon->count);
+	g_free(points);
 }
 
 void
@@ -875,6 +818,14 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 	gerbv_polarity_t polarity;
 	gdouble tempX, tempY, r;
 	gdouble minX=0,minY=0,maxX=0,maxY=0;
+	net_index_t *netIndex;
+	const net_index_rows_t *rows;
+	GArray *visibleRows = NULL;
+	guint visibleIndex, rowCount, row;
+	guint8 rowFlags;
+	gint aperture;
+	gerbv_aperture_t *currentAperture;
+	gerbv_polarity_t layerPolarity;
 
 	if (image == NULL || image->netlist == NULL) {
 		gdk_gc_unref(gc);
@@ -933,6 +884,9 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 	/* do image rotation */
 	cairo_matrix_rotate (&fullMatrix, image->info->imageRotation);
 
+	/* an edit may replace the index meanwhile, so take it only once */
+	netIndex = net_index_get (image);
+	rows = net_index_get_rows (netIndex);
 	if (useOptimizations) {
 		minX = renderInfo->lowerLeftX;
 		minY = renderInfo->lowerLeftY;
@@ -940,6 +894,9 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 					renderInfo->scaleFactorX);
 		maxY = renderInfo->lowerLeftY + (renderInfo->displayHeight /
 					renderInfo->scaleFactorY);
+		/* only walk the nets which can be inside the visible window */
+		visibleRows = net_index_query (netIndex,
+					minX, minY, maxX, maxY);
 	}
 
 	/* Set up the two "colors" we have */
@@ -960,21 +917,36 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 	}
 	oldLayer = image->layers;
 	oldState = image->states;
-	for (net = image->netlist->next ; net != NULL; net = gerbv_image_return_next_renderable_object(net)) {
+	layerPolarity = oldLayer->polarity;
+	rowCount = (visibleRows != NULL) ? visibleRows->len : rows->count;
+	for (visibleIndex = 0; visibleIndex < rowCount; visibleIndex++) {
 		int repeat_X=1, repeat_Y=1;
 		double repeat_dist_X=0.0, repeat_dist_Y=0.0;
 		int repeat_i, repeat_j;
+		/* without step and repeat the grown box of the row is the net box */
+		const gerbv_render_size_t *box;
+
+		row = (visibleRows != NULL) ?
+			g_array_index (visibleRows, guint, visibleIndex) : visibleIndex;
+		net = rows->nets[row];
+		rowFlags = rows->flags[row];
+		aperture = rows->apertures[row];
+		box = &rows->boxes[row];
 
 		/*
 		 * If step_and_repeat (%SR%) used, repeat the drawing;
 		 */
-		repeat_X = net->layer->stepAndRepeat.X;
-		repeat_Y = net->layer->stepAndRepeat.Y;
-		repeat_dist_X = net->layer->stepAndRepeat.dist_X;
-		repeat_dist_Y = net->layer->stepAndRepeat.dist_Y;
+		if (rowFlags & NET_INDEX_ROW_STEP_AND_REPEAT) {
+			repeat_X = net->layer->stepAndRepeat.X;
+			repeat_Y = net->layer->stepAndRepeat.Y;
+			repeat_dist_X = net->layer->stepAndRepeat.dist_X;
+			repeat_dist_Y = net->layer->stepAndRepeat.dist_Y;
+			box = &net->boundingBox;
+		}
 
 		/* check if this is a new netstate */
-		if (net->state != oldState){
+		if ((rowFlags & NET_INDEX_ROW_NEW_LAYER_OR_STATE)
+				&& (net->state != oldState)){
 			/* it's a new state, so recalculate the new transformation matrix
 			   for it */
 			draw_gdk_apply_netstate_transformation (&fullMatrix, &scaleMatrix, net->state);
@@ -982,25 +954,17 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		}
 		/* check if this is a new layer */
 		/* for now, only do layer rotations in GDK rendering */
-		if (net->layer != oldLayer){
+		if ((rowFlags & NET_INDEX_ROW_NEW_LAYER_OR_STATE)
+				&& (net->layer != oldLayer)){
 			cairo_matrix_rotate (&fullMatrix, net->layer->rotation);
 			oldLayer = net->layer;
+			layerPolarity = oldLayer->polarity;
 		}
 
 		if (drawMode == DRAW_SELECTIONS) {
-			int i;
-			gboolean foundNet = FALSE;
-			gerbv_selection_item_t sItem;
-			
-			for (i=0; i<selectionInfo->selectedNodeArray->len; i++){
-				sItem = g_array_index (selectionInfo->selectedNodeArray,
-						gerbv_selection_item_t, i);
-				if (sItem.net == net) {
-					foundNet = TRUE;
-					break;
-				}
-			}
-			if (!foundNet)
+			gerbv_selection_item_t sItem = {image, net};
+
+			if (!selection_contains_item (selectionInfo, &sItem))
 				continue;
 		}
 
@@ -1009,17 +973,17 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		  double sr_x = repeat_i * repeat_dist_X;
 		  double sr_y = repeat_j * repeat_dist_Y;
 			
-			if ((useOptimizations)&&((net->boundingBox.right+sr_x < minX)
-					|| (net->boundingBox.left+sr_x > maxX)
-					|| (net->boundingBox.top+sr_y < minY)
-					|| (net->boundingBox.bottom+sr_y > maxY))) {
+			if ((useOptimizations)&&((box->right+sr_x < minX)
+					|| (box->left+sr_x > maxX)
+					|| (box->top+sr_y < minY)
+					|| (box->bottom+sr_y > maxY))) {
 				continue;
 			}
 
 		/* 
 		 * If circle segment, scale and translate that one too
 		 */
-		if (net->cirseg) {
+		if (rowFlags & NET_INDEX_ROW_ARC) {
 		    tempX = net->cirseg->width;
 		    tempY = net->cirseg->height;
 		    cairo_matrix_transform_point (&scaleMatrix, &tempX, &tempY);
@@ -1038,7 +1002,7 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		 * and allow for the photoplot being negative.
 		 */
 		gdk_gc_set_function(gc, GDK_COPY);
-		if ((net->layer->polarity == GERBV_POLARITY_CLEAR) != (polarity == GERBV_POLARITY_NEGATIVE))
+		if ((layerPolarity == GERBV_POLARITY_CLEAR) != (polarity == GERBV_POLARITY_NEGATIVE))
 		    gdk_gc_set_foreground(gc, &opaque);
 		else
 		    gdk_gc_set_foreground(gc, &transparent);
@@ -1046,10 +1010,10 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		/*
 		 * Polygon Area Fill routines
 		 */
-		switch (net->interpolation) {
+		switch (rows->interpolations[row]) {
 		case GERBV_INTERPOLATION_PAREA_START :
-		    draw_gdk_render_polygon_object (net,image,sr_x,sr_y,&fullMatrix,
-		    	&scaleMatrix,gc,pgc,pixmap);
+		    draw_gdk_render_polygon_object (rows->polygons[row],sr_x,sr_y,
+		    	&fullMatrix,gc,pgc,pixmap);
 		    continue;
 		/* make sure we completely skip over any deleted nodes */
 		case GERBV_INTERPOLATION_DELETED:
@@ -1064,7 +1028,8 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		 * This happens when gerber files starts, but hasn't decided on 
 		 * which aperture to use.
 		 */
-		if (image->aperture[net->aperture] == NULL) {
+		currentAperture = gerbv_image_get_aperture (image, aperture);
+		if (currentAperture == NULL) {
 		  /* Commenting this out since it gets emitted every time you click on the screen 
 		     if (net->aperture_state != GERBV_APERTURE_STATE_OFF)
 		     GERB_MESSAGE("Aperture D%d is not defined", net->aperture);
@@ -1075,14 +1040,14 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		/*
 		 * Scale points with window scaling and translate them
 		 */
-		tempX = net->start_x + sr_x;
-		tempY = net->start_y + sr_y;
+		tempX = rows->startX[row] + sr_x;
+		tempY = rows->startY[row] + sr_y;
 		cairo_matrix_transform_point (&fullMatrix, &tempX, &tempY);
 		xlong1 = (int)round(tempX);
 		ylong1 = (int)round(tempY);
 
-		tempX = net->stop_x + sr_x;
-		tempY = net->stop_y + sr_y;
+		tempX = rows->stopX[row] + sr_x;
+		tempY = rows->stopY[row] + sr_y;
 		cairo_matrix_transform_point (&fullMatrix, &tempX, &tempY);
 		xlong2 = (int)round(tempX);
 		ylong2 = (int)round(tempY);
@@ -1114,18 +1079,18 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		else if (ylong2 < G_MININT) y2 = G_MININT;
 		else y2 = (int)ylong2;
 
-		switch (net->aperture_state) {
+		switch (rows->apertureStates[row]) {
 		case GERBV_APERTURE_STATE_ON :
-		    tempX = image->aperture[net->aperture]->parameter[0];
+		    tempX = currentAperture->parameter[0];
 		    cairo_matrix_transform_point (&scaleMatrix, &tempX, &tempY);
 		    p1 = (int)round(tempX);
 
 		    gdk_gc_set_line_attributes(gc, p1, GDK_LINE_SOLID,
-				    (image->aperture[net->aperture]->type == GERBV_APTYPE_RECTANGLE)?
+				    (currentAperture->type == GERBV_APTYPE_RECTANGLE)?
 						GDK_CAP_PROJECTING: GDK_CAP_ROUND,
 				    GDK_JOIN_MITER);
 		    
-		    switch (net->interpolation) {
+		    switch (rows->interpolations[row]) {
 		    case GERBV_INTERPOLATION_x10 :
 		    case GERBV_INTERPOLATION_LINEARx01 :
 		    case GERBV_INTERPOLATION_LINEARx001 :
@@ -1141,7 +1106,7 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 						   GDK_JOIN_MITER);
 			break;
 		    case GERBV_INTERPOLATION_LINEARx1 :
-			if (image->aperture[net->aperture]->type != GERBV_APTYPE_RECTANGLE) {
+			if (currentAperture->type != GERBV_APTYPE_RECTANGLE) {
 				gdk_draw_line(*pixmap, gc, x1, y1, x2, y2);
 
 				if (renderInfo->show_cross_on_drill_holes
@@ -1157,8 +1122,8 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 			gint dx, dy;
 			GdkPoint poly[6];
 
-			tempX = image->aperture[net->aperture]->parameter[0]/2;
-			tempY = image->aperture[net->aperture]->parameter[1]/2;
+			tempX = currentAperture->parameter[0]/2;
+			tempY = currentAperture->parameter[1]/2;
 			cairo_matrix_transform_point (&scaleMatrix, &tempX, &tempY);
 			dx = (int)round(tempX);
 			dy = (int)round(tempY);
@@ -1186,16 +1151,16 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		case GERBV_APERTURE_STATE_OFF :
 		    break;
 		case GERBV_APERTURE_STATE_FLASH :
-		    tempX = image->aperture[net->aperture]->parameter[0];
-		    tempY = image->aperture[net->aperture]->parameter[1];
+		    tempX = currentAperture->parameter[0];
+		    tempY = currentAperture->parameter[1];
 		    cairo_matrix_transform_point (&scaleMatrix, &tempX, &tempY);
 		    p1 = (int)round(tempX);
 		    p2 = (int)round(tempY);
-		    tempX = image->aperture[net->aperture]->parameter[2];
+		    tempX = currentAperture->parameter[2];
 		    tempY = 0;
 		    cairo_matrix_transform_point (&scaleMatrix, &tempX, &tempY);
 		    
-		    switch (image->aperture[net->aperture]->type) {
+		    switch (currentAperture->type) {
 		    case GERBV_APTYPE_CIRCLE :
 			gerbv_gdk_draw_circle(*pixmap, gc, TRUE, x2, y2, p1);
 
@@ -1242,16 +1207,22 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 		    case GERBV_APTYPE_MACRO :
 			/* TODO: check line22 and others */
 			gerbv_gdk_draw_amacro(*pixmap, gc, 
-					      image->aperture[net->aperture]->simplified,
+					      currentAperture->simplified,
 					      scale, x2, y2);
 			break;
 		    default :
 			GERB_MESSAGE(_("Unknown aperture type"));
+			if (visibleRows)
+			    g_array_free (visibleRows, TRUE);
+			net_index_unref (netIndex);
 			return 0;
 		    }
 		    break;
 		default :
 		    GERB_MESSAGE(_("Unknown aperture state"));
+		    if (visibleRows)
+			g_array_free (visibleRows, TRUE);
+		    net_index_unref (netIndex);
 		    return 0;
 		}
 		}
@@ -1262,6 +1233,9 @@ draw_gdk_image_to_pixmap(GdkPixmap **pixmap, gerbv_image_t *image,
 	*/
 	gdk_gc_unref(gc);
 	gdk_gc_unref(pgc);
+	if (visibleRows)
+		g_array_free (visibleRows, TRUE);
+	net_index_unref (netIndex);
 
 	return 1;
 
@@ -38,6 +38,8 @@
 #include "draw.h"
 #include "common.h"
 #include "selection.h"
+#include "net_index.h"
+#include "flash_stamp.h"
 
 #define dprintf if(DEBUG) printf
 
@@ -108,28 +110,21 @@ draw_cairo_translate_adjust (cairo_t *cairoTarget, gdouble x, gdouble y,
 
 /** Check if net is in selection buffer and possibly deselect it.
   @return TRUE if net is selected, FALSE if not selected.
+  @param image	Image of the net.
   @param net	Checked net.
   @param selectionInfo	Selection buffer.
   @param remove		TRUE for deselect net.
  */
 static gboolean
-draw_net_is_in_selection_buffer_remove (gerbv_net_t *net,
+draw_net_is_in_selection_buffer_remove (gerbv_image_t *image, gerbv_net_t *net,
 		gerbv_selection_info_t *selectionInfo, gboolean remove)
 {
-	gerbv_selection_item_t sItem;
-	gint i;
+	gerbv_selection_item_t sItem = {image, net};
 
-	for (i = 0; i < selection_length (selectionInfo); i++) {
-		sItem = selection_get_item_by_index (selectionInfo, i);
-		if (sItem.net == net) {
-			if (remove)
-				selection_clear_item_by_index (selectionInfo, i);
+	if (remove)
+		return selection_remove_item (selectionInfo, &sItem);
 
-			return TRUE;
-		}
-	}
-
-	return FALSE;
+	return selection_contains_item (selectionInfo, &sItem);
 }
 
 static void
@@ -160,7 +155,7 @@ draw_check_if_object_is_in_selected_area (cairo_t *cairoTarget,
 		if ((isStroke && cairo_in_stroke (cairoTarget, corner1X, corner1Y)) ||
 			(!isStroke && cairo_in_fill (cairoTarget, corner1X, corner1Y))) {
 
-			if (!draw_net_is_in_selection_buffer_remove (net,
+			if (!draw_net_is_in_selection_buffer_remove (image, net,
 					selectionInfo,
 					(drawMode == FIND_SELECTIONS_TOGGLE))) {
 				selection_add_item (selectionInfo, &sItem);
@@ -182,7 +177,7 @@ draw_check_if_object_is_in_selected_area (cairo_t *cairoTarget,
 			cairo_fill_extents (cairoTarget, &x1, &y1, &x2, &y2);
 
 		if ((minX < x1) && (minY < y1) && (maxX > x2) && (maxY > y2)) {
-			if (!draw_net_is_in_selection_buffer_remove (net,
+			if (!draw_net_is_in_selection_buffer_remove (image, net,
 					selectionInfo,
 					(drawMode == FIND_SELECTIONS_TOGGLE))) {
 				selection_add_item (selectionInfo, &sItem);
@@ -601,35 +596,24 @@ draw_apply_netstate_transformation (cairo_t *cairoTarget, gerbv_netstate_t *stat
 	}
 }
 
-void
-draw_render_polygon_object (gerbv_net_t *oldNet, cairo_t *cairoTarget,
-		gdouble sr_x, gdouble sr_y, gerbv_image_t *image,
-		enum draw_mode drawMode, gerbv_selection_info_t *selectionInfo,
-		gboolean pixelOutput)
+/* Traces the polygon area started by polygonStartNet with true arcs,
+   for vector output where the flattened outline would show its chords */
+static void
+draw_trace_polygon_nets (gerbv_net_t *polygonStartNet, cairo_t *cairoTarget,
+		gdouble sr_x, gdouble sr_y)
 {
-	gerbv_net_t *currentNet, *polygonStartNet;
-	int haveDrawnFirstFillPoint = 0;
-	gdouble x2,y2,cp_x=0,cp_y=0;
-
-	haveDrawnFirstFillPoint = FALSE;
-	/* save the first net in the polygon as the "ID" net pointer
-	   in case we are saving this net to the selection array */
-	polygonStartNet = oldNet;
-	cairo_new_path(cairoTarget);
+	gerbv_net_t *currentNet;
+	gboolean haveDrawnFirstFillPoint = FALSE;
+	gdouble x2, y2, cp_x, cp_y, radius;
 
-	for (currentNet = oldNet->next; currentNet!=NULL;
+	for (currentNet = polygonStartNet->next; currentNet != NULL;
 			currentNet = currentNet->next) {
 		x2 = currentNet->stop_x + sr_x;
 		y2 = currentNet->stop_y + sr_y;
 
-		/* translate circular x,y data as well */
-		if (currentNet->cirseg) {
-			cp_x = currentNet->cirseg->cp_x + sr_x;
-			cp_y = currentNet->cirseg->cp_y + sr_y;
-		}
 		if (!haveDrawnFirstFillPoint) {
-			draw_cairo_move_to (cairoTarget, x2, y2, FALSE, pixelOutput);
-			haveDrawnFirstFillPoint=TRUE;
+			draw_cairo_move_to (cairoTarget, x2, y2, FALSE, FALSE);
+			haveDrawnFirstFillPoint = TRUE;
 			continue;
 		}
 
@@ -638,28 +622,24 @@ draw_render_polygon_object (gerbv_net_t *oldNet, cairo_t *cairoTarget,
 		case GERBV_INTERPOLATION_LINEARx01 :
 		case GERBV_INTERPOLATION_LINEARx001 :
 		case GERBV_INTERPOLATION_LINEARx1 :
-			draw_cairo_line_to (cairoTarget, x2, y2, FALSE, pixelOutput);
+			draw_cairo_line_to (cairoTarget, x2, y2, FALSE, FALSE);
 			break;
 		case GERBV_INTERPOLATION_CW_CIRCULAR :
 		case GERBV_INTERPOLATION_CCW_CIRCULAR :
+			cp_x = currentNet->cirseg->cp_x + sr_x;
+			cp_y = currentNet->cirseg->cp_y + sr_y;
+			radius = currentNet->cirseg->width/2.0;
 			if (currentNet->cirseg->angle2 > currentNet->cirseg->angle1) {
-				cairo_arc (cairoTarget, cp_x, cp_y, currentNet->cirseg->width/2.0,
+				cairo_arc (cairoTarget, cp_x, cp_y, radius,
 					DEG2RAD(currentNet->cirseg->angle1),
 					DEG2RAD(currentNet->cirseg->angle2));
 			} else {
-				cairo_arc_negative (cairoTarget, cp_x, cp_y, currentNet->cirseg->width/2.0,
+				cairo_arc_negative (cairoTarget, cp_x, cp_y, radius,
 					DEG2RAD(currentNet->cirseg->angle1),
 					DEG2RAD(currentNet->cirseg->angle2));
 			}
 			break;
 		case GERBV_INTERPOLATION_PAREA_END :
-			cairo_close_path(cairoTarget);
-			/* turn off anti-aliasing for polygons, since it shows seams
-			   with adjacent polygons (usually on PCB ground planes) */
-			cairo_antialias_t oldAlias = cairo_get_antialias (cairoTarget);
-			cairo_set_antialias (cairoTarget, CAIRO_ANTIALIAS_NONE);
-			draw_fill (cairoTarget, drawMode, selectionInfo, image, polygonStartNet);
-			cairo_set_antialias (cairoTarget, oldAlias);
 			return;
 		default :
 			break;
@@ -667,6 +647,48 @@ draw_render_polygon_object (gerbv_net_t *oldNet, cairo_t *cairoTarget,
 	}
 }
 
+void
+draw_render_polygon_object (gerbv_net_t *oldNet,
+		const net_index_polygon_t *polygon, cairo_t *cairoTarget,
+		gdouble sr_x, gdouble sr_y, gerbv_image_t *image,
+		enum draw_mode drawMode, gerbv_selection_info_t *selectionInfo,
+		gboolean pixelOutput)
+{
+	const gdouble *p = polygon->points;
+	guint i;
+
+	/* the outline is empty if the area was never closed */
+	if (polygon->count == 0)
+		return;
+
+	/* oldNet is the "ID" net pointer of the polygon in case we are
+	   saving this net to the selection array */
+	cairo_new_path(cairoTarget);
+	if (!pixelOutput) {
+		draw_trace_polygon_nets (oldNet, cairoTarget, sr_x, sr_y);
+	} else {
+		draw_cairo_move_to (cairoTarget, p[0] + sr_x, p[1] + sr_y,
+				FALSE, pixelOutput);
+		for (i = 1; i < polygon->count; i++) {
+			/* only the net end points are snapped, arcs stay smooth */
+			if (polygon->corners[i])
+				draw_cairo_line_to (cairoTarget, p[2*i] + sr_x,
+						p[2*i + 1] + sr_y, FALSE, pixelOutput);
+			else
+				cairo_line_to (cairoTarget, p[2*i] + sr_x,
+						p[2*i + 1] + sr_y);
+		}
+	}
+	cairo_close_path(cairoTarget);
+
+	/* turn off anti-aliasing for polygons, since it shows seams
+	   with adjacent polygons (usually on PCB ground planes) */
+	cairo_antialias_t oldAlias = cairo_get_antialias (cairoTarget);
+	cairo_set_antialias (cairoTarget, CAIRO_ANTIALIAS_NONE);
+	draw_fill (cairoTarget, drawMode, selectionInfo, image, oldNet);
+	cairo_set_antialias (cairoTarget, oldAlias);
+}
+
 /** Draw Cairo cross.
   @param xc	Cross center x coordinate.
   @param yc	Cross center y coordinate.
@@ -682,6 +704,445 @@ draw_cairo_cross (cairo_t *cairoTarget, gdouble xc, gdouble yc, gdouble r)
 	cairo_stroke (cairoTarget);
 }
 
+/** Add the path of a flash of aperture centered at the current Cairo
+  coordinates.  Macros are drawn right away.
+  @return FALSE for an unknown aperture type.
+ */
+static gboolean
+draw_flash_aperture (cairo_t *cairoTarget, gerbv_aperture_t *aperture,
+		gdouble pixelWidth, gboolean limitLineWidth, gboolean pixelOutput,
+		cairo_operator_t drawOperatorClear, cairo_operator_t drawOperatorDark,
+		enum draw_mode drawMode, gerbv_selection_info_t *selectionInfo,
+		gerbv_image_t *image, struct gerbv_net *net)
+{
+	gdouble *p = aperture->parameter;
+	gdouble p0, p1;
+	gboolean displayPixel;
+
+	switch (aperture->type) {
+	case GERBV_APTYPE_CIRCLE :
+		gerbv_draw_circle(cairoTarget, p[0]);
+		gerbv_draw_aperture_hole (cairoTarget, p[1], p[2], pixelOutput);
+		break;
+	case GERBV_APTYPE_RECTANGLE :
+		// some CAD programs use very thin flashed rectangles to compose
+		//	logos/images, so we must make sure those display here
+		displayPixel = pixelOutput;
+		p0 = p[0];
+		p1 = p[1];
+		if (limitLineWidth && (p[0] < pixelWidth) && pixelOutput) {
+			p0 = pixelWidth;
+			displayPixel = FALSE;
+		}
+		if (limitLineWidth && (p[1] < pixelWidth) && pixelOutput) {
+			p1 = pixelWidth;
+			displayPixel = FALSE;
+		}
+		gerbv_draw_rectangle(cairoTarget, p0, p1, displayPixel);
+		gerbv_draw_aperture_hole (cairoTarget, p[2], p[3], displayPixel);
+		break;
+	case GERBV_APTYPE_OVAL :
+		gerbv_draw_oblong(cairoTarget, p[0], p[1]);
+		gerbv_draw_aperture_hole (cairoTarget, p[2], p[3], pixelOutput);
+		break;
+	case GERBV_APTYPE_POLYGON :
+		gerbv_draw_polygon(cairoTarget, p[0], p[1], p[2]);
+		gerbv_draw_aperture_hole (cairoTarget, p[3], p[4], pixelOutput);
+		break;
+	case GERBV_APTYPE_MACRO :
+		gerbv_draw_amacro(cairoTarget, drawOperatorClear, drawOperatorDark,
+			aperture->simplified, (gint)p[0], pixelWidth,
+			drawMode, selectionInfo, image, net);
+		break;
+	default :
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/** Distance from the flash center to the farthest point an aperture
+  can cover.  Rotations of macro primitives keep their distance to the
+  center, so the primitive offsets and sizes are enough.
+ */
+static gdouble
+draw_flash_aperture_radius (gerbv_aperture_t *aperture)
+{
+	gdouble *p = aperture->parameter;
+	gerbv_simplified_amacro_t *ls;
+	gdouble radius = 0;
+	int i;
+
+	switch (aperture->type) {
+	case GERBV_APTYPE_CIRCLE :
+	case GERBV_APTYPE_POLYGON :
+		return p[0]/2.0;
+	case GERBV_APTYPE_RECTANGLE :
+	case GERBV_APTYPE_OVAL :
+		return hypot (p[0], p[1])/2.0;
+	case GERBV_APTYPE_MACRO :
+		break;
+	default :
+		return 0;
+	}
+
+	for (ls = aperture->simplified; ls != NULL; ls = ls->next) {
+		gdouble *q = ls->parameter;
+
+		switch (ls->type) {
+		case GERBV_APTYPE_MACRO_CIRCLE :
+			radius = MAX (radius, hypot (q[CIRCLE_CENTER_X],
+					q[CIRCLE_CENTER_Y]) + q[CIRCLE_DIAMETER]/2.0);
+			break;
+		case GERBV_APTYPE_MACRO_OUTLINE :
+			for (i = 0; i <= (int)q[OUTLINE_NUMBER_OF_POINTS]; i++)
+				radius = MAX (radius,
+					hypot (q[OUTLINE_X_IDX_OF_POINT(i)],
+						q[OUTLINE_Y_IDX_OF_POINT(i)]));
+			break;
+		case GERBV_APTYPE_MACRO_POLYGON :
+			radius = MAX (radius, hypot (q[POLYGON_CENTER_X],
+					q[POLYGON_CENTER_Y]) + q[POLYGON_DIAMETER]/2.0);
+			break;
+		case GERBV_APTYPE_MACRO_MOIRE :
+			radius = MAX (radius, hypot (q[MOIRE_CENTER_X],
+					q[MOIRE_CENTER_Y]) +
+				MAX (q[MOIRE_OUTSIDE_DIAMETER],
+					hypot (q[MOIRE_CROSSHAIR_LENGTH],
+						q[MOIRE_CROSSHAIR_THICKNESS]))/2.0);
+			break;
+		case GERBV_APTYPE_MACRO_THERMAL :
+			radius = MAX (radius, hypot (q[THERMAL_CENTER_X],
+					q[THERMAL_CENTER_Y]) +
+				q[THERMAL_OUTSIDE_DIAMETER]/2.0);
+			break;
+		case GERBV_APTYPE_MACRO_LINE20 :
+			radius = MAX (radius, MAX (
+					hypot (q[LINE20_START_X], q[LINE20_START_Y]),
+					hypot (q[LINE20_END_X], q[LINE20_END_Y])) +
+				q[LINE20_LINE_WIDTH]/2.0);
+			break;
+		case GERBV_APTYPE_MACRO_LINE21 :
+			radius = MAX (radius, hypot (q[LINE21_CENTER_X],
+					q[LINE21_CENTER_Y]) +
+				hypot (q[LINE21_WIDTH], q[LINE21_HEIGHT])/2.0);
+			break;
+		case GERBV_APTYPE_MACRO_LINE22 :
+			radius = MAX (radius, hypot (
+					q[LINE22_LOWER_LEFT_X] + q[LINE22_WIDTH]/2.0,
+					q[LINE22_LOWER_LEFT_Y] + q[LINE22_HEIGHT]/2.0) +
+				hypot (q[LINE22_WIDTH], q[LINE22_HEIGHT])/2.0);
+			break;
+		default :
+			break;
+		}
+	}
+
+	return radius;
+}
+
+/** Get the stamp of a flash of aperture at the scale of cairoTarget,
+  rasterizing it on first use.
+  @return a new reference to the A8 stamp, or NULL if the flash must be
+  drawn as a path (rotated device matrix or too large a flash).
+  @param originX	Receives the stamp pixel of the flash center.
+  @param originY	Receives the stamp pixel of the flash center.
+ */
+static cairo_surface_t *
+draw_get_flash_stamp (cairo_t *cairoTarget, gerbv_image_t *image,
+		gint aperture, gdouble pixelWidth, gboolean limitLineWidth,
+		gint *originX, gint *originY)
+{
+	flash_stamp_key_t key;
+	cairo_matrix_t matrix;
+	cairo_surface_t *stamp;
+	cairo_t *cr;
+	gdouble radius;
+	gerbv_aperture_t *flashAperture = gerbv_image_get_aperture (image, aperture);
+
+	cairo_get_matrix (cairoTarget, &matrix);
+	if ((matrix.xy != 0) || (matrix.yx != 0))
+		return NULL;
+
+	key.scaleX = matrix.xx;
+	key.scaleY = matrix.yy;
+	key.pixelWidth = pixelWidth;
+	key.limitLineWidth = limitLineWidth;
+	key.antialias = cairo_get_antialias (cairoTarget);
+	stamp = flash_stamp_lookup (image, aperture, &key, originX, originY);
+	if (stamp != NULL)
+		return stamp;
+
+	/* leave room for the apertures widened to a pixel and for
+	   antialiasing */
+	radius = draw_flash_aperture_radius (flashAperture) +
+		pixelWidth;
+	*originX = ceil (fabs (matrix.xx) * radius) + 1;
+	*originY = ceil (fabs (matrix.yy) * radius) + 1;
+	if ((*originX * 2 + 1 > FLASH_STAMP_MAX_SIZE)
+	 || (*originY * 2 + 1 > FLASH_STAMP_MAX_SIZE))
+		return NULL;
+
+	stamp = cairo_image_surface_create (CAIRO_FORMAT_A8,
+			*originX * 2 + 1, *originY * 2 + 1);
+	cr = cairo_create (stamp);
+	cairo_set_antialias (cr, key.antialias);
+	cairo_set_tolerance (cr, cairo_get_tolerance (cairoTarget));
+	cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+	matrix.x0 = *originX;
+	matrix.y0 = *originY;
+	cairo_set_matrix (cr, &matrix);
+	if (!draw_flash_aperture (cr, flashAperture, pixelWidth,
+			limitLineWidth, TRUE, CAIRO_OPERATOR_CLEAR,
+			CAIRO_OPERATOR_OVER, DRAW_IMAGE, NULL, image, NULL)) {
+		cairo_destroy (cr);
+		cairo_surface_destroy (stamp);
+		return NULL;
+	}
+	cairo_fill (cr);
+	cairo_destroy (cr);
+
+	flash_stamp_store (image, aperture, &key, stamp, *originX, *originY);
+
+	return stamp;
+}
+
+/* A run of nets of one step and repeat layer and netstate, rendered once
+   into an alpha mask which is then stamped at every repeat */
+typedef struct {
+	gboolean active;
+	guint endIndex;		/* first visible index after the run */
+	gerbv_step_and_repeat_t *sr;
+	gdouble left, top, right, bottom;	/* device box of the first repeat */
+	cairo_operator_t drawOperatorClear, drawOperatorDark;
+	cairo_t *target;	/* the context the repeats are stamped on */
+	cairo_t *cr;		/* draws the first repeat into mask */
+	cairo_surface_t *mask;	/* A8 surface covering the device box */
+} draw_repeat_block_t;
+
+/** Start rendering the run of nets beginning at visibleIndex into a mask.
+  The mask is a surface of its own rather than a group of cairoTarget,
+  since a group would be cut to the clip of cairoTarget, and a first
+  repeat outside of the tile or window would stamp nothing.  The nets of
+  the run are drawn with block->cr.
+  @return FALSE if the run must be drawn repeat by repeat instead, because
+  a net has no usable bounding box or the mask would be too large.
+  @param boxToDevice	Maps the net bounding boxes to device space.
+ */
+static gboolean
+draw_begin_repeat_block (cairo_t *cairoTarget, draw_repeat_block_t *block,
+		const net_index_rows_t *rows, GArray *visibleRows,
+		guint visibleIndex, guint rowCount,
+		const cairo_matrix_t *boxToDevice, gerbv_render_info_t *renderInfo,
+		cairo_operator_t *drawOperatorClear, cairo_operator_t *drawOperatorDark)
+{
+	gdouble left = HUGE_VAL, right = -HUGE_VAL;
+	gdouble bottom = HUGE_VAL, top = -HUGE_VAL;
+	gdouble x, y;
+	gboolean usable = TRUE;
+	cairo_matrix_t matrix;
+	guint i, row;
+
+	for (i = visibleIndex; i < rowCount; i++) {
+		const gerbv_render_size_t *box;
+
+		row = (visibleRows != NULL) ?
+			g_array_index (visibleRows, guint, i) : i;
+		if ((i > visibleIndex)
+		 && (rows->flags[row] & NET_INDEX_ROW_NEW_LAYER_OR_STATE))
+			break;
+		box = &rows->nets[row]->boundingBox;
+		if (!(box->left <= box->right) || !(box->bottom <= box->top)
+		 || isinf (box->left) || isinf (box->right)
+		 || isinf (box->bottom) || isinf (box->top)) {
+			usable = FALSE;
+			continue;
+		}
+		left = MIN (left, box->left);
+		right = MAX (right, box->right);
+		bottom = MIN (bottom, box->bottom);
+		top = MAX (top, box->top);
+	}
+	block->endIndex = i;
+	if (!usable)
+		return FALSE;
+
+	block->left = block->top = HUGE_VAL;
+	block->right = block->bottom = -HUGE_VAL;
+	for (i = 0; i < 4; i++) {
+		x = (i & 1) ? right : left;
+		y = (i & 2) ? top : bottom;
+		cairo_matrix_transform_point (boxToDevice, &x, &y);
+		block->left = MIN (block->left, x);
+		block->right = MAX (block->right, x);
+		block->top = MIN (block->top, y);
+		block->bottom = MAX (block->bottom, y);
+	}
+	/* leave room for lines widened to a pixel */
+	block->left = floor (block->left) - 2;
+	block->top = floor (block->top) - 2;
+	block->right = ceil (block->right) + 2;
+	block->bottom = ceil (block->bottom) + 2;
+
+	/* when zoomed into a repeat, drawing only its visible nets is cheaper
+	   than masking it */
+	if ((block->right - block->left) * (block->bottom - block->top) >
+			4.0 * renderInfo->displayWidth * renderInfo->displayHeight)
+		return FALSE;
+
+	row = (visibleRows != NULL) ?
+		g_array_index (visibleRows, guint, visibleIndex) : visibleIndex;
+	block->sr = &rows->nets[row]->layer->stepAndRepeat;
+
+	block->mask = cairo_image_surface_create (CAIRO_FORMAT_A8,
+			(int) (block->right - block->left),
+			(int) (block->bottom - block->top));
+	if (cairo_surface_status (block->mask) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (block->mask);
+		block->mask = NULL;
+		return FALSE;
+	}
+
+	/* draw with the transformation of cairoTarget, moved to the mask */
+	block->target = cairoTarget;
+	block->cr = cairo_create (block->mask);
+	cairo_get_matrix (cairoTarget, &matrix);
+	matrix.x0 -= block->left;
+	matrix.y0 -= block->top;
+	cairo_set_matrix (block->cr, &matrix);
+	cairo_set_antialias (block->cr, cairo_get_antialias (cairoTarget));
+	cairo_set_tolerance (block->cr, cairo_get_tolerance (cairoTarget));
+	cairo_set_fill_rule (block->cr, cairo_get_fill_rule (cairoTarget));
+	cairo_set_source_rgba (block->cr, 0, 0, 0, 1);
+
+	/* the mask holds coverage, the layer polarity is applied when it is
+	   stamped */
+	block->drawOperatorClear = *drawOperatorClear;
+	block->drawOperatorDark = *drawOperatorDark;
+	*drawOperatorClear = CAIRO_OPERATOR_CLEAR;
+	*drawOperatorDark = CAIRO_OPERATOR_OVER;
+	cairo_set_operator (block->cr, CAIRO_OPERATOR_OVER);
+	block->active = TRUE;
+
+	return TRUE;
+}
+
+/** Finish the mask of a repeat block and stamp it at every repeat.
+  @return the context the nets after the block are drawn with.
+  @param replicate	FALSE to just drop the mask (on errors).
+  @param cull	Skip the repeats outside the display.
+ */
+static cairo_t *
+draw_end_repeat_block (draw_repeat_block_t *block,
+		gboolean replicate, gboolean cull, gerbv_render_info_t *renderInfo,
+		cairo_operator_t *drawOperatorClear, cairo_operator_t *drawOperatorDark)
+{
+	cairo_t *cairoTarget = block->target;
+	cairo_pattern_t *mask;
+	cairo_matrix_t matrix;
+	gdouble dx, dy;
+	int ix, iy;
+
+	cairo_destroy (block->cr);
+	block->cr = NULL;
+	cairo_surface_flush (block->mask);
+	mask = cairo_pattern_create_for_surface (block->mask);
+	cairo_surface_destroy (block->mask);
+	block->mask = NULL;
+	*drawOperatorClear = block->drawOperatorClear;
+	*drawOperatorDark = block->drawOperatorDark;
+	block->active = FALSE;
+
+	/* the mask is placed in device space, shifted by whole pixels so the
+	   repeats stay as sharp as the first one */
+	cairo_matrix_init_translate (&matrix, -block->left, -block->top);
+	cairo_pattern_set_matrix (mask, &matrix);
+	cairo_get_matrix (cairoTarget, &matrix);
+
+	for (ix = 0; replicate && ix < block->sr->X; ix++) {
+		for (iy = 0; iy < block->sr->Y; iy++) {
+			dx = ix * block->sr->dist_X;
+			dy = iy * block->sr->dist_Y;
+			cairo_matrix_transform_distance (&matrix, &dx, &dy);
+			dx = round (dx);
+			dy = round (dy);
+
+			if (cull && ((block->right + dx < 0)
+			 || (block->left + dx > renderInfo->displayWidth)
+			 || (block->bottom + dy < 0)
+			 || (block->top + dy > renderInfo->displayHeight)))
+				continue;
+
+			cairo_save (cairoTarget);
+			cairo_identity_matrix (cairoTarget);
+			cairo_translate (cairoTarget, dx, dy);
+			cairo_mask (cairoTarget, mask);
+			cairo_restore (cairoTarget);
+		}
+	}
+
+	cairo_pattern_destroy (mask);
+
+	return cairoTarget;
+}
+
+/** Fill the cells of a level of detail run which lie in the window.
+  @param boxToDevice	Maps the net bounding boxes to device space.
+*/
+static void
+draw_lod_run (cairo_t *cairoTarget, const net_index_lod_t *lod,
+		const net_index_lod_run_t *run, const cairo_matrix_t *boxToDevice,
+		gdouble minX, gdouble minY, gdouble maxX, gdouble maxY)
+{
+	cairo_surface_t *cells;
+	cairo_pattern_t *pattern;
+	cairo_matrix_t matrix;
+	unsigned char *data;
+	gint left, bottom, right, top, stride;
+	guint i;
+
+	left = MAX (run->left, floor (minX / lod->cellSize) - 1);
+	bottom = MAX (run->bottom, floor (minY / lod->cellSize) - 1);
+	right = MIN (run->right, floor (maxX / lod->cellSize) + 1);
+	top = MIN (run->top, floor (maxY / lod->cellSize) + 1);
+	if ((left > right) || (bottom > top))
+		return;
+
+	cells = cairo_image_surface_create (CAIRO_FORMAT_A8,
+			right - left + 1, top - bottom + 1);
+	if (cairo_surface_status (cells) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (cells);
+		return;
+	}
+	cairo_surface_flush (cells);
+	data = cairo_image_surface_get_data (cells);
+	stride = cairo_image_surface_get_stride (cells);
+	memset (data, 0, stride * (top - bottom + 1));
+	for (i = 0; i < run->cells->len; i += 2) {
+		gint x = g_array_index (run->cells, gint, i);
+		gint y = g_array_index (run->cells, gint, i + 1);
+
+		if ((x >= left) && (x <= right) && (y >= bottom) && (y <= top))
+			data[(y - bottom) * stride + (x - left)] = 0xff;
+	}
+	cairo_surface_mark_dirty (cells);
+
+	/* one cell is one pixel of the mask, painted with the layer operator */
+	pattern = cairo_pattern_create_for_surface (cells);
+	cairo_pattern_set_filter (pattern, CAIRO_FILTER_NEAREST);
+	cairo_matrix_init_translate (&matrix, -left, -bottom);
+	cairo_matrix_scale (&matrix, 1.0 / lod->cellSize, 1.0 / lod->cellSize);
+	cairo_pattern_set_matrix (pattern, &matrix);
+
+	cairo_save (cairoTarget);
+	cairo_set_matrix (cairoTarget, boxToDevice);
+	cairo_mask (cairoTarget, pattern);
+	cairo_restore (cairoTarget);
+
+	cairo_pattern_destroy (pattern);
+	cairo_surface_destroy (cells);
+}
+
 int
 draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 		gdouble pixelWidth, enum draw_mode drawMode,
@@ -692,17 +1153,29 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 	const int hole_cross_inc_px = 8;
 	struct gerbv_net *net, *polygonStartNet=NULL;
 	double x1, y1, x2, y2, cp_x=0, cp_y=0;
-	gdouble *p, p0, p1, dx, dy, lineWidth, r;
+	gdouble *p, dx, dy, lineWidth, r;
 	gerbv_netstate_t *oldState;
 	gerbv_layer_t *oldLayer;
 	cairo_operator_t drawOperatorClear, drawOperatorDark;
 	gboolean invertPolarity = FALSE, oddWidth = FALSE;
 	gdouble minX=0, minY=0, maxX=0, maxY=0;
+	net_index_t *netIndex;
+	const net_index_rows_t *rows;
+	GArray *visibleRows = NULL;
+	guint visibleIndex, rowCount, row;
+	guint8 rowFlags, interpolation;
+	gint aperture;
+	gerbv_aperture_t *currentAperture;
 	gdouble criticalRadius;
 	gdouble scaleX = transform.scaleX;
 	gdouble scaleY = transform.scaleY;
 	gboolean limitLineWidth = TRUE;
-	gboolean displayPixel = TRUE;
+	cairo_surface_t *stamp;
+	gint stampX, stampY;
+	draw_repeat_block_t block = {FALSE, 0, NULL};
+	cairo_matrix_t boxToDevice;
+	const net_index_lod_t *lod = NULL;
+	guint lodRun = 0;
 
 	/* If we are scaling the image at all, ignore the line width checks
 	 * since scaled up lines can still be visible */
@@ -731,6 +1204,9 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 			transform.mirrorAroundX || transform.mirrorAroundY)
 		useOptimizations = FALSE;
 
+	/* an edit may replace the index meanwhile, so take it only once */
+	netIndex = net_index_get (image);
+	rows = net_index_get_rows (netIndex);
 	if (useOptimizations && pixelOutput) {
 		minX = renderInfo->lowerLeftX;
 		minY = renderInfo->lowerLeftY;
@@ -738,11 +1214,29 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 					renderInfo->scaleFactorX);
 		maxY = renderInfo->lowerLeftY + (renderInfo->displayHeight /
 					renderInfo->scaleFactorY);
+		/* only walk the nets which can be inside the visible window */
+		visibleRows = net_index_query (netIndex,
+					minX, minY, maxX, maxY);
 	}
 
 	/* do initial justify */
 	cairo_translate (cairoTarget, image->info->imageJustifyOffsetActualA,
 		 image->info->imageJustifyOffsetActualB);
+	cairo_get_matrix (cairoTarget, &boxToDevice);
+
+	/* at low zoom, nets smaller than a pixel are drawn as filled cells of
+	   a raster computed once per power of two of the scale.  Only the
+	   screen asks for it, exported images keep their true geometry */
+	if (useOptimizations && pixelOutput && renderInfo->allowCoarseNets
+			&& (drawMode == DRAW_IMAGE)
+			&& (fabs (boxToDevice.xy) < 1e-9) && (fabs (boxToDevice.yx) < 1e-9)
+			&& !(renderInfo->show_cross_on_drill_holes
+			  && image->layertype == GERBV_LAYERTYPE_DRILL)) {
+		int band;
+
+		frexp (MIN (fabs (boxToDevice.xx), fabs (boxToDevice.yy)), &band);
+		lod = net_index_get_lod (netIndex, band - 1);
+	}
 
 	/* set the fill rule so aperture holes are cleared correctly */
 	cairo_set_fill_rule (cairoTarget, CAIRO_FILL_RULE_EVEN_ODD);
@@ -779,11 +1273,35 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 	oldLayer = image->layers;
 	oldState = image->states;
 
-	for (net = image->netlist->next; net != NULL;
-			net = gerbv_image_return_next_renderable_object(net)) {
+	rowCount = (visibleRows != NULL) ? visibleRows->len : rows->count;
+	for (visibleIndex = 0; visibleIndex < rowCount; visibleIndex++) {
+		row = (visibleRows != NULL) ?
+			g_array_index (visibleRows, guint, visibleIndex) : visibleIndex;
+		net = rows->nets[row];
+		rowFlags = rows->flags[row];
+		aperture = rows->apertures[row];
+		interpolation = rows->interpolations[row];
+
+		/* fill the collapsed nets of the layer and netstate before leaving
+		   them */
+		while ((lod != NULL) && (lodRun < lod->runs->len)
+				&& (row >= g_array_index (lod->runs,
+					net_index_lod_run_t, lodRun).endRow)) {
+			draw_lod_run (cairoTarget, lod, &g_array_index (lod->runs,
+					net_index_lod_run_t, lodRun), &boxToDevice,
+					minX, minY, maxX, maxY);
+			lodRun++;
+		}
+
+		/* a layer or netstate change ends a step and repeat block */
+		if (block.active && (visibleIndex >= block.endIndex))
+			cairoTarget = draw_end_repeat_block (&block, TRUE,
+					useOptimizations && pixelOutput, renderInfo,
+					&drawOperatorClear, &drawOperatorDark);
 
 		/* check if this is a new layer */
-		if (net->layer != oldLayer){
+		if ((rowFlags & NET_INDEX_ROW_NEW_LAYER_OR_STATE)
+				&& (net->layer != oldLayer)){
 			/* it's a new layer, so recalculate the new transformation matrix
 			   for it */
 			cairo_restore (cairoTarget);
@@ -830,7 +1348,8 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 		}
 
 		/* check if this is a new netstate */
-		if (net->state != oldState){
+		if ((rowFlags & NET_INDEX_ROW_NEW_LAYER_OR_STATE)
+				&& (net->state != oldState)){
 			/* pop the transformation matrix back to the "pre-state" state and
 			   resave it */
 			cairo_restore (cairoTarget);
@@ -841,6 +1360,9 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 			oldState = net->state;
 		}
 
+		if ((lod != NULL) && lod->collapsed[row])
+			continue;
+
 		/* if we are only drawing from the selection buffer, search if this net is
 		   in the buffer */
 		if (drawMode == DRAW_SELECTIONS) {
@@ -849,35 +1371,54 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 			   we don't want to check the nets inside the polygon) then
 			   polygonStartNet will be set */
 			if (!polygonStartNet) {
-				if (!draw_net_is_in_selection_buffer_remove (net,
+				if (!draw_net_is_in_selection_buffer_remove (image, net,
 							selectionInfo, FALSE))
 					continue;
 			}
 		}
 
-		/* step and repeat */
-		gerbv_step_and_repeat_t *sr = &net->layer->stepAndRepeat;
+		/* step and repeat: on screen, the nets of a repeated layer are
+		   drawn once into a mask which is stamped at every repeat when the
+		   run ends */
+		gerbv_step_and_repeat_t noRepeat = {1, 1, 0.0, 0.0};
+		gerbv_step_and_repeat_t *sr = &noRepeat;
+		/* without step and repeat the grown box of the row is the net box,
+		   and it also covers every repeat of a block */
+		const gerbv_render_size_t *box = &rows->boxes[row];
 		int ix, iy;
+
+		if ((rowFlags & NET_INDEX_ROW_STEP_AND_REPEAT) && !block.active
+				&& (visibleIndex >= block.endIndex) && pixelOutput
+				&& ((drawMode == DRAW_IMAGE) || (drawMode == DRAW_SELECTIONS))) {
+			if (draw_begin_repeat_block (cairoTarget, &block, rows,
+					visibleRows, visibleIndex, rowCount, &boxToDevice,
+					renderInfo, &drawOperatorClear, &drawOperatorDark))
+				cairoTarget = block.cr;
+		}
+		if ((rowFlags & NET_INDEX_ROW_STEP_AND_REPEAT) && !block.active) {
+			sr = &net->layer->stepAndRepeat;
+			box = &net->boundingBox;
+		}
 		for (ix = 0; ix < sr->X; ix++) {
 			for (iy = 0; iy < sr->Y; iy++) {
 				double sr_x = ix * sr->dist_X;
 				double sr_y = iy * sr->dist_Y;
 
 				if (useOptimizations && pixelOutput
-				&& ((net->boundingBox.right+sr_x < minX)
-				 || (net->boundingBox.left+sr_x > maxX)
-				 || (net->boundingBox.top+sr_y < minY)
-				 || (net->boundingBox.bottom+sr_y > maxY))) {
+				&& ((box->right+sr_x < minX)
+				 || (box->left+sr_x > maxX)
+				 || (box->top+sr_y < minY)
+				 || (box->bottom+sr_y > maxY))) {
 					continue;
 				}
 
-				x1 = net->start_x + sr_x;
-				y1 = net->start_y + sr_y;
-				x2 = net->stop_x + sr_x;
-				y2 = net->stop_y + sr_y;
+				x1 = rows->startX[row] + sr_x;
+				y1 = rows->startY[row] + sr_y;
+				x2 = rows->stopX[row] + sr_x;
+				y2 = rows->stopY[row] + sr_y;
 
 				/* translate circular x,y data as well */
-				if (net->cirseg) {
+				if (rowFlags & NET_INDEX_ROW_ARC) {
 					cp_x = net->cirseg->cp_x + sr_x;
 					cp_y = net->cirseg->cp_y + sr_y;
 				}
@@ -885,7 +1426,7 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 				/* render any labels attached to this net */
 				/* NOTE: this is currently only used on PNP files, so we may
 				   make some assumptions here... */
-				if (net->label) {
+				if (rowFlags & NET_INDEX_ROW_LABEL) {
 					cairo_set_font_size (cairoTarget, 0.05);
 					cairo_save (cairoTarget);
 
@@ -896,9 +1437,10 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 				}
 
 				/* Polygon area fill routines */
-				switch (net->interpolation) {
+				switch (interpolation) {
 				case GERBV_INTERPOLATION_PAREA_START :
-					draw_render_polygon_object (net, cairoTarget,
+					draw_render_polygon_object (net,
+							rows->polygons[row], cairoTarget,
 							sr_x, sr_y, image, drawMode,
 							selectionInfo, pixelOutput);
 					continue;
@@ -913,10 +1455,11 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 				 * This happens when gerber files starts, but hasn't decided on 
 				 * which aperture to use.
 				 */
-				if (image->aperture[net->aperture] == NULL)
+				currentAperture = gerbv_image_get_aperture (image, aperture);
+				if (currentAperture == NULL)
 					continue;
 
-				switch (net->aperture_state) {
+				switch (rows->apertureStates[row]) {
 				case GERBV_APERTURE_STATE_ON :
 					/* if the aperture width is truly 0, then render as a 1 pixel width
 					   line.  0 diameter apertures are used by some programs to draw labels,
@@ -924,11 +1467,11 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 					/* NOTE: also, make sure all lines are at least 1 pixel wide, so they
 					   always show up at low zoom levels */
 
-					if (limitLineWidth&&((image->aperture[net->aperture]->parameter[0] < pixelWidth)&&
+					if (limitLineWidth&&((currentAperture->parameter[0] < pixelWidth)&&
 							(pixelOutput)))
 						criticalRadius = pixelWidth/2.0;
 					else
-						criticalRadius = image->aperture[net->aperture]->parameter[0]/2.0;
+						criticalRadius = currentAperture->parameter[0]/2.0;
 					lineWidth = criticalRadius*2.0;
 					// convert to a pixel integer
 					cairo_user_to_device_distance (cairoTarget, &lineWidth, &x1);
@@ -944,7 +1487,7 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 					cairo_device_to_user_distance (cairoTarget, &lineWidth, &x1);
 					cairo_set_line_width (cairoTarget, lineWidth);
 
-					switch (net->interpolation) {
+					switch (interpolation) {
 					case GERBV_INTERPOLATION_x10 :
 					case GERBV_INTERPOLATION_LINEARx01 :
 					case GERBV_INTERPOLATION_LINEARx001 :
@@ -954,14 +1497,14 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 						/* weed out any lines that are
 						 * obviously not going to
 						 * render on the visible screen */
-						switch (image->aperture[net->aperture]->type) {
+						switch (currentAperture->type) {
 						case GERBV_APTYPE_CIRCLE :
 							if (renderInfo->show_cross_on_drill_holes
 							&&  image->layertype == GERBV_LAYERTYPE_DRILL) {
 								/* Draw center crosses on slot hole */
 								cairo_set_line_width (cairoTarget, pixelWidth);
 								cairo_set_line_cap (cairoTarget, CAIRO_LINE_CAP_SQUARE);
-								r = image->aperture[net->aperture]->parameter[0]/2.0 +
+								r = currentAperture->parameter[0]/2.0 +
 									hole_cross_inc_px*pixelWidth;
 								draw_cairo_cross (cairoTarget, x1, y1, r);
 								draw_cairo_cross (cairoTarget, x2, y2, r);
@@ -974,8 +1517,8 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 							draw_stroke (cairoTarget, drawMode, selectionInfo, image, net);
 							break;
 						case GERBV_APTYPE_RECTANGLE :
-							dx = image->aperture[net->aperture]->parameter[0]/2;
-							dy = image->aperture[net->aperture]->parameter[1]/2;
+							dx = currentAperture->parameter[0]/2;
+							dy = currentAperture->parameter[1]/2;
 							if(x1 > x2)
 								dx = -dx;
 							if(y1 > y2)
@@ -999,7 +1542,7 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 						/* macros can only be flashed, so ignore any that might be here */
 						default:
 							GERB_COMPILE_WARNING(_("Skipped aperture type \"%s\""),
-								_(aperture_names[image->aperture[net->aperture]->type]));
+								_(aperture_names[currentAperture->type]));
 							break;
 						}
 						break;
@@ -1009,7 +1552,7 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 						 * draw an arc and stretch it by scaling different x and y values
 						 */
 						cairo_new_path(cairoTarget);
-						if (image->aperture[net->aperture]->type == GERBV_APTYPE_RECTANGLE) {
+						if (currentAperture->type == GERBV_APTYPE_RECTANGLE) {
 							cairo_set_line_cap (cairoTarget, CAIRO_LINE_CAP_SQUARE);
 						}
 						else {
@@ -1033,67 +1576,66 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 						break;
 					default :
 						GERB_COMPILE_WARNING(_("Skipped interpolation type %d"),
-								net->interpolation);
+								interpolation);
 						break;
 					}
 					break;
 				case GERBV_APERTURE_STATE_OFF :
 					break;
 				case GERBV_APERTURE_STATE_FLASH :
-					p = image->aperture[net->aperture]->parameter;
+					p = currentAperture->parameter;
+
+					/* flashes landing on whole pixels are masked through a
+					   cached raster of the aperture */
+					if (pixelOutput && ((drawMode == DRAW_IMAGE)
+							|| (drawMode == DRAW_SELECTIONS))
+					&& !(renderInfo->show_cross_on_drill_holes
+					  && image->layertype == GERBV_LAYERTYPE_DRILL)) {
+						stamp = draw_get_flash_stamp (cairoTarget, image,
+								aperture, pixelWidth, limitLineWidth,
+								&stampX, &stampY);
+						if (stamp != NULL) {
+							cairo_user_to_device (cairoTarget, &x2, &y2);
+							cairo_save (cairoTarget);
+							cairo_identity_matrix (cairoTarget);
+							cairo_mask_surface (cairoTarget, stamp,
+									round (x2) - stampX,
+									round (y2) - stampY);
+							cairo_restore (cairoTarget);
+							cairo_surface_destroy (stamp);
+							break;
+						}
+					}
 
 					cairo_save (cairoTarget);
 					draw_cairo_translate_adjust(cairoTarget, x2, y2, pixelOutput);
 
-					switch (image->aperture[net->aperture]->type) {
-					case GERBV_APTYPE_CIRCLE :
-						if (renderInfo->show_cross_on_drill_holes
-						&& image->layertype == GERBV_LAYERTYPE_DRILL) {
-							/* Draw center cross on drill hole */
-							cairo_set_line_width (cairoTarget, pixelWidth);
-							cairo_set_line_cap (cairoTarget, CAIRO_LINE_CAP_SQUARE);
-							r = p[0]/2.0 + hole_cross_inc_px*pixelWidth;
-							draw_cairo_cross (cairoTarget, 0, 0, r);
-							cairo_set_line_width (cairoTarget, lineWidth);
-							cairo_set_line_cap (cairoTarget, CAIRO_LINE_CAP_ROUND);
-						}
+					if (currentAperture->type == GERBV_APTYPE_CIRCLE
+					&& renderInfo->show_cross_on_drill_holes
+					&& image->layertype == GERBV_LAYERTYPE_DRILL) {
+						/* Draw center cross on drill hole */
+						cairo_set_line_width (cairoTarget, pixelWidth);
+						cairo_set_line_cap (cairoTarget, CAIRO_LINE_CAP_SQUARE);
+						r = p[0]/2.0 + hole_cross_inc_px*pixelWidth;
+						draw_cairo_cross (cairoTarget, 0, 0, r);
+						cairo_set_line_width (cairoTarget, lineWidth);
+						cairo_set_line_cap (cairoTarget, CAIRO_LINE_CAP_ROUND);
+					}
 
-						gerbv_draw_circle(cairoTarget, p[0]);
-						gerbv_draw_aperture_hole (cairoTarget, p[1], p[2], pixelOutput);
-						break;
-					case GERBV_APTYPE_RECTANGLE :
-						// some CAD programs use very thin flashed rectangles to compose
-						//	logos/images, so we must make sure those display here
-						displayPixel = pixelOutput;
-						p0 = p[0];
-						p1 = p[1];
-						if (limitLineWidth && (p[0] < pixelWidth) && pixelOutput) {
-							p0 = pixelWidth;
-							displayPixel = FALSE;
-						}
-						if (limitLineWidth && (p[1] < pixelWidth) && pixelOutput) {
-							p1 = pixelWidth;
-							displayPixel = FALSE;
-						}
-						gerbv_draw_rectangle(cairoTarget, p0, p1, displayPixel);
-						gerbv_draw_aperture_hole (cairoTarget, p[2], p[3], displayPixel);
-						break;
-					case GERBV_APTYPE_OVAL :
-						gerbv_draw_oblong(cairoTarget, p[0], p[1]);
-						gerbv_draw_aperture_hole (cairoTarget, p[2], p[3], pixelOutput);
-						break;
-					case GERBV_APTYPE_POLYGON :
-						gerbv_draw_polygon(cairoTarget, p[0], p[1], p[2]);
-						gerbv_draw_aperture_hole (cairoTarget, p[3], p[4], pixelOutput);
-						break;
-					case GERBV_APTYPE_MACRO :
-						gerbv_draw_amacro(cairoTarget, drawOperatorClear, drawOperatorDark,
-							image->aperture[net->aperture]->simplified,
-							(gint)p[0], pixelWidth,
-							drawMode, selectionInfo, image, net);
-						break;
-					default :
+					if (!draw_flash_aperture (cairoTarget,
+							currentAperture, pixelWidth,
+							limitLineWidth, pixelOutput,
+							drawOperatorClear, drawOperatorDark,
+							drawMode, selectionInfo, image, net)) {
 						GERB_MESSAGE(_("Unknown aperture type"));
+						cairo_restore (cairoTarget);
+						if (block.active)
+							draw_end_repeat_block (&block,
+								FALSE, FALSE, renderInfo,
+								&drawOperatorClear, &drawOperatorDark);
+						if (visibleRows)
+							g_array_free (visibleRows, TRUE);
+						net_index_unref (netIndex);
 						return 0;
 					}
 					/* and finally fill the path */
@@ -1102,16 +1644,36 @@ draw_image_to_cairo_target (cairo_t *cairoTarget, gerbv_image_t *image,
 					break;
 				default:
 					GERB_MESSAGE(_("Unknown aperture state"));
+					if (block.active)
+						draw_end_repeat_block (&block,
+							FALSE, FALSE, renderInfo,
+							&drawOperatorClear, &drawOperatorDark);
+					if (visibleRows)
+						g_array_free (visibleRows, TRUE);
+					net_index_unref (netIndex);
 					return 0;
 				}
 			}
 		}
 	}
 
+	if (block.active)
+		cairoTarget = draw_end_repeat_block (&block, TRUE,
+				useOptimizations && pixelOutput, renderInfo,
+				&drawOperatorClear, &drawOperatorDark);
+	for (; (lod != NULL) && (lodRun < lod->runs->len); lodRun++)
+		draw_lod_run (cairoTarget, lod, &g_array_index (lod->runs,
+				net_index_lod_run_t, lodRun), &boxToDevice,
+				minX, minY, maxX, maxY);
+
 	/* restore the initial two state saves (one for layer, one for netstate)*/
 	cairo_restore (cairoTarget);
 	cairo_restore (cairoTarget);
 
+	if (visibleRows)
+		g_array_free (visibleRows, TRUE);
+	net_index_unref (netIndex);
+
 	return 1;
 }
 
@@ -55,6 +55,7 @@
 #include "common.h"
 #include "drill.h"
 #include "drill_stats.h"
+#include "gerb_image.h"
 
 /* DEBUG printing.  #define DEBUG 1 in config.h to use this fcn. */
 #define dprintf if(DEBUG) printf
@@ -236,15 +237,13 @@ drill_attribute_merge (gerbv_HID_Attribute *dest, int ndest, gerbv_HID_Attribute
 static gerbv_net_t *
 drill_add_drill_hole (gerbv_image_t *image, drill_state_t *state, gerbv_drill_stats_t *stats, gerbv_net_t *curr_net)
 {
+  gerbv_aperture_t *aperture;
+
   /* Add one to drill stats  for the current tool */
   drill_stats_increment_drill_counter(image->drill_stats->drill_list,
 				      state->current_tool);
 
-  curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-  if (curr_net->next == NULL)
-    GERB_FATAL_ERROR(_("malloc curr_net->next failed"));
-
-  curr_net = curr_net->next;
+  curr_net = gerbv_image_append_net (image);
   curr_net->layer = image->layers;
   curr_net->state = image->states;
   curr_net->start_x = (double)state->curr_x;
@@ -269,34 +268,35 @@ drill_add_drill_hole (gerbv_image_t *image, drill_state_t *state, gerbv_drill_st
   
   /* Check if aperture is set. Ignore the below instead of
      causing SEGV... */
-  if(image->aperture[state->current_tool] == NULL)
+  aperture = gerbv_image_get_aperture (image, state->current_tool);
+  if(aperture == NULL)
     return curr_net;
   
   curr_net->boundingBox.left=curr_net->start_x -
-    image->aperture[state->current_tool]->parameter[0] / 2;
+    aperture->parameter[0] / 2;
   curr_net->boundingBox.right=curr_net->start_x +
-    image->aperture[state->current_tool]->parameter[0] / 2;
+    aperture->parameter[0] / 2;
   curr_net->boundingBox.bottom=curr_net->start_y -
-    image->aperture[state->current_tool]->parameter[0] / 2;
+    aperture->parameter[0] / 2;
   curr_net->boundingBox.top=curr_net->start_y +
-    image->aperture[state->current_tool]->parameter[0] / 2;
+    aperture->parameter[0] / 2;
   
   image->info->min_x =
     min(image->info->min_x,
 	(curr_net->start_x -
-	 image->aperture[state->current_tool]->parameter[0] / 2));
+	 aperture->parameter[0] / 2));
   image->info->min_y =
     min(image->info->min_y,
 	(curr_net->start_y -
-	 image->aperture[state->current_tool]->parameter[0] / 2));
+	 aperture->parameter[0] / 2));
   image->info->max_x =
     max(image->info->max_x,
 	(curr_net->start_x +
-	 image->aperture[state->current_tool]->parameter[0] / 2));
+	 aperture->parameter[0] / 2));
   image->info->max_y =
     max(image->info->max_y,
 	(curr_net->start_y +
-	 image->aperture[state->current_tool]->parameter[0] / 2));
+	 aperture->parameter[0] / 2));
 
   return curr_net;
 }
@@ -318,7 +318,10 @@ parse_drillfile(gerb_file_t *fd, gerbv_HID_Attribute *attr_list, int n_attr, int
      * has problems when reading files using %f format.
      * Fixes bug #1963618 reported by Lorenzo Marcantonio.
      */
-    setlocale(LC_NUMERIC, "C" );
+    /* don't switch if it is already set, since other threads may
+       be parsing with it */
+    if (g_strcmp0 (setlocale(LC_NUMERIC, NULL), "C") != 0)
+	setlocale(LC_NUMERIC, "C" );
 
     /* Create new image for this layer */
     dprintf("In parse_drillfile, about to create image for this layer\n");
@@ -603,14 +606,16 @@ parse_drillfile(gerb_file_t *fd, gerbv_HID_Attribute *attr_list, int n_attr, int
 					  -1,
 					  _("Assuming all tool sizes are MM."),
 					  GERBV_MESSAGE_WARNING);
-		    int tool_num;
+		    int i, tool_num;
 		    double size;
+		    gerbv_aperture_t *aperture;
 		    stats = image->drill_stats;
-		    for (tool_num = TOOL_MIN; tool_num < TOOL_MAX; tool_num++) {
-			if (image->aperture && image->aperture[tool_num]) {
+		    for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+			aperture = gerbv_image_get_nth_aperture (image, i, &tool_num);
+			if ((tool_num >= TOOL_MIN) && (tool_num < TOOL_MAX)) {
 			    /* First update stats.   Do this before changing drill dias.
 			     * Maybe also put error into stats? */
-			    size = image->aperture[tool_num]->parameter[0];
+			    size = aperture->parameter[0];
 			    drill_stats_modify_drill_list(stats->drill_list, 
 							  tool_num, 
 							  size, 
@@ -618,7 +623,7 @@ parse_drillfile(gerb_file_t *fd, gerbv_HID_Attribute *attr_list, int n_attr, int
 			    /* Now go back and update all tool dias, since
 			     * tools are displayed in inch units
 			     */
-			    image->aperture[tool_num]->parameter[0] /= 25.4;
+			    aperture->parameter[0] /= 25.4;
 			}
 		    }
 		}
@@ -996,6 +1001,7 @@ drill_parse_T_code(gerb_file_t *fd, drill_state_t *state, gerbv_image_t *image)
     gboolean done = FALSE;
     int temp;
     double size;
+    gerbv_aperture_t *aperture;
     gerbv_drill_stats_t *stats = image->drill_stats;
     gchar *tmps;
     gchar *string;
@@ -1110,15 +1116,16 @@ drill_parse_T_code(gerb_file_t *fd, drill_state_t *state, gerbv_image_t *image)
 				      GERBV_MESSAGE_ERROR);
 		g_free(string);
 	    } else {
-		if(image->aperture[tool_num] != NULL) {
+		aperture = gerbv_image_get_aperture (image, tool_num);
+		if(aperture != NULL) {
 		    /* allow a redefine of a tool only if the new definition is exactly the same.
 		     * This avoid lots of spurious complaints with the output of some cad
 		     * tools while keeping complaints if there is a true problem
 		     */
-		    if (image->aperture[tool_num]->parameter[0] != size ||
-			image->aperture[tool_num]->type != GERBV_APTYPE_CIRCLE ||
-			image->aperture[tool_num]->nuf_parameters != 1 ||
-			image->aperture[tool_num]->unit != GERBV_UNIT_INCH) {
+		    if (aperture->parameter[0] != size ||
+			aperture->type != GERBV_APTYPE_CIRCLE ||
+			aperture->nuf_parameters != 1 ||
+			aperture->unit != GERBV_UNIT_INCH) {
 			string = g_strdup_printf(_("Found redefinition of drill %d."), tool_num);
 			drill_stats_add_error(stats->error_list,
 					      -1,
@@ -1127,18 +1134,19 @@ drill_parse_T_code(gerb_file_t *fd, drill_state_t *state, gerbv_image_t *image)
 			g_free(string);
 		    }
 		} else {
-		    image->aperture[tool_num] =
+		    aperture =
 			(gerbv_aperture_t *)g_malloc0(sizeof(gerbv_aperture_t));
-		    if (image->aperture[tool_num] == NULL)
+		    if (aperture == NULL)
 			GERB_FATAL_ERROR(_("malloc tool failed"));
 
 		    /* There's really no way of knowing what unit the tools
 		       are defined in without sneaking a peek in the rest of
 		       the file first. That's done in drill_guess_format() */
-		    image->aperture[tool_num]->parameter[0] = size;
-		    image->aperture[tool_num]->type = GERBV_APTYPE_CIRCLE;
-		    image->aperture[tool_num]->nuf_parameters = 1;
-		    image->aperture[tool_num]->unit = GERBV_UNIT_INCH;
+		    aperture->parameter[0] = size;
+		    aperture->type = GERBV_APTYPE_CIRCLE;
+		    aperture->nuf_parameters = 1;
+		    aperture->unit = GERBV_UNIT_INCH;
+		    gerbv_image_set_aperture (image, tool_num, aperture);
 		}
 	    }
 	    
@@ -1177,12 +1185,11 @@ drill_parse_T_code(gerb_file_t *fd, drill_state_t *state, gerbv_image_t *image)
 
     /* Catch the tools that aren't defined.
        This isn't strictly a good thing, but at least something is shown */
-    if(image->aperture[tool_num] == NULL) {
+    if(gerbv_image_get_aperture (image, tool_num) == NULL) {
         double dia;
 
-	image->aperture[tool_num] =
-	    (gerbv_aperture_t *)g_malloc0(sizeof(gerbv_aperture_t));
-	if (image->aperture[tool_num] == NULL)
+	aperture = (gerbv_aperture_t *)g_malloc0(sizeof(gerbv_aperture_t));
+	if (aperture == NULL)
 	    GERB_FATAL_ERROR(_("malloc tool failed"));
 
         /* See if we have the tool table */
@@ -1214,9 +1221,10 @@ drill_parse_T_code(gerb_file_t *fd, drill_state_t *state, gerbv_image_t *image)
             }
 	}
 
-	image->aperture[tool_num]->type = GERBV_APTYPE_CIRCLE;
-	image->aperture[tool_num]->nuf_parameters = 1;
-	image->aperture[tool_num]->parameter[0] = dia;
+	aperture->type = GERBV_APTYPE_CIRCLE;
+	aperture->nuf_parameters = 1;
+	aperture->parameter[0] = dia;
+	gerbv_image_set_aperture (image, tool_num, aperture);
 
 	/* Add the tool whose definition we just found into the list
 	 * of tools for this layer used to generate statistics. */
@@ -1231,7 +1239,7 @@ drill_parse_T_code(gerb_file_t *fd, drill_state_t *state, gerbv_image_t *image)
 					  string);
 	    g_free(string);
 	}
-    } /* if(image->aperture[tool_num] == NULL) */	
+    } /* if(gerbv_image_get_aperture (image, tool_num) == NULL) */	
     
     return tool_num;
 } /* drill_parse_T_code */
@@ -1553,155 +1561,110 @@ new_state(drill_state_t *state)
 static double
 read_double(gerb_file_t *fd, number_fmt_t fmt, gerbv_omit_zeros_t omit_zeros, int decimals)
 {
-    int read;
-    char temp[DRILL_READ_DOUBLE_SIZE];
-    int i = 0, ndigits = 0;
-    double result;
+    const char *start = fd->data + fd->ptr;
+    const char *p, *end;
+    gerb_decimal_t decimal;
     gboolean decimal_point = FALSE;
-    gboolean sign_prepend = FALSE;
+    int wantdigits;
+    double scale;
 
     dprintf("%s(%p, %d, %d, %d)\n", __FUNCTION__, fd, fmt, omit_zeros, decimals);
 
-    memset(temp, 0, sizeof(temp));
-
-    read = gerb_fgetc(fd);
-    while(read != EOF && i < (DRILL_READ_DOUBLE_SIZE -1) &&
-	  (isdigit(read) || read == '.' || read == ',' || read == '+' || read == '-')) {
-      if(read == ',' || read == '.') decimal_point = TRUE;
-      
-      /*
-       * FIXME -- if we are going to do this, don't we need a
-       * locale-independent strtod()?  I think pcb has one.
-       */
-      if(read == ',')
-	    read = '.'; /* adjust for strtod() */
-      
-      if(isdigit(read)) ndigits++;
-      
-	if(read == '-' || read == '+')
-	    sign_prepend = TRUE;
-
-      temp[i++] = (char)read;
-      read = gerb_fgetc(fd);
+    /* the number is the run of digits, points, commas and signs */
+    end = start + MIN(fd->datalen - fd->ptr, DRILL_READ_DOUBLE_SIZE - 1);
+    for (p = start; p < end; p++) {
+	if (*p == ',' || *p == '.')
+	    decimal_point = TRUE;
+	else if (!g_ascii_isdigit(*p) && *p != '+' && *p != '-')
+	    break;
     }
-    temp[i] = 0;
+    fd->ptr = p - fd->data;
+
+    /* both the point and the comma are decimal points */
+    if (gerb_scan_decimal(start, p - start, ".,", &decimal) == 0)
+	return 0.0;
+
+    if (decimal_point)
+	return gerb_decimal_to_double(&decimal);
+
+    dprintf("%s():  omit_zeros = %d, fmt = %d\n", __FUNCTION__, omit_zeros, fmt);
+    /* Nothing to take care for when leading zeros are
+       omitted. */
+    if (omit_zeros == GERBV_OMIT_ZEROS_TRAILING) {
+	switch (fmt) {
+	case FMT_00_0000:
+	  wantdigits = 2;
+	  break;
+
+	case FMT_000_000:
+	  wantdigits = 3;
+	  break;
+
+	case FMT_0000_00:
+	    wantdigits = 4;
+	    break;
 
-    gerb_ungetc(fd);
-    if (decimal_point) {
-	result = strtod(temp, NULL);
-    } else {
-	int wantdigits;
-	double scale;
-	char tmp2[DRILL_READ_DOUBLE_SIZE];
-
-	memset(tmp2, 0, sizeof(tmp2));
-
-	dprintf("%s():  omit_zeros = %d, fmt = %d\n", __FUNCTION__, omit_zeros, fmt);
-	/* Nothing to take care for when leading zeros are
-	   omitted. */
-	if (omit_zeros == GERBV_OMIT_ZEROS_TRAILING) {
-	    switch (fmt) {
-	    case FMT_00_0000:
-	      wantdigits = 2;
-	      break;
+	case FMT_000_00:
+	    wantdigits = 3;
+	    break;
 
-	    case FMT_000_000:
-	      wantdigits = 3;
-	      break;
+	case FMT_USER:
+	    wantdigits = decimals;
+	    break;
 
-	    case FMT_0000_00:
-		wantdigits = 4;
-		break;
+	default:
+	  /* cannot happen, just plugs a compiler warning */
+	  fprintf(stderr, _("%s():  omit_zeros == GERBV_OMIT_ZEROS_TRAILING but fmt = %d.\n"
+		  "This should never have happened\n"), __FUNCTION__, fmt);
+	  return 0;
+	}
 
-	    case FMT_000_00:
-		wantdigits = 3;
-		break;
+	if (wantdigits > DRILL_READ_DOUBLE_SIZE - 2) {
+	  fprintf(stderr, _("%s():  wantdigits = %d which exceeds the maximum allowed size\n"),
+		  __FUNCTION__, wantdigits);
+	  return 0;
+	}
 
-	    case FMT_USER:
-		wantdigits = decimals;
-		break;
+	/*
+	 * The first wantdigits digits are the integer part, missing
+	 * ones being trailing zeros, and the rest are the fraction.
+	 */
+	decimal.exponent += wantdigits - decimal.digits;
+	dprintf("%s():  wantdigits = %d, %d digits\n",
+		__FUNCTION__, wantdigits, decimal.digits);
 
-	    default:
-	      /* cannot happen, just plugs a compiler warning */
-	      fprintf(stderr, _("%s():  omit_zeros == GERBV_OMIT_ZEROS_TRAILING but fmt = %d.\n"
-		      "This should never have happened\n"), __FUNCTION__, fmt);
-	      return 0;
-	    }
-	    
-	    /* need to add an extra char for '+' or '-' */
-	    if (sign_prepend)
-	      wantdigits++;
-
-
-	    /* 
-	     * we need at least wantdigits + one for the decimal place
-	     * + one for the terminating null character
-	     */
-	    if (wantdigits > sizeof(tmp2) - 2) {
-	      fprintf(stderr, _("%s():  wantdigits = %d which exceeds the maximum allowed size\n"),
-		      __FUNCTION__, wantdigits);
-	      return 0;
-	    }
+	return gerb_decimal_to_double(&decimal);
+    }
 
-	    /*
-	     * After we have read the correct number of digits
-	     * preceeding the decimal point, insert a decimal point
-	     * and append the rest of the digits.
-	     */
-	    dprintf("%s():  wantdigits = %d, strlen(\"%s\") = %ld\n",
-		    __FUNCTION__, wantdigits, temp, (long) strlen(temp));
-	    for (i = 0 ; i < wantdigits && i < strlen(temp) ; i++) {
-	      tmp2[i] = temp[i];
-	    }
-	    for ( ; i < wantdigits ; i++) {
-	      tmp2[i] = '0';
-	    }
-	    tmp2[i++] = '.';
-	    for ( ; i <= strlen(temp) ; i++) {
-	      tmp2[i] = temp[i-1];
-	    }
-	    dprintf("%s():  After dealing with trailing zero suppression, convert \"%s\"\n", __FUNCTION__, tmp2);
-	    scale = 1.0;
-	    
-	    for (i = 0 ; i <= strlen(tmp2) && i < sizeof (temp) ; i++) {
-	      temp[i] = tmp2[i];
-	    }
+    /*
+     * figure out the scale factor when we are not suppressing
+     * trailing zeros.
+     */
+    switch (fmt) {
+    case FMT_00_0000:
+      scale = 1E-4;
+      break;
 
-	} else {
+    case FMT_000_000:
+      scale = 1E-3;
+      break;
 
-	  /*
-	   * figure out the scale factor when we are not suppressing
-	   * trailing zeros.
-	   */
-	  switch (fmt) {
-	  case FMT_00_0000:
-	    scale = 1E-4;
-	    break;
-	    
-	  case FMT_000_000:
-	    scale = 1E-3;
-	    break;
-	    
-	  case FMT_000_00:
-	  case FMT_0000_00:
-	    scale = 1E-2;
-	    break;
-	    
-	  case FMT_USER:
-	    scale = pow (10.0, -1.0*decimals);
-	    break;
-	    
-	  default:
-	    /* cannot happen, just plugs a compiler warning */
-	    fprintf (stderr, _("%s(): Unhandled fmt ` %d\n"), __FUNCTION__, fmt);
-	    exit (1);
-	  }
-	}
+    case FMT_000_00:
+    case FMT_0000_00:
+      scale = 1E-2;
+      break;
+
+    case FMT_USER:
+      scale = pow (10.0, -1.0*decimals);
+      break;
 
-	result = strtod(temp, NULL) * scale;
+    default:
+      /* cannot happen, just plugs a compiler warning */
+      fprintf (stderr, _("%s(): Unhandled fmt ` %d\n"), __FUNCTION__, fmt);
+      exit (1);
     }
 
-    return result;
+    return gerb_decimal_to_double(&decimal) * scale;
 } /* read_double */
 
 
@@ -1711,35 +1674,19 @@ read_double(gerb_file_t *fd, number_fmt_t fmt, gerbv_omit_zeros_t omit_zeros, in
 static void
 eat_line(gerb_file_t *fd)
 {
-    int read = gerb_fgetc(fd);
-    
-    while(read != 10 && read != 13) {
-	if (read == EOF) return;
-	read = gerb_fgetc(fd);
-    }
+    gerb_file_slice_t line;
+
+    gerb_fgetline(fd, &line);
 } /* eat_line */
 
 /* -------------------------------------------------------------- */
 static char *
 get_line(gerb_file_t *fd)
 {
-	int read = gerb_fgetc(fd);
-	gchar *retstring;
-	gchar *tmps=g_strdup("");
-
-	while(read != 10 && read != 13) {
-		if (read == EOF)
-			return tmps;
-		retstring = g_strdup_printf("%s%c", tmps, read);
-
-		/* since g_strdup_printf allocates memory, we need to free it */
-		if (tmps)  {
-			g_free (tmps);
-			tmps = NULL;
-		}
-		tmps = retstring;;
-		read = gerb_fgetc(fd);
-	}
-	return tmps;
+    gerb_file_slice_t line;
+
+    gerb_fgetline(fd, &line);
+
+    return g_strndup(line.data, line.len);
 } /* get_line */
 
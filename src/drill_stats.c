@@ -38,6 +38,10 @@
 
 #define dprintf if(DEBUG) printf
 
+static void drill_stats_append_error(gerbv_error_list_t *error_list_in,
+				     int layer, const char *error_text,
+				     gerbv_message_type_t type);
+
 
 /* ------------------------------------------------------- */
 /** Allocates a new drill_stats structure
@@ -108,18 +112,12 @@ gerbv_drill_stats_destroy(gerbv_drill_stats_t *stats) {
 }	
 	
 /* ------------------------------------------------------- */
-void
-gerbv_drill_stats_add_layer(gerbv_drill_stats_t *accum_stats, 
-		      gerbv_drill_stats_t *input_stats,
-		      int this_layer) {
+/*! Adds the code and drill counts of input_stats to accum_stats */
+static void
+drill_stats_add_counts(gerbv_drill_stats_t *accum_stats, 
+		       gerbv_drill_stats_t *input_stats) {
 
     gerbv_drill_list_t *drill;
-    gerbv_error_list_t *error;
-    char *tmps, *tmps2;
-
-    dprintf("--->  Entering gerbv_drill_stats_add_layer ..... \n");
-
-    accum_stats->layer_count++;
 
     accum_stats->comment += input_stats->comment;
     /* F codes go here */
@@ -158,7 +156,9 @@ gerbv_drill_stats_add_layer(gerbv_drill_stats_t *accum_stats,
     for (drill = input_stats->drill_list;
          drill != NULL;
 	 drill = drill->next) {
-	dprintf("   In gerbv_drill_stats_add_layer, adding drill_num = %d to list\n",
+	if (drill->drill_num == -1)
+	    continue;
+	dprintf("   In drill_stats_add_counts, adding drill_num = %d to list\n",
 		drill->drill_num);
 	/* First add this input drill to the accumulated list.
 	 * Drills already in accum list will not be added. */
@@ -175,58 +175,93 @@ gerbv_drill_stats_add_layer(gerbv_drill_stats_t *accum_stats,
 					 drill->drill_count);
 	accum_stats->total_count += drill->drill_count;
     }
+}
+
+/* ------------------------------------------------------- */
+/*! Appends detect as a new line to the broken tool detect text of
+ *  accum_stats */
+static void
+drill_stats_add_detect(gerbv_drill_stats_t *accum_stats, const char *detect) {
+
+    char *tmps;
+
+    if (accum_stats->detect) {
+	tmps = g_strdup_printf ("%s\n%s", accum_stats->detect, detect);
+	g_free (accum_stats->detect);
+    } else {
+	tmps = g_strdup (detect);
+    }
+    accum_stats->detect = tmps;
+}
+
+/* ------------------------------------------------------- */
+/*! Adds the stats of one layer to accum_stats.  The errors of the
+ *  layer were reported when it was parsed and are not reported
+ *  again. */
+void
+gerbv_drill_stats_add_layer(gerbv_drill_stats_t *accum_stats, 
+		      gerbv_drill_stats_t *input_stats,
+		      int this_layer) {
+
+    gerbv_error_list_t *error;
+    char *tmps;
+
+    dprintf("--->  Entering gerbv_drill_stats_add_layer ..... \n");
+
+    accum_stats->layer_count++;
+    drill_stats_add_counts(accum_stats, input_stats);
 
     /* ==== Now deal with the error list ==== */
     for (error = input_stats->error_list;
          error != NULL;
 	 error = error->next) {
 	if (error->error_text != NULL) {
-	    drill_stats_add_error(accum_stats->error_list,
-				  this_layer,
-				  error->error_text,
-				  error->type);
+	    drill_stats_append_error(accum_stats->error_list,
+				     this_layer,
+				     error->error_text,
+				     error->type);
 	}
     }
 
     /* ==== Now deal with the misc header stuff ==== */
-    tmps = NULL;
-    tmps2 = NULL;
     if (input_stats->detect) {
-	tmps2 = g_strdup_printf (_("Broken tool detect %s (layer %d)"), input_stats->detect, this_layer);
-    }    
-    if (accum_stats->detect) {
-	if (tmps2) {
-	    tmps = g_strdup_printf ("%s\n%s", accum_stats->detect, tmps2);
-	    g_free (accum_stats->detect);
-	    accum_stats->detect = NULL;
-	}
-    } else {
-	if (tmps2) {
-	    tmps = g_strdup_printf ("%s", tmps2);
-	}
-    }
-    if (tmps2) {
-	g_free (tmps2);
-    }
-    if (tmps != NULL) {
-	accum_stats->detect = tmps;
+	tmps = g_strdup_printf (_("Broken tool detect %s (layer %d)"), input_stats->detect, this_layer);
+	drill_stats_add_detect(accum_stats, tmps);
+	g_free (tmps);
     }
 
+    dprintf("<---  .... Leaving gerbv_drill_stats_add_layer.\n");
+	    
+    return;
+}
+
+/* ------------------------------------------------------- */
+/*! Adds the stats accumulated in input_stats to accum_stats.  The
+ *  errors and detect text of input_stats already carry their layer
+ *  numbers, so they are taken over as they are.  This is the
+ *  reduction step of gerbv_drill_stats_new_from_images(). */
+void
+gerbv_drill_stats_merge(gerbv_drill_stats_t *accum_stats, 
+			gerbv_drill_stats_t *input_stats) {
+
+    gerbv_error_list_t *error;
+
+    accum_stats->layer_count += input_stats->layer_count;
+    drill_stats_add_counts(accum_stats, input_stats);
+
     for (error = input_stats->error_list;
          error != NULL;
 	 error = error->next) {
 	if (error->error_text != NULL) {
-	    drill_stats_add_error(accum_stats->error_list,
-				  this_layer,
-				  error->error_text,
-				  error->type);
+	    drill_stats_append_error(accum_stats->error_list,
+				     error->layer,
+				     error->error_text,
+				     error->type);
 	}
     }
 
-
-    dprintf("<---  .... Leaving gerbv_drill_stats_add_layer.\n");
-	    
-    return;
+    if (input_stats->detect)
+	drill_stats_add_detect(accum_stats, input_stats->detect);
 }
 
 
@@ -412,32 +447,16 @@ gerbv_drill_stats_new_error_list() {
 
 
 /* ------------------------------------------------------- */
-void
-drill_stats_add_error(gerbv_error_list_t *error_list_in, 
-		      int layer, const char *error_text,
-		      gerbv_message_type_t type) {
+static void
+drill_stats_append_error(gerbv_error_list_t *error_list_in, 
+			 int layer, const char *error_text,
+			 gerbv_message_type_t type) {
 
     gerbv_error_list_t *error_list_new;
     gerbv_error_list_t *error_last = NULL;
     gerbv_error_list_t *error;
 
-    dprintf("   ----> Entering drill_stats_add_error......\n");
-
-    /* Replace embedded error messages */
-    switch (type) {
-	case GERBV_MESSAGE_FATAL:
-	    GERB_FATAL_ERROR("%s",error_text);
-	    break;
-	case GERBV_MESSAGE_ERROR:
-	    GERB_COMPILE_ERROR("%s",error_text);
-	    break;
-	case GERBV_MESSAGE_WARNING:
-	    GERB_COMPILE_WARNING("%s",error_text);
-	    break;
-	case GERBV_MESSAGE_NOTE:
-	    break;
-    }
-
+    dprintf("   ----> Entering drill_stats_append_error......\n");
 
     /* First handle case where this is the first list element */
     if (error_list_in->error_text == NULL) {
@@ -445,7 +464,7 @@ drill_stats_add_error(gerbv_error_list_t *error_list_in,
 	error_list_in->error_text = g_strdup_printf("%s", error_text);
 	error_list_in->type = type;
 	error_list_in->next = NULL;
-	dprintf("   <---- .... Leaving drill_stats_add_error after adding first error message.\n");
+	dprintf("   <---- .... Leaving drill_stats_append_error after adding first error message.\n");
 	return;
     }
 
@@ -472,7 +491,31 @@ drill_stats_add_error(gerbv_error_list_t *error_list_in,
     error_list_new->next = NULL;
     error_last->next = error_list_new;
 
-    dprintf("   <---- .... Leaving drill_stats_add_error after adding new error message.\n");
+    dprintf("   <---- .... Leaving drill_stats_append_error after adding new error message.\n");
     return;
 
 }
+
+/* ------------------------------------------------------- */
+void
+drill_stats_add_error(gerbv_error_list_t *error_list_in, 
+		      int layer, const char *error_text,
+		      gerbv_message_type_t type) {
+
+    /* Replace embedded error messages */
+    switch (type) {
+	case GERBV_MESSAGE_FATAL:
+	    GERB_FATAL_ERROR("%s",error_text);
+	    break;
+	case GERBV_MESSAGE_ERROR:
+	    GERB_COMPILE_ERROR("%s",error_text);
+	    break;
+	case GERBV_MESSAGE_WARNING:
+	    GERB_COMPILE_WARNING("%s",error_text);
+	    break;
+	case GERBV_MESSAGE_NOTE:
+	    break;
+    }
+
+    drill_stats_append_error(error_list_in, layer, error_text, type);
+}
@@ -62,21 +62,21 @@ gerbv_export_drill_file_from_image (const gchar *filename, gerbv_image_t *inputI
 
 	/* define all apertures */
 	gerbv_aperture_t *aperture;
-	gint i;
+	gint i, number;
 
 	/* the image should already have been cleaned by a duplicate_image call, so we can safely
 	   assume the aperture range is correct */
-	for (i = APERTURE_MIN; i < APERTURE_MAX; i++) {
-		aperture = image->aperture[i];
+	for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+		aperture = gerbv_image_get_nth_aperture (image, i, &number);
 		
-		if (!aperture)
+		if (number < APERTURE_MIN)
 			continue;
 
 		switch (aperture->type) {
 		case GERBV_APTYPE_CIRCLE:
-			fprintf(fd, "T%dC%1.3f\n", i, aperture->parameter[0]);
+			fprintf(fd, "T%dC%1.3f\n", number, aperture->parameter[0]);
 			/* add the "approved" aperture to our valid list */
-			g_array_append_val(apertureTable, i);
+			g_array_append_val(apertureTable, number);
 			break;
 		default:
 			break;
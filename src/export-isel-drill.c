@@ -93,21 +93,21 @@ gerbv_export_isel_drill_file_from_image (const gchar *filename, gerbv_image_t *i
 
 	/* define all apertures */
 	gerbv_aperture_t *currentAperture;
-	gint i;
+	gint i, number;
 
 	/* the image should already have been cleaned by a duplicate_image call, so we can safely
 	   assume the aperture range is correct */
-	for (i=APERTURE_MIN; i<APERTURE_MAX; i++) {
-		currentAperture = image->aperture[i];
+	for (i=0; i<gerbv_image_get_aperture_count (image); i++) {
+		currentAperture = gerbv_image_get_nth_aperture (image, i, &number);
 
-		if (!currentAperture)
+		if (number < APERTURE_MIN)
 			continue;
 
 		switch (currentAperture->type) {
 			case GERBV_APTYPE_CIRCLE:
 				/* add the "approved" aperture to our valid list */
-				fprintf(fd, "; TOOL %d - Diameter %1.3f mm\r\n", i + 1, currentAperture->parameter[0] * 25.4);
-	  			g_array_append_val (apertureTable, i);
+				fprintf(fd, "; TOOL %d - Diameter %1.3f mm\r\n", number + 1, currentAperture->parameter[0] * 25.4);
+	  			g_array_append_val (apertureTable, number);
 				break;
 			default:
 				break;
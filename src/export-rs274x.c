@@ -113,45 +113,45 @@ export_rs274x_write_macro (FILE *fd, gerbv_aperture_t *currentAperture,
 void
 export_rs274x_write_apertures (FILE *fd, gerbv_image_t *image) {
 	gerbv_aperture_t *currentAperture;
-	gint numberOfRequiredParameters=0,numberOfOptionalParameters=0,i,j;
+	gint numberOfRequiredParameters=0,numberOfOptionalParameters=0,i,j,number;
 	
 	/* the image should already have been cleaned by a duplicate_image call, so we can safely
 	   assume the aperture range is correct */
-	for (i=APERTURE_MIN; i<APERTURE_MAX; i++) {
+	for (i=0; i<gerbv_image_get_aperture_count (image); i++) {
 		gboolean writeAperture=TRUE;
 		
-		currentAperture = image->aperture[i];
+		currentAperture = gerbv_image_get_nth_aperture (image, i, &number);
 		
-		if (!currentAperture)
+		if (number < APERTURE_MIN)
 			continue;
 		
 		switch (currentAperture->type) {
 			case GERBV_APTYPE_CIRCLE:
-				fprintf(fd, "%%ADD%d",i);
+				fprintf(fd, "%%ADD%d",number);
 				fprintf(fd, "C,");
 				numberOfRequiredParameters = 1;
 				numberOfOptionalParameters = 2;
 				break;
 			case GERBV_APTYPE_RECTANGLE:
-				fprintf(fd, "%%ADD%d",i);
+				fprintf(fd, "%%ADD%d",number);
 				fprintf(fd, "R,");
 				numberOfRequiredParameters = 2;
 				numberOfOptionalParameters = 2;
 				break;
 			case GERBV_APTYPE_OVAL:
-				fprintf(fd, "%%ADD%d",i);
+				fprintf(fd, "%%ADD%d",number);
 				fprintf(fd, "O,");
 				numberOfRequiredParameters = 2;
 				numberOfOptionalParameters = 2;
 				break;
 			case GERBV_APTYPE_POLYGON:
-				fprintf(fd, "%%ADD%d",i);
+				fprintf(fd, "%%ADD%d",number);
 				fprintf(fd, "P,");
 				numberOfRequiredParameters = 2;
 				numberOfOptionalParameters = 3;
 				break;
 			case GERBV_APTYPE_MACRO:
-				export_rs274x_write_macro (fd, currentAperture, i);
+				export_rs274x_write_macro (fd, currentAperture, number);
 				writeAperture=FALSE;
 				break;
 			default:
@@ -299,7 +299,7 @@ gerbv_export_rs274x_file_from_image (const gchar *filename, gerbv_image_t *input
 		/* also, make sure the aperture number is a valid one, since sometimes
 		   the loaded file may refer to invalid apertures */
 		if ((currentNet->aperture != currentAperture)&&
-			(image->aperture[currentNet->aperture] != NULL)) {
+			(gerbv_image_get_aperture (image, currentNet->aperture) != NULL)) {
 			fprintf(fd, "G54D%02d*\n",currentNet->aperture);
 			currentAperture = currentNet->aperture;
 		}
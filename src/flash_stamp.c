@@ -0,0 +1,182 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * flash_stamp.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file flash_stamp.c
+    \brief Per-image cache of rasterized aperture flashes
+    \ingroup libgerbv
+
+    Pad-heavy layers flash the same few apertures thousands of times.
+    When a flash lands on whole device pixels and the device matrix is
+    not rotated, every flash of an aperture rasterizes to the same
+    pixels, so draw.c renders the aperture once into an A8 mask (a
+    "stamp") and masks the layer color through it for every further
+    flash.  The stamps are kept here, one per aperture, and are
+    redrawn whenever the scale or the aperture itself changes.
+*/
+
+#include "gerbv.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "flash_stamp.h"
+
+#define dprintf if(DEBUG) printf
+
+/* Memory all stamps of one image may use */
+#define FLASH_STAMP_MAX_BYTES (16 * 1024 * 1024)
+/* Aperture parameters compared to detect a changed aperture.  Standard
+   apertures use at most five, macros keep their shape in simplified */
+#define FLASH_STAMP_PARAMETERS 5
+
+typedef struct {
+	flash_stamp_key_t key;
+	gerbv_aperture_type_t type;
+	gerbv_simplified_amacro_t *simplified;
+	gdouble parameter[FLASH_STAMP_PARAMETERS];
+	cairo_surface_t *surface;
+	gint originX, originY;
+	gsize bytes;
+} flash_stamp_t;
+
+typedef struct {
+	GHashTable *stamps;	/*!< aperture number to flash_stamp_t */
+	gsize bytes;
+} flash_stamps_t;
+
+G_LOCK_DEFINE_STATIC (flash_stamp);
+
+static void
+flash_stamp_free (gpointer data)
+{
+	flash_stamp_t *stamp = data;
+
+	cairo_surface_destroy (stamp->surface);
+	g_free (stamp);
+}
+
+static gboolean
+flash_stamp_matches (const flash_stamp_t *stamp, const gerbv_aperture_t *aperture,
+		const flash_stamp_key_t *key)
+{
+	return (stamp->key.scaleX == key->scaleX)
+		&& (stamp->key.scaleY == key->scaleY)
+		&& (stamp->key.pixelWidth == key->pixelWidth)
+		&& (stamp->key.limitLineWidth == key->limitLineWidth)
+		&& (stamp->key.antialias == key->antialias)
+		&& (stamp->type == aperture->type)
+		&& (stamp->simplified == aperture->simplified)
+		&& (memcmp (stamp->parameter, aperture->parameter,
+				sizeof (stamp->parameter)) == 0);
+}
+
+cairo_surface_t *
+flash_stamp_lookup (gerbv_image_t *image, gint aperture,
+		const flash_stamp_key_t *key, gint *originX, gint *originY)
+{
+	flash_stamps_t *stamps;
+	flash_stamp_t *stamp = NULL;
+	cairo_surface_t *surface = NULL;
+
+	G_LOCK (flash_stamp);
+	stamps = image->flashStamps;
+	if (stamps != NULL)
+		stamp = g_hash_table_lookup (stamps->stamps,
+				GINT_TO_POINTER (aperture));
+	if ((stamp != NULL) && (gerbv_image_get_aperture (image, aperture) != NULL)
+			&& flash_stamp_matches (stamp,
+				gerbv_image_get_aperture (image, aperture), key)) {
+		surface = cairo_surface_reference (stamp->surface);
+		*originX = stamp->originX;
+		*originY = stamp->originY;
+	}
+	G_UNLOCK (flash_stamp);
+
+	return surface;
+}
+
+void
+flash_stamp_store (gerbv_image_t *image, gint aperture,
+		const flash_stamp_key_t *key, cairo_surface_t *surface,
+		gint originX, gint originY)
+{
+	flash_stamps_t *stamps;
+	flash_stamp_t *stamp, *oldStamp;
+	gerbv_aperture_t *flashAperture = gerbv_image_get_aperture (image, aperture);
+	gsize bytes;
+
+	if (flashAperture == NULL)
+		return;
+
+	bytes = cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+
+	G_LOCK (flash_stamp);
+	stamps = image->flashStamps;
+	if (stamps == NULL) {
+		stamps = g_new0 (flash_stamps_t, 1);
+		stamps->stamps = g_hash_table_new_full (g_direct_hash,
+				g_direct_equal, NULL, flash_stamp_free);
+		image->flashStamps = stamps;
+	}
+
+	oldStamp = g_hash_table_lookup (stamps->stamps, GINT_TO_POINTER (aperture));
+	if (oldStamp != NULL)
+		stamps->bytes -= oldStamp->bytes;
+
+	if (stamps->bytes + bytes > FLASH_STAMP_MAX_BYTES) {
+		/* out of room, keep drawing this aperture as a path */
+		dprintf ("flash stamp of aperture %d dropped, cache full\n", aperture);
+		g_hash_table_remove (stamps->stamps, GINT_TO_POINTER (aperture));
+		G_UNLOCK (flash_stamp);
+		return;
+	}
+
+	stamp = g_new (flash_stamp_t, 1);
+	stamp->key = *key;
+	stamp->type = flashAperture->type;
+	stamp->simplified = flashAperture->simplified;
+	memcpy (stamp->parameter, flashAperture->parameter,
+			sizeof (stamp->parameter));
+	stamp->surface = cairo_surface_reference (surface);
+	stamp->originX = originX;
+	stamp->originY = originY;
+	stamp->bytes = bytes;
+	stamps->bytes += bytes;
+	g_hash_table_replace (stamps->stamps, GINT_TO_POINTER (aperture), stamp);
+	G_UNLOCK (flash_stamp);
+}
+
+void
+flash_stamp_invalidate (gerbv_image_t *image)
+{
+	flash_stamps_t *stamps;
+
+	G_LOCK (flash_stamp);
+	stamps = image->flashStamps;
+	image->flashStamps = NULL;
+	G_UNLOCK (flash_stamp);
+
+	if (stamps == NULL)
+		return;
+
+	g_hash_table_destroy (stamps->stamps);
+	g_free (stamps);
+}
@@ -0,0 +1,63 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * flash_stamp.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file flash_stamp.h
+    \brief Header info for the cache of rasterized aperture flashes
+    \ingroup libgerbv
+*/
+
+#ifndef FLASH_STAMP_H
+#define FLASH_STAMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest stamp side, in pixels.  Larger flashes are drawn as paths */
+#define FLASH_STAMP_MAX_SIZE 256
+
+/* Everything besides the aperture which changes how a flash rasterizes */
+typedef struct {
+	gdouble scaleX, scaleY;		/* xx and yy of the device matrix */
+	gdouble pixelWidth;		/* one pixel, in user units */
+	gboolean limitLineWidth;	/* thin flashes are widened to a pixel */
+	cairo_antialias_t antialias;
+} flash_stamp_key_t;
+
+/* Returns a new reference to the A8 stamp of aperture drawn with key, or
+   NULL if there is none yet.  originX and originY receive the pixel
+   of the stamp the flash is centered on */
+cairo_surface_t *flash_stamp_lookup (gerbv_image_t *image, gint aperture,
+		const flash_stamp_key_t *key, gint *originX, gint *originY);
+
+/* Stores stamp as the stamp of aperture drawn with key, replacing any
+   stamp of the aperture drawn at another scale */
+void flash_stamp_store (gerbv_image_t *image, gint aperture,
+		const flash_stamp_key_t *key, cairo_surface_t *stamp,
+		gint originX, gint originY);
+
+/* Frees all stamps of image */
+void flash_stamp_invalidate (gerbv_image_t *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_STAMP_H */
@@ -0,0 +1,190 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * gerb_arena.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file gerb_arena.c
+    \brief Per-image arena allocator
+    \ingroup libgerbv
+
+    Nets, arc segments, layers and netstates live exactly as long as the
+    image owning them, so they are carved out of large zeroed chunks
+    instead of being allocated one by one.  Destroying the image frees a
+    handful of chunks instead of millions of small blocks.
+
+    The streaming parser hands every net to its caller as soon as it is
+    complete, and then drops everything allocated since the previous net
+    with gerb_arena_release().  Images merged from copies made on several
+    threads take over the arenas of the copies with gerb_arena_merge().
+*/
+
+#include <string.h>
+
+#include "gerb_arena.h"
+
+/* Chunks start small, so tiny images stay tiny, and double in size up
+   to GERB_ARENA_MAX_CHUNK_SIZE */
+#define GERB_ARENA_MIN_CHUNK_SIZE 4096
+#define GERB_ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+/* Alignment of all allocations, enough for doubles and pointers */
+#define GERB_ARENA_ALIGNMENT 8
+
+#define GERB_ARENA_ALIGN(size) \
+	(((size) + GERB_ARENA_ALIGNMENT - 1) & ~(gsize) (GERB_ARENA_ALIGNMENT - 1))
+
+typedef struct gerb_arena_chunk {
+	struct gerb_arena_chunk *next;
+	gsize size;		/*!< usable bytes after the header */
+	gsize used;
+} gerb_arena_chunk_t;
+
+#define GERB_ARENA_HEADER_SIZE GERB_ARENA_ALIGN (sizeof (gerb_arena_chunk_t))
+
+struct gerb_arena {
+	gerb_arena_chunk_t *chunks;	/*!< the current chunk comes first */
+	gsize nextChunkSize;
+};
+
+
+gerb_arena_t *
+gerb_arena_new (void)
+{
+	gerb_arena_t *arena = g_new0 (gerb_arena_t, 1);
+
+	arena->nextChunkSize = GERB_ARENA_MIN_CHUNK_SIZE;
+
+	return arena;
+}
+
+
+void
+gerb_arena_destroy (gerb_arena_t *arena)
+{
+	gerb_arena_chunk_t *chunk, *next;
+
+	if (arena == NULL)
+		return;
+
+	for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		g_free (chunk);
+	}
+	g_free (arena);
+}
+
+
+gpointer
+gerb_arena_alloc0 (gerb_arena_t *arena, gsize size)
+{
+	gerb_arena_chunk_t *chunk = arena->chunks;
+	gpointer memory;
+
+	size = GERB_ARENA_ALIGN (size);
+
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		gsize chunkSize = MAX (arena->nextChunkSize, size);
+
+		/* fresh chunks come zeroed, so allocations need no memset */
+		chunk = g_malloc0 (GERB_ARENA_HEADER_SIZE + chunkSize);
+		chunk->size = chunkSize;
+
+		if (arena->chunks != NULL && size > arena->nextChunkSize) {
+			/* keep filling the current chunk after an oversized
+			   allocation */
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		} else {
+			chunk->next = arena->chunks;
+			arena->chunks = chunk;
+		}
+
+		if (arena->nextChunkSize < GERB_ARENA_MAX_CHUNK_SIZE)
+			arena->nextChunkSize *= 2;
+	}
+
+	memory = (gchar *) chunk + GERB_ARENA_HEADER_SIZE + chunk->used;
+	chunk->used += size;
+
+	return memory;
+}
+
+
+void
+gerb_arena_merge (gerb_arena_t *arena, gerb_arena_t *other)
+{
+	gerb_arena_chunk_t *last;
+
+	if (other == NULL)
+		return;
+
+	if (other->chunks != NULL) {
+		for (last = other->chunks; last->next != NULL; last = last->next)
+			;
+
+		if (arena->chunks != NULL) {
+			/* keep filling the current chunk of arena */
+			last->next = arena->chunks->next;
+			arena->chunks->next = other->chunks;
+		} else {
+			arena->chunks = other->chunks;
+		}
+		other->chunks = NULL;
+	}
+	gerb_arena_destroy (other);
+}
+
+
+void
+gerb_arena_mark (gerb_arena_t *arena, gerb_arena_mark_t *mark)
+{
+	gerb_arena_chunk_t *chunk = arena->chunks;
+
+	mark->chunk = chunk;
+	mark->nextChunk = (chunk != NULL) ? chunk->next : NULL;
+	mark->used = (chunk != NULL) ? chunk->used : 0;
+}
+
+
+void
+gerb_arena_release (gerb_arena_t *arena, const gerb_arena_mark_t *mark)
+{
+	gerb_arena_chunk_t *chunk, *next;
+
+	/* chunks started after the mark are in front of the marked one... */
+	while (arena->chunks != mark->chunk) {
+		next = arena->chunks->next;
+		g_free (arena->chunks);
+		arena->chunks = next;
+	}
+
+	chunk = arena->chunks;
+	if (chunk == NULL)
+		return;
+
+	/* ...except oversized chunks, which go right behind it */
+	while (chunk->next != mark->nextChunk) {
+		next = chunk->next->next;
+		g_free (chunk->next);
+		chunk->next = next;
+	}
+
+	/* allocations expect zeroed memory */
+	memset ((gchar *) chunk + GERB_ARENA_HEADER_SIZE + mark->used, 0,
+			chunk->used - mark->used);
+	chunk->used = mark->used;
+}
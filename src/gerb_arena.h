@@ -0,0 +1,73 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * gerb_arena.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file gerb_arena.h
+    \brief Header info for the per-image arena allocator
+    \ingroup libgerbv
+*/
+
+#ifndef GERB_ARENA_H
+#define GERB_ARENA_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gerb_arena gerb_arena_t;
+
+/* Creates an empty arena */
+gerb_arena_t *gerb_arena_new (void);
+
+/* Frees the arena and everything allocated from it */
+void gerb_arena_destroy (gerb_arena_t *arena);
+
+/* Returns size bytes of zeroed memory which live as long as the arena.
+   The memory can not be freed on its own */
+gpointer gerb_arena_alloc0 (gerb_arena_t *arena, gsize size);
+
+/* Moves everything allocated from other into arena, to live as long as
+   arena, and destroys other.  Marks taken in arena before are no longer
+   valid */
+void gerb_arena_merge (gerb_arena_t *arena, gerb_arena_t *other);
+
+#define gerb_arena_new0(arena, struct_type) \
+	((struct_type *) gerb_arena_alloc0 ((arena), sizeof (struct_type)))
+
+/* A position in an arena, see gerb_arena_release() */
+typedef struct {
+	gpointer chunk;
+	gpointer nextChunk;
+	gsize used;
+} gerb_arena_mark_t;
+
+/* Remembers the current end of the arena in mark */
+void gerb_arena_mark (gerb_arena_t *arena, gerb_arena_mark_t *mark);
+
+/* Frees everything allocated from the arena after mark was taken.  Any
+   memory released this way must no longer be referenced */
+void gerb_arena_release (gerb_arena_t *arena, const gerb_arena_mark_t *mark);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GERB_ARENA_H */
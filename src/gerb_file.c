@@ -170,80 +170,258 @@ gerb_fgetc(gerb_file_t *fd)
 } /* gerb_fgetc */
 
 
+int
+gerb_fgetcode(gerb_file_t *fd)
+{
+    const char *p = fd->data + fd->ptr;
+    const char *end = fd->data + fd->datalen;
+
+    /* skip the white space between codes without returning to the parser */
+    while ((p < end) && ((*p == '\n') || (*p == '\r') || (*p == ' ')
+			 || (*p == '\t') || (*p == '\0')))
+	p++;
+
+    if (p >= end) {
+	fd->ptr = fd->datalen;
+	return EOF;
+    }
+
+    fd->ptr = p - fd->data + 1;
+
+    return (int) *p;
+} /* gerb_fgetcode */
+
+
 int
 gerb_fgetint(gerb_file_t *fd, int *len)
 {
-    long int result;
-    char *end;
-    
-    errno = 0;
-    result = strtol(fd->data + fd->ptr, &end, 10);
-    if (errno) {
-	GERB_COMPILE_ERROR(_("Failed to read integer"));
+    const char *start = fd->data + fd->ptr;
+    const char *end = fd->data + fd->datalen;
+    const char *p = start, *digits;
+    unsigned int result = 0;
+    int negative = 0;
+
+    /* 
+     * Accept the same syntax as strtol() but scan the digits by hand,
+     * since the data is not NUL terminated and this is called for every
+     * coordinate in the file.
+     */
+    while ((p < end) && g_ascii_isspace(*p))
+	p++;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+	negative = (*p == '-');
+	p++;
+    }
+
+    for (digits = p; (p < end) && g_ascii_isdigit(*p); p++) {
+	unsigned int digit = *p - '0';
+
+	if (result > (G_MAXINT - digit) / 10) {
+	    GERB_COMPILE_ERROR(_("Failed to read integer"));
+	    return 0;
+	}
+	result = result * 10 + digit;
+    }
+
+    /* like strtol(), don't move if there was no number */
+    if (p == digits) {
+	if (len)
+	    *len = 0;
 	return 0;
     }
 
     if (len) {
-	*len = end - (fd->data + fd->ptr);
+	*len = p - start;
+	if (negative && result)
+	    *len -= 1;
     }
 
-    fd->ptr = end - fd->data;
+    fd->ptr = p - fd->data;
 
-    if (len && (result < 0))
-	*len -= 1;
-
-    return (int)result;
+    return negative ? -(int)result : (int)result;
 } /* gerb_fgetint */
 
 
+int
+gerb_scan_decimal(const char *data, int len, const char *points,
+		  gerb_decimal_t *decimal)
+{
+    const char *p = data, *end = data + len;
+    int point = 0;
+
+    decimal->mantissa = 0;
+    decimal->exponent = 0;
+    decimal->digits = 0;
+    decimal->negative = 0;
+
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+	decimal->negative = (*p == '-');
+	p++;
+    }
+
+    for (; p < end; p++) {
+	if (g_ascii_isdigit(*p)) {
+	    decimal->digits++;
+	    if (decimal->mantissa < G_GUINT64_CONSTANT(1000000000000000000)) {
+		decimal->mantissa = decimal->mantissa * 10 + (*p - '0');
+		if (point)
+		    decimal->exponent--;
+	    } else if (!point) {
+		/* digits beyond the precision of a double only scale it */
+		decimal->exponent++;
+	    }
+	} else if (!point && (*p != '\0') && strchr(points, *p)) {
+	    point = 1;
+	} else {
+	    break;
+	}
+    }
+
+    /* like strtod(), a sign or point without digits is no number */
+    if (decimal->digits == 0)
+	return 0;
+
+    return p - data;
+} /* gerb_scan_decimal */
+
+
+double
+gerb_decimal_to_double(const gerb_decimal_t *decimal)
+{
+    static const double powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    char buffer[48];
+    double result;
+
+    /*
+     * Both the mantissa and the power of ten are exact doubles here, so
+     * one multiplication or division rounds like strtod() would
+     */
+    if ((decimal->mantissa <= (G_GUINT64_CONSTANT(1) << 53))
+	&& (decimal->exponent >= -22) && (decimal->exponent <= 22)) {
+	result = (double) decimal->mantissa;
+	if (decimal->exponent < 0)
+	    result /= powers[-decimal->exponent];
+	else
+	    result *= powers[decimal->exponent];
+    } else {
+	g_snprintf(buffer, sizeof(buffer), "%" G_GUINT64_FORMAT "e%d",
+		   decimal->mantissa, decimal->exponent);
+	result = g_ascii_strtod(buffer, NULL);
+    }
+
+    return decimal->negative ? -result : result;
+} /* gerb_decimal_to_double */
+
+
+int
+gerb_scan_double(const char *data, int len, double *value)
+{
+    const char *p = data, *end = data + len, *q;
+    gerb_decimal_t decimal;
+    int scanned, exponent = 0, negative = 0;
+
+    *value = 0.0;
+
+    while ((p < end) && g_ascii_isspace(*p))
+	p++;
+    scanned = gerb_scan_decimal(p, end - p, ".", &decimal);
+    if (scanned == 0)
+	return 0;
+    p += scanned;
+
+    /* an exponent only counts if it has digits */
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+	q = p + 1;
+	if ((q < end) && ((*q == '-') || (*q == '+'))) {
+	    negative = (*q == '-');
+	    q++;
+	}
+	if ((q < end) && g_ascii_isdigit(*q)) {
+	    for (; (q < end) && g_ascii_isdigit(*q); q++) {
+		if (exponent < 100000)
+		    exponent = exponent * 10 + (*q - '0');
+	    }
+	    decimal.exponent += negative ? -exponent : exponent;
+	    p = q;
+	}
+    }
+
+    *value = gerb_decimal_to_double(&decimal);
+
+    return p - data;
+} /* gerb_scan_double */
+
+
 double
 gerb_fgetdouble(gerb_file_t *fd)
 {
     double result;
-    char *end;
 
-    errno = 0;    
-    result = strtod(fd->data + fd->ptr, &end);
+    errno = 0;
+    fd->ptr += gerb_scan_double(fd->data + fd->ptr, fd->datalen - fd->ptr,
+				&result);
+    /* only an out of range exponent sets errno */
     if (errno) {
 	GERB_COMPILE_ERROR(_("Failed to read double"));
 	return 0.0;
     }
 
-    fd->ptr = end - fd->data;
-
     return result;
 } /* gerb_fgetdouble */
 
 
-char *
-gerb_fgetstring(gerb_file_t *fd, char term)
+int
+gerb_fgetslice(gerb_file_t *fd, char term, gerb_file_slice_t *slice)
 {
-    char *strend = NULL;
-    char *newstr;
-    char *i, *iend;
-    int len;
-
-    iend = fd->data + fd->datalen;
-    for (i = fd->data + fd->ptr; i < iend; i++) {
-	if (*i == term) {
-	    strend = i;
-	    break;
-	}
-    }
+    const char *start = fd->data + fd->ptr;
+    const char *strend;
 
+    strend = memchr(start, term, fd->datalen - fd->ptr);
     if (strend == NULL)
-	return NULL;
+	return 0;
+
+    slice->data = start;
+    slice->len = strend - start;
+    fd->ptr += slice->len;
+
+    return 1;
+} /* gerb_fgetslice */
+
+
+int
+gerb_fgetline(gerb_file_t *fd, gerb_file_slice_t *slice)
+{
+    const char *start = fd->data + fd->ptr;
+    const char *end = fd->data + fd->datalen;
+    const char *p;
+
+    for (p = start; (p < end) && (*p != '\n') && (*p != '\r'); p++)
+	;
+
+    slice->data = start;
+    slice->len = p - start;
+    fd->ptr = p - fd->data;
+    if (p == end)
+	return 0;
+
+    fd->ptr++;
 
-    len = strend - (fd->data + fd->ptr);
+    return 1;
+} /* gerb_fgetline */
+
+
+char *
+gerb_fgetstring(gerb_file_t *fd, char term)
+{
+    gerb_file_slice_t slice;
 
-    newstr = (char *)g_malloc(len + 1);
-    if (newstr == NULL)
+    if (!gerb_fgetslice(fd, term, &slice))
 	return NULL;
-    strncpy(newstr, fd->data + fd->ptr, len);
-    newstr[len] = '\0';
-    fd->ptr += len;
 
-    return newstr;
+    return g_strndup(slice.data, slice.len);
 } /* gerb_fgetstring */
 
 
@@ -30,6 +30,7 @@
 #define GERB_FILE_H
 
 #include <stdio.h>
+#include <glib.h>
 
 typedef struct file {
     FILE *fd;     /* File descriptor */
@@ -40,13 +41,47 @@ typedef struct file {
     char *filename;  /* File name */
 } gerb_file_t;
 
+/* A piece of the file data, which is not NUL terminated */
+typedef struct {
+    const char *data;
+    int len;
+} gerb_file_slice_t;
+
+/* A decimal number scanned from the file data, worth
+   mantissa * 10^exponent */
+typedef struct {
+    guint64 mantissa; /* the first 19 digits */
+    int exponent;
+    int digits;       /* number of digits scanned */
+    int negative;
+} gerb_decimal_t;
+
 
 gerb_file_t *gerb_fopen(char const* filename);
 int gerb_fgetc(gerb_file_t *fd);
+int gerb_fgetcode(gerb_file_t *fd); /* gerb_fgetc() skipping white space */
 int gerb_fgetint(gerb_file_t *fd, int *len); /* If len != NULL, returns number
 						of chars parsed in len */
 double gerb_fgetdouble(gerb_file_t *fd);
+int gerb_scan_decimal(const char *data, int len, const char *points,
+		      gerb_decimal_t *decimal);
+			/* Scans [sign]digits[point digits] from the len
+			   bytes at data, with any char of points as the
+			   decimal point.  Returns the number of bytes
+			   scanned, 0 if there is no number */
+double gerb_decimal_to_double(const gerb_decimal_t *decimal);
+			/* Rounds like strtod() */
+int gerb_scan_double(const char *data, int len, double *value);
+			/* Like g_ascii_strtod() on the len bytes at data,
+			   without hex, inf and nan.  Returns the number of
+			   bytes scanned */
 char *gerb_fgetstring(gerb_file_t *fd, char term);
+int gerb_fgetslice(gerb_file_t *fd, char term, gerb_file_slice_t *slice);
+			/* Like gerb_fgetstring() without copying, returns
+			   0 if term isn't found */
+int gerb_fgetline(gerb_file_t *fd, gerb_file_slice_t *slice);
+			/* Returns the rest of the line and skips its CR or
+			   LF, returns 0 if the line ends the file */
 void gerb_ungetc(gerb_file_t *fd);
 void gerb_fclose(gerb_file_t *fd);
 
@@ -36,11 +36,39 @@
 #include "gerb_image.h"
 #include "gerber.h"
 #include "amacro.h"
-
+#include "net_index.h"
+#include "flash_stamp.h"
+#include "aperture_index.h"
+#include "aperture_table.h"
+#include "gerb_arena.h"
+#include "layer_stats.h"
+
+/* Errors found while transforming the apertures of one copied image */
+typedef struct {
+	guint	scale_circle,
+		scale_line_macro,
+		scale_poly_macro,
+		scale_thermo_macro,
+		scale_moire_macro,
+		unknown_aperture,
+		unknown_macro_aperture,
+		rotate_oval,
+		rotate_rect;
+} gerbv_image_transform_errors_t;
+
+/* The copy of the nets of one source image made by
+   gerbv_image_merge_nets(), before it is spliced onto the destination */
 typedef struct {
-    int oldAperture;
-    int newAperture;
-} gerb_translation_entry_t;
+	gerbv_image_t *sourceImage;	/*!< NULL if the image is skipped */
+	gerbv_user_transformation_t *trans;
+	int *apertureMap;	/*!< destination aperture by source aperture number, or -1 */
+	int apertureMapSize;
+	gerb_arena_t *arena;	/*!< storage of the copy until it is spliced */
+	gerbv_layer_t *firstLayer, *lastLayer;
+	gerbv_netstate_t *firstState, *lastState;
+	gerbv_net_t *firstNet, *lastNet;
+	gint layerCount, stateCount, netCount;
+} gerbv_image_segment_t;
 
 gerbv_image_t *
 gerbv_create_image(gerbv_image_t *image, const gchar *type)
@@ -53,16 +81,13 @@ gerbv_create_image(gerbv_image_t *image, const gchar *type)
     }
     memset((void *)image, 0, sizeof(gerbv_image_t));
     
-    /* Malloc space for image->netlist */
-    if ((image->netlist = (gerbv_net_t *)g_malloc(sizeof(gerbv_net_t))) == NULL) {
-	g_free(image);
-	return NULL;
-    }
-    memset((void *)image->netlist, 0, sizeof(gerbv_net_t));
+    /* The nets, layers and netstates all live in the image's arena */
+    image->arena = gerb_arena_new ();
+    image->netlist = gerb_arena_new0 (image->arena, gerbv_net_t);
     
     /* Malloc space for image->info */
     if ((image->info = (gerbv_image_info_t *)g_malloc(sizeof(gerbv_image_info_t))) == NULL) {
-	g_free(image->netlist);
+	gerb_arena_destroy(image->arena);
 	g_free(image);
 	return NULL;
     }
@@ -78,13 +103,13 @@ gerbv_create_image(gerbv_image_t *image, const gchar *type)
     image->info->max_y = -HUGE_VAL;
 
     /* create our first layer and fill with non-zero default values */
-    image->layers = g_new0 (gerbv_layer_t, 1);
+    image->layers = gerb_arena_new0 (image->arena, gerbv_layer_t);
     image->layers->stepAndRepeat.X = 1;
     image->layers->stepAndRepeat.Y = 1;
     image->layers->polarity = GERBV_POLARITY_DARK;
     
     /* create our first netstate and fill with non-zero default values */
-    image->states = g_new0 (gerbv_netstate_t, 1);
+    image->states = gerb_arena_new0 (image->arena, gerbv_netstate_t);
     image->states->scaleA = 1;
     image->states->scaleB = 1;
 
@@ -109,29 +134,33 @@ void
 gerbv_destroy_image(gerbv_image_t *image)
 {
     int i;
-    gerbv_net_t *net, *tmp;
-    gerbv_layer_t *layer;
-    gerbv_netstate_t *state;
+    gerbv_net_t *net;
     gerbv_simplified_amacro_t *sam,*sam2;
 
     if(image==NULL)
         return;
+
+    net_index_invalidate (image);
+    flash_stamp_invalidate (image);
+    aperture_index_invalidate (image);
+    layer_stats_invalidate (image);
         
     /*
      * Free apertures
      */
-    for (i = 0; i < APERTURE_MAX; i++) 
-	if (image->aperture[i] != NULL) {
-	    for (sam = image->aperture[i]->simplified; sam != NULL; ){
-	      sam2 = sam->next;
-	    	g_free (sam);
-	    	sam = sam2;
-	    }
-
-	    g_free(image->aperture[i]);
-	    image->aperture[i] = NULL;
+    for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+	gerbv_aperture_t *aperture = gerbv_image_get_nth_aperture (image, i, NULL);
+
+	for (sam = aperture->simplified; sam != NULL; ){
+	  sam2 = sam->next;
+		g_free (sam);
+		sam = sam2;
 	}
 
+	g_free(aperture);
+    }
+    aperture_table_destroy (image);
+
     /*
      * Free aperture macro
      */
@@ -157,33 +186,15 @@ gerbv_destroy_image(gerbv_image_t *image)
     }
     
     /*
-     * Free netlist
+     * Free netlist.  The nets, cirsegs, layers and netstates are freed
+     * all at once with the arena, only the labels are separate.
      */
-    for (net = image->netlist; net != NULL; ) {
-	tmp = net; 
-	net = net->next; 
-	if (tmp->cirseg != NULL) {
-	    g_free(tmp->cirseg);
-	    tmp->cirseg = NULL;
-	}
-	if (tmp->label) {
-		g_string_free (tmp->label, TRUE);
+    for (net = image->netlist; net != NULL; net = net->next) {
+	if (net->label) {
+		g_string_free (net->label, TRUE);
 	}
-	g_free(tmp);
-	tmp = NULL;
-    }
-    for (layer = image->layers; layer != NULL; ) {
-    	gerbv_layer_t *tempLayer = layer;
-    	
-    	layer = layer->next;
-    	g_free (tempLayer);
-    }
-    for (state = image->states; state != NULL; ) {
-    	gerbv_netstate_t *tempState = state;
-    	
-    	state = state->next;
-    	g_free (tempState);
     }
+    gerb_arena_destroy (image->arena);
     gerbv_stats_destroy(image->gerbv_stats);
     gerbv_drill_stats_destroy(image->drill_stats);
 
@@ -211,7 +222,7 @@ gerb_verify_error_t
 gerbv_image_verify(gerbv_image_t const* image)
 {
     gerb_verify_error_t error = GERB_IMAGE_OK;
-    int i, n_nets;;
+    int n_nets;
     gerbv_net_t *net;
 
     if (image->netlist == NULL) error |= GERB_IMAGE_MISSING_NETLIST;
@@ -228,8 +239,8 @@ gerbv_image_verify(gerbv_image_t const* image)
 
     /* If we have nets but no apertures are defined, then complain */
     if( n_nets > 0) {
-      for (i = 0; i < APERTURE_MAX && image->aperture[i] == NULL; i++);
-      if (i == APERTURE_MAX) error |= GERB_IMAGE_MISSING_APERTURES;
+      if (gerbv_image_get_aperture_count (image) == 0)
+	error |= GERB_IMAGE_MISSING_APERTURES;
     }
 
     return error;
@@ -291,40 +302,38 @@ gerbv_image_aperture_state(gerbv_aperture_state_t state)
 void 
 gerbv_image_dump(gerbv_image_t const* image)
 {
-    int i, j;
-    gerbv_aperture_t * const* aperture;
+    int i, j, number;
+    gerbv_aperture_t const* aperture;
     gerbv_net_t const * net;
 
     /* Apertures */
     printf(_("Apertures:\n"));
-    aperture = image->aperture;
-    for (i = 0; i < APERTURE_MAX; i++) {
-	if (aperture[i]) {
-	    printf(_(" Aperture no:%d is an "), i);
-	    switch(aperture[i]->type) {
-	    case GERBV_APTYPE_CIRCLE:
-		printf(_("circle"));
-		break;
-	    case GERBV_APTYPE_RECTANGLE:
-		printf(_("rectangle"));
-		break;
-	    case GERBV_APTYPE_OVAL:
-		printf(_("oval"));
-		break;
-	    case GERBV_APTYPE_POLYGON:
-		printf(_("polygon"));
-		break;
-	    case GERBV_APTYPE_MACRO:
-		printf(_("macro"));
-		break;
-	    default:
-		printf(_("unknown"));
-	    }
-	    for (j = 0; j < aperture[i]->nuf_parameters; j++) {
-		printf(" %f", aperture[i]->parameter[j]);
-	    }
-	    printf("\n");
+    for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+	aperture = gerbv_image_get_nth_aperture (image, i, &number);
+	printf(_(" Aperture no:%d is an "), number);
+	switch(aperture->type) {
+	case GERBV_APTYPE_CIRCLE:
+	    printf(_("circle"));
+	    break;
+	case GERBV_APTYPE_RECTANGLE:
+	    printf(_("rectangle"));
+	    break;
+	case GERBV_APTYPE_OVAL:
+	    printf(_("oval"));
+	    break;
+	case GERBV_APTYPE_POLYGON:
+	    printf(_("polygon"));
+	    break;
+	case GERBV_APTYPE_MACRO:
+	    printf(_("macro"));
+	    break;
+	default:
+	    printf(_("unknown"));
 	}
+	for (j = 0; j < aperture->nuf_parameters; j++) {
+	    printf(" %f", aperture->parameter[j]);
+	}
+	printf("\n");
     }
 
     /* Netlist */
@@ -341,50 +350,138 @@ gerbv_image_dump(gerbv_image_t const* image)
 
 
 gerbv_layer_t *
-gerbv_image_return_new_layer (gerbv_layer_t *previousLayer)
+gerbv_image_return_new_layer (gerbv_image_t *image, gerbv_layer_t *previousLayer)
 {
-    gerbv_layer_t *newLayer = g_new0 (gerbv_layer_t, 1);
+    gerbv_layer_t *newLayer = gerb_arena_new0 (image->arena, gerbv_layer_t);
     
     *newLayer = *previousLayer;
     previousLayer->next = newLayer;
     /* clear this boolean so we only draw the knockout once */
     newLayer->knockout.firstInstance = FALSE;
     newLayer->next = NULL;
+    if (previousLayer == image->lastLayer) {
+	image->lastLayer = newLayer;
+	image->layerCount++;
+    }
     
     return newLayer;
 } /* gerbv_image_return_new_layer */
 
 
 gerbv_netstate_t *
-gerbv_image_return_new_netstate (gerbv_netstate_t *previousState)
+gerbv_image_return_new_netstate (gerbv_image_t *image, gerbv_netstate_t *previousState)
 {
-    gerbv_netstate_t *newState = g_new0 (gerbv_netstate_t, 1);
+    gerbv_netstate_t *newState = gerb_arena_new0 (image->arena, gerbv_netstate_t);
     
     *newState = *previousState;
     previousState->next = newState;
     newState->scaleA = 1.0;
     newState->scaleB = 1.0;
     newState->next = NULL;
+    if (previousState == image->lastState) {
+	image->lastState = newState;
+	image->stateCount++;
+    }
     
     return newState;
 } /* gerbv_image_return_new_netstate */
 
+/*
+ * The image remembers the last net, layer and netstate of its chains and
+ * how many there are, so appending does not walk the chains.  Whatever
+ * was linked in behind the remembered tail without going through the
+ * image is picked up on the next call.
+ */
+gerbv_net_t *
+gerbv_image_get_last_net (gerbv_image_t *image)
+{
+    if (image->lastNet == NULL) {
+	image->lastNet = image->netlist;
+	image->netCount = 1;
+    }
+    while (image->lastNet->next != NULL) {
+	image->lastNet = image->lastNet->next;
+	image->netCount++;
+    }
+
+    return image->lastNet;
+} /* gerbv_image_get_last_net */
+
+
 gerbv_layer_t *
-gerbv_image_duplicate_layer (gerbv_layer_t *oldLayer) {
-    gerbv_layer_t *newLayer = g_new (gerbv_layer_t,1);
-    
-    *newLayer = *oldLayer;
-    newLayer->name = g_strdup (oldLayer->name);
-    return newLayer;
+gerbv_image_get_last_layer (gerbv_image_t *image)
+{
+    if (image->lastLayer == NULL) {
+	image->lastLayer = image->layers;
+	image->layerCount = 1;
+    }
+    while (image->lastLayer->next != NULL) {
+	image->lastLayer = image->lastLayer->next;
+	image->layerCount++;
+    }
+
+    return image->lastLayer;
+} /* gerbv_image_get_last_layer */
+
+
+gerbv_netstate_t *
+gerbv_image_get_last_state (gerbv_image_t *image)
+{
+    if (image->lastState == NULL) {
+	image->lastState = image->states;
+	image->stateCount = 1;
+    }
+    while (image->lastState->next != NULL) {
+	image->lastState = image->lastState->next;
+	image->stateCount++;
+    }
+
+    return image->lastState;
+} /* gerbv_image_get_last_state */
+
+
+gint
+gerbv_image_get_net_count (gerbv_image_t *image)
+{
+    gerbv_image_get_last_net (image);
+
+    return image->netCount;
+}
+
+
+gint
+gerbv_image_get_layer_count (gerbv_image_t *image)
+{
+    gerbv_image_get_last_layer (image);
+
+    return image->layerCount;
+}
+
+
+gint
+gerbv_image_get_state_count (gerbv_image_t *image)
+{
+    gerbv_image_get_last_state (image);
+
+    return image->stateCount;
 }
 
-static gerbv_netstate_t *
-gerbv_image_duplicate_state (gerbv_netstate_t *oldState)
+
+gerbv_net_t *
+gerbv_image_append_net (gerbv_image_t *image)
 {
-	gerbv_netstate_t *newState = g_new (gerbv_netstate_t, 1);
+    gerbv_net_t *lastNet = gerbv_image_get_last_net (image);
+
+    return gerber_create_new_net (image, lastNet, NULL, NULL);
+} /* gerbv_image_append_net */
 
-	*newState = *oldState;
-	return newState;
+gerbv_layer_t *
+gerbv_image_duplicate_layer (gerbv_image_t *image, gerbv_layer_t *oldLayer) {
+    gerbv_layer_t *newLayer = gerb_arena_new0 (image->arena, gerbv_layer_t);
+    
+    *newLayer = *oldLayer;
+    newLayer->name = g_strdup (oldLayer->name);
+    return newLayer;
 }
 
 static gerbv_aperture_t *
@@ -414,541 +511,679 @@ gerbv_image_duplicate_aperture (gerbv_aperture_t *oldAperture)
     return newAperture;
 }
 
-static void
-gerbv_image_copy_all_nets (gerbv_image_t *sourceImage,
-		gerbv_image_t *destImage, gerbv_layer_t *lastLayer,
-		gerbv_netstate_t *lastState, gerbv_net_t *lastNet,
-		gerbv_user_transformation_t *trans,
-		GArray *translationTable)
+/* Adds aperture to image under the number after the highest one in use,
+   and returns that number */
+static int
+gerbv_image_append_aperture (gerbv_image_t *image, gerbv_aperture_t *aperture)
 {
-	/* NOTE: destImage already contains apertures and data,
-	 * latest data is: lastLayer, lastState, lastNet. */
+	int number = MAX (aperture_table_last_number (image), 0) + 1;
 
-	gerbv_net_t *currentNet, *newNet;
+	gerbv_image_set_aperture (image, number, aperture);
+
+	return number;
+}
+
+/* Returns the number of a copy of aperture number of destImage transformed
+   by trans, which is added to destImage, or number if it is left as is */
+static int
+gerbv_image_transform_aperture (gerbv_image_t *destImage, int number,
+		gerbv_user_transformation_t *trans,
+		gerbv_image_transform_errors_t *errors)
+{
 	gerbv_aperture_type_t aper_type;
 	gerbv_aperture_t *aper;
 	gerbv_simplified_amacro_t *sam;
-	int *trans_apers = NULL; /* Transformed apertures */
-	int aper_last_id = 0;
-	guint	err_scale_circle = 0,
-		err_scale_line_macro = 0,
-		err_scale_poly_macro = 0,
-		err_scale_thermo_macro = 0,
-		err_scale_moire_macro = 0,
-		err_unknown_aperture = 0,
-		err_unknown_macro_aperture = 0,
-		err_rotate_oval = 0,
-		err_rotate_rect = 0;
 	guint i;
 
-	if (trans && (trans->mirrorAroundX || trans->mirrorAroundY)) {
-		if (sourceImage->layertype != GERBV_LAYERTYPE_DRILL) {
-			GERB_COMPILE_ERROR(_("Exporting mirrored file "
-						"is not supported!"));
-			return;
-		}
-	}
+	aper_type = gerbv_image_get_aperture (destImage, number)->type;
 
-	if (trans && trans->inverted) {
-		GERB_COMPILE_ERROR(_("Exporting inverted file "
-					"is not supported!"));
-		return;
-	}
+	switch (aper_type) {
+	case GERBV_APTYPE_NONE:
+	case GERBV_APTYPE_POLYGON:
+		break;
 
-	if (trans) {
-		/* Find last used aperture to add transformed apertures if
-		 * needed */
-		for (aper_last_id = APERTURE_MAX - 1; aper_last_id > 0;
-						aper_last_id--) {
-			if (destImage->aperture[aper_last_id] != NULL)
-				break;
+	case GERBV_APTYPE_CIRCLE:
+		if (trans->scaleX == trans->scaleY
+				&& trans->scaleX == 1.0) {
+			break;
 		}
 
-		trans_apers = g_new (int, aper_last_id + 1);
-		/* Initialize trans_apers array */
-		for (i = 0; i < aper_last_id + 1; i++)
-			trans_apers[i] = -1;
-	}
-
-	for (currentNet = sourceImage->netlist; currentNet != NULL;
-			currentNet = currentNet->next) {
-
-		/* Check for any new layers and duplicate them if needed */
-		if (currentNet->layer != lastLayer) {
-			lastLayer->next =
-				gerbv_image_duplicate_layer (currentNet->layer);
-			lastLayer = lastLayer->next;
-		}
+		if (trans->scaleX == trans->scaleY) {
+			aper = gerbv_image_duplicate_aperture (
+					gerbv_image_get_aperture (
+						destImage,
+						number));
+			aper->parameter[0] *= trans->scaleX;
 
-		/* Check for any new states and duplicate them if needed */
-		if (currentNet->state != lastState) {
-			lastState->next =
-				gerbv_image_duplicate_state (currentNet->state);
-			lastState = lastState->next;
+			return gerbv_image_append_aperture (destImage, aper);
+		} else {
+			errors->scale_circle++;
 		}
+		break;
 
-		/* Create and copy the actual net over */
-		newNet = g_new (gerbv_net_t, 1);
-		*newNet = *currentNet;
-
-		if (currentNet->cirseg) {
-			newNet->cirseg = g_new (gerbv_cirseg_t, 1);
-			*(newNet->cirseg) = *(currentNet->cirseg);
+	case GERBV_APTYPE_RECTANGLE:
+	case GERBV_APTYPE_OVAL:
+		if (trans->scaleX == trans->scaleY
+		&& trans->scaleX == 1.0
+		&& (fabs(trans->rotation) == M_PI
+		 || fabs(trans->rotation) == DEG2RAD(180)))
+			break;	/* DEG2RAD for calc error */
+
+		aper = gerbv_image_duplicate_aperture (
+				gerbv_image_get_aperture (destImage,
+					number));
+		aper->parameter[0] *= trans->scaleX;
+		aper->parameter[1] *= trans->scaleY;
+
+		if (fabs(trans->rotation) == M_PI_2
+		 || fabs(trans->rotation) == DEG2RAD(90)
+		 || fabs(trans->rotation) == (M_PI+M_PI_2)
+		 || fabs(trans->rotation) == DEG2RAD(270)) {
+					/* DEG2RAD for calc error */
+			double t = aper->parameter[0];
+			aper->parameter[0] = aper->parameter[1];
+			aper->parameter[1] = t;
+		} else {
+			if (aper_type == GERBV_APTYPE_RECTANGLE)
+				errors->rotate_rect++;	/* TODO: make line21 macro */
+			else
+				errors->rotate_oval++;
+
+			g_free (aper);
+			break;
 		}
 
-		if (currentNet->label)
-			newNet->label = g_string_new (currentNet->label->str);
-		else
-			newNet->label = NULL;
+		return gerbv_image_append_aperture (destImage, aper);
 
-		newNet->state = lastState;
-		newNet->layer = lastLayer;
+	case GERBV_APTYPE_MACRO:
+		aper = gerbv_image_duplicate_aperture (
+				gerbv_image_get_aperture (destImage,
+					number));
+		sam = aper->simplified;
 
-		if (lastNet)
-			lastNet->next = newNet;
-		else
-			destImage->netlist = newNet;
+		for (; sam != NULL; sam = sam->next) {
+			switch (sam->type) {
+			case GERBV_APTYPE_MACRO_CIRCLE:
 
-		lastNet = newNet;
+/* TODO: test circle macro center rotation */
+				sam->parameter[CIRCLE_CENTER_X] *=
+							trans->scaleX;
+				sam->parameter[CIRCLE_CENTER_Y] *=
+							trans->scaleY;
+				gerbv_rotate_coord(
+					sam->parameter +CIRCLE_CENTER_X,
+					sam->parameter +CIRCLE_CENTER_Y,
+					trans->rotation);
 
-		/* Check if we need to translate the aperture number */
-		if (translationTable) {
-			for (i = 0; i < translationTable->len; i++) {
-				gerb_translation_entry_t translationEntry;
-
-				translationEntry =
-					g_array_index (translationTable,
-						gerb_translation_entry_t, i);
-
-				if (translationEntry.oldAperture ==
-						newNet->aperture) {
-					newNet->aperture =
-						translationEntry.newAperture;
+				if (trans->scaleX != trans->scaleY) {
+					errors->scale_circle++;
 					break;
 				}
-			}
-		}
-
-		if (trans == NULL)
-			continue;
-
-		/* Transforming coords */
-		gerbv_transform_coord (&newNet->start_x,
-				&newNet->start_y, trans);
-		gerbv_transform_coord (&newNet->stop_x,
-				&newNet->stop_y, trans);
-
-		if (newNet->cirseg) {
-			/* Circular interpolation only exported by start, stop
-			 * end center coordinates. */
-			gerbv_transform_coord (&newNet->cirseg->cp_x,
-				&newNet->cirseg->cp_y, trans);
-		}
-
-		if (destImage->aperture[newNet->aperture] == NULL)
-			continue;
-
-		if (trans->scaleX == trans->scaleY
-				&& trans->scaleX == 1.0
-				&& trans->rotation == 0.0)
-			continue;
-
-		/* Aperture is already transformed, use it */
-		if (trans_apers[newNet->aperture] != -1) {
-			newNet->aperture = trans_apers[newNet->aperture];
-			continue;
-		}
-
-		/* Transforming apertures */
-		aper_type = destImage->aperture[newNet->aperture]->type;
-		switch (aper_type) {
-		case GERBV_APTYPE_NONE:
-		case GERBV_APTYPE_POLYGON:
-			break;
-
-		case GERBV_APTYPE_CIRCLE:
-			if (trans->scaleX == trans->scaleY
-					&& trans->scaleX == 1.0) {
+				sam->parameter[CIRCLE_DIAMETER] *=
+							trans->scaleX;
 				break;
-			}
-
-			if (trans->scaleX == trans->scaleY) {
-				aper = gerbv_image_duplicate_aperture (
-						destImage->aperture[
-							newNet->aperture]);
-				aper->parameter[0] *= trans->scaleX;
-
-				trans_apers[newNet->aperture] = ++aper_last_id;
-				destImage->aperture[aper_last_id] = aper;
-				newNet->aperture = aper_last_id;
-			} else {
-				err_scale_circle++;
-			}
-			break;
-
-		case GERBV_APTYPE_RECTANGLE:
-		case GERBV_APTYPE_OVAL:
-			if (trans->scaleX == trans->scaleY
-			&& trans->scaleX == 1.0
-			&& (fabs(trans->rotation) == M_PI
-			 || fabs(trans->rotation) == DEG2RAD(180)))
-				break;	/* DEG2RAD for calc error */
 
-			aper = gerbv_image_duplicate_aperture (
-					destImage->aperture[newNet->aperture]);
-			aper->parameter[0] *= trans->scaleX;
-			aper->parameter[1] *= trans->scaleY;
-
-			if (fabs(trans->rotation) == M_PI_2
-			 || fabs(trans->rotation) == DEG2RAD(90)
-			 || fabs(trans->rotation) == (M_PI+M_PI_2)
-			 || fabs(trans->rotation) == DEG2RAD(270)) {
-						/* DEG2RAD for calc error */
-				double t = aper->parameter[0];
-				aper->parameter[0] = aper->parameter[1];
-				aper->parameter[1] = t;
-			} else {
-				if (aper_type == GERBV_APTYPE_RECTANGLE)
-					err_rotate_rect++;	/* TODO: make line21 macro */
-				else
-					err_rotate_oval++;
+			case GERBV_APTYPE_MACRO_LINE20:
+				/* Vector line rectangle */
+				if (trans->scaleX == trans->scaleY) {
+					sam->parameter[LINE20_LINE_WIDTH] *=
+							trans->scaleX;
+				} else if (sam->parameter[LINE20_START_X] ==
+						sam->parameter[LINE20_END_X]) {
+					sam->parameter[LINE20_LINE_WIDTH] *=
+						trans->scaleX;	/* Vertical */
+				} else if (sam->parameter[LINE20_START_Y] ==
+						sam->parameter[LINE20_END_Y]) {
+					sam->parameter[LINE20_LINE_WIDTH] *=
+						trans->scaleY;	/* Horizontal */
+				} else {
+					/* TODO: make outline macro */
+					errors->scale_line_macro++;
+					break;
+				}
 
+				sam->parameter[LINE20_START_X] *=
+						trans->scaleX;
+				sam->parameter[LINE20_START_Y] *=
+						trans->scaleY;
+				sam->parameter[LINE20_END_X] *=
+						trans->scaleX;
+				sam->parameter[LINE20_END_Y] *=
+						trans->scaleY;
+
+				/* LINE20_START_X, LINE20_START_Y,
+				 * LINE20_END_X, LINE20_END_Y are not
+				 * rotated, change only rotation angle */
+				sam->parameter[LINE20_ROTATION] +=
+					RAD2DEG(trans->rotation);
 				break;
-			}
 
-			trans_apers[newNet->aperture] = ++aper_last_id;
-			destImage->aperture[aper_last_id] = aper;
-			newNet->aperture = aper_last_id;
+/* Compile time check if LINE21 and LINE22 parameters indexes are equal */
+#if (LINE21_WIDTH != LINE22_WIDTH) \
+ || (LINE21_HEIGHT != LINE22_HEIGHT) \
+ || (LINE21_ROTATION != LINE22_ROTATION) \
+ || (LINE21_CENTER_X != LINE22_LOWER_LEFT_X) \
+ || (LINE21_CENTER_Y != LINE22_LOWER_LEFT_Y)
+# error "LINE21 and LINE22 indexes are not equal"
+#endif
 
-			break;
+			case GERBV_APTYPE_MACRO_LINE21:
+					/* Centered line rectangle */
+			case GERBV_APTYPE_MACRO_LINE22:
+					/* Lower left line rectangle */
 
-		case GERBV_APTYPE_MACRO:
-			aper = gerbv_image_duplicate_aperture (
-					destImage->aperture[newNet->aperture]);
-			sam = aper->simplified;
+				/* Using LINE21 parameters array
+				 * indexes for LINE21 and LINE22, as
+				 * they are equal */
+				if (trans->scaleX == trans->scaleY) {
+					sam->parameter[LINE21_WIDTH] *=
+							trans->scaleX;
+					sam->parameter[LINE21_HEIGHT] *=
+							trans->scaleX;
 
-			for (; sam != NULL; sam = sam->next) {
-				switch (sam->type) {
-				case GERBV_APTYPE_MACRO_CIRCLE:
+				} else if (fabs(sam->parameter[LINE21_ROTATION]) == 0
+				|| fabs(sam->parameter[LINE21_ROTATION]) == 190) {
+					sam->parameter[LINE21_WIDTH] *=
+							trans->scaleX;
+					sam->parameter[LINE21_HEIGHT] *=
+							trans->scaleY;
 
-/* TODO: test circle macro center rotation */
-					sam->parameter[CIRCLE_CENTER_X] *=
-								trans->scaleX;
-					sam->parameter[CIRCLE_CENTER_Y] *=
-								trans->scaleY;
-					gerbv_rotate_coord(
-						sam->parameter +CIRCLE_CENTER_X,
-						sam->parameter +CIRCLE_CENTER_Y,
-						trans->rotation);
-
-					if (trans->scaleX != trans->scaleY) {
-						err_scale_circle++;
-						break;
-					}
-					sam->parameter[CIRCLE_DIAMETER] *=
-								trans->scaleX;
+				} else if (fabs(sam->parameter[LINE21_ROTATION]) == 90
+				|| fabs(sam->parameter[LINE21_ROTATION]) == 270) {
+					/* DEG2RAD for calc error */
+					double t;
+					t =sam->parameter[LINE21_WIDTH];
+					sam->parameter[LINE21_WIDTH] =
+						trans->scaleY *
+						sam->parameter[
+							LINE21_HEIGHT];
+					sam->parameter[LINE21_HEIGHT] =
+						trans->scaleX * t;
+				} else {
+					/* TODO: make outline macro */
+					errors->scale_line_macro++;
 					break;
+				}
 
-				case GERBV_APTYPE_MACRO_LINE20:
-					/* Vector line rectangle */
-					if (trans->scaleX == trans->scaleY) {
-						sam->parameter[LINE20_LINE_WIDTH] *=
-								trans->scaleX;
-					} else if (sam->parameter[LINE20_START_X] ==
-							sam->parameter[LINE20_END_X]) {
-						sam->parameter[LINE20_LINE_WIDTH] *=
-							trans->scaleX;	/* Vertical */
-					} else if (sam->parameter[LINE20_START_Y] ==
-							sam->parameter[LINE20_END_Y]) {
-						sam->parameter[LINE20_LINE_WIDTH] *=
-							trans->scaleY;	/* Horizontal */
-					} else {
-						/* TODO: make outline macro */
-						err_scale_line_macro++;
-						break;
-					}
-
-					sam->parameter[LINE20_START_X] *=
+				sam->parameter[LINE21_CENTER_X] *=
 							trans->scaleX;
-					sam->parameter[LINE20_START_Y] *=
+				sam->parameter[LINE21_CENTER_Y] *=
 							trans->scaleY;
-					sam->parameter[LINE20_END_X] *=
+
+				sam->parameter[LINE21_ROTATION] +=
+					RAD2DEG(trans->rotation);
+				gerbv_rotate_coord(
+					sam->parameter +LINE21_CENTER_X,
+					sam->parameter +LINE21_CENTER_Y,
+					trans->rotation);
+				break;
+
+			case GERBV_APTYPE_MACRO_OUTLINE:
+				for (i = 0; i < 1 + sam->parameter[
+						OUTLINE_NUMBER_OF_POINTS]; i++) {
+					sam->parameter[OUTLINE_X_IDX_OF_POINT(i)] *=
 							trans->scaleX;
-					sam->parameter[LINE20_END_Y] *=
+					sam->parameter[OUTLINE_Y_IDX_OF_POINT(i)] *=
 							trans->scaleY;
+				}
 
-					/* LINE20_START_X, LINE20_START_Y,
-					 * LINE20_END_X, LINE20_END_Y are not
-					 * rotated, change only rotation angle */
-					sam->parameter[LINE20_ROTATION] +=
-						RAD2DEG(trans->rotation);
-					break;
-
-/* Compile time check if LINE21 and LINE22 parameters indexes are equal */
-#if (LINE21_WIDTH != LINE22_WIDTH) \
- || (LINE21_HEIGHT != LINE22_HEIGHT) \
- || (LINE21_ROTATION != LINE22_ROTATION) \
- || (LINE21_CENTER_X != LINE22_LOWER_LEFT_X) \
- || (LINE21_CENTER_Y != LINE22_LOWER_LEFT_Y)
-# error "LINE21 and LINE22 indexes are not equal"
-#endif
+				sam->parameter[OUTLINE_ROTATION_IDX(sam->parameter)] +=
+							RAD2DEG(trans->rotation);
+				break;
 
-				case GERBV_APTYPE_MACRO_LINE21:
-						/* Centered line rectangle */
-				case GERBV_APTYPE_MACRO_LINE22:
-						/* Lower left line rectangle */
-
-					/* Using LINE21 parameters array
-					 * indexes for LINE21 and LINE22, as
-					 * they are equal */
-					if (trans->scaleX == trans->scaleY) {
-						sam->parameter[LINE21_WIDTH] *=
-								trans->scaleX;
-						sam->parameter[LINE21_HEIGHT] *=
-								trans->scaleX;
-
-					} else if (fabs(sam->parameter[LINE21_ROTATION]) == 0
-					|| fabs(sam->parameter[LINE21_ROTATION]) == 190) {
-						sam->parameter[LINE21_WIDTH] *=
-								trans->scaleX;
-						sam->parameter[LINE21_HEIGHT] *=
-								trans->scaleY;
-
-					} else if (fabs(sam->parameter[LINE21_ROTATION]) == 90
-					|| fabs(sam->parameter[LINE21_ROTATION]) == 270) {
-						/* DEG2RAD for calc error */
-						double t;
-						t =sam->parameter[LINE21_WIDTH];
-						sam->parameter[LINE21_WIDTH] =
-							trans->scaleY *
-							sam->parameter[
-								LINE21_HEIGHT];
-						sam->parameter[LINE21_HEIGHT] =
-							trans->scaleX * t;
-					} else {
-						/* TODO: make outline macro */
-						err_scale_line_macro++;
-						break;
-					}
-
-					sam->parameter[LINE21_CENTER_X] *=
-								trans->scaleX;
-					sam->parameter[LINE21_CENTER_Y] *=
-								trans->scaleY;
-
-					sam->parameter[LINE21_ROTATION] +=
-						RAD2DEG(trans->rotation);
-					gerbv_rotate_coord(
-						sam->parameter +LINE21_CENTER_X,
-						sam->parameter +LINE21_CENTER_Y,
-						trans->rotation);
+			case GERBV_APTYPE_MACRO_POLYGON:
+				if (trans->scaleX == trans->scaleY) {
+					sam->parameter[POLYGON_CENTER_X]
+						*= trans->scaleX;
+					sam->parameter[POLYGON_CENTER_Y]
+						*= trans->scaleX;
+					sam->parameter[POLYGON_DIAMETER]
+						*= trans->scaleX;
+				} else {
+					/* TODO: make outline macro */
+					errors->scale_poly_macro++;
 					break;
+				}
 
-				case GERBV_APTYPE_MACRO_OUTLINE:
-					for (i = 0; i < 1 + sam->parameter[
-							OUTLINE_NUMBER_OF_POINTS]; i++) {
-						sam->parameter[OUTLINE_X_IDX_OF_POINT(i)] *=
-								trans->scaleX;
-						sam->parameter[OUTLINE_Y_IDX_OF_POINT(i)] *=
-								trans->scaleY;
-					}
-
-					sam->parameter[OUTLINE_ROTATION_IDX(sam->parameter)] +=
-								RAD2DEG(trans->rotation);
-					break;
-#if 0
-{
-/* TODO */
-#include "main.h"
-gerbv_selection_item_t sItem = {sourceImage, currentNet};
-selection_add_item (&screen.selectionInfo, &sItem);
-}
-#endif
+				sam->parameter[POLYGON_ROTATION] +=
+					RAD2DEG(trans->rotation);
+				break;
 
-				case GERBV_APTYPE_MACRO_POLYGON:
-					if (trans->scaleX == trans->scaleY) {
-						sam->parameter[POLYGON_CENTER_X]
-							*= trans->scaleX;
-						sam->parameter[POLYGON_CENTER_Y]
-							*= trans->scaleX;
-						sam->parameter[POLYGON_DIAMETER]
-							*= trans->scaleX;
-					} else {
-						/* TODO: make outline macro */
-						err_scale_poly_macro++;
-						break;
-					}
-
-					sam->parameter[POLYGON_ROTATION] +=
-						RAD2DEG(trans->rotation);
+			case GERBV_APTYPE_MACRO_MOIRE:
+				if (trans->scaleX == trans->scaleY) {
+					sam->parameter[MOIRE_CENTER_X]
+						*= trans->scaleX;
+					sam->parameter[MOIRE_CENTER_Y]
+						*= trans->scaleX;
+					sam->parameter[MOIRE_OUTSIDE_DIAMETER]
+						*= trans->scaleX;
+					sam->parameter[MOIRE_CIRCLE_THICKNESS]
+						*= trans->scaleX;
+					sam->parameter[MOIRE_GAP_WIDTH]
+						*= trans->scaleX;
+					sam->parameter[MOIRE_CROSSHAIR_THICKNESS]
+						*= trans->scaleX;
+					sam->parameter[MOIRE_CROSSHAIR_LENGTH]
+						*= trans->scaleX;
+				} else {
+					errors->scale_moire_macro++;
 					break;
+				}
 
-				case GERBV_APTYPE_MACRO_MOIRE:
-					if (trans->scaleX == trans->scaleY) {
-						sam->parameter[MOIRE_CENTER_X]
-							*= trans->scaleX;
-						sam->parameter[MOIRE_CENTER_Y]
-							*= trans->scaleX;
-						sam->parameter[MOIRE_OUTSIDE_DIAMETER]
-							*= trans->scaleX;
-						sam->parameter[MOIRE_CIRCLE_THICKNESS]
-							*= trans->scaleX;
-						sam->parameter[MOIRE_GAP_WIDTH]
-							*= trans->scaleX;
-						sam->parameter[MOIRE_CROSSHAIR_THICKNESS]
-							*= trans->scaleX;
-						sam->parameter[MOIRE_CROSSHAIR_LENGTH]
-							*= trans->scaleX;
-					} else {
-						err_scale_moire_macro++;
-						break;
-					}
-
-					sam->parameter[MOIRE_ROTATION] +=
-						RAD2DEG(trans->rotation);
-					break;
+				sam->parameter[MOIRE_ROTATION] +=
+					RAD2DEG(trans->rotation);
+				break;
 
-				case GERBV_APTYPE_MACRO_THERMAL:
-					if (trans->scaleX == trans->scaleY) {
-						sam->parameter[THERMAL_CENTER_X]
-							*= trans->scaleX;
-						sam->parameter[THERMAL_CENTER_Y]
-							*= trans->scaleX;
-						sam->parameter[THERMAL_INSIDE_DIAMETER]
-							*= trans->scaleX;
-						sam->parameter[THERMAL_OUTSIDE_DIAMETER]
-							*= trans->scaleX;
-						sam->parameter[THERMAL_CROSSHAIR_THICKNESS]
-							*= trans->scaleX;
-					} else {
-						err_scale_thermo_macro++;
-						break;
-					}
-
-					sam->parameter[THERMAL_ROTATION] +=
-						RAD2DEG(trans->rotation);
+			case GERBV_APTYPE_MACRO_THERMAL:
+				if (trans->scaleX == trans->scaleY) {
+					sam->parameter[THERMAL_CENTER_X]
+						*= trans->scaleX;
+					sam->parameter[THERMAL_CENTER_Y]
+						*= trans->scaleX;
+					sam->parameter[THERMAL_INSIDE_DIAMETER]
+						*= trans->scaleX;
+					sam->parameter[THERMAL_OUTSIDE_DIAMETER]
+						*= trans->scaleX;
+					sam->parameter[THERMAL_CROSSHAIR_THICKNESS]
+						*= trans->scaleX;
+				} else {
+					errors->scale_thermo_macro++;
 					break;
-
-				default:
-					/* TODO: free aper if it is skipped (i.e. unused)? */
-					err_unknown_macro_aperture++;
 				}
-			}
 
-			trans_apers[newNet->aperture] = ++aper_last_id;
-			destImage->aperture[aper_last_id] = aper;
-			newNet->aperture = aper_last_id;
+				sam->parameter[THERMAL_ROTATION] +=
+					RAD2DEG(trans->rotation);
+				break;
 
-			break;
-		default:
-			err_unknown_aperture++;
+			default:
+				/* TODO: free aper if it is skipped (i.e. unused)? */
+				errors->unknown_macro_aperture++;
+			}
 		}
+
+		return gerbv_image_append_aperture (destImage, aper);
+	default:
+		errors->unknown_aperture++;
 	}
 
-	if (err_rotate_rect)
+	return number;
+}
+
+static void
+gerbv_image_report_transform_errors (gerbv_image_transform_errors_t *errors,
+		gerbv_user_transformation_t *trans)
+{
+	if (errors->rotate_rect)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't rotate %u rectangular aperture to %.2f "
 			"degrees (non 90 multiply)!",
 			"Can't rotate %u rectangular apertures to %.2f "
-			"degrees (non 90 multiply)!", err_rotate_rect),
-			err_rotate_rect, RAD2DEG(trans->rotation));
+			"degrees (non 90 multiply)!", errors->rotate_rect),
+			errors->rotate_rect, RAD2DEG(trans->rotation));
 
-	if (err_scale_line_macro)
+	if (errors->scale_line_macro)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't scale %u line macro!",
 			"Can't scale %u line macros!",
-			err_scale_line_macro), err_scale_line_macro);
+			errors->scale_line_macro), errors->scale_line_macro);
 
-	if (err_scale_poly_macro)
+	if (errors->scale_poly_macro)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't scale %u polygon macro!",
 			"Can't scale %u polygon macros!",
-			err_scale_poly_macro), err_scale_poly_macro);
+			errors->scale_poly_macro), errors->scale_poly_macro);
 
-	if (err_scale_thermo_macro)
+	if (errors->scale_thermo_macro)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't scale %u thermal macro!",
 			"Can't scale %u thermal macros!",
-			err_scale_poly_macro), err_scale_poly_macro);
+			errors->scale_poly_macro), errors->scale_poly_macro);
 
-	if (err_scale_moire_macro)
+	if (errors->scale_moire_macro)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't scale %u moire macro!",
 			"Can't scale %u moire macros!",
-			err_scale_poly_macro), err_scale_poly_macro);
+			errors->scale_poly_macro), errors->scale_poly_macro);
 
-	if (err_rotate_oval)
+	if (errors->rotate_oval)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't rotate %u oval aperture to %.2f "
 			"degrees (non 90 multiply)!",
 			"Can't rotate %u oval apertures to %.2f "
-			"degrees (non 90 multiply)!", err_rotate_oval),
-			err_rotate_oval, RAD2DEG(trans->rotation));
+			"degrees (non 90 multiply)!", errors->rotate_oval),
+			errors->rotate_oval, RAD2DEG(trans->rotation));
 
-	if (err_scale_circle)
+	if (errors->scale_circle)
 		GERB_COMPILE_ERROR(ngettext(
 			"Can't scale %u circle aperture to ellipse!",
 			"Can't scale %u circle apertures to ellipse!",
-			err_scale_circle), err_scale_circle);
+			errors->scale_circle), errors->scale_circle);
 
-	if (err_unknown_aperture)
+	if (errors->unknown_aperture)
 		GERB_COMPILE_ERROR(ngettext(
 			"Skipped %u aperture with unknown type!",
 			"Skipped %u apertures with unknown type!",
-			err_unknown_aperture), err_unknown_aperture);
+			errors->unknown_aperture), errors->unknown_aperture);
 
-	if (err_unknown_macro_aperture)
+	if (errors->unknown_macro_aperture)
 		GERB_COMPILE_ERROR(ngettext(
 			"Skipped %u macro aperture!",
 			"Skipped %u macro apertures!",
-			err_unknown_macro_aperture),
-				err_unknown_macro_aperture);
+			errors->unknown_macro_aperture),
+				errors->unknown_macro_aperture);
+}
+
+/* Copies the apertures of sourceImage to destImage, renumbering them from
+   APERTURE_MIN on, and returns the destination number of every source
+   aperture number in a new array of mapSize entries, -1 for the unused
+   ones.  If reuseExisting, an aperture destImage already has is used
+   instead of a copy */
+static int *
+gerbv_image_copy_apertures (gerbv_image_t *sourceImage,
+		gerbv_image_t *destImage, gboolean reuseExisting,
+		int *mapSize)
+{
+	gerbv_aperture_t *sourceAperture;
+	int lastUsedApertureNumber = APERTURE_MIN - 1;
+	int i, number, existingAperture;
+	int *apertureMap;
+
+	*mapSize = aperture_table_last_number (sourceImage) + 1;
+	apertureMap = g_new (int, MAX (*mapSize, 1));
+	for (i = 0; i < *mapSize; i++)
+		apertureMap[i] = -1;
+
+	for (i = 0; i < gerbv_image_get_aperture_count (sourceImage); i++) {
+		sourceAperture = gerbv_image_get_nth_aperture (sourceImage, i,
+				&number);
+
+		if (reuseExisting) {
+			existingAperture = aperture_index_find_match (destImage,
+					sourceAperture);
+			if (existingAperture > 0) {
+				apertureMap[number] = existingAperture;
+				continue;
+			}
+		}
+
+		lastUsedApertureNumber = aperture_index_find_unused (destImage,
+				lastUsedApertureNumber + 1);
+		gerbv_image_set_aperture (destImage, lastUsedApertureNumber,
+				gerbv_image_duplicate_aperture (sourceAperture));
+		apertureMap[number] = lastUsedApertureNumber;
+	}
+
+	return apertureMap;
+}
+
+/* Prepares segment for copying the nets of sourceImage transformed by
+   trans into destImage, and copies the apertures over.  Returns FALSE,
+   leaving the segment empty, if trans can not be applied to the image */
+static gboolean
+gerbv_image_segment_init (gerbv_image_segment_t *segment,
+		gerbv_image_t *sourceImage, gerbv_user_transformation_t *trans,
+		gerbv_image_t *destImage, gboolean reuseApertures)
+{
+	memset (segment, 0, sizeof (gerbv_image_segment_t));
+
+	if (trans && (trans->mirrorAroundX || trans->mirrorAroundY)) {
+		if (sourceImage->layertype != GERBV_LAYERTYPE_DRILL) {
+			GERB_COMPILE_ERROR(_("Exporting mirrored file "
+						"is not supported!"));
+			return FALSE;
+		}
+	}
+
+	if (trans && trans->inverted) {
+		GERB_COMPILE_ERROR(_("Exporting inverted file "
+					"is not supported!"));
+		return FALSE;
+	}
+
+	segment->sourceImage = sourceImage;
+	segment->trans = trans;
+	segment->apertureMap = gerbv_image_copy_apertures (sourceImage,
+			destImage, reuseApertures, &segment->apertureMapSize);
+	segment->arena = gerb_arena_new ();
+
+	return TRUE;
+}
+
+/* Copies the layers, states and nets of segment->sourceImage into the
+   segment.  Runs on the threads of gerbv_image_merge_nets(), so it
+   only touches the segment and reads the source image */
+static void
+gerbv_image_copy_segment (gpointer data, gpointer user_data)
+{
+	gerbv_image_segment_t *segment = data;
+	gerbv_user_transformation_t *trans = segment->trans;
+	gerbv_layer_t *sourceLayer = NULL;
+	gerbv_netstate_t *sourceState = NULL;
+	gerbv_net_t *currentNet, *newNet;
+
+	for (currentNet = segment->sourceImage->netlist; currentNet != NULL;
+			currentNet = currentNet->next) {
+
+		/* Duplicate the layers and states as the nets reach them,
+		 * since we really don't have any other way to figure out
+		 * where states and layers are used */
+		if (segment->lastLayer == NULL
+				|| currentNet->layer != sourceLayer) {
+			gerbv_layer_t *newLayer = gerb_arena_new0 (
+					segment->arena, gerbv_layer_t);
+
+			*newLayer = *currentNet->layer;
+			newLayer->name = g_strdup (currentNet->layer->name);
+			newLayer->next = NULL;
+			if (segment->lastLayer)
+				segment->lastLayer->next = newLayer;
+			else
+				segment->firstLayer = newLayer;
+			segment->lastLayer = newLayer;
+			segment->layerCount++;
+			sourceLayer = currentNet->layer;
+		}
+
+		if (segment->lastState == NULL
+				|| currentNet->state != sourceState) {
+			gerbv_netstate_t *newState = gerb_arena_new0 (
+					segment->arena, gerbv_netstate_t);
+
+			*newState = *currentNet->state;
+			newState->next = NULL;
+			if (segment->lastState)
+				segment->lastState->next = newState;
+			else
+				segment->firstState = newState;
+			segment->lastState = newState;
+			segment->stateCount++;
+			sourceState = currentNet->state;
+		}
+
+		/* Create and copy the actual net over */
+		newNet = gerb_arena_new0 (segment->arena, gerbv_net_t);
+		*newNet = *currentNet;
+		newNet->next = NULL;
+
+		if (currentNet->cirseg) {
+			newNet->cirseg = gerb_arena_new0 (segment->arena,
+					gerbv_cirseg_t);
+			*(newNet->cirseg) = *(currentNet->cirseg);
+		}
+
+		if (currentNet->label)
+			newNet->label = g_string_new (currentNet->label->str);
+		else
+			newNet->label = NULL;
+
+		newNet->state = segment->lastState;
+		newNet->layer = segment->lastLayer;
+
+		if (segment->lastNet)
+			segment->lastNet->next = newNet;
+		else
+			segment->firstNet = newNet;
+		segment->lastNet = newNet;
+		segment->netCount++;
+
+		/* Check if we need to translate the aperture number */
+		if (newNet->aperture >= 0
+				&& newNet->aperture < segment->apertureMapSize
+				&& segment->apertureMap[newNet->aperture] != -1)
+			newNet->aperture =
+				segment->apertureMap[newNet->aperture];
+
+		if (trans == NULL)
+			continue;
+
+		/* Transforming coords */
+		gerbv_transform_coord (&newNet->start_x,
+				&newNet->start_y, trans);
+		gerbv_transform_coord (&newNet->stop_x,
+				&newNet->stop_y, trans);
+
+		if (newNet->cirseg) {
+			/* Circular interpolation only exported by start, stop
+			 * end center coordinates. */
+			gerbv_transform_coord (&newNet->cirseg->cp_x,
+				&newNet->cirseg->cp_y, trans);
+		}
+	}
+}
 
+/* Points the nets of the copied segment to scaled and rotated copies of
+   their apertures, which are added to destImage.  Adding apertures
+   changes destImage, so this is done after the threads are finished */
+static void
+gerbv_image_transform_segment_apertures (gerbv_image_t *destImage,
+		gerbv_image_segment_t *segment)
+{
+	gerbv_user_transformation_t *trans = segment->trans;
+	gerbv_image_transform_errors_t errors;
+	gerbv_net_t *currentNet;
+	int *trans_apers; /* Transformed apertures */
+	int aper_count, i;
+
+	if (trans == NULL
+			|| (trans->scaleX == trans->scaleY
+				&& trans->scaleX == 1.0
+				&& trans->rotation == 0.0))
+		return;
+
+	memset (&errors, 0, sizeof (errors));
+	aper_count = aperture_table_last_number (destImage) + 1;
+	trans_apers = g_new (int, MAX (aper_count, 1));
+	for (i = 0; i < aper_count; i++)
+		trans_apers[i] = -1;
+
+	for (currentNet = segment->firstNet; currentNet != NULL;
+			currentNet = currentNet->next) {
+		if (currentNet->aperture < 0
+		|| currentNet->aperture >= aper_count
+		|| gerbv_image_get_aperture (destImage,
+				currentNet->aperture) == NULL)
+			continue;
+
+		/* Aperture is not transformed yet */
+		if (trans_apers[currentNet->aperture] == -1)
+			trans_apers[currentNet->aperture] =
+				gerbv_image_transform_aperture (destImage,
+					currentNet->aperture, trans, &errors);
+
+		currentNet->aperture = trans_apers[currentNet->aperture];
+	}
+
+	gerbv_image_report_transform_errors (&errors, trans);
 	g_free (trans_apers);
 }
 
+/* Appends the copies of the nets of the count segments to destImage, or
+   puts them in place of the netlist if replaceNetlist.  The segments are
+   copied in parallel, each into an arena of its own, and then spliced
+   onto the tails of the chains of destImage in order.  Frees the
+   segments, but not the array */
+static void
+gerbv_image_merge_nets (gerbv_image_t *destImage,
+		gerbv_image_segment_t *segments, gint count,
+		gboolean replaceNetlist)
+{
+	gerbv_image_segment_t *segment;
+	GThreadPool *pool = NULL;
+	gint i, threadCount;
+
+	if (count > 1) {
+		threadCount = MIN ((gint) g_get_num_processors (), count);
+		if (threadCount > 1)
+			pool = g_thread_pool_new (gerbv_image_copy_segment,
+					NULL, threadCount, TRUE, NULL);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (segments[i].sourceImage == NULL)
+			continue;
+		if (pool)
+			g_thread_pool_push (pool, &segments[i], NULL);
+		else
+			gerbv_image_copy_segment (&segments[i], NULL);
+	}
+	if (pool) {
+		/* wait for all segments to be copied */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+
+	net_index_invalidate (destImage);
+
+	/* make sure the tails of destImage are known */
+	gerbv_image_get_last_layer (destImage);
+	gerbv_image_get_last_state (destImage);
+	gerbv_image_get_last_net (destImage);
+
+	for (i = 0; i < count; i++) {
+		segment = &segments[i];
+		if (segment->sourceImage == NULL)
+			continue;
+
+		gerbv_image_transform_segment_apertures (destImage, segment);
+
+		if (segment->firstNet != NULL) {
+			destImage->lastLayer->next = segment->firstLayer;
+			destImage->lastLayer = segment->lastLayer;
+			destImage->layerCount += segment->layerCount;
+			destImage->lastState->next = segment->firstState;
+			destImage->lastState = segment->lastState;
+			destImage->stateCount += segment->stateCount;
+			if (replaceNetlist) {
+				destImage->netlist = segment->firstNet;
+				destImage->netCount = 0;
+				replaceNetlist = FALSE;
+			} else {
+				destImage->lastNet->next = segment->firstNet;
+			}
+			destImage->lastNet = segment->lastNet;
+			destImage->netCount += segment->netCount;
+		}
+
+		gerb_arena_merge (destImage->arena, segment->arena);
+		g_free (segment->apertureMap);
+		memset (segment, 0, sizeof (gerbv_image_segment_t));
+	}
+}
+
 gint
 gerbv_image_find_existing_aperture_match (gerbv_aperture_t *checkAperture, gerbv_image_t *imageToSearch) {
-    int i,j;
-    gboolean isMatch;
-    
-    for (i = 0; i < APERTURE_MAX; i++) {
-	if (imageToSearch->aperture[i] != NULL) {
-	  if ((imageToSearch->aperture[i]->type == checkAperture->type) &&
-	      (imageToSearch->aperture[i]->simplified == NULL) &&
-	      (imageToSearch->aperture[i]->unit == checkAperture->unit)) {
-	    /* check all parameters match too */
-	    isMatch=TRUE;
-	    for (j=0; j<APERTURE_PARAMETERS_MAX; j++){
-	      if (imageToSearch->aperture[i]->parameter[j] != checkAperture->parameter[j])
-	        isMatch = FALSE;
-	    }
-	    if (isMatch)
-	      return i;
-	  }	      
-	}
-    }
-    return 0;
+    return aperture_index_find_match (imageToSearch, checkAperture);
 }
 
 int
 gerbv_image_find_unused_aperture_number (int startIndex, gerbv_image_t *image){
-    int i;
-    
-    for (i = startIndex; i < APERTURE_MAX; i++) {
-	if (image->aperture[i] == NULL) {
-	  return i;
-	}
-    }
-    return -1;
+    return aperture_index_find_unused (image, startIndex);
 }
 
-gerbv_image_t *
-gerbv_image_duplicate_image (gerbv_image_t *sourceImage, gerbv_user_transformation_t *transform) {
+/* Creates an empty image with the type and information of sourceImage */
+static gerbv_image_t *
+gerbv_image_create_like (gerbv_image_t *sourceImage)
+{
     gerbv_image_t *newImage = gerbv_create_image(NULL, sourceImage->info->type);
-    int i;
-    int lastUsedApertureNumber = APERTURE_MIN - 1;
-    GArray *apertureNumberTable = g_array_new(FALSE,FALSE,sizeof(gerb_translation_entry_t));
     
     newImage->layertype = sourceImage->layertype;
     /* copy information layer over */
@@ -958,75 +1193,64 @@ gerbv_image_duplicate_image (gerbv_image_t *sourceImage, gerbv_user_transformati
     newImage->info->plotterFilm = g_strdup (sourceImage->info->plotterFilm);
     newImage->info->attr_list = gerbv_attribute_dup (sourceImage->info->attr_list,
     		 sourceImage->info->n_attr);
-    
-    /* copy apertures over, compressing all the numbers down for a cleaner output, and
-       moving and apertures less than 10 up to the correct range */
-    for (i = 0; i < APERTURE_MAX; i++) {
-	if (sourceImage->aperture[i] != NULL) {
-	  gerbv_aperture_t *newAperture = gerbv_image_duplicate_aperture (sourceImage->aperture[i]);
 
-	  lastUsedApertureNumber = gerbv_image_find_unused_aperture_number (lastUsedApertureNumber + 1, newImage);
-	  /* store the aperture numbers (new and old) in the translation table */
-	  gerb_translation_entry_t translationEntry={i,lastUsedApertureNumber};
-	  g_array_append_val (apertureNumberTable,translationEntry);
+    return newImage;
+}
 
-	  newImage->aperture[lastUsedApertureNumber] = newAperture;
-	}
-    }
+gerbv_image_t *
+gerbv_image_duplicate_image (gerbv_image_t *sourceImage, gerbv_user_transformation_t *transform) {
+    gerbv_image_t *newImage = gerbv_image_create_like (sourceImage);
+    gerbv_image_segment_t segment;
     
-    /* step through all nets and create new layers and states on the fly, since
-       we really don't have any other way to figure out where states and layers are used */
-    gerbv_image_copy_all_nets (sourceImage, newImage, newImage->layers, newImage->states, NULL, transform, apertureNumberTable);
-    g_array_free (apertureNumberTable, TRUE);
+    /* copy apertures over, compressing all the numbers down for a cleaner output, and
+       moving and apertures less than 10 up to the correct range */
+    if (gerbv_image_segment_init (&segment, sourceImage, transform, newImage, FALSE))
+	gerbv_image_merge_nets (newImage, &segment, 1, TRUE);
     return newImage;
 }
 
 void
 gerbv_image_copy_image (gerbv_image_t *sourceImage, gerbv_user_transformation_t *transform, gerbv_image_t *destinationImage) {
-    int lastUsedApertureNumber = APERTURE_MIN - 1;
-    int i;
-    GArray *apertureNumberTable = g_array_new(FALSE,FALSE,sizeof(gerb_translation_entry_t));
-    
-    /* copy apertures over */
-    for (i = 0; i < APERTURE_MAX; i++) {
-	if (sourceImage->aperture[i] != NULL) {
-	  gint existingAperture = gerbv_image_find_existing_aperture_match (sourceImage->aperture[i], destinationImage);
-	  
-	  /* if we already have an existing aperture in the destination image that matches what
-	     we want, just use it instead */
-	  if (existingAperture > 0) {
-	  	gerb_translation_entry_t translationEntry={i,existingAperture};
-	 	g_array_append_val (apertureNumberTable,translationEntry);
-	  }
-	  /* else, create a new aperture and put it in the destination image */
-	  else {
-	  	gerbv_aperture_t *newAperture = gerbv_image_duplicate_aperture (sourceImage->aperture[i]);
-	  
-	  	lastUsedApertureNumber = gerbv_image_find_unused_aperture_number (lastUsedApertureNumber + 1, destinationImage);
-	  	/* store the aperture numbers (new and old) in the translation table */
-	  	gerb_translation_entry_t translationEntry={i,lastUsedApertureNumber};
-	  	g_array_append_val (apertureNumberTable,translationEntry);
-
-	  	destinationImage->aperture[lastUsedApertureNumber] = newAperture;
-	  }
-	}
-    }
-    /* find the last layer, state, and net in the linked chains */
-    gerbv_netstate_t *lastState;
-    gerbv_layer_t *lastLayer;
-    gerbv_net_t *lastNet;
+    gerbv_image_segment_t segment;
     
-    for (lastState = destinationImage->states; lastState->next; lastState=lastState->next){}
-    for (lastLayer = destinationImage->layers; lastLayer->next; lastLayer=lastLayer->next){}
-    for (lastNet = destinationImage->netlist; lastNet->next; lastNet=lastNet->next){}
-    
-    /* and then copy them all to the destination image, using the aperture translation table we just built */
-    gerbv_image_copy_all_nets (sourceImage, destinationImage, lastLayer, lastState, lastNet, transform, apertureNumberTable);
-    g_array_free (apertureNumberTable, TRUE);
+    /* copy apertures over, using an existing aperture in the destination image
+       instead if it matches what we want */
+    if (!gerbv_image_segment_init (&segment, sourceImage, transform, destinationImage, TRUE))
+	return;
+
+    /* and then append them all to the destination image, using the aperture translation table we just built */
+    gerbv_image_merge_nets (destinationImage, &segment, 1, FALSE);
 }
 
-void
-gerbv_image_delete_net (gerbv_net_t *currentNet) {
+gerbv_image_t *
+gerbv_image_merge_images (gerbv_image_t **sourceImages,
+		gerbv_user_transformation_t **transforms, gint count) {
+    gerbv_image_t *newImage;
+    gerbv_image_segment_t *segments;
+    gint i;
+
+    if (count <= 0)
+	return NULL;
+
+    newImage = gerbv_image_create_like (sourceImages[0]);
+    segments = g_new (gerbv_image_segment_t, count);
+
+    /* the apertures go first, one image after another, so that every
+       image can reuse the apertures of the images before it */
+    for (i = 0; i < count; i++)
+	gerbv_image_segment_init (&segments[i], sourceImages[i],
+			transforms ? transforms[i] : NULL, newImage, i > 0);
+
+    gerbv_image_merge_nets (newImage, segments, count, TRUE);
+    g_free (segments);
+
+    return newImage;
+}
+
+/* Turns currentNet, and the rest of its polygon area, into deleted
+   nets.  The callers drop what the net index derived from them */
+static void
+gerbv_image_clear_net (gerbv_net_t *currentNet) {
 	gerbv_net_t *tempNet;
 	
 	g_assert (currentNet);
@@ -1055,20 +1279,38 @@ gerbv_image_delete_net (gerbv_net_t *currentNet) {
 	currentNet->interpolation = GERBV_INTERPOLATION_DELETED;
 }
 
+void
+gerbv_image_delete_net (gerbv_net_t *currentNet) {
+	gerbv_image_clear_net (currentNet);
+	/* the net index keeps its own copy of these fields, and the polygon
+	   outlines and level of detail rasters built from them.  The image
+	   isn't known here, so every index is rebuilt */
+	net_index_nets_changed ();
+}
+
+void
+gerbv_image_delete_net_from_image (gerbv_image_t *image,
+		gerbv_net_t *currentNet) {
+	gerbv_image_clear_net (currentNet);
+	/* only the index of this image knew the net */
+	net_index_invalidate (image);
+}
+
 void
 gerbv_image_create_rectangle_object (gerbv_image_t *image, gdouble coordinateX,
 		gdouble coordinateY, gdouble width, gdouble height) {
 	gerbv_net_t *currentNet;
 	
-	/* run through and find last net pointer */
-	for (currentNet = image->netlist; currentNet->next; currentNet = currentNet->next){}
+	net_index_invalidate (image);
+
+	currentNet = gerbv_image_get_last_net (image);
 	
 	/* create the polygon start node */
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_PAREA_START;
 	
 	/* go to start point (we need this to create correct RS274X export code) */
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_LINEARx1;
 	currentNet->aperture_state = GERBV_APERTURE_STATE_OFF;
 	currentNet->start_x = coordinateX;
@@ -1077,46 +1319,46 @@ gerbv_image_create_rectangle_object (gerbv_image_t *image, gdouble coordinateX,
 	currentNet->stop_y = coordinateY;
 	
 	/* draw the 4 corners */
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_LINEARx1;
 	currentNet->aperture_state = GERBV_APERTURE_STATE_ON;
 	currentNet->start_x = coordinateX;
 	currentNet->start_y = coordinateY;
 	currentNet->stop_x = coordinateX + width;
 	currentNet->stop_y = coordinateY;
-	gerber_update_min_and_max (&currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
+	gerber_update_min_and_max (NULL, &currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
 		0,0,0,0);
 	gerber_update_image_min_max (&currentNet->boundingBox, 0, 0, image);
 		
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_LINEARx1;
 	currentNet->aperture_state = GERBV_APERTURE_STATE_ON;
 	currentNet->stop_x = coordinateX + width;
 	currentNet->stop_y = coordinateY + height;
-	gerber_update_min_and_max (&currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
+	gerber_update_min_and_max (NULL, &currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
 		0,0,0,0);
 	gerber_update_image_min_max (&currentNet->boundingBox, 0, 0, image);
 	
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_LINEARx1;
 	currentNet->aperture_state = GERBV_APERTURE_STATE_ON;
 	currentNet->stop_x = coordinateX;
 	currentNet->stop_y = coordinateY + height;
-	gerber_update_min_and_max (&currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
+	gerber_update_min_and_max (NULL, &currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
 		0,0,0,0);
 	gerber_update_image_min_max (&currentNet->boundingBox, 0, 0, image);
 	
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_LINEARx1;
 	currentNet->aperture_state = GERBV_APERTURE_STATE_ON;
 	currentNet->stop_x = coordinateX;
 	currentNet->stop_y = coordinateY;
-	gerber_update_min_and_max (&currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
+	gerber_update_min_and_max (NULL, &currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
 		0,0,0,0);
 	gerber_update_image_min_max (&currentNet->boundingBox, 0, 0, image);
 	
 	/* create the polygon end node */
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_PAREA_END;
 	
 	return;
@@ -1126,20 +1368,20 @@ gerbv_net_t *
 gerb_image_return_aperture_index (gerbv_image_t *image, gdouble lineWidth, int *apertureIndex){
 	gerbv_net_t *currentNet;
 	gerbv_aperture_t *aperture=NULL;
-	int i;
+	int i, number;
 		
-	/* run through and find last net pointer */
-	for (currentNet = image->netlist; currentNet->next; currentNet = currentNet->next){}
+	currentNet = gerbv_image_get_last_net (image);
 	
 	/* try to find an existing aperture that matches the requested width and type */
-	for (i = 0; i < APERTURE_MAX; i++) {
-		if (image->aperture[i] != NULL) {
-			if ((image->aperture[i]->type == GERBV_APTYPE_CIRCLE) && 
-				(fabs (image->aperture[i]->parameter[0] - lineWidth) < 0.001)){
-				aperture = image->aperture[i];
-				*apertureIndex = i;
-				break;
-			}
+	for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+		gerbv_aperture_t *candidate =
+			gerbv_image_get_nth_aperture (image, i, &number);
+
+		if ((candidate->type == GERBV_APTYPE_CIRCLE) && 
+			(fabs (candidate->parameter[0] - lineWidth) < 0.001)){
+			aperture = candidate;
+			*apertureIndex = number;
+			break;
 		}
 	}
 
@@ -1167,8 +1409,10 @@ gerbv_image_create_arc_object (gerbv_image_t *image, gdouble centerX, gdouble ce
 	if (!currentNet)
 		return;
 	
+	net_index_invalidate (image);
+
 	/* draw the arc */
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_CCW_CIRCULAR;
 	currentNet->aperture_state = GERBV_APERTURE_STATE_ON;
 	currentNet->aperture = apertureIndex;
@@ -1176,7 +1420,7 @@ gerbv_image_create_arc_object (gerbv_image_t *image, gdouble centerX, gdouble ce
 	currentNet->start_y = centerY + (sin(DEG2RAD(startAngle)) * radius);
 	currentNet->stop_x = centerX + (cos(DEG2RAD(endAngle)) * radius);
 	currentNet->stop_y = centerY + (sin(DEG2RAD(endAngle)) * radius);
-	currentNet->cirseg = g_new0 (gerbv_cirseg_t,1);
+	currentNet->cirseg = gerb_arena_new0 (image->arena, gerbv_cirseg_t);
 	*(currentNet->cirseg) = cirSeg;
 	
 	gdouble angleDiff = currentNet->cirseg->angle2 - currentNet->cirseg->angle1;
@@ -1188,7 +1432,7 @@ gerbv_image_create_arc_object (gerbv_image_t *image, gdouble centerX, gdouble ce
 		gdouble tempY = currentNet->cirseg->cp_y + currentNet->cirseg->width / 2.0 *
 				sin (DEG2RAD(currentNet->cirseg->angle1 +
 						(i*angleDiff)/steps));
-		gerber_update_min_and_max (&currentNet->boundingBox,
+		gerber_update_min_and_max (NULL, &currentNet->boundingBox,
 			       tempX, tempY, 
 			       lineWidth/2,lineWidth/2,
 			       lineWidth/2,lineWidth/2);
@@ -1208,8 +1452,10 @@ gerbv_image_create_line_object (gerbv_image_t *image, gdouble startX, gdouble st
 	if (!currentNet)
 		return;
 	
+	net_index_invalidate (image);
+
 	/* draw the line */
-	currentNet = gerber_create_new_net (currentNet, NULL, NULL);
+	currentNet = gerber_create_new_net (image, currentNet, NULL, NULL);
 	currentNet->interpolation = GERBV_INTERPOLATION_LINEARx1;
 	
 	/* if the start and end coordinates are the same, use a "flash" aperture state */
@@ -1223,9 +1469,9 @@ gerbv_image_create_line_object (gerbv_image_t *image, gdouble startX, gdouble st
 	currentNet->stop_x = endX;
 	currentNet->stop_y = endY;
 
-	gerber_update_min_and_max (&currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
+	gerber_update_min_and_max (NULL, &currentNet->boundingBox,currentNet->stop_x,currentNet->stop_y, 
 		lineWidth/2,lineWidth/2,lineWidth/2,lineWidth/2);
-	gerber_update_min_and_max (&currentNet->boundingBox,currentNet->start_x,currentNet->start_y, 
+	gerber_update_min_and_max (NULL, &currentNet->boundingBox,currentNet->start_x,currentNet->start_y, 
 		lineWidth/2,lineWidth/2,lineWidth/2,lineWidth/2);
 	gerber_update_image_min_max (&currentNet->boundingBox, 0, 0, image);
 	return;
@@ -1295,15 +1541,18 @@ gerbv_image_reduce_area_of_selected_objects (GArray *selectionArray,
 				(currentNet->interpolation == GERBV_INTERPOLATION_LINEARx1)) {
 			gdouble dx=0,dy=0;
 			/* figure out the overall size of this element */
-			switch (image->aperture[currentNet->aperture]->type) {
+			gerbv_aperture_t *aperture =
+				gerbv_image_get_aperture (image, currentNet->aperture);
+
+			switch (aperture->type) {
 				case GERBV_APTYPE_CIRCLE :
 				case GERBV_APTYPE_OVAL :
 				case GERBV_APTYPE_POLYGON :
-					dx = dy = image->aperture[currentNet->aperture]->parameter[0];
+					dx = dy = aperture->parameter[0];
 					break;
 				case GERBV_APTYPE_RECTANGLE :
-					dx = (image->aperture[currentNet->aperture]->parameter[0]/ 2);
-					dy = (image->aperture[currentNet->aperture]->parameter[1]/ 2);
+					dx = (aperture->parameter[0]/ 2);
+					dy = (aperture->parameter[1]/ 2);
 					break;
 				default :
 					break;
@@ -1332,6 +1581,7 @@ gerbv_image_reduce_area_of_selected_objects (GArray *selectionArray,
 		/* we don't current support arcs */
 		else
 			return FALSE;
+		net_index_invalidate (image);
 		
 		/* create new structures */
 		gerbv_image_create_window_pane_objects (image, minX, minY, maxX - minX, maxY - minY,
@@ -1348,6 +1598,20 @@ gerbv_image_move_selected_objects (GArray *selectionArray, gdouble translationX,
 	for (i=0; i<selectionArray->len; i++) {
 		gerbv_selection_item_t sItem = g_array_index (selectionArray,gerbv_selection_item_t, i);
 		gerbv_net_t *currentNet = sItem.net;
+		cairo_matrix_t netToBox;
+		gdouble boxX = translationX, boxY = translationY;
+
+		net_index_invalidate (sItem.image);
+
+		/* keep the bounding box around the moved net, so the renderers
+		   don't cull it and can redraw where it went */
+		net_index_net_to_box (sItem.image, currentNet->layer,
+				currentNet->state, &netToBox);
+		cairo_matrix_transform_distance (&netToBox, &boxX, &boxY);
+		currentNet->boundingBox.left += boxX;
+		currentNet->boundingBox.right += boxX;
+		currentNet->boundingBox.bottom += boxY;
+		currentNet->boundingBox.top += boxY;
 
 		if (currentNet->interpolation == GERBV_INTERPOLATION_PAREA_START) {
 			/* if it's a polygon, step through every vertex and translate the point */
@@ -1395,11 +1659,14 @@ gerbv_image_create_dummy_apertures (gerbv_image_t *parsed_image) {
 		
 	/* run through and find last net pointer */
 	for (currentNet = parsed_image->netlist; currentNet->next; currentNet = currentNet->next){
-		if (parsed_image->aperture[currentNet->aperture] == NULL) {
-			parsed_image->aperture[currentNet->aperture] = g_new0 (gerbv_aperture_t, 1);
-			parsed_image->aperture[currentNet->aperture]->type = GERBV_APTYPE_CIRCLE;
-			parsed_image->aperture[currentNet->aperture]->parameter[0] = 0;
-			parsed_image->aperture[currentNet->aperture]->parameter[1] = 0;
+		if ((currentNet->aperture >= 0) &&
+		    (gerbv_image_get_aperture (parsed_image, currentNet->aperture) == NULL)) {
+			gerbv_aperture_t *aperture = g_new0 (gerbv_aperture_t, 1);
+
+			aperture->type = GERBV_APTYPE_CIRCLE;
+			aperture->parameter[0] = 0;
+			aperture->parameter[1] = 0;
+			gerbv_image_set_aperture (parsed_image, currentNet->aperture, aperture);
 		}
 	}
 }
@@ -64,10 +64,14 @@ gerb_verify_error_t gerbv_image_verify(gerbv_image_t const* image);
 void gerbv_image_dump(gerbv_image_t const* image);
 
 gerbv_layer_t *
-gerbv_image_return_new_layer (gerbv_layer_t *previousLayer);
+gerbv_image_return_new_layer (gerbv_image_t *image, gerbv_layer_t *previousLayer);
 
 gerbv_netstate_t *
-gerbv_image_return_new_netstate (gerbv_netstate_t *previousState);
+gerbv_image_return_new_netstate (gerbv_image_t *image, gerbv_netstate_t *previousState);
+
+/* Appends a new zeroed net to the netlist of image and returns it */
+gerbv_net_t *
+gerbv_image_append_net (gerbv_image_t *image);
 
 
 #ifdef __cplusplus
@@ -37,6 +37,10 @@
 
 #define dprintf if(DEBUG) printf
 
+static void gerbv_stats_append_error(gerbv_error_list_t *error_list_in,
+				     int layer, const char *error_text,
+				     gerbv_message_type_t type);
+
 /* ------------------------------------------------------- */
 /** Allocates a new gerbv_stats structure
    @return gerbv_stats pointer on success, NULL on ERROR */
@@ -113,24 +117,13 @@ gerbv_stats_destroy(gerbv_stats_t *stats) {
 
 
 /* ------------------------------------------------------- */
-/*! This fcn is called with a two gerbv_stats_t structs:
- * accum_stats and input_stats.  Accum_stats holds 
- * a list of stats accumulated for
- * all layers.  This will be reported in the report window.
- * Input_stats holds a list of the stats for one particular layer
- * to be added to the accumulated list.  */
-void
-gerbv_stats_add_layer(gerbv_stats_t *accum_stats, 
-		     gerbv_stats_t *input_stats,
-		     int this_layer) {
-    
-    dprintf("---> Entering gerbv_stats_add_layer ... \n");
+/*! Adds the code counts of input_stats to accum_stats */
+static void
+gerbv_stats_add_counts(gerbv_stats_t *accum_stats,
+		      gerbv_stats_t *input_stats) {
 
-    gerbv_error_list_t *error;
-    gerbv_aperture_list_t *aperture;
     gerbv_aperture_list_t *D_code;
 
-    accum_stats->layer_count++;
     accum_stats->G0 += input_stats->G0;
     accum_stats->G1 += input_stats->G1;
     accum_stats->G2 += input_stats->G2;
@@ -159,11 +152,11 @@ gerbv_stats_add_layer(gerbv_stats_t *accum_stats,
          D_code != NULL;
          D_code = D_code->next) {
         if (D_code->number != -1) {
-	  dprintf("     .... In gerbv_stats_add_layer, D code section, adding number = %d to accum_stats D list ...\n",
+	  dprintf("     .... In gerbv_stats_add_counts, D code section, adding number = %d to accum_stats D list ...\n",
 		  D_code->number);
 	  gerbv_stats_add_to_D_list(accum_stats->D_code_list,
 				   D_code->number);
-	  dprintf("     .... In gerbv_stats_add_layer, D code section, calling increment_D_count with count %d ...\n", 
+	  dprintf("     .... In gerbv_stats_add_counts, D code section, calling increment_D_count with count %d ...\n", 
 		  D_code->count);
 	  gerbv_stats_increment_D_list_count(accum_stats->D_code_list,
 					    D_code->number,
@@ -186,16 +179,38 @@ gerbv_stats_add_layer(gerbv_stats_t *accum_stats,
 
     accum_stats->star += input_stats->star;
     accum_stats->unknown += input_stats->unknown;
+}
+
+/* ------------------------------------------------------- */
+/*! This fcn is called with a two gerbv_stats_t structs:
+ * accum_stats and input_stats.  Accum_stats holds 
+ * a list of stats accumulated for
+ * all layers.  This will be reported in the report window.
+ * Input_stats holds a list of the stats for one particular layer
+ * to be added to the accumulated list.  The errors of the layer
+ * were reported when it was parsed and are not reported again. */
+void
+gerbv_stats_add_layer(gerbv_stats_t *accum_stats, 
+		     gerbv_stats_t *input_stats,
+		     int this_layer) {
+    
+    dprintf("---> Entering gerbv_stats_add_layer ... \n");
+
+    gerbv_error_list_t *error;
+    gerbv_aperture_list_t *aperture;
+
+    accum_stats->layer_count++;
+    gerbv_stats_add_counts(accum_stats, input_stats);
 
     /* ==== Now deal with the error list ==== */
     for (error = input_stats->error_list;
          error != NULL;
          error = error->next) {
         if (error->error_text != NULL) {
-            gerbv_stats_add_error(accum_stats->error_list,
-                                  this_layer,
-                                  error->error_text,
-                                  error->type);
+            gerbv_stats_append_error(accum_stats->error_list,
+                                     this_layer,
+                                     error->error_text,
+                                     error->type);
         }
     }
 
@@ -217,6 +232,62 @@ gerbv_stats_add_layer(gerbv_stats_t *accum_stats,
     return;
 }
 
+/* ------------------------------------------------------- */
+/*! Adds the stats accumulated in input_stats to accum_stats.
+ *  The errors and apertures of input_stats already carry their
+ *  layer numbers, and must be of other layers than those of
+ *  accum_stats, so they are just appended without looking for
+ *  duplicates.  This is the reduction step of
+ *  gerbv_stats_new_from_images(). */
+void
+gerbv_stats_merge(gerbv_stats_t *accum_stats,
+		 gerbv_stats_t *input_stats) {
+
+    gerbv_error_list_t *error, *error_last;
+    gerbv_aperture_list_t *aperture, *aperture_last;
+
+    accum_stats->layer_count += input_stats->layer_count;
+    gerbv_stats_add_counts(accum_stats, input_stats);
+
+    /* ==== Append copies of the error list ==== */
+    for (error_last = accum_stats->error_list;
+	 error_last->next != NULL;
+	 error_last = error_last->next)
+	;
+    for (error = input_stats->error_list;
+         error != NULL;
+         error = error->next) {
+        if (error->error_text == NULL)
+	    continue;
+	if (error_last->error_text != NULL) {
+	    error_last->next = g_new (gerbv_error_list_t, 1);
+	    error_last = error_last->next;
+	}
+	error_last->layer = error->layer;
+	error_last->error_text = g_strdup (error->error_text);
+	error_last->type = error->type;
+	error_last->next = NULL;
+    }
+
+    /* ==== Append copies of the aperture list ==== */
+    for (aperture_last = accum_stats->aperture_list;
+	 aperture_last->next != NULL;
+	 aperture_last = aperture_last->next)
+	;
+    for (aperture = input_stats->aperture_list;
+         aperture != NULL;
+         aperture = aperture->next) {
+        if (aperture->number == -1)
+	    continue;
+	if (aperture_last->number != -1) {
+	    aperture_last->next = g_new (gerbv_aperture_list_t, 1);
+	    aperture_last = aperture_last->next;
+	}
+	*aperture_last = *aperture;
+	aperture_last->next = NULL;
+    }
+}
+
 /* ------------------------------------------------------- */
 gerbv_error_list_t *
 gerbv_stats_new_error_list() {
@@ -235,30 +306,17 @@ gerbv_stats_new_error_list() {
 
 
 /* ------------------------------------------------------- */
-void
-gerbv_stats_add_error(gerbv_error_list_t *error_list_in,
-                      int layer, const char *error_text,
-                      gerbv_message_type_t type) {
+/*! Adds an error to the list without reporting it, so it can be
+ *  called again for errors which were already reported */
+static void
+gerbv_stats_append_error(gerbv_error_list_t *error_list_in,
+                         int layer, const char *error_text,
+                         gerbv_message_type_t type) {
 
     gerbv_error_list_t *error_list_new;
     gerbv_error_list_t *error_last = NULL;
     gerbv_error_list_t *error;
 
-    /* Replace embedded error messages */
-    switch (type) {
-        case GERBV_MESSAGE_FATAL:
-            GERB_FATAL_ERROR("%s",error_text);
-            break;
-        case GERBV_MESSAGE_ERROR:
-            GERB_COMPILE_ERROR("%s",error_text);
-            break;
-        case GERBV_MESSAGE_WARNING:
-            GERB_COMPILE_WARNING("%s",error_text);
-            break;
-        case GERBV_MESSAGE_NOTE:
-            break;
-    }
-
     /* First handle case where this is the first list element */
     if (error_list_in->error_text == NULL) {
         error_list_in->layer = layer;
@@ -294,6 +352,30 @@ gerbv_stats_add_error(gerbv_error_list_t *error_list_in,
     return;
 }
 
+/* ------------------------------------------------------- */
+void
+gerbv_stats_add_error(gerbv_error_list_t *error_list_in,
+                      int layer, const char *error_text,
+                      gerbv_message_type_t type) {
+
+    /* Replace embedded error messages */
+    switch (type) {
+        case GERBV_MESSAGE_FATAL:
+            GERB_FATAL_ERROR("%s",error_text);
+            break;
+        case GERBV_MESSAGE_ERROR:
+            GERB_COMPILE_ERROR("%s",error_text);
+            break;
+        case GERBV_MESSAGE_WARNING:
+            GERB_COMPILE_WARNING("%s",error_text);
+            break;
+        case GERBV_MESSAGE_NOTE:
+            break;
+    }
+
+    gerbv_stats_append_error(error_list_in, layer, error_text, type);
+}
+
 /* ------------------------------------------------------- */
 gerbv_aperture_list_t *
 gerbv_stats_new_aperture_list() {
@@ -31,7 +31,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>  /* pow() */
-#include <locale.h>
 #include <errno.h>
 #include <ctype.h>
 
@@ -40,6 +39,8 @@
 #include "gerber.h"
 #include "gerb_stats.h"
 #include "amacro.h"
+#include "gerb_arena.h"
+#include "aperture_index.h"
 
 #undef AMACRO_DEBUG
 #define dprintf if(DEBUG) printf
@@ -65,27 +66,27 @@ static void calc_cirseg_sq(struct gerbv_net *net, int cw,
 			   double delta_cp_x, double delta_cp_y);
 static void calc_cirseg_mq(struct gerbv_net *net, int cw, 
 			   double delta_cp_x, double delta_cp_y);
-static void calc_cirseg_bbox(const gerbv_cirseg_t *cirseg,
+static void calc_cirseg_bbox(gerb_state_t *state,
+			const gerbv_cirseg_t *cirseg,
 			double apert_size_x, double apert_size_y,
 			gerbv_render_size_t *bbox);
 
-static void gerber_update_any_running_knockout_measurements(gerbv_image_t *image);
+static void gerber_update_any_running_knockout_measurements(gerb_state_t *state);
 
 static void gerber_calculate_final_justify_effects (gerbv_image_t *image);
 
-gboolean knockoutMeasure = FALSE;
-gdouble knockoutLimitXmin, knockoutLimitYmin, knockoutLimitXmax, 
-    knockoutLimitYmax;
-gerbv_layer_t *knockoutLayer = NULL;
-cairo_matrix_t currentMatrix;
-
 
 /* --------------------------------------------------------- */
 gerbv_net_t *
-gerber_create_new_net (gerbv_net_t *currentNet, gerbv_layer_t *layer, gerbv_netstate_t *state){
-	gerbv_net_t *newNet = g_new0 (gerbv_net_t, 1);
+gerber_create_new_net (gerbv_image_t *image, gerbv_net_t *currentNet,
+		gerbv_layer_t *layer, gerbv_netstate_t *state){
+	gerbv_net_t *newNet = gerb_arena_new0 (image->arena, gerbv_net_t);
 	
 	currentNet->next = newNet;
+	if (currentNet == image->lastNet) {
+		image->lastNet = newNet;
+		image->netCount++;
+	}
 	if (layer)
 		newNet->layer = layer;
 	else
@@ -97,26 +98,73 @@ gerber_create_new_net (gerbv_net_t *currentNet, gerbv_layer_t *layer, gerbv_nets
 	return newNet;
 }
 
+/* --------------------------------------------------------- */
+/* Hands the nets parsed since the last call to the streaming callback,
+ * then drops them and returns the netlist head to append to.
+ */
+static gerbv_net_t *
+gerber_stream_nets (gerbv_image_t *image, gerb_state_t *state)
+{
+	gerbv_net_t *net;
+
+	for (net = image->netlist->next; net != NULL; net = net->next)
+		state->netFunc (image, net, state->netFuncData);
+	image->netlist->next = NULL;
+	/* the remembered last net is gone, it is looked up again when needed */
+	image->lastNet = NULL;
+
+	/* layers and netstates live in the arena too and must be kept, so
+	   only release the memory if none were created since the mark */
+	if ((state->layer == state->netMarkLayer) &&
+			(state->state == state->netMarkState)) {
+		gerb_arena_release (image->arena, &state->netMark);
+	} else {
+		gerb_arena_mark (image->arena, &state->netMark);
+		state->netMarkLayer = state->layer;
+		state->netMarkState = state->state;
+	}
+	return image->netlist;
+}
+
 /* --------------------------------------------------------- */
 gboolean
 gerber_create_new_aperture (gerbv_image_t *image, int *indexNumber,
 		gerbv_aperture_type_t apertureType, gdouble parameter1, gdouble parameter2){
+	gerbv_aperture_t *aperture;
 	int i;
 	
 	/* search for an available aperture spot */
-	for (i = 0; i <= APERTURE_MAX; i++) {
-		if (image->aperture[i] == NULL) {
-			image->aperture[i] = g_new0 (gerbv_aperture_t, 1);
-			image->aperture[i]->type = apertureType;
-			image->aperture[i]->parameter[0] = parameter1;
-			image->aperture[i]->parameter[1] = parameter2;
-			*indexNumber = i;
-			return TRUE;
-		}
-	}
-	return FALSE;
+	i = aperture_index_find_unused (image, 0);
+
+	aperture = g_new0 (gerbv_aperture_t, 1);
+	aperture->type = apertureType;
+	aperture->parameter[0] = parameter1;
+	aperture->parameter[1] = parameter2;
+	gerbv_image_set_aperture (image, i, aperture);
+	*indexNumber = i;
+	return TRUE;
 }
 
+/* ------------------------------------------------------------------ */
+/* Reads an X, Y, I or J coordinate.  If the format omits trailing zeros,
+ * the coordinate is padded back to formatDigits digits.
+ */
+static int
+gerber_fgetcoord(gerb_file_t *fd, gerbv_image_t *image, int formatDigits)
+{
+    static const int padding[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000
+    };
+    int coord, len;
+
+    coord = gerb_fgetint(fd, &len);
+    if (image->format && (image->format->omit_zeros == GERBV_OMIT_ZEROS_TRAILING)
+	&& (formatDigits - len > 0) && (formatDigits - len < 8))
+	coord *= padding[formatDigits - len];
+
+    return coord;
+} /* gerber_fgetcoord */
+
 /* --------------------------------------------------------- */
 /*! This function reads the Gerber file char by char, looking
  *  for various Gerber codes (e.g. G, D, etc).  Once it reads 
@@ -132,16 +180,17 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 			   gerb_state_t *state,	gerbv_net_t *curr_net, 
 			   gerbv_stats_t *stats, gerb_file_t *fd, 
 			   gchar *directoryPath) {
-    int read, coord, len, polygonPoints=0;
+    int read, coord, polygonPoints=0;
     double x_scale = 0.0, y_scale = 0.0;
     double delta_cp_x = 0.0, delta_cp_y = 0.0;
     double aperture_sizeX, aperture_sizeY;
+    gerbv_aperture_t *aperture;
     double scale;
     gboolean foundEOF = FALSE;
     gchar *string;
     gerbv_render_size_t boundingBox={HUGE_VAL,-HUGE_VAL,HUGE_VAL,-HUGE_VAL};
     
-    while ((read = gerb_fgetc(fd)) != EOF) {
+    while ((read = gerb_fgetcode(fd)) != EOF) {
         /* figure out the scale, since we need to normalize 
 	   all dimensions to inches */
         if (state->state->unit == GERBV_UNIT_MM)
@@ -175,29 +224,8 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 	case 'X':
 	    dprintf("... Found X code\n");
 	    stats->X++;
-	    coord = gerb_fgetint(fd, &len);
-	    if (image->format && image->format->omit_zeros == GERBV_OMIT_ZEROS_TRAILING) {
-		
-		switch ((image->format->x_int + image->format->x_dec) - len) {
-		case 7:
-		    coord *= 10;
-		case 6:
-		    coord *= 10;
-		case 5:
-		    coord *= 10;
-		case 4:
-		    coord *= 10;
-		case 3:
-		    coord *= 10;
-		case 2:
-		    coord *= 10;
-		case 1:
-		    coord *= 10;
-		    break;
-		default:
-		    ;
-		}
-	    }
+	    coord = gerber_fgetcoord(fd, image, image->format ?
+				     image->format->x_int + image->format->x_dec : 0);
 	    if (image->format && (image->format->coordinate==GERBV_COORDINATE_INCREMENTAL))
 	        state->curr_x += coord;
 	    else
@@ -207,29 +235,8 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 	case 'Y':
 	    dprintf("... Found Y code\n");
 	    stats->Y++;
-	    coord = gerb_fgetint(fd, &len);
-	    if (image->format && image->format->omit_zeros == GERBV_OMIT_ZEROS_TRAILING) {
-
-		switch ((image->format->y_int + image->format->y_dec) - len) {
-		case 7:
-		    coord *= 10;
-		case 6:
-		    coord *= 10;
-		case 5:
-		    coord *= 10;
-		case 4:
-		    coord *= 10;
-		case 3:
-		    coord *= 10;
-		case 2:
-		    coord *= 10;
-		case 1:
-		    coord *= 10;
-		    break;
-		default:
-		    ;
-		}
-	    }
+	    coord = gerber_fgetcoord(fd, image, image->format ?
+				     image->format->y_int + image->format->y_dec : 0);
 	    if (image->format && (image->format->coordinate==GERBV_COORDINATE_INCREMENTAL))
 	        state->curr_y += coord;
 	    else
@@ -239,58 +246,16 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 	case 'I':
 	    dprintf("... Found I code\n");
 	    stats->I++;
-	    coord = gerb_fgetint(fd, &len);
-	    if (image->format && image->format->omit_zeros == GERBV_OMIT_ZEROS_TRAILING) {
-
-		switch ((image->format->y_int + image->format->y_dec) - len) {
-		case 7:
-		    coord *= 10;
-		case 6:
-		    coord *= 10;
-		case 5:
-		    coord *= 10;
-		case 4:
-		    coord *= 10;
-		case 3:
-		    coord *= 10;
-		case 2:
-		    coord *= 10;
-		case 1:
-		    coord *= 10;
-		    break;
-		default:
-		    ;
-		}
-	    }
+	    coord = gerber_fgetcoord(fd, image, image->format ?
+				     image->format->y_int + image->format->y_dec : 0);
 	    state->delta_cp_x = coord;
 	    state->changed = 1;
 	    break;
 	case 'J':
 	    dprintf("... Found J code\n");
 	    stats->J++;
-	    coord = gerb_fgetint(fd, &len);
-	    if (image->format && image->format->omit_zeros == GERBV_OMIT_ZEROS_TRAILING) {
-
-		switch ((image->format->y_int + image->format->y_dec) - len) {
-		case 7:
-		    coord *= 10;
-		case 6:
-		    coord *= 10;
-		case 5:
-		    coord *= 10;
-		case 4:
-		    coord *= 10;
-		case 3:
-		    coord *= 10;
-		case 2:
-		    coord *= 10;
-		case 1:
-		    coord *= 10;
-		    break;
-		default:
-		    ;
-		}
-	    }
+	    coord = gerber_fgetcoord(fd, image, image->format ?
+				     image->format->y_int + image->format->y_dec : 0);
 	    state->delta_cp_y = coord;
 	    state->changed = 1;
 	    break;
@@ -299,9 +264,7 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 	    while (1) {
 	    	parse_rs274x(levelOfRecursion, fd, image, state, curr_net, stats, directoryPath);
 	    	/* advance past any whitespace here */
-		int c = gerb_fgetc(fd);
-		while ((c == '\n')||(c == '\r')||(c == ' ')||(c == '\t')||(c == 0))
-			c = gerb_fgetc(fd);
+		int c = gerb_fgetcode(fd);
 		if(c == EOF || c == '%')
 		    break;
 		// loop again to catch multiple blocks on the same line (separated by * char)
@@ -323,7 +286,7 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 		state->prev_y = state->curr_y;
 		break;
 	    }
-	    curr_net = gerber_create_new_net (curr_net, state->layer, state->state);
+	    curr_net = gerber_create_new_net (image, curr_net, state->layer, state->state);
 	    /*
 	     * Scale to given coordinate format
 	     * XXX only "omit leading zeros".
@@ -342,14 +305,14 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 	    delta_cp_y = (double)state->delta_cp_y / y_scale;
 	    switch (state->interpolation) {
 	    case GERBV_INTERPOLATION_CW_CIRCULAR :
-		curr_net->cirseg = g_new0 (gerbv_cirseg_t,1);
+		curr_net->cirseg = gerb_arena_new0 (image->arena, gerbv_cirseg_t);
 		if (state->mq_on)
 		    calc_cirseg_mq(curr_net, 1, delta_cp_x, delta_cp_y);
 		else
 		    calc_cirseg_sq(curr_net, 1, delta_cp_x, delta_cp_y);
 		break;
 	    case GERBV_INTERPOLATION_CCW_CIRCULAR :
-		curr_net->cirseg = g_new0 (gerbv_cirseg_t,1);
+		curr_net->cirseg = gerb_arena_new0 (image->arena, gerbv_cirseg_t);
 		if (state->mq_on)
 		    calc_cirseg_mq(curr_net, 0, delta_cp_x, delta_cp_y);
 		else
@@ -397,12 +360,12 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 		if ((state->aperture_state == GERBV_APERTURE_STATE_OFF &&
 		    	state->interpolation != GERBV_INTERPOLATION_PAREA_START) && (polygonPoints > 0)) {
 		    curr_net->interpolation = GERBV_INTERPOLATION_PAREA_END;
-		    curr_net = gerber_create_new_net (curr_net, state->layer, state->state);
+		    curr_net = gerber_create_new_net (image, curr_net, state->layer, state->state);
 		    curr_net->interpolation = GERBV_INTERPOLATION_PAREA_START;
 		    state->parea_start_node->boundingBox = boundingBox;
 		    state->parea_start_node = curr_net;
 		    polygonPoints = 0;
-		    curr_net = gerber_create_new_net (curr_net, state->layer, state->state);		    
+		    curr_net = gerber_create_new_net (image, curr_net, state->layer, state->state);		    
 		    curr_net->start_x = (double)state->prev_x / x_scale;
 		    curr_net->start_y = (double)state->prev_y / y_scale;
 		    curr_net->stop_x = (double)state->curr_x / x_scale;
@@ -503,34 +466,34 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 		repeat_off_Y = (state->layer->stepAndRepeat.Y - 1) *
 		    state->layer->stepAndRepeat.dist_Y;
 		
-		cairo_matrix_init (&currentMatrix, 1, 0, 0, 1, 0, 0);
+		cairo_matrix_init (&state->transform, 1, 0, 0, 1, 0, 0);
 		/* offset image */
-		cairo_matrix_translate (&currentMatrix, image->info->offsetA, 
+		cairo_matrix_translate (&state->transform, image->info->offsetA, 
 					image->info->offsetB);
 		/* do image rotation */
-		cairo_matrix_rotate (&currentMatrix, image->info->imageRotation);
+		cairo_matrix_rotate (&state->transform, image->info->imageRotation);
 		/* it's a new layer, so recalculate the new transformation 
 		 * matrix for it */
 		/* do any rotations */
-		cairo_matrix_rotate (&currentMatrix, state->layer->rotation);
+		cairo_matrix_rotate (&state->transform, state->layer->rotation);
 			
 		/* calculate current layer and state transformation matrices */
 		/* apply scale factor */
-		cairo_matrix_scale (&currentMatrix, state->state->scaleA, 
+		cairo_matrix_scale (&state->transform, state->state->scaleA, 
 				    state->state->scaleB);
 		/* apply offset */
-		cairo_matrix_translate (&currentMatrix, state->state->offsetA,
+		cairo_matrix_translate (&state->transform, state->state->offsetA,
 					state->state->offsetB);
 		/* apply mirror */
 		switch (state->state->mirrorState) {
 		case GERBV_MIRROR_STATE_FLIPA:
-		    cairo_matrix_scale (&currentMatrix, -1, 1);
+		    cairo_matrix_scale (&state->transform, -1, 1);
 		    break;
 		case GERBV_MIRROR_STATE_FLIPB:
-		    cairo_matrix_scale (&currentMatrix, 1, -1);
+		    cairo_matrix_scale (&state->transform, 1, -1);
 		    break;
 		case GERBV_MIRROR_STATE_FLIPAB:
-		    cairo_matrix_scale (&currentMatrix, -1, -1);
+		    cairo_matrix_scale (&state->transform, -1, -1);
 		    break;
 		default:
 		    break;
@@ -540,14 +503,15 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 		    /* we do this by rotating 270 (counterclockwise, then 
 		     *  mirroring the Y axis 
 		     */
-		    cairo_matrix_rotate (&currentMatrix, M_PI + M_PI_2);
-		    cairo_matrix_scale (&currentMatrix, 1, -1);
+		    cairo_matrix_rotate (&state->transform, M_PI + M_PI_2);
+		    cairo_matrix_scale (&state->transform, 1, -1);
 		}
 		/* if it's a macro, step through all the primitive components
 		   and calculate the true bounding box */
-		if ((image->aperture[curr_net->aperture] != NULL) &&
-		    (image->aperture[curr_net->aperture]->type == GERBV_APTYPE_MACRO)) {
-		    gerbv_simplified_amacro_t *ls = image->aperture[curr_net->aperture]->simplified;
+		aperture = gerbv_image_get_aperture (image, curr_net->aperture);
+		if ((aperture != NULL) &&
+		    (aperture->type == GERBV_APTYPE_MACRO)) {
+		    gerbv_simplified_amacro_t *ls = aperture->simplified;
 	      
 		    while (ls != NULL) {
 			gdouble offsetx = 0, offsety = 0, widthx = 0, widthy = 0;
@@ -562,7 +526,7 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 			    numberOfPoints = (int) ls->parameter[OUTLINE_NUMBER_OF_POINTS];
 		
 			    for (pointCounter = 0; pointCounter <= numberOfPoints; pointCounter++) {
-				gerber_update_min_and_max (&boundingBox,
+				gerber_update_min_and_max (state, &boundingBox,
 							   curr_net->stop_x +
 							   ls->parameter[pointCounter * 2 + OUTLINE_FIRST_X],
 							   curr_net->stop_y +
@@ -584,13 +548,13 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 			    widthx = widthy = ls->parameter[THERMAL_OUTSIDE_DIAMETER];
 			} else if (ls->type == GERBV_APTYPE_MACRO_LINE20) {
 			    widthx = widthy = ls->parameter[LINE20_LINE_WIDTH];
-			    gerber_update_min_and_max (&boundingBox,
+			    gerber_update_min_and_max (state, &boundingBox,
 						       curr_net->stop_x +
 						       ls->parameter[LINE20_START_X],
 						       curr_net->stop_y +
 						       ls->parameter[LINE20_START_Y], 
 						       widthx/2,widthx/2,widthy/2,widthy/2);
-			    gerber_update_min_and_max (&boundingBox,
+			    gerber_update_min_and_max (state, &boundingBox,
 						       curr_net->stop_x +
 						       ls->parameter[LINE20_END_X],
 						       curr_net->stop_y +
@@ -618,7 +582,7 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 			}
 	      	
 			if (!calculatedAlready) {
-			    gerber_update_min_and_max (&boundingBox,
+			    gerber_update_min_and_max (state, &boundingBox,
 						       curr_net->stop_x + offsetx,
 						       curr_net->stop_y + offsety, 
 						       widthx/2,widthx/2,widthy/2,widthy/2);
@@ -626,10 +590,10 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 	    		ls = ls->next;
 		    }
 		} else {
-		    if (image->aperture[curr_net->aperture] != NULL) {
-			aperture_sizeX = image->aperture[curr_net->aperture]->parameter[0];
-			if ((image->aperture[curr_net->aperture]->type == GERBV_APTYPE_RECTANGLE) || (image->aperture[curr_net->aperture]->type == GERBV_APTYPE_OVAL)) {
-				aperture_sizeY = image->aperture[curr_net->aperture]->parameter[1];
+		    if (aperture != NULL) {
+			aperture_sizeX = aperture->parameter[0];
+			if ((aperture->type == GERBV_APTYPE_RECTANGLE) || (aperture->type == GERBV_APTYPE_OVAL)) {
+				aperture_sizeY = aperture->parameter[1];
 			}
 			else
 				aperture_sizeY = aperture_sizeX;
@@ -645,7 +609,7 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 					GERBV_INTERPOLATION_CW_CIRCULAR) ||
 			(curr_net->interpolation ==
 					GERBV_INTERPOLATION_CCW_CIRCULAR)) {
-				calc_cirseg_bbox(curr_net->cirseg,
+				calc_cirseg_bbox(state, curr_net->cirseg,
 						aperture_sizeX, aperture_sizeY,
 						&boundingBox);
 		    } else {
@@ -654,12 +618,12 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 			    /* Note: only check start coordinate if this isn't a flash, 
 			       since the start point may be bogus if it is a flash */
 			    if (curr_net->aperture_state != GERBV_APERTURE_STATE_FLASH) {
-				gerber_update_min_and_max (&boundingBox,
+				gerber_update_min_and_max (state, &boundingBox,
 							   curr_net->start_x, curr_net->start_y, 
 							   aperture_sizeX/2,aperture_sizeX/2,
 							   aperture_sizeY/2,aperture_sizeY/2);
 			    }
-			    gerber_update_min_and_max (&boundingBox,
+			    gerber_update_min_and_max (state, &boundingBox,
 						       curr_net->stop_x, curr_net->stop_y, 
 						       aperture_sizeX/2,aperture_sizeX/2,
 						       aperture_sizeY/2,aperture_sizeY/2);
@@ -672,15 +636,15 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 			gerber_update_image_min_max(&boundingBox, repeat_off_X, repeat_off_Y, image);
 		}
 		/* optionally update the knockout measurement box */
-		if (knockoutMeasure) {
-			if (boundingBox.left < knockoutLimitXmin)
-				knockoutLimitXmin = boundingBox.left;
-			if (boundingBox.right+repeat_off_X > knockoutLimitXmax)
-				knockoutLimitXmax = boundingBox.right+repeat_off_X;
-			if (boundingBox.bottom < knockoutLimitYmin)
-				knockoutLimitYmin = boundingBox.bottom;
-			if (boundingBox.top+repeat_off_Y > knockoutLimitYmax)
-				knockoutLimitYmax = boundingBox.top+repeat_off_Y;
+		if (state->knockoutMeasure) {
+			if (boundingBox.left < state->knockoutLimitXmin)
+				state->knockoutLimitXmin = boundingBox.left;
+			if (boundingBox.right+repeat_off_X > state->knockoutLimitXmax)
+				state->knockoutLimitXmax = boundingBox.right+repeat_off_X;
+			if (boundingBox.bottom < state->knockoutLimitYmin)
+				state->knockoutLimitYmin = boundingBox.bottom;
+			if (boundingBox.top+repeat_off_Y > state->knockoutLimitYmax)
+				state->knockoutLimitYmax = boundingBox.top+repeat_off_Y;
 		}
 		/* if we're not in a polygon fill, then update the object bounding box */
 		if (!state->in_parea_fill) {
@@ -693,12 +657,6 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 		}
 	    }
 	    break;
-	case 10 :   /* White space */
-	case 13 :
-	case ' ' :
-	case '\t' :
-	case 0 :
-	    break;
 	default:
 	    stats->unknown++;
 	    string = g_strdup_printf(_("Found unknown character (whitespace?) [%d]%c"),
@@ -709,7 +667,14 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 				  GERBV_MESSAGE_ERROR);
 	    g_free(string);
 	}  /* switch((char) (read & 0xff)) */
+
+	/* when streaming, hand over each net (or whole polygon) once done */
+	if (state->netFunc && (curr_net != image->netlist) && !state->in_parea_fill)
+	    curr_net = gerber_stream_nets (image, state);
     }
+    /* and whatever is left of an unterminated polygon */
+    if (state->netFunc && (curr_net != image->netlist))
+	gerber_stream_nets (image, state);
     return foundEOF;
 }
 
@@ -724,24 +689,53 @@ gerber_parse_file_segment (gint levelOfRecursion, gerbv_image_t *image,
 gerbv_image_t *
 parse_gerb(gerb_file_t *fd, gchar *directoryPath)
 {
-    gerb_state_t *state = NULL;
-    gerbv_image_t *image = NULL;
-    gerbv_net_t *curr_net = NULL;
-    gerbv_stats_t *stats;
-    gboolean foundEOF = FALSE;
-    gchar *string;
-    
-    /* added by t.motylewski@bfad.de
-     * many locales redefine "." as "," and so on, 
-     * so sscanf and strtod has problems when
-     * reading files using %f format */
-    setlocale(LC_NUMERIC, "C" );
+    gerb_state_t *state;
+    gerbv_image_t *image;
 
     /* 
      * Create new state.  This is used locally to keep track
      * of the photoplotter's state as the Gerber is read in.
      */
     state = g_new0 (gerb_state_t, 1);
+    image = parse_gerb_with_context (fd, directoryPath, state);
+    g_free (state);
+
+    return image;
+} /* parse_gerb */
+
+
+/* ------------------------------------------------------------------ */
+/*! Same as parse_gerb(), but with the photoplotter state supplied by
+ *  the caller.  Numbers are read locale independently and no state is
+ *  kept outside of state, so several files may be parsed at the same
+ *  time as long as each parse uses its own state.
+ */
+gerbv_image_t *
+parse_gerb_with_context(gerb_file_t *fd, gchar *directoryPath,
+		gerb_state_t *state)
+{
+    return parse_gerb_streaming (fd, directoryPath, state, NULL, NULL);
+} /* parse_gerb_with_context */
+
+
+/* ------------------------------------------------------------------ */
+/*! Same as parse_gerb_with_context(), but if netFunc is not NULL every
+ *  net is passed to it as soon as it is complete and then freed, so the
+ *  returned image has no nets.  The statistics, apertures, layers,
+ *  netstates and bounding box of the image are still filled in, and
+ *  the memory used no longer grows with the number of nets.
+ */
+gerbv_image_t *
+parse_gerb_streaming(gerb_file_t *fd, gchar *directoryPath,
+		gerb_state_t *state, gerbv_net_func_t netFunc, gpointer userData)
+{
+    gerbv_image_t *image = NULL;
+    gerbv_net_t *curr_net = NULL;
+    gerbv_stats_t *stats;
+    gboolean foundEOF = FALSE;
+    gchar *string;
+    
+    memset (state, 0, sizeof (gerb_state_t));
 
     /* 
      * Create new image.  This will be returned.
@@ -762,6 +756,14 @@ parse_gerb(gerb_file_t *fd, gchar *directoryPath)
     curr_net->layer = state->layer;
     curr_net->state = state->state;
 
+    if (netFunc != NULL) {
+	state->netFunc = netFunc;
+	state->netFuncData = userData;
+	gerb_arena_mark (image->arena, &state->netMark);
+	state->netMarkLayer = state->layer;
+	state->netMarkState = state->state;
+    }
+
     /*
      * Start parsing
      */
@@ -777,14 +779,13 @@ parse_gerb(gerb_file_t *fd, gchar *directoryPath)
 			      GERBV_MESSAGE_ERROR);
 	g_free(string);
     }
-    g_free(state);
+    gerber_update_any_running_knockout_measurements (state);
     
     dprintf("               ... done parsing Gerber file\n");
-    gerber_update_any_running_knockout_measurements (image);
     gerber_calculate_final_justify_effects(image);
 
     return image;
-} /* parse_gerb */
+} /* parse_gerb_streaming */
 
 
 /* ------------------------------------------------------------------- */
@@ -1035,7 +1036,7 @@ parse_G_code(gerb_file_t *fd, gerb_state_t *state, gerbv_image_t *image)
 	/* XXX Maybe uneccesary??? */
 	if (gerb_fgetc(fd) == 'D') {
 	    int a = gerb_fgetint(fd, NULL);
-	    if ((a >= 0) && (a <= APERTURE_MAX)) {
+	    if (a >= 0) {
 		state->curr_aperture = a;
 	    } else { 
 		string = g_strdup_printf(_("Found aperture D%d out of bounds while parsing G code in file \"%s\""),
@@ -1061,12 +1062,12 @@ parse_G_code(gerb_file_t *fd, gerb_state_t *state, gerbv_image_t *image)
 	stats->G55++;
 	break;
     case 70: /* Specify inches */
-	state->state = gerbv_image_return_new_netstate (state->state);
+	state->state = gerbv_image_return_new_netstate (image, state->state);
 	state->state->unit = GERBV_UNIT_INCH;
 	stats->G70++;
 	break;
     case 71: /* Specify millimeters */
-	state->state = gerbv_image_return_new_netstate (state->state);
+	state->state = gerbv_image_return_new_netstate (image, state->state);
 	state->state->unit = GERBV_UNIT_MM;
 	stats->G71++;
 	break;
@@ -1147,7 +1148,7 @@ parse_D_code(gerb_file_t *fd, gerb_state_t *state, gerbv_image_t *image)
 	stats->D3++;
 	break;
     default: /* Aperture in use */
-	if ((a >= 0) && (a <= APERTURE_MAX)) {
+	if (a >= 0) {
 	    state->curr_aperture = a;
 	    
 	} else {
@@ -1246,7 +1247,7 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
     case A2I('A','S'): /* Axis Select */
 	op[0] = gerb_fgetc(fd);
 	op[1] = gerb_fgetc(fd);
-	state->state = gerbv_image_return_new_netstate (state->state);
+	state->state = gerbv_image_return_new_netstate (image, state->state);
 	
 	if ((op[0] == EOF) || (op[1] == EOF)) {
 	    string = g_strdup_printf(_("Unexpected EOF found in file \"%s\""), fd->filename);
@@ -1425,7 +1426,7 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	break;
     case A2I('M','I'): /* Mirror Image */
 	op[0] = gerb_fgetc(fd);
-	state->state = gerbv_image_return_new_netstate (state->state);
+	state->state = gerbv_image_return_new_netstate (image, state->state);
 	
 	while ((op[0] != '*')&&(op[0] != EOF)) {
             gint readValue=0;
@@ -1470,11 +1471,11 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 				 GERBV_MESSAGE_ERROR);
 	switch (A2I(op[0],op[1])) {
 	case A2I('I','N'):
-	    state->state = gerbv_image_return_new_netstate (state->state);
+	    state->state = gerbv_image_return_new_netstate (image, state->state);
 	    state->state->unit = GERBV_UNIT_INCH;
 	    break;
 	case A2I('M','M'):
-	    state->state = gerbv_image_return_new_netstate (state->state);
+	    state->state = gerbv_image_return_new_netstate (image, state->state);
 	    state->state->unit = GERBV_UNIT_MM;
 	    break;
 	default:
@@ -1572,7 +1573,7 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	}
 	break;
     case A2I('S','F'): /* Scale Factor */
-     state->state = gerbv_image_return_new_netstate (state->state);
+     state->state = gerbv_image_return_new_netstate (image, state->state);
 	if (gerb_fgetc(fd) == 'A')
 	    state->state->scaleA = gerb_fgetdouble(fd);
 	else 
@@ -1732,9 +1733,9 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	if (ano == -1) {
 		/* error with line parse, so just quietly ignore */
 	}
-	else if ((ano >= 0) && (ano <= APERTURE_MAX)) {
+	else if (ano >= 0) {
 	    a->unit = state->state->unit;
-	    image->aperture[ano] = a;
+	    gerbv_image_set_aperture (image, ano, a);
 	    dprintf("     In parse_rs274x, adding new aperture to aperture list ...\n");
 	    gerbv_stats_add_aperture(stats->aperture_list,
 				    -1, ano, 
@@ -1780,11 +1781,11 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	return;
 	/* Layer */
     case A2I('L','N'): /* Layer Name */
-	state->layer = gerbv_image_return_new_layer (state->layer);
+	state->layer = gerbv_image_return_new_layer (image, state->layer);
 	state->layer->name = gerb_fgetstring(fd, '*');
 	break;
     case A2I('L','P'): /* Layer Polarity */
-	state->layer = gerbv_image_return_new_layer (state->layer);
+	state->layer = gerbv_image_return_new_layer (image, state->layer);
 	switch (gerb_fgetc(fd)) {
 	case 'D': /* Dark Polarity (default) */
 	    state->layer->polarity = GERBV_POLARITY_DARK;
@@ -1803,10 +1804,10 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	}
 	break;
     case A2I('K','O'): /* Knock Out */
-        state->layer = gerbv_image_return_new_layer (state->layer);
-        gerber_update_any_running_knockout_measurements (image);
+        state->layer = gerbv_image_return_new_layer (image, state->layer);
+        gerber_update_any_running_knockout_measurements (state);
         /* reset any previous knockout measurements */
-        knockoutMeasure = FALSE;
+        state->knockoutMeasure = FALSE;
         op[0] = gerb_fgetc(fd);
 	if (op[0] == '*') { /* Disable previous SR parameters */
 	    state->layer->knockout.type = GERBV_KNOCKOUT_TYPE_NOKNOCKOUT;
@@ -1854,12 +1855,12 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	        state->layer->knockout.border = gerb_fgetdouble(fd) / scale;
 	        /* this is a bordered knockout, so we need to start measuring the
 	           size of a square bordering all future components */
-	        knockoutMeasure = TRUE;
-	        knockoutLimitXmin = HUGE_VAL;
-	        knockoutLimitYmin = HUGE_VAL;
-	        knockoutLimitXmax = -HUGE_VAL;
-	        knockoutLimitYmax = -HUGE_VAL;
-	        knockoutLayer = state->layer;
+	        state->knockoutMeasure = TRUE;
+	        state->knockoutLimitXmin = HUGE_VAL;
+	        state->knockoutLimitYmin = HUGE_VAL;
+	        state->knockoutLimitXmax = -HUGE_VAL;
+	        state->knockoutLimitYmax = -HUGE_VAL;
+	        state->knockoutLayer = state->layer;
 	        break;
 	    default:
 		string = g_strdup_printf(_("Unknown variable in knockout in file \"%s\""),
@@ -1875,7 +1876,7 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	break;
     case A2I('S','R'): /* Step and Repeat */
         /* start by generating a new layer (duplicating previous layer settings */
-        state->layer = gerbv_image_return_new_layer (state->layer);
+        state->layer = gerbv_image_return_new_layer (image, state->layer);
 	op[0] = gerb_fgetc(fd);
 	if (op[0] == '*') { /* Disable previous SR parameters */
 	    state->layer->stepAndRepeat.X = 1;
@@ -1923,7 +1924,7 @@ parse_rs274x(gint levelOfRecursion, gerb_file_t *fd, gerbv_image_t *image,
 	break;
 	/* is this an actual RS274X command??  It isn't explainined in the spec... */
     case A2I('R','O'):
-	state->layer = gerbv_image_return_new_layer (state->layer);
+	state->layer = gerbv_image_return_new_layer (image, state->layer);
 	
 	state->layer->rotation = DEG2RAD(gerb_fgetdouble(fd));
 	op[0] = gerb_fgetc(fd);
@@ -2270,14 +2271,43 @@ simplify_aperture_macro(gerbv_aperture_t *aperture, gdouble scale)
 } /* simplify_aperture_macro */
 
 
+/* ------------------------------------------------------------------ */
+/*! Splits the next token up to delim off rest, skipping empty tokens
+ *  like strtok() does.  Returns FALSE if there is no token left */
+static gboolean
+gerber_slice_token(gerb_file_slice_t *rest, char delim, gerb_file_slice_t *token)
+{
+    const char *end;
+
+    while ((rest->len > 0) && (*rest->data == delim)) {
+	rest->data++;
+	rest->len--;
+    }
+    if (rest->len == 0)
+	return FALSE;
+
+    token->data = rest->data;
+    end = memchr(rest->data, delim, rest->len);
+    token->len = (end != NULL) ? end - rest->data : rest->len;
+    rest->data += token->len;
+    rest->len -= token->len;
+    /* skip the delimiter itself */
+    if (rest->len > 0) {
+	rest->data++;
+	rest->len--;
+    }
+
+    return TRUE;
+} /* gerber_slice_token */
+
+
 /* ------------------------------------------------------------------ */
 static int 
 parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
 			  gerbv_image_t *image, gdouble scale)
 {
     int ano, i;
-    char *ad;
-    char *token;
+    gerb_file_slice_t ad, token;
     gerbv_amacro_t *curr_amacro;
     gerbv_amacro_t *amacro = image->amacro;
     gerbv_stats_t *stats = image->gerbv_stats;
@@ -2301,12 +2331,10 @@ parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
     ano = gerb_fgetint(fd, NULL);
     
     /*
-     * Read in the whole aperture defintion and tokenize it
+     * Tokenize the whole aperture defintion in the file data
      */
-    ad = gerb_fgetstring(fd, '*');
-    token = strtok(ad, ",");
-    
-    if (token == NULL) {
+    if (!gerb_fgetslice(fd, '*', &ad)
+	|| !gerber_slice_token(&ad, ',', &token)) {
 		string = g_strdup_printf(_("Invalid aperture definition in file \"%s\""),
 					 fd->filename);
 		gerbv_stats_add_error(stats->error_list,
@@ -2316,8 +2344,8 @@ parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
 		g_free(string);
 		return -1;
     }
-    if (strlen(token) == 1) {
-	switch (token[0]) {
+    if (token.len == 1) {
+	switch (token.data[0]) {
 	case 'C':
 	    aperture->type = GERBV_APTYPE_CIRCLE;
 	    break;
@@ -2340,8 +2368,8 @@ parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
 	 */
 	curr_amacro = amacro;
 	while (curr_amacro) {
-	    if ((strlen(curr_amacro->name) == strlen(token)) &&
-		(strcmp(curr_amacro->name, token) == 0)) {
+	    if (((int) strlen(curr_amacro->name) == token.len) &&
+		(memcmp(curr_amacro->name, token.data, token.len) == 0)) {
 		aperture->amacro = curr_amacro;
 		break;
 	    }
@@ -2352,8 +2380,7 @@ parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
     /*
      * Parse all parameters
      */
-    for (token = strtok(NULL, "X"), i = 0; token != NULL; 
-	 token = strtok(NULL, "X"), i++) {
+    for (i = 0; gerber_slice_token(&ad, 'X', &token); i++) {
 	if (i == APERTURE_PARAMETERS_MAX) {
 	    string = g_strdup_printf(_("Maximum number of allowed parameters exceeded in aperture %d in file \"%s\""),
 				     ano, fd->filename);
@@ -2366,7 +2393,7 @@ parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
 	}
 	errno = 0;
 
-	tempHolder = strtod(token, NULL);
+	gerb_scan_double(token.data, token.len, &tempHolder);
 	/* convert any MM values to inches */
 	/* don't scale polygon angles or side numbers, or macro parmaeters */
 	if (!(((aperture->type == GERBV_APTYPE_POLYGON) && ((i==1) || (i==2)))||
@@ -2397,8 +2424,6 @@ parse_aperture_definition(gerb_file_t *fd, gerbv_aperture_t *aperture,
 	dprintf("Done simplifying\n");
     }
     
-    g_free(ad);
-    
     return ano;
 } /* parse_aperture_definition */
 
@@ -2597,7 +2622,7 @@ calc_cirseg_mq(struct gerbv_net *net, int cw,
 
 /* Calculate circular interpolation bounding box */
 static void
-calc_cirseg_bbox(const gerbv_cirseg_t *cirseg,
+calc_cirseg_bbox(gerb_state_t *state, const gerbv_cirseg_t *cirseg,
 		double apert_size_x, double apert_size_y,
 		gerbv_render_size_t *bbox)
 {
@@ -2613,7 +2638,7 @@ calc_cirseg_bbox(const gerbv_cirseg_t *cirseg,
 	/* Start arc point */
 	x = cirseg->cp_x + cirseg->width*cos(ang1)/2;
 	y = cirseg->cp_y + cirseg->width*sin(ang1)/2;
-	gerber_update_min_and_max(bbox, x, y,
+	gerber_update_min_and_max(state, bbox, x, y,
 				apert_size_x, apert_size_x,
 				apert_size_y, apert_size_y);
 
@@ -2623,7 +2648,7 @@ calc_cirseg_bbox(const gerbv_cirseg_t *cirseg,
 				step_pi_2 += M_PI_2) {
 		x = cirseg->cp_x + cirseg->width*cos(step_pi_2)/2;
 		y = cirseg->cp_y + cirseg->width*sin(step_pi_2)/2;
-		gerber_update_min_and_max(bbox, x, y,
+		gerber_update_min_and_max(state, bbox, x, y,
 					apert_size_x, apert_size_x,
 					apert_size_y, apert_size_y);
 	}
@@ -2631,20 +2656,22 @@ calc_cirseg_bbox(const gerbv_cirseg_t *cirseg,
 	/* Stop arc point */
 	x = cirseg->cp_x + cirseg->width*cos(ang2)/2;
 	y = cirseg->cp_y + cirseg->width*sin(ang2)/2;
-	gerber_update_min_and_max(bbox, x, y,
+	gerber_update_min_and_max(state, bbox, x, y,
 				apert_size_x, apert_size_x,
 				apert_size_y, apert_size_y);
 }
 
 static void
-gerber_update_any_running_knockout_measurements (gerbv_image_t *image)
+gerber_update_any_running_knockout_measurements (gerb_state_t *state)
 {
-    if (knockoutMeasure) {
-	knockoutLayer->knockout.lowerLeftX = knockoutLimitXmin;
-	knockoutLayer->knockout.lowerLeftY = knockoutLimitYmin;
-	knockoutLayer->knockout.width = knockoutLimitXmax - knockoutLimitXmin;
-	knockoutLayer->knockout.height = knockoutLimitYmax - knockoutLimitYmin;
-	knockoutMeasure = FALSE;
+    if (state->knockoutMeasure) {
+	gerbv_layer_t *layer = state->knockoutLayer;
+
+	layer->knockout.lowerLeftX = state->knockoutLimitXmin;
+	layer->knockout.lowerLeftY = state->knockoutLimitYmin;
+	layer->knockout.width = state->knockoutLimitXmax - state->knockoutLimitXmin;
+	layer->knockout.height = state->knockoutLimitYmax - state->knockoutLimitYmin;
+	state->knockoutMeasure = FALSE;
     }
 }
 
@@ -2696,7 +2723,8 @@ void gerber_update_image_min_max (gerbv_render_size_t *boundingBox, double repea
 }
 
 void
-gerber_update_min_and_max(gerbv_render_size_t *boundingBox,
+gerber_update_min_and_max(gerb_state_t *state,
+			  gerbv_render_size_t *boundingBox,
 			  gdouble x, gdouble y, gdouble apertureSizeX1,
 			  gdouble apertureSizeX2,gdouble apertureSizeY1,
 			  gdouble apertureSizeY2)
@@ -2708,8 +2736,10 @@ gerber_update_min_and_max(gerbv_render_size_t *boundingBox,
        for any scaling, offsets, mirroring, etc */
     /* NOTE: we need to already add/subtract in the aperture size since
        the final rendering may be scaled */
-    cairo_matrix_transform_point (&currentMatrix, &ourX1, &ourY1);
-    cairo_matrix_transform_point (&currentMatrix, &ourX2, &ourY2);
+    if (state) {
+	cairo_matrix_transform_point (&state->transform, &ourX1, &ourY1);
+	cairo_matrix_transform_point (&state->transform, &ourX2, &ourY2);
+    }
 
     /* check both points against the min/max, since depending on the rotation,
        mirroring, etc, either point could possibly be a min or max */
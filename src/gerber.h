@@ -37,6 +37,7 @@ extern "C" {
 #include <glib.h>
 
 #include "gerb_file.h"
+#include "gerb_arena.h"
 
 typedef struct gerb_state {
     int curr_x;
@@ -55,16 +56,39 @@ typedef struct gerb_state {
     gerbv_netstate_t *state;
     int in_parea_fill;
     int mq_on;		/* Is multiquadrant circular iterpolation */
+    cairo_matrix_t transform;	/* Image, layer and netstate transformation
+				   applied to the current net's bounding box */
+    gboolean knockoutMeasure;	/* Is a bordered knockout being measured */
+    gdouble knockoutLimitXmin, knockoutLimitYmin,
+	knockoutLimitXmax, knockoutLimitYmax;
+    gerbv_layer_t *knockoutLayer;
+    gerbv_net_func_t netFunc;	/* Receives the finished nets when streaming */
+    gpointer netFuncData;
+    gerb_arena_mark_t netMark;	/* Arena end after the last streamed nets */
+    gerbv_layer_t *netMarkLayer;	/* Layer and netstate when netMark was */
+    gerbv_netstate_t *netMarkState;	/* taken */
 } gerb_state_t;
 
 /*
  * parse gerber file pointed to by fd
  */
 gerbv_image_t *parse_gerb(gerb_file_t *fd, gchar *directoryPath);
+/*
+ * parse gerber file pointed to by fd, keeping all parser state in state
+ */
+gerbv_image_t *parse_gerb_with_context(gerb_file_t *fd, gchar *directoryPath,
+		gerb_state_t *state);
+/*
+ * parse gerber file pointed to by fd, handing every net to netFunc instead
+ * of keeping it in the image
+ */
+gerbv_image_t *parse_gerb_streaming(gerb_file_t *fd, gchar *directoryPath,
+		gerb_state_t *state, gerbv_net_func_t netFunc, gpointer userData);
 gboolean gerber_is_rs274x_p(gerb_file_t *fd, gboolean *returnFoundBinary);
 gboolean gerber_is_rs274d_p(gerb_file_t *fd);
 gerbv_net_t *
-gerber_create_new_net (gerbv_net_t *currentNet, gerbv_layer_t *layer, gerbv_netstate_t *state);
+gerber_create_new_net (gerbv_image_t *image, gerbv_net_t *currentNet,
+		gerbv_layer_t *layer, gerbv_netstate_t *state);
 
 gboolean
 gerber_create_new_aperture (gerbv_image_t *image, int *indexNumber,
@@ -72,7 +96,8 @@ gerber_create_new_aperture (gerbv_image_t *image, int *indexNumber,
 		
 void gerber_update_image_min_max (gerbv_render_size_t *boundingBox, double repeat_off_X,
 		double repeat_off_Y, gerbv_image_t* image);
-void gerber_update_min_and_max(gerbv_render_size_t *boundingBox,
+void gerber_update_min_and_max(gerb_state_t *state,
+			  gerbv_render_size_t *boundingBox,
 			  gdouble x, gdouble y, gdouble apertureSizeX1,
 			  gdouble apertureSizeX2,gdouble apertureSizeY1,
 			  gdouble apertureSizeY2);
@@ -63,10 +63,14 @@
 #include "draw.h"
 
 #include "pick-and-place.h"
+#include "image_cache.h"
 
 /* DEBUG printing.  #define DEBUG 1 in config.h to use this fcn. */
 #define dprintf if(DEBUG) printf
 
+/* Memory the layer rasters of a threaded render may use at once */
+#define GERBV_RENDER_THREADED_MAX_BYTES (512 * 1024 * 1024)
+
 /* These are the names of the valid apertures.  Please keep this in sync with
  * the gerbv_aperture_type_t enum defined in gerbv.h */
 const char *aperture_names[] = {
@@ -424,55 +428,41 @@ gerbv_add_parsed_image_to_project (gerbv_project_t *gerbvProject, gerbv_image_t
 }
 
 /* ------------------------------------------------------------------ */
-int
-gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int reload,
-		gerbv_HID_Attribute *fattr, int n_fattr, gboolean forceLoadFile)
+/* Detects the type of filename and parses it, without touching any project,
+   so it may run on any thread.  image2 receives the bottom side image of
+   pick and place files. */
+static gboolean
+gerbv_parse_layer_file (gchar *filename, gerbv_HID_Attribute *attr_list,
+		int n_attr, int reload, gerbv_layertype_t reloadLayertype,
+		gboolean forceLoadFile, gerbv_image_t **image,
+		gerbv_image_t **image2, gboolean *isPnpFile)
 {
     gerb_file_t *fd;
     gerbv_image_t *parsed_image = NULL, *parsed_image2 = NULL;
-    gint retv = -1;
-    gboolean isPnpFile = FALSE, foundBinary;
-    gerbv_HID_Attribute *attr_list = NULL;
-    int n_attr = 0;
-    /* If we're reloading, we'll pass in our file format attribute list
-     * since this is our hook for letting the user override the fileformat.
-     */
-    if (reload)
-	{
-	    /* We're reloading so use the attribute list in memory */
-	    attr_list =  gerbvProject->file[idx]->image->info->attr_list;
-	    n_attr =  gerbvProject->file[idx]->image->info->n_attr;
-	}
-    else
-	{
-	    /* We're not reloading so use the attribute list read from the 
-	     * project file if given or NULL otherwise.
-	     */
-	    attr_list = fattr;
-	    n_attr = n_fattr;
-	}
-    /* if we don't have enough spots, then grow the file list by 2 to account for the possible 
-       loading of two images for PNP files */
-    if ((idx+1) >= gerbvProject->max_files) {
-	gerbvProject->file = g_renew (gerbv_fileinfo_t *,
-			gerbvProject->file, gerbvProject->max_files + 2);
+    gboolean foundBinary;
+
+    *isPnpFile = FALSE;
 
-	gerbvProject->file[gerbvProject->max_files] = NULL;
-	gerbvProject->file[gerbvProject->max_files+1] = NULL;
-	gerbvProject->max_files += 2;
-    }
-    
     dprintf("In open_image, about to try opening filename = %s\n", filename);
     
     fd = gerb_fopen(filename);
     if (fd == NULL) {
 	GERB_MESSAGE(_("Trying to open %s: %s"), filename, strerror(errno));
-	return -1;
+	return FALSE;
     }
 
     /* Store filename info fd for further use */
     fd->filename = g_strdup(filename);
     
+    /* a file opened before may not need to be parsed at all */
+    parsed_image = image_cache_load (filename, fd);
+    if (parsed_image != NULL) {
+	gerb_fclose(fd);
+	*image = parsed_image;
+	*image2 = NULL;
+	return TRUE;
+    }
+
     dprintf("In open_image, successfully opened file.  Now check its type....\n");
     /* Here's where we decide what file type we have */
     /* Note: if the file has some invalid characters in it but still appears to
@@ -488,6 +478,7 @@ gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int rel
 		gchar *currentLoadDirectory = g_path_get_dirname (filename);
 		parsed_image = parse_gerb(fd, currentLoadDirectory);
 		g_free (currentLoadDirectory);
+		image_cache_save (filename, fd, parsed_image);
 	}
     } else if(drill_file_p(fd, &foundBinary)) {
 	dprintf("Found drill file\n");
@@ -500,7 +491,7 @@ gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int rel
 		if (!reload) {
 			pick_and_place_parse_file_to_images(fd, &parsed_image, &parsed_image2);
 		} else {
-			switch (gerbvProject->file[idx]->image->layertype) {
+			switch (reloadLayertype) {
 			case GERBV_LAYERTYPE_PICKANDPLACE_TOP:
 				/* Non NULL pointer is used as "not to reload" mark */
 				parsed_image2 = (void *)!NULL;
@@ -518,7 +509,7 @@ gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int rel
 			}
 		}
 			
-		isPnpFile = TRUE;
+		*isPnpFile = TRUE;
 	}
     } else if (gerber_is_rs274d_p(fd)) {
 	dprintf("Most likely found a RS-274D file...trying to open anyways\n");
@@ -538,8 +529,32 @@ gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int rel
     }
     
     gerb_fclose(fd);
-    if (parsed_image == NULL) {
-	return -1;
+
+    *image = parsed_image;
+    *image2 = parsed_image2;
+
+    return (parsed_image != NULL);
+} /* gerbv_parse_layer_file */
+
+/* ------------------------------------------------------------------ */
+/* Adds the images parsed by gerbv_parse_layer_file() to the project at
+   idx (and idx + 1 for the bottom side of pick and place files) */
+static int
+gerbv_add_parsed_layer_file (gerbv_project_t *gerbvProject, gchar *filename,
+		int idx, int reload, gerbv_image_t *parsed_image,
+		gerbv_image_t *parsed_image2, gboolean isPnpFile)
+{
+    gint retv = -1;
+
+    /* if we don't have enough spots, then grow the file list by 2 to account for the possible 
+       loading of two images for PNP files */
+    if ((idx+1) >= gerbvProject->max_files) {
+	gerbvProject->file = g_renew (gerbv_fileinfo_t *,
+			gerbvProject->file, gerbvProject->max_files + 2);
+
+	gerbvProject->file[gerbvProject->max_files] = NULL;
+	gerbvProject->file[gerbvProject->max_files+1] = NULL;
+	gerbvProject->max_files += 2;
     }
     
     if (parsed_image) {
@@ -571,10 +586,156 @@ gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int rel
     }
 
     return retv;
+} /* gerbv_add_parsed_layer_file */
+
+/* ------------------------------------------------------------------ */
+int
+gerbv_open_image(gerbv_project_t *gerbvProject, char *filename, int idx, int reload,
+		gerbv_HID_Attribute *fattr, int n_fattr, gboolean forceLoadFile)
+{
+    gerbv_image_t *parsed_image = NULL, *parsed_image2 = NULL;
+    gerbv_layertype_t reloadLayertype = GERBV_LAYERTYPE_RS274X;
+    gboolean isPnpFile = FALSE;
+    gerbv_HID_Attribute *attr_list = NULL;
+    int n_attr = 0;
+    /* If we're reloading, we'll pass in our file format attribute list
+     * since this is our hook for letting the user override the fileformat.
+     */
+    if (reload)
+	{
+	    /* We're reloading so use the attribute list in memory */
+	    attr_list =  gerbvProject->file[idx]->image->info->attr_list;
+	    n_attr =  gerbvProject->file[idx]->image->info->n_attr;
+	    reloadLayertype = gerbvProject->file[idx]->image->layertype;
+	}
+    else
+	{
+	    /* We're not reloading so use the attribute list read from the 
+	     * project file if given or NULL otherwise.
+	     */
+	    attr_list = fattr;
+	    n_attr = n_fattr;
+	}
+
+    if (!gerbv_parse_layer_file (filename, attr_list, n_attr, reload,
+			reloadLayertype, forceLoadFile,
+			&parsed_image, &parsed_image2, &isPnpFile))
+	return -1;
+
+    return gerbv_add_parsed_layer_file (gerbvProject, filename, idx, reload,
+			parsed_image, parsed_image2, isPnpFile);
 } /* open_image */
 
+/* ------------------------------------------------------------------ */
+/* Returns the number of threads worth running for parallel work */
+static gint
+gerbv_get_thread_count (void)
+{
+	return g_get_num_processors ();
+}
+
+/* ------------------------------------------------------------------ */
+/* One file parsed by a loader thread of gerbv_open_layers_from_filenames() */
+typedef struct {
+    gerbv_layer_file_t *layerFile;
+    gerbv_image_t *image;
+    gerbv_image_t *image2;
+    gboolean isPnpFile;
+} gerbv_layer_load_job_t;
+
+static void
+gerbv_load_layer_job (gpointer data, gpointer user_data)
+{
+    gerbv_layer_load_job_t *job = data;
+
+    gerbv_parse_layer_file (job->layerFile->filename,
+		    job->layerFile->attr_list, job->layerFile->n_attr,
+		    FALSE, GERBV_LAYERTYPE_RS274X, TRUE,
+		    &job->image, &job->image2, &job->isPnpFile);
+}
+
+/* ------------------------------------------------------------------ */
+gint
+gerbv_open_layers_from_filenames (gerbv_project_t *gerbvProject,
+		gerbv_layer_file_t *layerFiles, gint count)
+{
+    gerbv_layer_load_job_t *jobs;
+    GThreadPool *pool = NULL;
+    gint i, idx, threadCount, loadedCount = 0;
+
+    if (count <= 0)
+	return 0;
+
+    jobs = g_new0 (gerbv_layer_load_job_t, count);
+    for (i = 0; i < count; i++)
+	jobs[i].layerFile = &layerFiles[i];
+
+    threadCount = MIN (gerbv_get_thread_count (), count);
+    if (threadCount > 1) {
+	/* the parsers switch LC_NUMERIC themselves, but must not do so
+	   while other threads are already parsing */
+	setlocale (LC_NUMERIC, "C");
+	pool = g_thread_pool_new (gerbv_load_layer_job, NULL, threadCount,
+			TRUE, NULL);
+    }
+
+    if (pool) {
+	for (i = 0; i < count; i++)
+	    g_thread_pool_push (pool, &jobs[i], NULL);
+	/* wait for all files to be parsed */
+	g_thread_pool_free (pool, FALSE, TRUE);
+    } else {
+	for (i = 0; i < count; i++)
+	    gerbv_load_layer_job (&jobs[i], NULL);
+    }
+
+    /* add the layers in their original order */
+    for (i = 0; i < count; i++) {
+	idx = gerbvProject->last_loaded + 1;
+	layerFiles[i].fileIndex = -1;
+
+	if (jobs[i].image == NULL
+	|| gerbv_add_parsed_layer_file (gerbvProject, layerFiles[i].filename,
+			idx, FALSE, jobs[i].image, jobs[i].image2,
+			jobs[i].isPnpFile) == -1) {
+	    GERB_MESSAGE(_("Could not read %s[%d]"), layerFiles[i].filename,
+			    idx);
+	    continue;
+	}
+
+	layerFiles[i].fileIndex = idx;
+	loadedCount++;
+    }
+    g_free (jobs);
+
+    return loadedCount;
+} /* gerbv_open_layers_from_filenames */
+
 gerbv_image_t *
 gerbv_create_rs274x_image_from_filename (gchar *filename){
+	gerbv_rs274x_context_t *context;
+	gerbv_image_t *returnImage;
+
+	context = gerbv_rs274x_context_new ();
+	returnImage = gerbv_create_rs274x_image_from_filename_with_context (
+			context, filename);
+	gerbv_rs274x_context_destroy (context);
+	return returnImage;
+}
+
+gerbv_rs274x_context_t *
+gerbv_rs274x_context_new (void){
+	return g_new0 (gerbv_rs274x_context_t, 1);
+}
+
+void
+gerbv_rs274x_context_destroy (gerbv_rs274x_context_t *context){
+	g_free (context);
+}
+
+gerbv_image_t *
+gerbv_create_rs274x_image_from_filename_with_context (
+		gerbv_rs274x_context_t *context, gchar *filename){
 	gerbv_image_t *returnImage;
 	gerb_file_t *fd;
 	
@@ -584,7 +745,26 @@ gerbv_create_rs274x_image_from_filename (gchar *filename){
 		return NULL;
 	}
 	gchar *currentLoadDirectory = g_path_get_dirname (filename);
-	returnImage = parse_gerb(fd, currentLoadDirectory);
+	returnImage = parse_gerb_with_context(fd, currentLoadDirectory, context);
+	g_free (currentLoadDirectory);
+	gerb_fclose(fd);
+	return returnImage;
+}
+
+gerbv_image_t *
+gerbv_stream_rs274x_image_from_filename (gerbv_rs274x_context_t *context,
+		gchar *filename, gerbv_net_func_t netFunc, gpointer userData){
+	gerbv_image_t *returnImage;
+	gerb_file_t *fd;
+	
+	fd = gerb_fopen(filename);
+	if (fd == NULL) {
+		GERB_MESSAGE(_("Trying to open %s: %s"), filename, strerror(errno));
+		return NULL;
+	}
+	gchar *currentLoadDirectory = g_path_get_dirname (filename);
+	returnImage = parse_gerb_streaming(fd, currentLoadDirectory, context,
+			netFunc, userData);
 	g_free (currentLoadDirectory);
 	gerb_fclose(fd);
 	return returnImage;
@@ -853,6 +1033,148 @@ gerbv_render_all_layers_to_cairo_target_for_vector_output (gerbv_project_t *gerb
 	}
 }
 
+/* ------------------------------------------------------------------ */
+/* One layer rasterized by a render worker thread */
+typedef struct {
+	gerbv_fileinfo_t *fileInfo;
+	gerbv_render_info_t *renderInfo;
+	cairo_surface_t *surface;
+	GAsyncQueue *finishedQueue;
+	gboolean finished;	/* only touched by the calling thread */
+} gerbv_render_layer_job_t;
+
+static void
+gerbv_render_layer_job (gpointer data, gpointer user_data)
+{
+	gerbv_render_layer_job_t *job = data;
+	cairo_t *cr;
+
+	job->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+			job->renderInfo->displayWidth, job->renderInfo->displayHeight);
+	cr = cairo_create (job->surface);
+	gerbv_render_layer_to_cairo_target (cr, job->fileInfo, job->renderInfo);
+	cairo_destroy (cr);
+
+	g_async_queue_push (job->finishedQueue, job);
+}
+
+/* ------------------------------------------------------------------ */
+/* Returns TRUE if cr draws in device space and is not clipped to less
+   than its whole target */
+static gboolean
+gerbv_render_target_is_untransformed (cairo_t *cr)
+{
+	cairo_surface_t *target = cairo_get_target (cr);
+	cairo_rectangle_list_t *clip;
+	cairo_matrix_t matrix;
+	gboolean unclipped;
+
+	cairo_get_matrix (cr, &matrix);
+	if (matrix.xx != 1.0 || matrix.yx != 0.0 || matrix.xy != 0.0
+	|| matrix.yy != 1.0 || matrix.x0 != 0.0 || matrix.y0 != 0.0)
+		return FALSE;
+
+	clip = cairo_copy_clip_rectangle_list (cr);
+	unclipped = (clip->status == CAIRO_STATUS_SUCCESS
+		&& clip->num_rectangles == 1
+		&& clip->rectangles[0].x <= 0 && clip->rectangles[0].y <= 0
+		&& clip->rectangles[0].x + clip->rectangles[0].width
+			>= cairo_image_surface_get_width (target)
+		&& clip->rectangles[0].y + clip->rectangles[0].height
+			>= cairo_image_surface_get_height (target));
+	cairo_rectangle_list_destroy (clip);
+
+	return unclipped;
+}
+
+/* ------------------------------------------------------------------ */
+/* Rasterizes the visible layers on a pool of worker threads, and blends
+   them onto cr in z-order as they become available.  Returns FALSE if
+   the layers should rather be rendered one after another. */
+static gboolean
+gerbv_render_all_layers_threaded (gerbv_project_t *gerbvProject, cairo_t *cr,
+			gerbv_render_info_t *renderInfo) {
+	gerbv_render_layer_job_t *jobs, *job;
+	GThreadPool *pool;
+	GAsyncQueue *finishedQueue;
+	gint i, jobCount = 0, nextJob, threadCount, maxPending;
+	gsize layerBytes;
+
+	/* the layers are blended as image surfaces, so keep vector output
+	   as vectors */
+	if (cairo_surface_get_type (cairo_get_target (cr)) != CAIRO_SURFACE_TYPE_IMAGE
+	|| renderInfo->displayWidth <= 0 || renderInfo->displayHeight <= 0)
+		return FALSE;
+
+	/* the layer rasters are drawn in device space, so they would not
+	   follow a transformation or clip set by the caller */
+	if (!gerbv_render_target_is_untransformed (cr))
+		return FALSE;
+
+	threadCount = gerbv_get_thread_count ();
+	if (threadCount < 2)
+		return FALSE;
+
+	jobs = g_new0 (gerbv_render_layer_job_t, gerbvProject->last_loaded + 1);
+	finishedQueue = g_async_queue_new ();
+	for(i = gerbvProject->last_loaded; i >= 0; i--) {
+		if (gerbvProject->file[i] && gerbvProject->file[i]->isVisible) {
+			jobs[jobCount].fileInfo = gerbvProject->file[i];
+			jobs[jobCount].renderInfo = renderInfo;
+			jobs[jobCount].finishedQueue = finishedQueue;
+			jobCount++;
+		}
+	}
+	if (jobCount < 2) {
+		g_async_queue_unref (finishedQueue);
+		g_free (jobs);
+		return FALSE;
+	}
+
+	/* limit the number of layer rasters held at once */
+	layerBytes = (gsize) renderInfo->displayWidth * renderInfo->displayHeight * 4;
+	maxPending = CLAMP (GERBV_RENDER_THREADED_MAX_BYTES / layerBytes,
+				1, 2 * threadCount);
+	threadCount = MIN (threadCount, MIN (maxPending, jobCount));
+
+	pool = g_thread_pool_new (gerbv_render_layer_job, NULL, threadCount,
+				TRUE, NULL);
+	if (!pool) {
+		g_async_queue_unref (finishedQueue);
+		g_free (jobs);
+		return FALSE;
+	}
+
+	for (nextJob = 0; nextJob < MIN (maxPending, jobCount); nextJob++)
+		g_thread_pool_push (pool, &jobs[nextJob], NULL);
+
+	for (i = 0; i < jobCount; i++) {
+		/* wait for the next layer in z-order */
+		while (!jobs[i].finished) {
+			job = g_async_queue_pop (finishedQueue);
+			job->finished = TRUE;
+		}
+
+		cairo_save (cr);
+		cairo_identity_matrix (cr);
+		cairo_set_source_surface (cr, jobs[i].surface, 0, 0);
+		cairo_paint_with_alpha (cr,
+			(double) jobs[i].fileInfo->alpha/G_MAXUINT16);
+		cairo_restore (cr);
+		cairo_surface_destroy (jobs[i].surface);
+		jobs[i].surface = NULL;
+
+		if (nextJob < jobCount)
+			g_thread_pool_push (pool, &jobs[nextJob++], NULL);
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_async_queue_unref (finishedQueue);
+	g_free (jobs);
+
+	return TRUE;
+}
+
 /* ------------------------------------------------------------------ */
 void
 gerbv_render_all_layers_to_cairo_target (gerbv_project_t *gerbvProject, cairo_t *cr,
@@ -863,6 +1185,10 @@ gerbv_render_all_layers_to_cairo_target (gerbv_project_t *gerbvProject, cairo_t
 		(double) gerbvProject->background.green/G_MAXUINT16,
 		(double) gerbvProject->background.blue/G_MAXUINT16, 1);
 	cairo_paint (cr);
+
+	if (gerbv_render_all_layers_threaded (gerbvProject, cr, renderInfo))
+		return;
+
 	for(i = gerbvProject->last_loaded; i >= 0; i--) {
 		if (gerbvProject->file[i] && gerbvProject->file[i]->isVisible) {
 			cairo_push_group (cr);
@@ -83,7 +83,6 @@ extern "C" {
 #endif
 
 #define APERTURE_MIN 10
-#define APERTURE_MAX 9999
 
 /*
  * Maximum number of aperture parameters is set by the outline aperture
@@ -548,6 +547,7 @@ typedef struct {
 	gdouble upperRightX;
 	gdouble upperRightY;
 	GArray *selectedNodeArray;
+	GHashTable *selectedNodeIndexes; /*!< private map from the selected nets to their index in selectedNodeArray, see selection.c */
 } gerbv_selection_info_t;
 
 /*!  Stores image transformation information, used to modify the rendered
@@ -637,6 +637,10 @@ typedef struct gerbv_net {
     gerbv_netstate_t *state; /*!< the RS274X state this net belongs to */
 } gerbv_net_t;
 
+/*! Sparse table of the apertures of an image by aperture number, only
+ *  accessed through gerbv_image_get_aperture() and friends */
+typedef struct gerbv_aperture_table gerbv_aperture_table_t;
+
 /*! Struct holding info about interpreting the Gerber files read
  *  e.g. leading zeros, etc.  */
 typedef struct gerbv_format {
@@ -688,7 +692,7 @@ typedef struct gerbv_image_info {
 /*!  The structure used to hold a layer (RS274X, drill, or pick-and-place data) */
 typedef struct {
   gerbv_layertype_t layertype; /*!< the type of layer (RS274X, drill, or pick-and-place) */
-  gerbv_aperture_t *aperture[APERTURE_MAX]; /*!< an array with all apertures used */
+  gerbv_aperture_table_t *apertures; /*!< all apertures used, see gerbv_image_get_aperture() */
   gerbv_layer_t *layers; /*!< an array of all RS274X layers used (only used in RS274X types) */
   gerbv_netstate_t *states; /*!< an array of all RS274X states used (only used in RS274X types) */
   gerbv_amacro_t *amacro; /*!< an array of all macros used (only used in RS274X types) */
@@ -697,6 +701,17 @@ typedef struct {
   gerbv_net_t *netlist; /*!< an array of all geometric entities in the layer */
   gerbv_stats_t *gerbv_stats; /*!< RS274X statistics for the layer */
   gerbv_drill_stats_t *drill_stats;  /*!< Excellon drill statistics for the layer */
+  gpointer netIndex; /*!< private spatial index over the netlist, built on demand by the renderers */
+  gpointer arena; /*!< private storage for the nets, arc segments, layers and netstates of this image */
+  gpointer flashStamps; /*!< private cache of rasterized aperture flashes, see flash_stamp.c */
+  gpointer apertureIndex; /*!< private index of the apertures by content, see aperture_index.c */
+  gpointer layerStats; /*!< private cache of the statistics report of the layer, see layer_stats.c */
+  gerbv_net_t *lastNet; /*!< the last net of netlist, or NULL if not known yet, see gerbv_image_get_last_net() */
+  gerbv_layer_t *lastLayer; /*!< the last layer of layers, or NULL if not known yet */
+  gerbv_netstate_t *lastState; /*!< the last netstate of states, or NULL if not known yet */
+  gint netCount; /*!< the number of nets up to lastNet */
+  gint layerCount; /*!< the number of layers up to lastLayer */
+  gint stateCount; /*!< the number of netstates up to lastState */
 } gerbv_image_t;
 
 /*!  Holds information related to an individual layer that is part of a project */
@@ -734,6 +749,24 @@ typedef struct {
   gchar *project;     /*!< the default name for the private project file */
 } gerbv_project_t;
 
+/*! The private state of a RS274X parse.  Threads parsing files at the
+same time must each use their own context */
+typedef struct gerb_state gerbv_rs274x_context_t;
+
+/*! Receives the nets of a streamed RS274X file in file order.  The net,
+and the rest of a polygon starting with it, is freed once the callback
+returns; its layer, netstate and aperture stay valid in image */
+typedef void (*gerbv_net_func_t) (gerbv_image_t *image, gerbv_net_t *net,
+		gpointer userData);
+
+/*! One file to be loaded by gerbv_open_layers_from_filenames() */
+typedef struct {
+  gchar *filename; /*!< the full pathname of the file to be parsed */
+  gerbv_HID_Attribute *attr_list; /*!< the file format attributes, or NULL */
+  int n_attr; /*!< the number of entries in attr_list */
+  gint fileIndex; /*!< set to the index of the new layer, or -1 if the file could not be loaded */
+} gerbv_layer_file_t;
+
 /*! Color of layer */
 typedef struct{
     unsigned char red;
@@ -752,6 +785,7 @@ typedef struct {
 	gint displayWidth; /*!< the width of the scene (in pixels, or points depending on the surface type) */
 	gint displayHeight; /*!< the height of the scene (in pixels, or points depending on the surface type) */
 	gboolean show_cross_on_drill_holes; /*!< TRUE to show cross on drill holes */
+	gboolean allowCoarseNets; /*!< TRUE to draw nets smaller than a pixel as cells of a coarse raster, for interactive views only */
 } gerbv_render_info_t;
 
 //! Allocate a new gerbv_image structure
@@ -778,11 +812,26 @@ gerbv_image_duplicate_image (gerbv_image_t *sourceImage, /*!< the source image *
 	gerbv_user_transformation_t *transform /*!< the transformation to apply to the new image, or NULL for none */
 );
 
-//! Delete a net in an existing image
+//! Merge several images into a new one, copying their nets on several threads.
+//! Gives the same image as duplicating the first image and copying the others into it
+//! \return the newly created image, or NULL if count is 0
+gerbv_image_t *
+gerbv_image_merge_images (gerbv_image_t **sourceImages, /*!< the images to merge, in drawing order */
+	gerbv_user_transformation_t **transforms, /*!< the transformation to apply to each image, NULL or a NULL entry for none */
+	gint count /*!< the number of images */
+);
+
+//! Delete a net in an existing image.  Every image rebuilds its net index, prefer gerbv_image_delete_net_from_image()
 void
 gerbv_image_delete_net (gerbv_net_t *currentNet /*!< the net to delete */
 );
 
+//! Delete a net of image, only rebuilding the net index of image
+void
+gerbv_image_delete_net_from_image (gerbv_image_t *image, /*!< the image holding the net */
+		gerbv_net_t *currentNet /*!< the net to delete */
+);
+
 gboolean
 gerbv_image_reduce_area_of_selected_objects (GArray *selectionArray, gdouble areaReduction, gint paneRows,
 		gint paneColumns, gdouble paneSeparation);
@@ -821,6 +870,21 @@ gerbv_open_layer_from_filename_with_color(gerbv_project_t *gerbvProject, /*!< th
 	guint16 alpha /*!< the value for the alpha color component */
 );
 
+//! Open several files, parse them in parallel, and add them as new layers to an existing project in the given order
+gint
+gerbv_open_layers_from_filenames (
+	gerbv_project_t *gerbvProject, /*!< the existing project to add the new layers to */
+	gerbv_layer_file_t *layerFiles, /*!< the files to load, in layer order */
+	gint count /*!< the number of entries in layerFiles */
+);
+
+//! Keep the parsed RS274X images in an on-disk cache, so opening the same files again skips the parsing.  The cache is off until this is called
+void
+gerbv_set_image_cache (
+	const gchar *directory, /*!< the directory of the cache files, or NULL to turn the cache off */
+	guint64 maxSize /*!< the size in bytes the cache is trimmed to by removing the least recently used files, or 0 for no limit */
+);
+
 //! Free a fileinfo structure
 void
 gerbv_destroy_fileinfo (gerbv_fileinfo_t *fileInfo /*!< the fileinfo to free */
@@ -967,6 +1031,35 @@ gerbv_image_t *
 gerbv_create_rs274x_image_from_filename (gchar *filename /*!< the filename of the file to be parsed*/
 );
 
+//! Create a new RS274X parser context
+gerbv_rs274x_context_t *
+gerbv_rs274x_context_new (void);
+
+//! Free a RS274X parser context
+void
+gerbv_rs274x_context_destroy (gerbv_rs274x_context_t *context /*!< the context to free */
+);
+
+//! Parse a RS274X file using the given parser context and return the parsed image
+//! \return the new gerbv_image_t, or NULL if not successful
+gerbv_image_t *
+gerbv_create_rs274x_image_from_filename_with_context (
+		gerbv_rs274x_context_t *context, /*!< the parser context, which may not be used by another thread at the same time */
+		gchar *filename /*!< the filename of the file to be parsed*/
+);
+
+//! Parse a RS274X file, passing every net to netFunc as it is parsed instead of
+//! storing it.  Memory use does not grow with the number of nets.
+//! \return the new gerbv_image_t without any nets but with its apertures,
+//! layers, netstates, statistics and bounding box, or NULL if not successful
+gerbv_image_t *
+gerbv_stream_rs274x_image_from_filename (
+		gerbv_rs274x_context_t *context, /*!< the parser context, which may not be used by another thread at the same time */
+		gchar *filename, /*!< the filename of the file to be parsed*/
+		gerbv_net_func_t netFunc, /*!< called for every parsed net */
+		gpointer userData /*!< passed to netFunc */
+);
+
 //! Export an image to a new file in RS274X format
 //! \return TRUE if successful, or FALSE if not
 gboolean
@@ -1023,6 +1116,65 @@ gerbv_image_create_rectangle_object (gerbv_image_t *image, /*!< the image to dra
 		gdouble height /*!< the height of the drawn rectangle */
 );
 
+//! Look up an aperture of an image by its number (D code or tool)
+//! \return the aperture, or NULL if the image has none with that number
+gerbv_aperture_t *
+gerbv_image_get_aperture (const gerbv_image_t *image, /*!< the image to search */
+		gint number /*!< the aperture number */
+);
+
+//! Store an aperture in an image, replacing (but not freeing) any aperture
+//! with the same number.  The image takes ownership of the aperture.
+void
+gerbv_image_set_aperture (gerbv_image_t *image, /*!< the image to change */
+		gint number, /*!< the aperture number, 0 or greater */
+		gerbv_aperture_t *aperture /*!< the aperture, or NULL to remove it */
+);
+
+//! Return the number of apertures in an image
+gint
+gerbv_image_get_aperture_count (const gerbv_image_t *image /*!< the image */
+);
+
+//! Step through the apertures of an image in order of their numbers
+//! \return the aperture, or NULL if index is out of range
+gerbv_aperture_t *
+gerbv_image_get_nth_aperture (const gerbv_image_t *image, /*!< the image */
+		gint index, /*!< from 0 to gerbv_image_get_aperture_count() - 1 */
+		gint *number /*!< receives the number of the aperture, or NULL */
+);
+
+//! Return the last net of an image, for appending to the netlist.
+//! Nets linked in without going through the image are picked up as well
+gerbv_net_t *
+gerbv_image_get_last_net (gerbv_image_t *image /*!< the image */
+);
+
+//! Return the last layer of an image
+gerbv_layer_t *
+gerbv_image_get_last_layer (gerbv_image_t *image /*!< the image */
+);
+
+//! Return the last netstate of an image
+gerbv_netstate_t *
+gerbv_image_get_last_state (gerbv_image_t *image /*!< the image */
+);
+
+//! Return the number of nets of an image, including the empty first one
+gint
+gerbv_image_get_net_count (gerbv_image_t *image /*!< the image */
+);
+
+//! Return the number of layers of an image
+gint
+gerbv_image_get_layer_count (gerbv_image_t *image /*!< the image */
+);
+
+//! Return the number of netstates of an image
+gint
+gerbv_image_get_state_count (gerbv_image_t *image /*!< the image */
+);
+
 //! Create any missing apertures in the specified image
 void
 gerbv_image_create_dummy_apertures (gerbv_image_t *parsed_image /*!< the image to repair */
@@ -1044,6 +1196,20 @@ gerbv_drill_stats_add_layer(gerbv_drill_stats_t *accum_stats,
 		int this_layer
 );
 
+/*! Add drill stats accumulated over other layers to accum_stats */
+void
+gerbv_drill_stats_merge(gerbv_drill_stats_t *accum_stats,
+		gerbv_drill_stats_t *input_stats
+);
+
+/*! Create drill stats accumulated over the specified layers.  The stats
+ *  of each layer are kept on its image for the next report */
+gerbv_drill_stats_t *
+gerbv_drill_stats_new_from_images(gerbv_image_t **images, /*!< the images of the layers */
+		gint *layers, /*!< the layer number of each image */
+		gint count /*!< the number of images */
+);
+
 /*! Create new struct for holding Gerber stats */
 gerbv_stats_t *
 gerbv_stats_new(void);
@@ -1060,6 +1226,20 @@ gerbv_stats_add_layer(gerbv_stats_t *accum_stats,
 		int this_layer
 );
 
+/*! Add Gerber stats accumulated over other layers to accum_stats */
+void
+gerbv_stats_merge(gerbv_stats_t *accum_stats,
+		gerbv_stats_t *input_stats
+);
+
+/*! Create Gerber stats accumulated over the specified layers.  The stats
+ *  of each layer are kept on its image for the next report */
+gerbv_stats_t *
+gerbv_stats_new_from_images(gerbv_image_t **images, /*!< the images of the layers */
+		gint *layers, /*!< the layer number of each image */
+		gint count /*!< the number of images */
+);
+
 void
 gerbv_attribute_destroy_HID_attribute (gerbv_HID_Attribute *attributeList, int n_attr);
 
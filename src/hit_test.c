@@ -0,0 +1,523 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * hit_test.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file hit_test.c
+    \brief Geometric hit testing of point clicks and drag boxes against nets
+    \ingroup libgerbv
+
+    Selecting used to replay the whole image into a Cairo context and ask
+    Cairo whether each path contained the click.  Here the candidates come
+    from the spatial index (see net_index.c) and each one is tested
+    directly against its geometry: lines are swept apertures, arcs are
+    circles with a width, flashes are the aperture shapes and polygons are
+    tested with an even-odd crossing count over their flattened outline.
+
+    Three coordinate systems are involved: the world coordinates of the
+    render info, the box coordinates the net bounding boxes are stored in
+    (world coordinates before the user transformation and the image
+    justification) and the net coordinates of the net geometry itself
+    (box coordinates before the image, layer and netstate transformations,
+    see gerber.c).
+*/
+
+#include "gerbv.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "common.h"
+#include "hit_test.h"
+#include "net_index.h"
+#include "selection.h"
+
+#define dprintf if(DEBUG) printf
+
+typedef struct {
+	gerbv_image_t *image;
+	gerbv_selection_info_t *selectionInfo;
+	gboolean toggle;
+	cairo_matrix_t boxToWorld;
+	gdouble x, y;			/* point click, in box coordinates */
+	gdouble tolerance;		/* half a pixel, in box coordinates */
+	gdouble minX, minY, maxX, maxY;	/* drag box, in world coordinates */
+} hit_test_t;
+
+static void
+hit_test_screen_to_world (gerbv_render_info_t *renderInfo,
+		gdouble *x, gdouble *y)
+{
+	/* the inverse of gerbv_render_cairo_set_scale_and_translation() */
+	*x = renderInfo->lowerLeftX + *x / renderInfo->scaleFactorX;
+	*y = renderInfo->lowerLeftY +
+		(renderInfo->displayHeight - *y) / renderInfo->scaleFactorY;
+}
+
+static gdouble
+hit_test_segment_distance (gdouble x, gdouble y,
+		gdouble x1, gdouble y1, gdouble x2, gdouble y2)
+{
+	gdouble dx = x2 - x1, dy = y2 - y1;
+	gdouble length2 = dx*dx + dy*dy;
+	gdouble t = 0;
+
+	if (length2 > 0)
+		t = CLAMP (((x - x1)*dx + (y - y1)*dy) / length2, 0, 1);
+
+	return hypot (x - (x1 + t*dx), y - (y1 + t*dy));
+}
+
+/* Narrows [*t1, *t2] to the positions t of a line x1 + t*dx for which
+   the point x is less than halfWidth away */
+static void
+hit_test_clip_sweep (gdouble x, gdouble x1, gdouble dx, gdouble halfWidth,
+		gdouble *t1, gdouble *t2)
+{
+	gdouble a, b;
+
+	if (dx == 0) {
+		if (fabs (x - x1) > halfWidth)
+			*t2 = -1;
+		return;
+	}
+	a = (x - x1 - halfWidth) / dx;
+	b = (x - x1 + halfWidth) / dx;
+	*t1 = MAX (*t1, MIN (a, b));
+	*t2 = MIN (*t2, MAX (a, b));
+}
+
+/* A line drawn with a rectangular aperture covers every position of the
+   rectangle moved from the start to the end point */
+static gboolean
+hit_test_swept_rectangle (gdouble x, gdouble y,
+		gdouble x1, gdouble y1, gdouble x2, gdouble y2,
+		gdouble halfWidth, gdouble halfHeight)
+{
+	gdouble t1 = 0, t2 = 1;
+
+	hit_test_clip_sweep (x, x1, x2 - x1, halfWidth, &t1, &t2);
+	hit_test_clip_sweep (y, y1, y2 - y1, halfHeight, &t1, &t2);
+
+	return t1 <= t2;
+}
+
+static gboolean
+hit_test_angle_in_arc (gdouble angle, gdouble angle1, gdouble angle2)
+{
+	gdouble low = MIN (angle1, angle2), high = MAX (angle1, angle2);
+
+	if (high - low >= 360)
+		return TRUE;
+	angle -= 360 * floor ((angle - low) / 360);
+
+	return angle <= high;
+}
+
+static gdouble
+hit_test_arc_distance (gdouble x, gdouble y,
+		gdouble cpX, gdouble cpY, gerbv_cirseg_t *cirseg)
+{
+	/* elliptical arcs are measured as circles of the mean radius */
+	gdouble radius = (cirseg->width + cirseg->height) / 4.0;
+	gdouble angle = RAD2DEG (atan2 (y - cpY, x - cpX));
+	gdouble a1 = DEG2RAD (cirseg->angle1), a2 = DEG2RAD (cirseg->angle2);
+
+	if (hit_test_angle_in_arc (angle, cirseg->angle1, cirseg->angle2))
+		return fabs (hypot (x - cpX, y - cpY) - radius);
+
+	return MIN (hypot (x - cpX - radius*cos (a1), y - cpY - radius*sin (a1)),
+		hypot (x - cpX - radius*cos (a2), y - cpY - radius*sin (a2)));
+}
+
+/* Returns TRUE if x, y is inside the aperture hole of the given size */
+static gboolean
+hit_test_in_hole (gdouble x, gdouble y, gdouble dimensionX, gdouble dimensionY)
+{
+	if (!dimensionX)
+		return FALSE;
+	if (dimensionY)
+		return (fabs (x) < dimensionX/2.0) && (fabs (y) < dimensionY/2.0);
+
+	return hypot (x, y) < dimensionX/2.0;
+}
+
+static gboolean
+hit_test_regular_polygon (gdouble x, gdouble y, gdouble outsideDiameter,
+		gint sides, gdouble degreesOfRotation, gdouble tolerance)
+{
+	gdouble sector, angle, normal;
+
+	if (sides < 3)
+		return FALSE;
+
+	/* the point is inside if it is behind the edge facing it */
+	sector = 2.0*M_PI / sides;
+	angle = atan2 (y, x) - DEG2RAD (degreesOfRotation);
+	angle -= 2.0*M_PI * floor (angle / (2.0*M_PI));
+	normal = DEG2RAD (degreesOfRotation) + (floor (angle / sector) + 0.5)*sector;
+
+	return x*cos (normal) + y*sin (normal) <=
+		outsideDiameter/2.0 * cos (sector/2.0) + tolerance;
+}
+
+/* Tests a flash at the origin, see the flash shapes in draw.c */
+static gboolean
+hit_test_flash (gdouble x, gdouble y, gerbv_aperture_t *aperture,
+		gdouble tolerance)
+{
+	gdouble *p = aperture->parameter;
+	gdouble radius, stroke;
+
+	switch (aperture->type) {
+	case GERBV_APTYPE_CIRCLE :
+		return (hypot (x, y) <= p[0]/2.0 + tolerance)
+			&& !hit_test_in_hole (x, y, p[1], p[2]);
+	case GERBV_APTYPE_RECTANGLE :
+		return (fabs (x) <= p[0]/2.0 + tolerance)
+			&& (fabs (y) <= p[1]/2.0 + tolerance)
+			&& !hit_test_in_hole (x, y, p[2], p[3]);
+	case GERBV_APTYPE_OVAL :
+		radius = MIN (p[0], p[1]) / 2.0;
+		stroke = fabs (p[0] - p[1]) / 2.0;
+		if (p[0] < p[1])
+			return (hit_test_segment_distance (x, y,
+					0, -stroke, 0, stroke) <= radius + tolerance)
+				&& !hit_test_in_hole (x, y, p[2], p[3]);
+		return (hit_test_segment_distance (x, y,
+				-stroke, 0, stroke, 0) <= radius + tolerance)
+			&& !hit_test_in_hole (x, y, p[2], p[3]);
+	case GERBV_APTYPE_POLYGON :
+		return hit_test_regular_polygon (x, y, p[0], (gint) p[1], p[2],
+				tolerance)
+			&& !hit_test_in_hole (x, y, p[3], p[4]);
+	default :
+		return FALSE;
+	}
+}
+
+/* Flips *inside if the edge crosses the ray from x, y towards +x */
+static void
+hit_test_crossing (gboolean *inside, gdouble x, gdouble y,
+		gdouble x1, gdouble y1, gdouble x2, gdouble y2)
+{
+	if (((y1 > y) != (y2 > y))
+	 && (x < x1 + (y - y1) * (x2 - x1) / (y2 - y1)))
+		*inside = !*inside;
+}
+
+/* Tests the flattened outline of a polygon area */
+static gboolean
+hit_test_polygon (gdouble x, gdouble y, const net_index_polygon_t *polygon)
+{
+	const gdouble *p = polygon->points;
+	gboolean inside = FALSE;
+	guint i, j;
+
+	if ((polygon->count == 0)
+	 || (x < polygon->box.left) || (x > polygon->box.right)
+	 || (y < polygon->box.bottom) || (y > polygon->box.top))
+		return FALSE;
+
+	for (i = 0, j = polygon->count - 1; i < polygon->count; j = i++)
+		hit_test_crossing (&inside, x, y, p[2*j], p[2*j + 1],
+				p[2*i], p[2*i + 1]);
+
+	return inside;
+}
+
+/* Tests one row at x, y in net coordinates (step and repeat already
+   removed) */
+static gboolean
+hit_test_row_at (gerbv_image_t *image, const net_index_rows_t *rows,
+		guint row, gdouble x, gdouble y, gdouble tolerance)
+{
+	gerbv_net_t *net = rows->nets[row];
+	gerbv_aperture_t *aperture =
+		gerbv_image_get_aperture (image, rows->apertures[row]);
+	gdouble halfWidth;
+
+	if (rows->interpolations[row] == GERBV_INTERPOLATION_PAREA_START)
+		return hit_test_polygon (x, y, rows->polygons[row]);
+	if (aperture == NULL)
+		return FALSE;
+
+	switch (rows->apertureStates[row]) {
+	case GERBV_APERTURE_STATE_ON :
+		halfWidth = aperture->parameter[0]/2.0;
+
+		switch (rows->interpolations[row]) {
+		case GERBV_INTERPOLATION_x10 :
+		case GERBV_INTERPOLATION_LINEARx01 :
+		case GERBV_INTERPOLATION_LINEARx001 :
+		case GERBV_INTERPOLATION_LINEARx1 :
+			switch (aperture->type) {
+			case GERBV_APTYPE_CIRCLE :
+			case GERBV_APTYPE_OVAL :
+			case GERBV_APTYPE_POLYGON :
+				return hit_test_segment_distance (x, y,
+						rows->startX[row], rows->startY[row],
+						rows->stopX[row], rows->stopY[row])
+					<= halfWidth + tolerance;
+			case GERBV_APTYPE_RECTANGLE :
+				return hit_test_swept_rectangle (x, y,
+						rows->startX[row], rows->startY[row],
+						rows->stopX[row], rows->stopY[row],
+						halfWidth + tolerance,
+						aperture->parameter[1]/2.0 + tolerance);
+			default :
+				return FALSE;
+			}
+		case GERBV_INTERPOLATION_CW_CIRCULAR :
+		case GERBV_INTERPOLATION_CCW_CIRCULAR :
+			return hit_test_arc_distance (x, y,
+					net->cirseg->cp_x, net->cirseg->cp_y,
+					net->cirseg) <= halfWidth + tolerance;
+		default :
+			return FALSE;
+		}
+	case GERBV_APERTURE_STATE_FLASH :
+		return hit_test_flash (x - rows->stopX[row], y - rows->stopY[row],
+				aperture, tolerance);
+	default :
+		return FALSE;
+	}
+}
+
+static gboolean
+hit_test_box_contains (const gerbv_render_size_t *box,
+		gdouble x, gdouble y, gdouble tolerance)
+{
+	return (x >= box->left - tolerance) && (x <= box->right + tolerance)
+		&& (y >= box->bottom - tolerance) && (y <= box->top + tolerance);
+}
+
+/* Returns TRUE if the box, moved by dx, dy, lies strictly inside the
+   drag box */
+static gboolean
+hit_test_box_in_drag_box (hit_test_t *hit, const gerbv_render_size_t *box,
+		gdouble dx, gdouble dy)
+{
+	gdouble cornerX[4] = {box->left, box->left, box->right, box->right};
+	gdouble cornerY[4] = {box->bottom, box->top, box->bottom, box->top};
+	gint i;
+
+	for (i = 0; i < 4; i++) {
+		gdouble x = cornerX[i] + dx, y = cornerY[i] + dy;
+
+		cairo_matrix_transform_point (&hit->boxToWorld, &x, &y);
+		if ((x <= hit->minX) || (x >= hit->maxX)
+		 || (y <= hit->minY) || (y >= hit->maxY))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+hit_test_select (hit_test_t *hit, gerbv_net_t *net)
+{
+	gerbv_selection_item_t sItem = {hit->image, net};
+
+	if (!selection_contains_item (hit->selectionInfo, &sItem))
+		selection_add_item (hit->selectionInfo, &sItem);
+	else if (hit->toggle)
+		selection_remove_item (hit->selectionInfo, &sItem);
+}
+
+void
+hit_test_fill_selection (gerbv_image_t *image,
+		gerbv_selection_info_t *selectionInfo,
+		gerbv_render_info_t *renderInfo,
+		gerbv_user_transformation_t transform, gboolean toggle)
+{
+	hit_test_t hit;
+	cairo_matrix_t worldToBox, boxToNet;
+	const net_index_rows_t *rows;
+	net_index_t *netIndex;
+	gerbv_layer_t *layer = NULL;
+	gerbv_netstate_t *state = NULL;
+	gdouble scaleX = transform.scaleX, scaleY = transform.scaleY;
+	gdouble minX, minY, maxX, maxY, x, y, dx, dy, netTolerance = 0;
+	gdouble netX = 0, netY = 0;
+	GArray *found;
+	guint i, row;
+	gint ix, iy;
+
+	if (image == NULL || image->netlist == NULL)
+		return;
+
+	hit.image = image;
+	hit.selectionInfo = selectionInfo;
+	hit.toggle = toggle;
+
+	/* the user transformation and justification, in the order
+	   draw_image_to_cairo_target() applies them */
+	if (transform.mirrorAroundX)
+		scaleY *= -1;
+	if (transform.mirrorAroundY)
+		scaleX *= -1;
+	cairo_matrix_init_identity (&hit.boxToWorld);
+	cairo_matrix_translate (&hit.boxToWorld,
+			transform.translateX, transform.translateY);
+	cairo_matrix_scale (&hit.boxToWorld, scaleX, scaleY);
+	cairo_matrix_rotate (&hit.boxToWorld, transform.rotation);
+	cairo_matrix_translate (&hit.boxToWorld,
+			image->info->imageJustifyOffsetActualA,
+			image->info->imageJustifyOffsetActualB);
+	worldToBox = hit.boxToWorld;
+	if (cairo_matrix_invert (&worldToBox) != CAIRO_STATUS_SUCCESS)
+		return;
+
+	switch (selectionInfo->type) {
+	case GERBV_SELECTION_POINT_CLICK:
+		hit.x = selectionInfo->lowerLeftX;
+		hit.y = selectionInfo->lowerLeftY;
+		hit_test_screen_to_world (renderInfo, &hit.x, &hit.y);
+		cairo_matrix_transform_point (&worldToBox, &hit.x, &hit.y);
+
+		/* allow half a pixel around the nets, so hairlines drawn one
+		   pixel wide can still be clicked */
+		dx = 0.5 / MAX (renderInfo->scaleFactorX, renderInfo->scaleFactorY);
+		dy = 0;
+		cairo_matrix_transform_distance (&worldToBox, &dx, &dy);
+		hit.tolerance = hypot (dx, dy);
+
+		minX = hit.x - hit.tolerance;
+		maxX = hit.x + hit.tolerance;
+		minY = hit.y - hit.tolerance;
+		maxY = hit.y + hit.tolerance;
+		break;
+	case GERBV_SELECTION_DRAG_BOX:
+		hit.minX = selectionInfo->lowerLeftX;
+		hit.maxY = selectionInfo->lowerLeftY;
+		hit.maxX = selectionInfo->upperRightX;
+		hit.minY = selectionInfo->upperRightY;
+		hit_test_screen_to_world (renderInfo, &hit.minX, &hit.maxY);
+		hit_test_screen_to_world (renderInfo, &hit.maxX, &hit.minY);
+
+		/* the drag box may be rotated in box coordinates, so query
+		   the bounds of all its corners */
+		minX = minY = HUGE_VAL;
+		maxX = maxY = -HUGE_VAL;
+		for (i = 0; i < 4; i++) {
+			x = (i & 1) ? hit.maxX : hit.minX;
+			y = (i & 2) ? hit.maxY : hit.minY;
+			cairo_matrix_transform_point (&worldToBox, &x, &y);
+			minX = MIN (minX, x);
+			maxX = MAX (maxX, x);
+			minY = MIN (minY, y);
+			maxY = MAX (maxY, y);
+		}
+		break;
+	default:
+		return;
+	}
+
+	netIndex = net_index_get (image);
+	rows = net_index_get_rows (netIndex);
+	found = net_index_query (netIndex, minX, minY, maxX, maxY);
+	dprintf ("hit test: %u candidates of %u nets\n", found->len, rows->count);
+
+	for (i = 0; i < found->len; i++) {
+		gerbv_net_t *net;
+		gerbv_step_and_repeat_t noRepeat = {1, 1, 0.0, 0.0};
+		gerbv_step_and_repeat_t *sr = &noRepeat;
+		gboolean isHit = FALSE;
+
+		row = g_array_index (found, guint, i);
+		net = rows->nets[row];
+
+		if (rows->interpolations[row] == GERBV_INTERPOLATION_DELETED)
+			continue;
+		if ((rows->interpolations[row] != GERBV_INTERPOLATION_PAREA_START)
+		 && (rows->apertureStates[row] == GERBV_APERTURE_STATE_OFF))
+			continue;
+		if (rows->flags[row] & NET_INDEX_ROW_STEP_AND_REPEAT)
+			sr = &net->layer->stepAndRepeat;
+
+		if (selectionInfo->type == GERBV_SELECTION_DRAG_BOX) {
+			for (ix = 0; ix < sr->X && !isHit; ix++) {
+				for (iy = 0; iy < sr->Y && !isHit; iy++) {
+					isHit = hit_test_box_in_drag_box (&hit,
+						&net->boundingBox,
+						ix * sr->dist_X, iy * sr->dist_Y);
+				}
+			}
+			if (isHit)
+				hit_test_select (&hit, net);
+			continue;
+		}
+
+		if (!hit_test_box_contains (&rows->boxes[row],
+				hit.x, hit.y, hit.tolerance))
+			continue;
+
+		/* macros are tested against their bounding box, which
+		   gerber.c already measures from the macro primitives */
+		if ((rows->apertureStates[row] == GERBV_APERTURE_STATE_FLASH)
+		 && (gerbv_image_get_aperture (image, rows->apertures[row]) != NULL)
+		 && (gerbv_image_get_aperture (image, rows->apertures[row])->type ==
+				GERBV_APTYPE_MACRO)) {
+			for (ix = 0; ix < sr->X && !isHit; ix++) {
+				for (iy = 0; iy < sr->Y && !isHit; iy++) {
+					isHit = hit_test_box_contains (&net->boundingBox,
+						hit.x - ix * sr->dist_X,
+						hit.y - iy * sr->dist_Y,
+						hit.tolerance);
+				}
+			}
+			if (isHit)
+				hit_test_select (&hit, net);
+			continue;
+		}
+
+		/* the rows are in netlist order, so the net transformation
+		   only changes with the layer or netstate */
+		if ((net->layer != layer) || (net->state != state)) {
+			layer = net->layer;
+			state = net->state;
+			net_index_net_to_box (image, layer, state, &boxToNet);
+			if (cairo_matrix_invert (&boxToNet) != CAIRO_STATUS_SUCCESS) {
+				/* a zero scale leaves nothing to hit */
+				layer = NULL;
+				continue;
+			}
+			netX = hit.x;
+			netY = hit.y;
+			cairo_matrix_transform_point (&boxToNet, &netX, &netY);
+			dx = hit.tolerance;
+			dy = 0;
+			cairo_matrix_transform_distance (&boxToNet, &dx, &dy);
+			netTolerance = hypot (dx, dy);
+		}
+
+		for (ix = 0; ix < sr->X && !isHit; ix++) {
+			for (iy = 0; iy < sr->Y && !isHit; iy++) {
+				isHit = hit_test_row_at (image, rows, row,
+					netX - ix * sr->dist_X,
+					netY - iy * sr->dist_Y, netTolerance);
+			}
+		}
+		if (isHit)
+			hit_test_select (&hit, net);
+	}
+
+	g_array_free (found, TRUE);
+	net_index_unref (netIndex);
+}
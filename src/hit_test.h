@@ -0,0 +1,46 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * hit_test.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file hit_test.h
+    \brief Header info for the geometric hit testing of nets
+    \ingroup libgerbv
+*/
+
+#ifndef HIT_TEST_H
+#define HIT_TEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Adds the nets of image hit by the point click or drag box of
+   selectionInfo, given in the screen pixels of renderInfo, to the
+   selection.  Nets which are already selected are removed again if
+   toggle is set */
+void hit_test_fill_selection (gerbv_image_t *image,
+		gerbv_selection_info_t *selectionInfo,
+		gerbv_render_info_t *renderInfo,
+		gerbv_user_transformation_t transform, gboolean toggle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIT_TEST_H */
@@ -0,0 +1,746 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * image_cache.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file image_cache.c
+    \brief On-disk cache of parsed images
+    \ingroup libgerbv
+
+    Parsing a large RS274X file takes far longer than reading its image
+    back from a binary dump, so once gerbv_set_image_cache() named a
+    cache directory, every parsed RS274X image is written there, and
+    opening, reverting or exporting the same file again loads the dump
+    instead.  When the cache grows beyond its size limit, the files used
+    least recently are removed; loading a cache file touches it.
+
+    A cache file is only used if the path, size, modification time and
+    SHA-1 of the source file all still match.  The dump is written in
+    the native byte order and structure layout, so the header also holds
+    the sizes of all dumped structures, and IMAGE_CACHE_VERSION must be
+    bumped whenever one of them changes without changing its size.
+    Aperture macro programs are not stored, only their simplified
+    primitives, just like gerbv_image_duplicate_image() does.
+*/
+
+#include "gerbv.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include "common.h"
+#include "gerb_arena.h"
+#include "gerb_stats.h"
+#include "image_cache.h"
+
+#define dprintf if(DEBUG) printf
+
+#define IMAGE_CACHE_MAGIC "gerbvimg"
+#define IMAGE_CACHE_VERSION 2
+#define IMAGE_CACHE_BYTE_ORDER 0x01020304
+#define IMAGE_CACHE_HASH_SIZE 20	/* SHA-1 */
+#define IMAGE_CACHE_LAYOUT_SIZE 11
+#define IMAGE_CACHE_SUFFIX ".img"
+
+typedef struct {
+	gchar magic[8];
+	guint32 version;
+	guint32 byteOrder;
+	guint32 layout[IMAGE_CACHE_LAYOUT_SIZE];	/* structure sizes */
+	guint64 fileSize;
+	gint64 fileMtime;
+	guint8 fileHash[IMAGE_CACHE_HASH_SIZE];
+} image_cache_header_t;
+
+/* One net, followed by its cirseg and label if the flags say so */
+typedef struct {
+	gdouble startX, startY, stopX, stopY;
+	gerbv_render_size_t boundingBox;
+	gint32 aperture;
+	gint32 apertureState;
+	gint32 interpolation;
+	gint32 layer;		/*!< index into the layers of the image */
+	gint32 state;		/*!< index into the netstates of the image */
+	guint32 flags;
+} image_cache_net_t;
+
+#define IMAGE_CACHE_NET_CIRSEG (1 << 0)
+#define IMAGE_CACHE_NET_LABEL (1 << 1)
+
+typedef struct {
+	const gchar *data;
+	gsize size;
+	gsize position;
+	gboolean failed;
+} image_cache_reader_t;
+
+/* A cache file found while trimming the cache */
+typedef struct {
+	gchar *path;
+	gint64 size;
+	time_t mtime;
+} image_cache_entry_t;
+
+/* The settings of gerbv_set_image_cache(), read by the loader threads */
+G_LOCK_DEFINE_STATIC (imageCache);
+static gchar *imageCacheDir = NULL;
+static guint64 imageCacheMaxSize = 0;
+
+
+/* Returns the cache file name for filename, or NULL if the cache is off */
+static gchar *
+image_cache_get_path (const gchar *filename)
+{
+	gchar *hash, *name, *path = NULL;
+
+	hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, filename, -1);
+	name = g_strconcat (hash, IMAGE_CACHE_SUFFIX, NULL);
+	G_LOCK (imageCache);
+	if (imageCacheDir != NULL)
+		path = g_build_filename (imageCacheDir, name, NULL);
+	G_UNLOCK (imageCache);
+	g_free (name);
+	g_free (hash);
+
+	return path;
+}
+
+
+/* Fills layout with the sizes of the dumped structures, so a cache file
+   written by a build with other structures is never read */
+static void
+image_cache_fill_layout (guint32 *layout)
+{
+	layout[0] = sizeof (gerbv_image_info_t);
+	layout[1] = sizeof (gerbv_format_t);
+	layout[2] = sizeof (gerbv_aperture_t);
+	layout[3] = sizeof (gerbv_simplified_amacro_t);
+	layout[4] = sizeof (gerbv_layer_t);
+	layout[5] = sizeof (gerbv_netstate_t);
+	layout[6] = sizeof (image_cache_net_t);
+	layout[7] = sizeof (gerbv_cirseg_t);
+	layout[8] = sizeof (gerbv_stats_t);
+	layout[9] = sizeof (gerbv_aperture_list_t);
+	layout[10] = sizeof (gerbv_render_size_t);
+}
+
+
+static gboolean
+image_cache_fill_header (image_cache_header_t *header, gerb_file_t *fd)
+{
+	struct stat statinfo;
+	GChecksum *checksum;
+	gsize hashSize = IMAGE_CACHE_HASH_SIZE;
+
+	if (fstat (fd->fileno, &statinfo) < 0)
+		return FALSE;
+
+	memset (header, 0, sizeof (image_cache_header_t));
+	memcpy (header->magic, IMAGE_CACHE_MAGIC, sizeof (header->magic));
+	header->version = IMAGE_CACHE_VERSION;
+	header->byteOrder = IMAGE_CACHE_BYTE_ORDER;
+	image_cache_fill_layout (header->layout);
+	header->fileSize = fd->datalen;
+	header->fileMtime = statinfo.st_mtime;
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA1);
+	g_checksum_update (checksum, (const guchar *) fd->data, fd->datalen);
+	g_checksum_get_digest (checksum, header->fileHash, &hashSize);
+	g_checksum_free (checksum);
+
+	return TRUE;
+}
+
+
+static void
+image_cache_put (GString *out, gconstpointer data, gsize size)
+{
+	g_string_append_len (out, data, size);
+}
+
+
+static void
+image_cache_put_int (GString *out, gint32 value)
+{
+	image_cache_put (out, &value, sizeof (value));
+}
+
+
+/* Strings are stored as their length, or -1 for NULL, and the bytes */
+static void
+image_cache_put_string (GString *out, const gchar *string)
+{
+	gint32 length = (string != NULL) ? strlen (string) : -1;
+
+	image_cache_put_int (out, length);
+	if (length > 0)
+		image_cache_put (out, string, length);
+}
+
+
+static gboolean
+image_cache_get (image_cache_reader_t *reader, gpointer data, gsize size)
+{
+	if (reader->failed || (reader->size - reader->position < size)) {
+		reader->failed = TRUE;
+		memset (data, 0, size);
+		return FALSE;
+	}
+	memcpy (data, reader->data + reader->position, size);
+	reader->position += size;
+
+	return TRUE;
+}
+
+
+static gint32
+image_cache_get_int (image_cache_reader_t *reader)
+{
+	gint32 value;
+
+	image_cache_get (reader, &value, sizeof (value));
+
+	return value;
+}
+
+
+/* Returns a count, which can not be larger than the number of records
+   of recordSize bytes left in the cache file */
+static gint32
+image_cache_get_count (image_cache_reader_t *reader, gsize recordSize)
+{
+	gint32 count = image_cache_get_int (reader);
+
+	if ((count < 0) || ((gsize) count >
+			(reader->size - reader->position) / recordSize)) {
+		reader->failed = TRUE;
+		return 0;
+	}
+
+	return count;
+}
+
+
+static gchar *
+image_cache_get_string (image_cache_reader_t *reader)
+{
+	gint32 length = image_cache_get_int (reader);
+	gchar *string;
+
+	if (reader->failed || (length < 0))
+		return NULL;
+	if ((gsize) length > reader->size - reader->position) {
+		reader->failed = TRUE;
+		return NULL;
+	}
+	string = g_strndup (reader->data + reader->position, length);
+	reader->position += length;
+
+	return string;
+}
+
+
+static void
+image_cache_put_aperture_list (GString *out, gerbv_aperture_list_t *list)
+{
+	gerbv_aperture_list_t *item;
+	gint32 count = 0;
+
+	for (item = list; item != NULL; item = item->next)
+		count++;
+	image_cache_put_int (out, count);
+	for (item = list; item != NULL; item = item->next)
+		image_cache_put (out, item, sizeof (gerbv_aperture_list_t));
+}
+
+
+static gerbv_aperture_list_t *
+image_cache_get_aperture_list (image_cache_reader_t *reader)
+{
+	gerbv_aperture_list_t *list = NULL, **last = &list;
+	gint32 i, count;
+
+	count = image_cache_get_count (reader, sizeof (gerbv_aperture_list_t));
+	for (i = 0; i < count; i++) {
+		*last = g_new (gerbv_aperture_list_t, 1);
+		image_cache_get (reader, *last, sizeof (gerbv_aperture_list_t));
+		(*last)->next = NULL;
+		last = &(*last)->next;
+	}
+
+	/* the statistics expect at least the empty head of the list */
+	if (list == NULL)
+		list = gerbv_stats_new_aperture_list ();
+
+	return list;
+}
+
+
+static void
+image_cache_put_stats (GString *out, gerbv_stats_t *stats)
+{
+	gerbv_error_list_t *error;
+	gint32 count = 0;
+
+	image_cache_put_int (out, stats != NULL);
+	if (stats == NULL)
+		return;
+
+	image_cache_put (out, stats, sizeof (gerbv_stats_t));
+
+	for (error = stats->error_list; error != NULL; error = error->next)
+		count++;
+	image_cache_put_int (out, count);
+	for (error = stats->error_list; error != NULL; error = error->next) {
+		image_cache_put_int (out, error->layer);
+		image_cache_put_int (out, error->type);
+		image_cache_put_string (out, error->error_text);
+	}
+
+	image_cache_put_aperture_list (out, stats->aperture_list);
+	image_cache_put_aperture_list (out, stats->D_code_list);
+}
+
+
+static gerbv_stats_t *
+image_cache_get_stats (image_cache_reader_t *reader)
+{
+	gerbv_stats_t *stats;
+	gerbv_error_list_t **lastError;
+	gint32 i, count;
+
+	if (!image_cache_get_int (reader))
+		return NULL;
+
+	stats = g_new (gerbv_stats_t, 1);
+	image_cache_get (reader, stats, sizeof (gerbv_stats_t));
+	stats->error_list = NULL;
+
+	lastError = &stats->error_list;
+	count = image_cache_get_count (reader, 3 * sizeof (gint32));
+	for (i = 0; i < count; i++) {
+		*lastError = g_new0 (gerbv_error_list_t, 1);
+		(*lastError)->layer = image_cache_get_int (reader);
+		(*lastError)->type = image_cache_get_int (reader);
+		(*lastError)->error_text = image_cache_get_string (reader);
+		lastError = &(*lastError)->next;
+	}
+	if (stats->error_list == NULL)
+		stats->error_list = gerbv_stats_new_error_list ();
+
+	stats->aperture_list = image_cache_get_aperture_list (reader);
+	stats->D_code_list = image_cache_get_aperture_list (reader);
+
+	return stats;
+}
+
+
+static GString *
+image_cache_write_image (gerbv_image_t *image)
+{
+	GString *out = g_string_sized_new (4096);
+	GHashTable *layerIndexes, *stateIndexes;
+	gerbv_layer_t *layer;
+	gerbv_netstate_t *state;
+	gerbv_net_t *net;
+	gerbv_simplified_amacro_t *sam;
+	gint32 i, count;
+
+	image_cache_put_int (out, image->layertype);
+
+	image_cache_put (out, image->info, sizeof (gerbv_image_info_t));
+	image_cache_put_string (out, image->info->name);
+	image_cache_put_string (out, image->info->plotterFilm);
+	image_cache_put_string (out, image->info->type);
+
+	image_cache_put_int (out, image->format != NULL);
+	if (image->format != NULL)
+		image_cache_put (out, image->format, sizeof (gerbv_format_t));
+
+	image_cache_put_int (out, gerbv_image_get_aperture_count (image));
+	for (i = 0; i < gerbv_image_get_aperture_count (image); i++) {
+		gint number;
+		gerbv_aperture_t *aperture =
+			gerbv_image_get_nth_aperture (image, i, &number);
+
+		image_cache_put_int (out, number);
+		image_cache_put (out, aperture, sizeof (gerbv_aperture_t));
+		for (sam = aperture->simplified, count = 0;
+				sam != NULL; sam = sam->next)
+			count++;
+		image_cache_put_int (out, count);
+		for (sam = aperture->simplified; sam != NULL; sam = sam->next)
+			image_cache_put (out, sam, sizeof (gerbv_simplified_amacro_t));
+	}
+
+	/* nets refer to their layer and netstate by index */
+	layerIndexes = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (layer = image->layers, count = 0; layer != NULL; layer = layer->next)
+		g_hash_table_insert (layerIndexes, layer, GINT_TO_POINTER (count++));
+	image_cache_put_int (out, count);
+	for (layer = image->layers; layer != NULL; layer = layer->next) {
+		image_cache_put (out, layer, sizeof (gerbv_layer_t));
+		image_cache_put_string (out, layer->name);
+	}
+
+	stateIndexes = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (state = image->states, count = 0; state != NULL; state = state->next)
+		g_hash_table_insert (stateIndexes, state, GINT_TO_POINTER (count++));
+	image_cache_put_int (out, count);
+	for (state = image->states; state != NULL; state = state->next)
+		image_cache_put (out, state, sizeof (gerbv_netstate_t));
+
+	image_cache_put_int (out, gerbv_image_get_net_count (image));
+	for (net = image->netlist; net != NULL; net = net->next) {
+		image_cache_net_t record;
+
+		memset (&record, 0, sizeof (record));
+		record.startX = net->start_x;
+		record.startY = net->start_y;
+		record.stopX = net->stop_x;
+		record.stopY = net->stop_y;
+		record.boundingBox = net->boundingBox;
+		record.aperture = net->aperture;
+		record.apertureState = net->aperture_state;
+		record.interpolation = net->interpolation;
+		record.layer = GPOINTER_TO_INT (g_hash_table_lookup (layerIndexes,
+					net->layer));
+		record.state = GPOINTER_TO_INT (g_hash_table_lookup (stateIndexes,
+					net->state));
+		if (net->cirseg != NULL)
+			record.flags |= IMAGE_CACHE_NET_CIRSEG;
+		if (net->label != NULL)
+			record.flags |= IMAGE_CACHE_NET_LABEL;
+
+		image_cache_put (out, &record, sizeof (record));
+		if (net->cirseg != NULL)
+			image_cache_put (out, net->cirseg, sizeof (gerbv_cirseg_t));
+		if (net->label != NULL)
+			image_cache_put_string (out, net->label->str);
+	}
+	g_hash_table_destroy (layerIndexes);
+	g_hash_table_destroy (stateIndexes);
+
+	image_cache_put_stats (out, image->gerbv_stats);
+
+	return out;
+}
+
+
+static gerbv_image_t *
+image_cache_read_image (image_cache_reader_t *reader)
+{
+	gerbv_image_t *image;
+	gerbv_image_info_t *info;
+	gerbv_layer_t **layers;
+	gerbv_netstate_t **states;
+	gerbv_net_t *net = NULL;
+	gerbv_simplified_amacro_t **lastSam;
+	gint32 i, j, index, count, layerCount, stateCount;
+
+	image = gerbv_create_image (NULL, NULL);
+	image->layertype = image_cache_get_int (reader);
+
+	info = image->info;
+	g_free (info->type);
+	image_cache_get (reader, info, sizeof (gerbv_image_info_t));
+	info->name = image_cache_get_string (reader);
+	info->plotterFilm = image_cache_get_string (reader);
+	info->type = image_cache_get_string (reader);
+	info->attr_list = NULL;
+	info->n_attr = 0;
+
+	if (image_cache_get_int (reader)) {
+		image->format = g_new (gerbv_format_t, 1);
+		image_cache_get (reader, image->format, sizeof (gerbv_format_t));
+	}
+
+	count = image_cache_get_count (reader, sizeof (gerbv_aperture_t));
+	for (i = 0; (i < count) && !reader->failed; i++) {
+		gerbv_aperture_t *aperture;
+
+		index = image_cache_get_int (reader);
+		if ((index < 0)
+				|| (gerbv_image_get_aperture (image, index) != NULL)) {
+			reader->failed = TRUE;
+			break;
+		}
+		aperture = g_new (gerbv_aperture_t, 1);
+		image_cache_get (reader, aperture, sizeof (gerbv_aperture_t));
+		gerbv_image_set_aperture (image, index, aperture);
+		aperture->amacro = NULL;
+		aperture->simplified = NULL;
+
+		lastSam = &aperture->simplified;
+		j = image_cache_get_count (reader, sizeof (gerbv_simplified_amacro_t));
+		for (; j > 0; j--) {
+			*lastSam = g_new (gerbv_simplified_amacro_t, 1);
+			image_cache_get (reader, *lastSam,
+					sizeof (gerbv_simplified_amacro_t));
+			(*lastSam)->next = NULL;
+			lastSam = &(*lastSam)->next;
+		}
+	}
+
+	/* the first layer and netstate were created with the image */
+	layerCount = image_cache_get_count (reader, sizeof (gerbv_layer_t));
+	layers = g_new (gerbv_layer_t *, MAX (layerCount, 1));
+	layers[0] = image->layers;
+	for (i = 0; i < layerCount; i++) {
+		if (i > 0)
+			layers[i] = layers[i - 1]->next =
+				gerb_arena_new0 (image->arena, gerbv_layer_t);
+		image_cache_get (reader, layers[i], sizeof (gerbv_layer_t));
+		layers[i]->next = NULL;
+		layers[i]->name = image_cache_get_string (reader);
+	}
+
+	stateCount = image_cache_get_count (reader, sizeof (gerbv_netstate_t));
+	states = g_new (gerbv_netstate_t *, MAX (stateCount, 1));
+	states[0] = image->states;
+	for (i = 0; i < stateCount; i++) {
+		if (i > 0)
+			states[i] = states[i - 1]->next =
+				gerb_arena_new0 (image->arena, gerbv_netstate_t);
+		image_cache_get (reader, states[i], sizeof (gerbv_netstate_t));
+		states[i]->next = NULL;
+	}
+
+	/* the netlist head was created with the image as well */
+	count = image_cache_get_count (reader, sizeof (image_cache_net_t));
+	for (i = 0; (i < count) && !reader->failed; i++) {
+		image_cache_net_t record;
+
+		if (net == NULL)
+			net = image->netlist;
+		else
+			net = net->next = gerb_arena_new0 (image->arena, gerbv_net_t);
+
+		image_cache_get (reader, &record, sizeof (record));
+		if ((record.layer < 0) || (record.layer >= layerCount)
+				|| (record.state < 0) || (record.state >= stateCount)) {
+			reader->failed = TRUE;
+			break;
+		}
+		net->start_x = record.startX;
+		net->start_y = record.startY;
+		net->stop_x = record.stopX;
+		net->stop_y = record.stopY;
+		net->boundingBox = record.boundingBox;
+		net->aperture = record.aperture;
+		net->aperture_state = record.apertureState;
+		net->interpolation = record.interpolation;
+		net->layer = layers[record.layer];
+		net->state = states[record.state];
+		if (record.flags & IMAGE_CACHE_NET_CIRSEG) {
+			net->cirseg = gerb_arena_new0 (image->arena, gerbv_cirseg_t);
+			image_cache_get (reader, net->cirseg, sizeof (gerbv_cirseg_t));
+		}
+		if (record.flags & IMAGE_CACHE_NET_LABEL) {
+			gchar *label = image_cache_get_string (reader);
+
+			net->label = g_string_new (label);
+			g_free (label);
+		}
+	}
+	image->gerbv_stats = image_cache_get_stats (reader);
+
+	if (reader->failed || (layerCount < 1) || (stateCount < 1) || (count < 1)) {
+		g_free (layers);
+		g_free (states);
+		gerbv_destroy_image (image);
+		return NULL;
+	}
+
+	/* the chains were just built, so their tails are known */
+	image->lastLayer = layers[layerCount - 1];
+	image->layerCount = layerCount;
+	image->lastState = states[stateCount - 1];
+	image->stateCount = stateCount;
+	image->lastNet = net;
+	image->netCount = count;
+	g_free (layers);
+	g_free (states);
+
+	return image;
+}
+
+
+gerbv_image_t *
+image_cache_load (const gchar *filename, gerb_file_t *fd)
+{
+	image_cache_header_t header, cachedHeader;
+	image_cache_reader_t reader;
+	GMappedFile *mappedFile;
+	gerbv_image_t *image = NULL;
+	gchar *path, *cachedFilename;
+
+	path = image_cache_get_path (filename);
+	if (path == NULL)
+		return NULL;
+	mappedFile = g_mapped_file_new (path, FALSE, NULL);
+	if (mappedFile == NULL) {
+		g_free (path);
+		return NULL;
+	}
+
+	memset (&reader, 0, sizeof (reader));
+	reader.data = g_mapped_file_get_contents (mappedFile);
+	reader.size = g_mapped_file_get_length (mappedFile);
+
+	image_cache_get (&reader, &cachedHeader, sizeof (cachedHeader));
+	cachedFilename = image_cache_get_string (&reader);
+	if (!reader.failed && image_cache_fill_header (&header, fd)
+			&& (memcmp (&header, &cachedHeader, sizeof (header)) == 0)
+			&& (g_strcmp0 (cachedFilename, filename) == 0)) {
+		image = image_cache_read_image (&reader);
+		dprintf ("%s cache for %s\n", image ? "Using" : "Invalid", filename);
+	}
+	g_free (cachedFilename);
+	g_mapped_file_free (mappedFile);
+
+	/* the modification time of a cache file is the time it was last
+	   used */
+	if (image != NULL)
+		g_utime (path, NULL);
+	g_free (path);
+
+	return image;
+}
+
+
+static gint
+image_cache_compare_entries (gconstpointer a, gconstpointer b)
+{
+	const image_cache_entry_t *entryA = a, *entryB = b;
+
+	if (entryA->mtime != entryB->mtime)
+		return (entryA->mtime < entryB->mtime) ? -1 : 1;
+
+	return strcmp (entryA->path, entryB->path);
+}
+
+
+/* Removes the least recently used cache files from directory until
+   they take at most maxSize bytes */
+static void
+image_cache_trim (const gchar *directory, guint64 maxSize)
+{
+	GDir *dir;
+	GArray *entries;
+	const gchar *name;
+	guint64 totalSize = 0;
+	guint i;
+
+	dir = g_dir_open (directory, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	entries = g_array_new (FALSE, FALSE, sizeof (image_cache_entry_t));
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		image_cache_entry_t entry;
+		struct stat statinfo;
+
+		if (!g_str_has_suffix (name, IMAGE_CACHE_SUFFIX))
+			continue;
+		entry.path = g_build_filename (directory, name, NULL);
+		if ((g_stat (entry.path, &statinfo) != 0)
+				|| !S_ISREG (statinfo.st_mode)) {
+			g_free (entry.path);
+			continue;
+		}
+		entry.size = statinfo.st_size;
+		entry.mtime = statinfo.st_mtime;
+		totalSize += entry.size;
+		g_array_append_val (entries, entry);
+	}
+	g_dir_close (dir);
+
+	g_array_sort (entries, image_cache_compare_entries);
+	for (i = 0; i < entries->len; i++) {
+		image_cache_entry_t *entry =
+			&g_array_index (entries, image_cache_entry_t, i);
+
+		if ((totalSize > maxSize) && (g_unlink (entry->path) == 0)) {
+			dprintf ("Removed %s from the image cache\n", entry->path);
+			totalSize -= entry->size;
+		}
+		g_free (entry->path);
+	}
+	g_array_free (entries, TRUE);
+}
+
+
+void
+image_cache_save (const gchar *filename, gerb_file_t *fd,
+		gerbv_image_t *image)
+{
+	image_cache_header_t header;
+	GString *out, *body;
+	gchar *path, *directory;
+	guint64 maxSize;
+
+	if ((image == NULL) || (image->layertype != GERBV_LAYERTYPE_RS274X))
+		return;
+	/* the cache is only checked against this file, not any included one */
+	if (g_strstr_len (fd->data, fd->datalen, "%IF") != NULL)
+		return;
+	if (!image_cache_fill_header (&header, fd))
+		return;
+
+	path = image_cache_get_path (filename);
+	if (path == NULL)
+		return;
+	directory = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (directory, 0700) == 0) {
+		out = g_string_new_len ((const gchar *) &header, sizeof (header));
+		image_cache_put_string (out, filename);
+		body = image_cache_write_image (image);
+		g_string_append_len (out, body->str, body->len);
+		g_string_free (body, TRUE);
+
+		/* written to a temporary file and renamed, so readers never
+		   see a partial cache file */
+		if (!g_file_set_contents (path, out->str, out->len, NULL))
+			dprintf ("Could not write the cache of %s\n", filename);
+		g_string_free (out, TRUE);
+
+		/* one loader thread trims at a time */
+		G_LOCK (imageCache);
+		maxSize = imageCacheMaxSize;
+		if (maxSize > 0)
+			image_cache_trim (directory, maxSize);
+		G_UNLOCK (imageCache);
+	}
+	g_free (directory);
+	g_free (path);
+}
+
+
+void
+gerbv_set_image_cache (const gchar *directory, guint64 maxSize)
+{
+	G_LOCK (imageCache);
+	g_free (imageCacheDir);
+	imageCacheDir = g_strdup (directory);
+	imageCacheMaxSize = maxSize;
+	G_UNLOCK (imageCache);
+}
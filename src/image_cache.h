@@ -0,0 +1,48 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * image_cache.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file image_cache.h
+    \brief Header info for the on-disk cache of parsed images
+    \ingroup libgerbv
+*/
+
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include "gerb_file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the cached image of filename, or NULL if the cache is off,
+   there is none or the file fd has changed since it was cached */
+gerbv_image_t *image_cache_load (const gchar *filename, gerb_file_t *fd);
+
+/* Stores image, parsed from the file fd, as the cached image of filename,
+   if the cache is on.  Only RS274X images are cached */
+void image_cache_save (const gchar *filename, gerb_file_t *fd,
+		gerbv_image_t *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMAGE_CACHE_H */
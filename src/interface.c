@@ -835,9 +835,9 @@ interface_create_gui (int req_width, int req_height)
 			      _("Examine a detailed anaylsis of the contents of all visible drill layers"), NULL);
 	gtk_container_add (GTK_CONTAINER (menuitem_analyze_menu), analyze_active_drill);
 
-	analyze_benchmark = gtk_menu_item_new_with_mnemonic (_("_Benchmark (1 min)"));
+	analyze_benchmark = gtk_menu_item_new_with_mnemonic (_("_Benchmark"));
 	gtk_tooltips_set_tip (tooltips, analyze_benchmark, 
-			      _("Benchmark different rendering methods. Will make the application unresponsive for 1 minute!"), NULL);
+			      _("Benchmark different rendering methods. Will make the application unresponsive while it runs!"), NULL);
 	gtk_container_add (GTK_CONTAINER (menuitem_analyze_menu), analyze_benchmark);
 
 
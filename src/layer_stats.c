@@ -0,0 +1,159 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * layer_stats.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file layer_stats.c
+    \brief Statistics reports over several layers, cached per layer
+    \ingroup libgerbv
+
+    The analysis reports folded the statistics of every visible layer
+    into one report each time the report window was opened.  Here the
+    report of each layer is kept on the image together with the layer
+    number it was stamped with, and the reports of the layers are merged
+    in order into the report over all of them.  An image never changes
+    its statistics once parsed, and reloading a layer replaces its
+    image, so the cached report is only rebuilt when the layer number of
+    the image changes.
+*/
+
+#include "gerbv.h"
+
+#include "common.h"
+#include "layer_stats.h"
+
+#define dprintf if(DEBUG) printf
+
+typedef struct {
+	gint layer;		/*!< the layer number the reports were stamped with */
+	gerbv_stats_t *stats;	/*!< report of image->gerbv_stats, or NULL */
+	gerbv_drill_stats_t *drillStats; /*!< report of image->drill_stats, or NULL */
+} layer_stats_t;
+
+/* ------------------------------------------------------------------ */
+/* Returns the cached reports of image for layer, emptied if they were
+   stamped with another layer */
+static layer_stats_t *
+layer_stats_get (gerbv_image_t *image, gint layer)
+{
+	layer_stats_t *cache = image->layerStats;
+
+	if ((cache != NULL) && (cache->layer != layer)) {
+		layer_stats_invalidate (image);
+		cache = NULL;
+	}
+	if (cache == NULL) {
+		cache = g_new0 (layer_stats_t, 1);
+		cache->layer = layer;
+		image->layerStats = cache;
+	}
+
+	return cache;
+}
+
+/* ------------------------------------------------------------------ */
+/* Returns TRUE if image is listed before index i.  Such an image keeps
+   the report of its first layer, the later ones are added directly */
+static gboolean
+layer_stats_is_listed_before (gerbv_image_t **images, gint i)
+{
+	gint j;
+
+	for (j = 0; j < i; j++)
+		if (images[j] == images[i])
+			return TRUE;
+
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------ */
+gerbv_stats_t *
+gerbv_stats_new_from_images (gerbv_image_t **images, gint *layers,
+		gint count)
+{
+	gerbv_stats_t *stats = gerbv_stats_new ();
+	layer_stats_t *cache;
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		if (images[i] == NULL)
+			continue;
+		if (layer_stats_is_listed_before (images, i)) {
+			gerbv_stats_add_layer (stats, images[i]->gerbv_stats,
+					layers[i]);
+			continue;
+		}
+		cache = layer_stats_get (images[i], layers[i]);
+		if (cache->stats == NULL) {
+			dprintf ("building the statistics of layer %d\n",
+					layers[i]);
+			cache->stats = gerbv_stats_new ();
+			gerbv_stats_add_layer (cache->stats,
+					images[i]->gerbv_stats, layers[i]);
+		}
+		gerbv_stats_merge (stats, cache->stats);
+	}
+
+	return stats;
+}
+
+/* ------------------------------------------------------------------ */
+gerbv_drill_stats_t *
+gerbv_drill_stats_new_from_images (gerbv_image_t **images, gint *layers,
+		gint count)
+{
+	gerbv_drill_stats_t *stats = gerbv_drill_stats_new ();
+	layer_stats_t *cache;
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		if (images[i] == NULL)
+			continue;
+		if (layer_stats_is_listed_before (images, i)) {
+			gerbv_drill_stats_add_layer (stats,
+					images[i]->drill_stats, layers[i]);
+			continue;
+		}
+		cache = layer_stats_get (images[i], layers[i]);
+		if (cache->drillStats == NULL) {
+			dprintf ("building the drill statistics of layer %d\n",
+					layers[i]);
+			cache->drillStats = gerbv_drill_stats_new ();
+			gerbv_drill_stats_add_layer (cache->drillStats,
+					images[i]->drill_stats, layers[i]);
+		}
+		gerbv_drill_stats_merge (stats, cache->drillStats);
+	}
+
+	return stats;
+}
+
+/* ------------------------------------------------------------------ */
+void
+layer_stats_invalidate (gerbv_image_t *image)
+{
+	layer_stats_t *cache = image->layerStats;
+
+	if (cache == NULL)
+		return;
+
+	image->layerStats = NULL;
+	gerbv_stats_destroy (cache->stats);
+	gerbv_drill_stats_destroy (cache->drillStats);
+	g_free (cache);
+}
@@ -0,0 +1,41 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * layer_stats.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file layer_stats.h
+    \brief Header info for the per-image cache of layer statistics
+    \ingroup libgerbv
+*/
+
+#ifndef LAYER_STATS_H
+#define LAYER_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frees the statistics report cached on image, it is rebuilt when next
+   needed */
+void layer_stats_invalidate (gerbv_image_t *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LAYER_STATS_H */
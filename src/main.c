@@ -54,6 +54,7 @@
 #include "interface.h"
 #include "render.h"
 #include "project.h"
+#include "batch.h"
 
 #if (DEBUG)
 # define dprintf printf("%s():  ", __FUNCTION__); printf
@@ -63,6 +64,8 @@
 
 #define NUMBER_OF_DEFAULT_COLORS 18
 #define NUMBER_OF_DEFAULT_TRANSFORMATIONS 20
+/* The size the image cache below the user cache directory is kept at */
+#define IMAGE_CACHE_MAX_SIZE (256 * 1024 * 1024)
 
 static gerbv_layer_color mainDefaultColors[NUMBER_OF_DEFAULT_COLORS] = {
 	{115,115,222,177},
@@ -132,6 +135,8 @@ const struct option longopts[] = {
     {"translate",       required_argument,  NULL,    'T'},
     {"window",		required_argument,  NULL,    'w'},
     {"export",          required_argument,  NULL,    'x'},
+    {"batch",           required_argument,  NULL,    'X'},
+    {"batch-output",    required_argument,  NULL,    'Y'},
     {"geometry",        required_argument,  &longopt_val, 1},
     /* GDK/GDK debug flags to be "let through" */
     {"gtk-module",      required_argument,  &longopt_val, 2},
@@ -148,7 +153,7 @@ const struct option longopts[] = {
     {0, 0, 0, 0},
 };
 #endif /* HAVE_GETOPT_LONG*/
-const char *opt_options = "VadhB:D:O:W:b:f:r:m:l:o:p:t:T:w:x:";
+const char *opt_options = "VadhB:D:O:W:b:f:r:m:l:o:p:t:T:w:x:X:Y:";
 
 /**Global state variable to keep track of what's happening on the screen.
    Declared extern in main.h
@@ -159,13 +164,35 @@ gerbv_screen_t screen;
 gboolean logToFileOption;
 gchar *logToFileFilename;
 
+static const char *export_type_names[] = {
+	"png",
+	"pdf",
+	"svg",
+	"ps",
+	"rs274x",
+	"drill",
+	"idrill",
+	NULL
+};
+static const gchar *export_def_file_names[] = {
+	"output.png",
+	"output.pdf",
+	"output.svg",
+	"output.ps",
+	"output.gbx",
+	"output.cnc",
+	"output.ncp",
+	NULL
+};
+
 /* ------------------------------------------------------------------ */
 void 
 main_open_project_from_filename(gerbv_project_t *gerbvProject, gchar *filename) 
 {
-	project_list_t *list, *plist;
-	gint i, max_layer_num = -1;
+	project_list_t *list, *plist, **layerItems;
+	gint i, max_layer_num = -1, layerCount;
 	gerbv_fileinfo_t *file_info;
+	gerbv_layer_file_t *layerFiles;
 
 	dprintf("Opening project = %s\n", (gchar *) filename);
 	list = read_project_file(filename);
@@ -186,8 +213,15 @@ main_open_project_from_filename(gerbv_project_t *gerbvProject, gchar *filename)
 		plist = plist->next;
 	}
 
-	/* Increase the layer count each time and find (if any) the
-	 * corresponding entry */
+	/* Collect the layers in order of their layer number, so they can
+	 * be loaded together */
+	layerCount = 0;
+	for (plist = list; plist; plist = plist->next)
+		layerCount++;
+	layerFiles = g_new0 (gerbv_layer_file_t, layerCount);
+	layerItems = g_new0 (project_list_t *, layerCount);
+	layerCount = 0;
+
 	for (i = -1; i <= max_layer_num; i++) {
 		plist = list;
 		while (plist) {
@@ -196,58 +230,61 @@ main_open_project_from_filename(gerbv_project_t *gerbvProject, gchar *filename)
 				continue;
 			}
 
-			GdkColor colorTemplate = {0,
-				plist->rgb[0], plist->rgb[1], plist->rgb[2]};
 			if (i == -1) {
+				GdkColor colorTemplate = {0,
+					plist->rgb[0], plist->rgb[1], plist->rgb[2]};
 				gerbvProject->background = colorTemplate;
 				plist = plist->next;
 				continue;
 			}
 
-			gchar *fullName = NULL;
-			gchar *dirName = NULL;
-			gint fileIndex = gerbvProject->last_loaded + 1;
-
 			if (!g_path_is_absolute (plist->filename)) {
 				/* Build the full pathname to the layer */
-				dirName = g_path_get_dirname (filename);
-				fullName = g_build_filename (dirName,
-					plist->filename, NULL);
+				gchar *dirName = g_path_get_dirname (filename);
+				layerFiles[layerCount].filename =
+					g_build_filename (dirName,
+						plist->filename, NULL);
+				g_free (dirName);
 			} else {
-				fullName = g_strdup (plist->filename);
-			}
-
-			if (gerbv_open_image(gerbvProject, fullName,
-					fileIndex, FALSE,
-					plist->attr_list,
-					plist->n_attr, TRUE) == -1) {
-				GERB_MESSAGE(_("could not read file: %s"),
-						fullName);
-				plist = plist->next;
-				continue;
+				layerFiles[layerCount].filename =
+					g_strdup (plist->filename);
 			}
-
-			g_free (dirName);
-			g_free (fullName);
-
-			/* Change color from default to from the project list */
-			file_info = gerbvProject->file[fileIndex];
-			file_info->color = colorTemplate;
-			file_info->alpha = plist->alpha;
-			file_info->transform.inverted =	plist->inverted;
-			file_info->transform.translateX = plist->translate_x;
-			file_info->transform.translateY = plist->translate_y;
-			file_info->transform.rotation = plist->rotation;
-			file_info->transform.scaleX = plist->scale_x;
-			file_info->transform.scaleY = plist->scale_y;
-			file_info->transform.mirrorAroundX = plist->mirror_x;
-			file_info->transform.mirrorAroundY = plist->mirror_y;
-			file_info->isVisible = plist->visible;
+			layerFiles[layerCount].attr_list = plist->attr_list;
+			layerFiles[layerCount].n_attr = plist->n_attr;
+			layerItems[layerCount] = plist;
+			layerCount++;
 
 			plist = plist->next;
 		}
 	}
 
+	gerbv_open_layers_from_filenames (gerbvProject, layerFiles, layerCount);
+
+	for (i = 0; i < layerCount; i++) {
+		g_free (layerFiles[i].filename);
+		if (layerFiles[i].fileIndex == -1)
+			continue;
+
+		/* Change color from default to from the project list */
+		plist = layerItems[i];
+		GdkColor colorTemplate = {0,
+			plist->rgb[0], plist->rgb[1], plist->rgb[2]};
+		file_info = gerbvProject->file[layerFiles[i].fileIndex];
+		file_info->color = colorTemplate;
+		file_info->alpha = plist->alpha;
+		file_info->transform.inverted =	plist->inverted;
+		file_info->transform.translateX = plist->translate_x;
+		file_info->transform.translateY = plist->translate_y;
+		file_info->transform.rotation = plist->rotation;
+		file_info->transform.scaleX = plist->scale_x;
+		file_info->transform.scaleY = plist->scale_y;
+		file_info->transform.mirrorAroundX = plist->mirror_x;
+		file_info->transform.mirrorAroundY = plist->mirror_y;
+		file_info->isVisible = plist->visible;
+	}
+	g_free (layerFiles);
+	g_free (layerItems);
+
 	project_destroy_project_list(list);
 
 	/* Save project filename for later use */
@@ -337,7 +374,212 @@ main_save_as_project_from_filename(gerbv_project_t *gerbvProject, gchar *filenam
     main_save_project_from_filename (gerbvProject, filename);
 } /* gerbv_save_as_project_from_filename */
 
+/* ------------------------------------------------------------------ */
+/* Gives fileInfo the color of the index'th layer given on the command
+   line */
+void
+main_set_default_layer_color (gerbv_fileinfo_t *fileInfo, gint index)
+{
+    gerbv_layer_color *color =
+	    &mainDefaultColors[index % NUMBER_OF_DEFAULT_COLORS];
+    GdkColor colorTemplate = {0,
+	    color->red*257, color->green*257, color->blue*257};
+
+    fileInfo->color = colorTemplate;
+    fileInfo->alpha = color->alpha*257;
+}
+
+/* ------------------------------------------------------------------ */
+enum exp_type
+main_export_type_from_name (const gchar *name)
+{
+    int i;
+
+    for (i = 0; export_type_names[i] != NULL; i++) {
+	if (strcmp (name, export_type_names[i]) == 0)
+	    return i;
+    }
+
+    return EXP_TYPE_NONE;
+}
+
+/* ------------------------------------------------------------------ */
+/* Merges the images of all files of gerbvProject for exporting them as
+   one file, the first file first and the others in reverse order */
+static gerbv_image_t *
+main_merge_project_images (gerbv_project_t *gerbvProject,
+		main_export_t *export)
+{
+    gerbv_image_t **images;
+    gerbv_user_transformation_t **transforms;
+    gerbv_image_t *mergedImage;
+    int i, count = 0;
+
+    images = g_new (gerbv_image_t *, gerbvProject->last_loaded + 1);
+    transforms = g_new (gerbv_user_transformation_t *,
+		    gerbvProject->last_loaded + 1);
+    images[count] = gerbvProject->file[0]->image;
+    transforms[count++] = &export->transformations[0];
+    for (i = gerbvProject->last_loaded; i > 0; i--) {
+	if (gerbvProject->file[i]) {
+	    images[count] = gerbvProject->file[i]->image;
+	    transforms[count++] = &export->transformations[i];
+	}
+    }
+
+    mergedImage = gerbv_image_merge_images (images, transforms, count);
+    g_free (images);
+    g_free (transforms);
+
+    return mergedImage;
+} /* main_merge_project_images */
+
+/* ------------------------------------------------------------------ */
+/* Exports the visible layers of gerbvProject as given on the command
+   line.  Returns FALSE if there was nothing to export */
+gboolean
+main_export_project (gerbv_project_t *gerbvProject, main_export_t *export)
+{
+    gboolean userSuppliedOrigin = export->userSuppliedOrigin,
+	     userSuppliedWindow = export->userSuppliedWindow,
+	     userSuppliedWindowInPixels = export->userSuppliedWindowInPixels,
+	     userSuppliedDpi = export->userSuppliedDpi,
+	     userSuppliedAntiAlias = export->antiAlias;
+    gfloat userSuppliedOriginX = export->originX,
+	   userSuppliedOriginY = export->originY,
+	   userSuppliedDpiX = export->dpiX, userSuppliedDpiY = export->dpiY,
+	   userSuppliedWidth = export->width,
+	   userSuppliedHeight = export->height,
+	   userSuppliedBorder = export->border;
+    const gchar *exportFilename = export->filename;
+    gerbv_image_t *exportImage;
+
+	/* load the info struct with the default values */
+
+	if (!exportFilename)
+		exportFilename = export_def_file_names[export->type];
+
+	gerbv_render_size_t bb;
+	gerbv_render_get_boundingbox(gerbvProject, &bb);
+	// Set origin to the left-bottom corner if it is not specified
+	if(!userSuppliedOrigin){
+	    userSuppliedOriginX = bb.left;
+	    userSuppliedOriginY = bb.top;
+	}
+
+	float width  = bb.right  - userSuppliedOriginX + 0.001;	// Plus a little extra to prevent from 
+	float height = bb.bottom - userSuppliedOriginY + 0.001; // missing items due to round-off errors
+	// If the user did not specify a height and width, autoscale w&h till full size from origin.
+	if(!userSuppliedWindow){
+	    userSuppliedWidth  = width;
+	    userSuppliedHeight = height;
+	}else{
+	    // If size was specified in pixels, and no resolution was specified, autoscale resolution till fit
+	    if( (!userSuppliedDpi)&& userSuppliedWindowInPixels){
+		userSuppliedDpiX = MIN(((userSuppliedWidth-0.5)  / width),((userSuppliedHeight-0.5) / height));
+		userSuppliedDpiY = userSuppliedDpiX;
+		userSuppliedOriginX -= 0.5/userSuppliedDpiX;
+		userSuppliedOriginY -= 0.5/userSuppliedDpiY;
+	    }
+	}
+
+	// Add the border size (if there is one)
+	if(userSuppliedBorder!=0){
+	    // If supplied in inches, add a border around the image
+	    if(!userSuppliedWindowInPixels){
+	      userSuppliedOriginX -= (userSuppliedWidth*userSuppliedBorder)/2.0;
+		userSuppliedOriginY -= (userSuppliedHeight*userSuppliedBorder)/2.0;
+		userSuppliedWidth  += userSuppliedWidth*userSuppliedBorder;
+		userSuppliedHeight  += userSuppliedHeight*userSuppliedBorder;
+	    }
+	    // If supplied in pixels, shrink image content for border_size
+	    else{
+	      userSuppliedOriginX -= ((userSuppliedWidth/userSuppliedDpiX)*userSuppliedBorder)/2.0;
+		userSuppliedOriginY -= ((userSuppliedHeight/userSuppliedDpiX)*userSuppliedBorder)/2.0;
+		userSuppliedDpiX -= (userSuppliedDpiX*userSuppliedBorder);
+		userSuppliedDpiY -= (userSuppliedDpiY*userSuppliedBorder);
+	    }
+	}
+	
+	if(!userSuppliedWindowInPixels){
+	    userSuppliedWidth  *= userSuppliedDpiX;
+	    userSuppliedHeight *= userSuppliedDpiY;
+	}
+	
+	// Make sure there is something valid in it. It could become negative if 
+	// the userSuppliedOrigin is further than the bb.right or bb.top.
+	if(userSuppliedWidth <=0)
+	    userSuppliedWidth  = 1;
+	if(userSuppliedHeight <=0)
+	    userSuppliedHeight = 1;
+
+
+	gerbv_render_info_t renderInfo = {userSuppliedDpiX, userSuppliedDpiY, 
+	    userSuppliedOriginX, userSuppliedOriginY,
+	    userSuppliedAntiAlias? GERBV_RENDER_TYPE_CAIRO_HIGH_QUALITY: GERBV_RENDER_TYPE_CAIRO_NORMAL,
+	    userSuppliedWidth,userSuppliedHeight };
+	
+	switch (export->type) {
+	case EXP_TYPE_PNG:
+	    gerbv_export_png_file_from_project(gerbvProject,
+			    &renderInfo, exportFilename);
+	    break;
+	case EXP_TYPE_PDF:
+	    gerbv_export_pdf_file_from_project(gerbvProject,
+			    &renderInfo, exportFilename);
+	    break;
+	case EXP_TYPE_SVG:
+	    gerbv_export_svg_file_from_project(gerbvProject,
+			    &renderInfo, exportFilename);
+	    break;
+	case EXP_TYPE_PS:
+	    gerbv_export_postscript_file_from_project(gerbvProject,
+			    &renderInfo, exportFilename);
+	    break;
+	case EXP_TYPE_RS274X:
+	case EXP_TYPE_DRILL:
+	    if (!gerbvProject->file[0]->image) {
+		fprintf(stderr, _("A valid file was not loaded.\n"));
+		return FALSE;
+	    }
+
+	    /* if more than one file, merge them before exporting */
+	    exportImage = main_merge_project_images (gerbvProject, export);
+	    if (export->type == EXP_TYPE_RS274X)
+		gerbv_export_rs274x_file_from_image(exportFilename,
+				exportImage, &gerbvProject->file[0]->transform);
+	    if (export->type == EXP_TYPE_DRILL)
+		gerbv_export_drill_file_from_image(exportFilename,
+				exportImage, &gerbvProject->file[0]->transform);
+
+	    gerbv_destroy_image(exportImage);
+	    break;
+	case EXP_TYPE_IDRILL:
+	    if (!gerbvProject->file[0]->image) {
+		fprintf(stderr, _("A valid file was not loaded.\n"));
+		return FALSE;
+	    }
+
+	    /* If we have more than one file, we need to merge them before
+	     * exporting */
+	    exportImage = main_merge_project_images (gerbvProject, export);
+	    gerbv_export_isel_drill_file_from_image (exportFilename,
+			    exportImage,
+			    &gerbvProject->file[0]->transform);
+	    gerbv_destroy_image (exportImage);
+	    break;
+	default:
+	    fprintf(stderr, _("A valid file was not loaded.\n"));
+	    return FALSE;
+	}
+
+
+    return TRUE;
+} /* main_export_project */
+
 GArray *log_array_tmp = NULL;
+/* layers are parsed from several threads at startup */
+G_LOCK_DEFINE_STATIC (log_array_tmp);
 
 /* Temporary log messages handler. It will store log messages before GUI
  * initialization. */
@@ -350,7 +592,9 @@ callbacks_temporary_handle_log_messages(const gchar *log_domain,
     item.domain = g_strdup (log_domain);
     item.level = log_level;
     item.message = g_strdup (message);
+    G_LOCK (log_array_tmp);
     g_array_append_val (log_array_tmp, item);
+    G_UNLOCK (log_array_tmp);
 
     g_log_default_handler (log_domain, log_level, message, user_data);
 }
@@ -378,39 +622,10 @@ main(int argc, char *argv[])
 	   userSuppliedWidth=0, userSuppliedHeight=0,
 	   userSuppliedBorder = GERBV_DEFAULT_BORDER_COEFF;
 
-    gerbv_image_t *exportImage;
-
-    enum exp_type {
-	EXP_TYPE_NONE = -1,
-	EXP_TYPE_PNG,
-	EXP_TYPE_PDF,
-	EXP_TYPE_SVG,
-	EXP_TYPE_PS,
-	EXP_TYPE_RS274X,
-	EXP_TYPE_DRILL,
-	EXP_TYPE_IDRILL,
-    };
     enum exp_type exportType = EXP_TYPE_NONE;
-    const char *export_type_names[] = {
-	"png",
-	"pdf",
-	"svg",
-	"ps",
-	"rs274x",
-	"drill",
-	"idrill",
-	NULL
-    };
-    const gchar *export_def_file_names[] = {
-	"output.png",
-	"output.pdf",
-	"output.svg",
-	"output.ps",
-	"output.gbx",
-	"output.cnc",
-	"output.ncp",
-	NULL
-    };
+    const gchar *batchSource = NULL;
+    const gchar *batchOutputDir = NULL;
+    gchar *imageCacheDir;
 
 #if ENABLE_NLS
     setlocale(LC_ALL, "");
@@ -427,6 +642,7 @@ main(int argc, char *argv[])
      */
     memset((void *)&screen, 0, sizeof(gerbv_screen_t));
     screen.state = NORMAL;
+    screen.mainThread = g_thread_self ();
     
     mainProject = gerbv_create_project();
     mainProject->execname = g_strdup(argv[0]);
@@ -724,19 +940,27 @@ main(int argc, char *argv[])
 		exit(1);
 	    }
 
-	    for (i = 0; export_type_names[i] != NULL; i++) {
-		if (strcmp (optarg, export_type_names[i]) == 0) {
-		    exportType = i;
-		    break;
-		}
-	    }
-
+	    exportType = main_export_type_from_name (optarg);
 	    if (exportType == EXP_TYPE_NONE) {
 		fprintf(stderr, _("Unrecognized \"%s\" export type.\n"),
 				optarg);
 		exit(1);				
 	    }
 	    break;
+	case 'X' :
+	    if (optarg == NULL) {
+		fprintf(stderr, _("You must give a socket path, or - for the standard input.\n"));
+		exit(1);
+	    }
+	    batchSource = optarg;
+	    break;
+	case 'Y' :
+	    if (optarg == NULL) {
+		fprintf(stderr, _("You must give the directory of the batch output files.\n"));
+		exit(1);
+	    }
+	    batchOutputDir = optarg;
+	    break;
 	case 'd':
 	    screen.dump_parsed_image = 1;
 	    break;
@@ -778,7 +1002,13 @@ main(int argc, char *argv[])
 		"                                  for multiple layers.\n"
 		"  -x, --export=<png|pdf|ps|svg|   Export a rendered picture to a file with\n"
 		"                rs274x|drill|     the specified format.\n"
-		"                idrill>\n"),
+		"                idrill>\n"
+		"  -X, --batch=<socket|->          Run export jobs read line by line from\n"
+		"                                  the UNIX socket <socket>, or from the\n"
+		"                                  standard input, keeping the parsed\n"
+		"                                  layers in memory between jobs.\n"
+		"  -Y, --batch-output=<dir>        Let the batch jobs write output files\n"
+		"                                  inside the directory <dir>.\n"),
 			(int)(GERBV_DEFAULT_BORDER_COEFF * 100));
 #else
 	    printf(_("Usage: gerbv [OPTIONS...] [FILE...]\n\n"
@@ -817,7 +1047,13 @@ main(int argc, char *argv[])
 		"                          for multiple layers.\n"
 		"  -x <png|pdf|ps|svg|     Export a rendered picture to a file with\n"
 		"      rs274x|drill|       the specified format.\n"
-		"      idrill>\n"),
+		"      idrill>\n"
+		"  -X<socket|->            Run export jobs read line by line from\n"
+		"                          the UNIX socket <socket>, or from the\n"
+		"                          standard input, keeping the parsed\n"
+		"                          layers in memory between jobs.\n"
+		"  -Y<dir>                 Let the batch jobs write output files\n"
+		"                          inside the directory <dir>.\n"),
 			(int)(GERBV_DEFAULT_BORDER_COEFF * 100));
 
 #endif /* HAVE_GETOPT_LONG */
@@ -827,6 +1063,11 @@ main(int argc, char *argv[])
 	    printf(_("Not handled option [%d=%c]\n"), read_opt, read_opt);
 	}
     }
+
+    /* reopening files is faster with the parsed images kept on disk */
+    imageCacheDir = g_build_filename (g_get_user_cache_dir (), "gerbv", NULL);
+    gerbv_set_image_cache (imageCacheDir, IMAGE_CACHE_MAX_SIZE);
+    g_free (imageCacheDir);
     
     /*
      * If project is given, load that one and use it for files and colors.
@@ -854,30 +1095,33 @@ main(int argc, char *argv[])
 	    main_open_project_from_filename (mainProject, project_filename);
 	    mainProject->path = g_path_get_dirname (project_filename);
 	}
-    } else {
-    	gint loadedIndex = 0;
+    } else if (optind < argc) {
+	gint loadedIndex, layerCount = argc - optind;
+	gerbv_layer_file_t *layerFiles = g_new0 (gerbv_layer_file_t, layerCount);
+
 	for(i = optind ; i < argc; i++) {
-	    g_free (mainProject->path);
-	    if (!g_path_is_absolute(argv[i])) {
-		gchar *fullName = g_build_filename (g_get_current_dir (),
-						    argv[i], NULL);
-		gerbv_open_layer_from_filename_with_color (mainProject, fullName,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].red*257,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].green*257,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].blue*257,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].alpha*257);
-		mainProject->path = g_path_get_dirname (fullName);
-		g_free (fullName);
-	    } else {
-		gerbv_open_layer_from_filename_with_color (mainProject, argv[i],
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].red*257,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].green*257,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].blue*257,
-			mainDefaultColors[loadedIndex % NUMBER_OF_DEFAULT_COLORS].alpha*257);
-		mainProject->path = g_path_get_dirname (argv[i]);
-	    }
-	    loadedIndex++;
+	    if (!g_path_is_absolute(argv[i]))
+		layerFiles[i - optind].filename = g_build_filename (
+				g_get_current_dir (), argv[i], NULL);
+	    else
+		layerFiles[i - optind].filename = g_strdup (argv[i]);
 	}
+
+	gerbv_open_layers_from_filenames (mainProject, layerFiles, layerCount);
+
+	for (loadedIndex = 0; loadedIndex < layerCount; loadedIndex++) {
+	    gint fileIndex = layerFiles[loadedIndex].fileIndex;
+
+	    if (fileIndex != -1)
+		main_set_default_layer_color (mainProject->file[fileIndex],
+				loadedIndex);
+	}
+
+	g_free (mainProject->path);
+	mainProject->path = g_path_get_dirname (layerFiles[layerCount - 1].filename);
+	for (loadedIndex = 0; loadedIndex < layerCount; loadedIndex++)
+	    g_free (layerFiles[loadedIndex].filename);
+	g_free (layerFiles);
     }
 
     if (initial_rotation != 0.0) {
@@ -911,142 +1155,28 @@ main(int argc, char *argv[])
     }
 
     screen.unit = GERBV_DEFAULT_UNIT;
-    if (exportType != EXP_TYPE_NONE) {
-	/* load the info struct with the default values */
-
-	if (!exportFilename)
-		exportFilename = export_def_file_names[exportType];
-
-	gerbv_render_size_t bb;
-	gerbv_render_get_boundingbox(mainProject, &bb);
-	// Set origin to the left-bottom corner if it is not specified
-	if(!userSuppliedOrigin){
-	    userSuppliedOriginX = bb.left;
-	    userSuppliedOriginY = bb.top;
-	}
-
-	float width  = bb.right  - userSuppliedOriginX + 0.001;	// Plus a little extra to prevent from 
-	float height = bb.bottom - userSuppliedOriginY + 0.001; // missing items due to round-off errors
-	// If the user did not specify a height and width, autoscale w&h till full size from origin.
-	if(!userSuppliedWindow){
-	    userSuppliedWidth  = width;
-	    userSuppliedHeight = height;
-	}else{
-	    // If size was specified in pixels, and no resolution was specified, autoscale resolution till fit
-	    if( (!userSuppliedDpi)&& userSuppliedWindowInPixels){
-		userSuppliedDpiX = MIN(((userSuppliedWidth-0.5)  / width),((userSuppliedHeight-0.5) / height));
-		userSuppliedDpiY = userSuppliedDpiX;
-		userSuppliedOriginX -= 0.5/userSuppliedDpiX;
-		userSuppliedOriginY -= 0.5/userSuppliedDpiY;
-	    }
-	}
-
-	// Add the border size (if there is one)
-	if(userSuppliedBorder!=0){
-	    // If supplied in inches, add a border around the image
-	    if(!userSuppliedWindowInPixels){
-	      userSuppliedOriginX -= (userSuppliedWidth*userSuppliedBorder)/2.0;
-		userSuppliedOriginY -= (userSuppliedHeight*userSuppliedBorder)/2.0;
-		userSuppliedWidth  += userSuppliedWidth*userSuppliedBorder;
-		userSuppliedHeight  += userSuppliedHeight*userSuppliedBorder;
-	    }
-	    // If supplied in pixels, shrink image content for border_size
-	    else{
-	      userSuppliedOriginX -= ((userSuppliedWidth/userSuppliedDpiX)*userSuppliedBorder)/2.0;
-		userSuppliedOriginY -= ((userSuppliedHeight/userSuppliedDpiX)*userSuppliedBorder)/2.0;
-		userSuppliedDpiX -= (userSuppliedDpiX*userSuppliedBorder);
-		userSuppliedDpiY -= (userSuppliedDpiY*userSuppliedBorder);
-	    }
-	}
-	
-	if(!userSuppliedWindowInPixels){
-	    userSuppliedWidth  *= userSuppliedDpiX;
-	    userSuppliedHeight *= userSuppliedDpiY;
-	}
-	
-	// Make sure there is something valid in it. It could become negative if 
-	// the userSuppliedOrigin is further than the bb.right or bb.top.
-	if(userSuppliedWidth <=0)
-	    userSuppliedWidth  = 1;
-	if(userSuppliedHeight <=0)
-	    userSuppliedHeight = 1;
-
-
-	gerbv_render_info_t renderInfo = {userSuppliedDpiX, userSuppliedDpiY, 
+    if (batchSource != NULL) {
+	main_export_t exportDefaults = {exportType, exportFilename,
+	    userSuppliedOrigin, userSuppliedWindow, userSuppliedWindowInPixels,
+	    userSuppliedDpi, userSuppliedAntiAlias,
 	    userSuppliedOriginX, userSuppliedOriginY,
-	    userSuppliedAntiAlias? GERBV_RENDER_TYPE_CAIRO_HIGH_QUALITY: GERBV_RENDER_TYPE_CAIRO_NORMAL,
-	    userSuppliedWidth,userSuppliedHeight };
-	
-	switch (exportType) {
-	case EXP_TYPE_PNG:
-	    gerbv_export_png_file_from_project(mainProject,
-			    &renderInfo, exportFilename);
-	    break;
-	case EXP_TYPE_PDF:
-	    gerbv_export_pdf_file_from_project(mainProject,
-			    &renderInfo, exportFilename);
-	    break;
-	case EXP_TYPE_SVG:
-	    gerbv_export_svg_file_from_project(mainProject,
-			    &renderInfo, exportFilename);
-	    break;
-	case EXP_TYPE_PS:
-	    gerbv_export_postscript_file_from_project(mainProject,
-			    &renderInfo, exportFilename);
-	    break;
-	case EXP_TYPE_RS274X:
-	case EXP_TYPE_DRILL:
-	    if (!mainProject->file[0]->image) {
-		fprintf(stderr, _("A valid file was not loaded.\n"));
-		exit(1);
-	    }
-
-	    exportImage = gerbv_image_duplicate_image(
-			    mainProject->file[0]->image,
-			    &mainDefaultTransformations[0]);
+	    userSuppliedDpiX, userSuppliedDpiY,
+	    userSuppliedWidth, userSuppliedHeight, userSuppliedBorder, NULL};
 
-	    /* if more than one file, merge them before exporting */
-	    for (i = mainProject->last_loaded; i > 0; i--) {
-		if (mainProject->file[i])
-			gerbv_image_copy_image(mainProject->file[i]->image,
-				&mainDefaultTransformations[i], exportImage);
-	    }
-	    if (exportType == EXP_TYPE_RS274X)
-		gerbv_export_rs274x_file_from_image(exportFilename,
-				exportImage, &mainProject->file[0]->transform);
-	    if (exportType == EXP_TYPE_DRILL)
-		gerbv_export_drill_file_from_image(exportFilename,
-				exportImage, &mainProject->file[0]->transform);
-
-	    gerbv_destroy_image(exportImage);
-	    break;
-	case EXP_TYPE_IDRILL:
-	    if (!mainProject->file[0]->image) {
-		fprintf(stderr, _("A valid file was not loaded.\n"));
-		exit(1);
-	    }
+	/* serve export jobs until the input ends, without a display */
+	exit (batch_run (batchSource, batchOutputDir, &exportDefaults) ? 0 : 1);
+    }
+    if (exportType != EXP_TYPE_NONE) {
+	main_export_t export = {exportType, exportFilename,
+	    userSuppliedOrigin, userSuppliedWindow, userSuppliedWindowInPixels,
+	    userSuppliedDpi, userSuppliedAntiAlias,
+	    userSuppliedOriginX, userSuppliedOriginY,
+	    userSuppliedDpiX, userSuppliedDpiY,
+	    userSuppliedWidth, userSuppliedHeight, userSuppliedBorder,
+	    mainDefaultTransformations};
 
-	    exportImage = gerbv_image_duplicate_image (
-			    mainProject->file[0]->image,
-			    &mainDefaultTransformations[0]);
-	    /* If we have more than one file, we need to merge them before
-	     * exporting */
-	    for (i = mainProject->last_loaded; i > 0; i--) {
-		    if (mainProject->file[i]) {
-			    gerbv_image_copy_image (mainProject->file[i]->image,
-					    &mainDefaultTransformations[i],
-					    exportImage);
-		    }
-	    }
-	    gerbv_export_isel_drill_file_from_image (exportFilename,
-			    exportImage,
-			    &mainProject->file[0]->transform);
-	    gerbv_destroy_image (exportImage);
-	    break;
-	default:
-	    fprintf(stderr, _("A valid file was not loaded.\n"));
+	if (!main_export_project (mainProject, &export))
 	    exit(1);
-	}
 
 	/* exit now and don't start up gtk if this is a command line export */
 	exit(0);
@@ -122,6 +122,8 @@ typedef struct {
     gdouble length_sum;
 
     int dump_parsed_image;
+
+    GThread *mainThread;	/* The thread running the GTK main loop */
 } gerbv_screen_t;
 
 struct log_struct {
@@ -130,9 +132,47 @@ struct log_struct {
     gchar *message;
 };
 
+/* The formats of command line exports */
+enum exp_type {
+    EXP_TYPE_NONE = -1,
+    EXP_TYPE_PNG,
+    EXP_TYPE_PDF,
+    EXP_TYPE_SVG,
+    EXP_TYPE_PS,
+    EXP_TYPE_RS274X,
+    EXP_TYPE_DRILL,
+    EXP_TYPE_IDRILL,
+};
+
+/* One export, as given by the command line options */
+typedef struct {
+    enum exp_type type;
+    const gchar *filename;	/* NULL for the default of the type */
+    gboolean userSuppliedOrigin;
+    gboolean userSuppliedWindow;
+    gboolean userSuppliedWindowInPixels;
+    gboolean userSuppliedDpi;
+    gboolean antiAlias;
+    gfloat originX, originY;	/* inches */
+    gfloat dpiX, dpiY;
+    gfloat width, height;	/* inches, or pixels for windows in pixels */
+    gfloat border;		/* fraction of the width/height */
+    gerbv_user_transformation_t *transformations;	/* per file index, used
+				   to merge the layers of vector exports */
+} main_export_t;
+
 extern gerbv_screen_t screen;
 extern gerbv_project_t *mainProject;
 
+void
+main_set_default_layer_color (gerbv_fileinfo_t *fileInfo, gint index);
+
+enum exp_type
+main_export_type_from_name (const gchar *name);
+
+gboolean
+main_export_project (gerbv_project_t *gerbvProject, main_export_t *export);
+
 void
 main_save_as_project_from_filename(gerbv_project_t *gerbvProject, gchar *filename);
 
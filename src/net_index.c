@@ -0,0 +1,670 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * net_index.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file net_index.c
+    \brief Uniform grid spatial index over the net bounding boxes of an image
+    \ingroup libgerbv
+
+    The renderers use the index to visit only the nets which intersect the
+    visible window instead of walking the whole netlist on every redraw.
+    A query returns the nets in netlist order, so layer and netstate
+    transformations, polarities and knockouts are applied exactly as they
+    are during a full walk.
+
+    The index also caches the fields the renderers read for every net in
+    separate arrays (see net_index_rows_t), so drawing walks a few dense
+    arrays instead of chasing the netlist pointers, and only follows a
+    row back to its gerbv_net_t for arcs, labels and layer changes.
+    This is a render-walk cache on top of the netlist, not a smaller
+    form of it: on 64-bit hosts a row takes 87 bytes, plus 4 bytes for
+    every grid cell its net touches, next to the 120 bytes of the
+    gerbv_net_t, so an indexed image holds roughly 1.8 times the memory
+    of its nets.
+    Polygon areas are flattened into point arrays when the index is
+    built.  For every power of two of the zoom drawn, the nets smaller
+    than a pixel are also binned into a coarse raster of cells (see
+    net_index_get_lod()), which the cairo renderer fills instead of
+    drawing those nets one by one.  The netlist itself stays the
+    authoritative copy, and every edit of it must invalidate the index.
+    The index is reference counted, so a draw that took it keeps it
+    even if an edit replaces it meanwhile.
+*/
+
+#include "gerbv.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "common.h"
+#include "net_index.h"
+
+#define dprintf if(DEBUG) printf
+
+/* Nets covering more grid cells than this are kept in a separate list
+   instead of being added to every cell (e.g. large polygon pours) */
+#define NET_INDEX_MAX_CELL_SPAN 64
+/* Upper limit of the grid size */
+#define NET_INDEX_MAX_CELLS (1 << 20)
+
+struct net_index {
+	net_index_rows_t netRows;	/*!< renderable nets, in netlist order */
+
+	GArray *alwaysNets;		/*!< indexes returned by every query */
+	GArray *largeNets;		/*!< indexes too large for the grid */
+
+	gdouble minX, minY;
+	gdouble cellWidth, cellHeight;
+	guint columns, rows;
+	guint *cellStart;		/*!< columns*rows+1 offsets into cellNets */
+	guint *cellNets;		/*!< net indexes of all cells */
+
+	GPtrArray *lods;		/*!< net_index_lod_t of the zoom bands drawn */
+	gint generation;		/*!< netEditGeneration the index was built at */
+	volatile gint refCount;		/*!< the image and every draw using it */
+};
+
+G_LOCK_DEFINE_STATIC (net_index);
+
+/* Bumped by net_index_nets_changed().  gerbv_image_delete_net() gets no
+   image, so every index built before such a delete is rebuilt on its
+   next use */
+static volatile gint netEditGeneration = 0;
+
+static gboolean
+net_index_box_is_valid (const gerbv_render_size_t *box)
+{
+	/* this also catches NaN and the unset HUGE_VAL boxes */
+	return (box->left <= box->right) && (box->bottom <= box->top);
+}
+
+static void
+net_index_box_to_cells (const net_index_t *netIndex,
+		gdouble left, gdouble bottom, gdouble right, gdouble top,
+		guint *col1, guint *row1, guint *col2, guint *row2)
+{
+	gdouble c1, r1, c2, r2;
+
+	c1 = floor ((left - netIndex->minX) / netIndex->cellWidth);
+	c2 = floor ((right - netIndex->minX) / netIndex->cellWidth);
+	r1 = floor ((bottom - netIndex->minY) / netIndex->cellHeight);
+	r2 = floor ((top - netIndex->minY) / netIndex->cellHeight);
+
+	*col1 = (c1 < 0) ? 0 : ((c1 >= netIndex->columns) ? netIndex->columns - 1 : c1);
+	*col2 = (c2 < 0) ? 0 : ((c2 >= netIndex->columns) ? netIndex->columns - 1 : c2);
+	*row1 = (r1 < 0) ? 0 : ((r1 >= netIndex->rows) ? netIndex->rows - 1 : r1);
+	*row2 = (r2 < 0) ? 0 : ((r2 >= netIndex->rows) ? netIndex->rows - 1 : r2);
+}
+
+static void
+net_index_polygon_add_point (GArray *points, GArray *corners,
+		gdouble x, gdouble y, guint8 corner)
+{
+	g_array_append_val (points, x);
+	g_array_append_val (points, y);
+	g_array_append_val (corners, corner);
+}
+
+/* Flattens the polygon area started by polygonStartNet the way
+   draw_render_polygon_object() used to trace it net by net */
+static net_index_polygon_t *
+net_index_flatten_polygon (gerbv_net_t *polygonStartNet)
+{
+	net_index_polygon_t *polygon = g_new (net_index_polygon_t, 1);
+	GArray *points = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	GArray *corners = g_array_new (FALSE, FALSE, sizeof (guint8));
+	gerbv_net_t *currentNet;
+	gboolean closed = FALSE;
+	gdouble angleDiff, angle, radius;
+	gint i, steps;
+
+	for (currentNet = polygonStartNet->next; currentNet != NULL && !closed;
+			currentNet = currentNet->next) {
+		if (corners->len == 0) {
+			net_index_polygon_add_point (points, corners,
+					currentNet->stop_x, currentNet->stop_y, TRUE);
+			continue;
+		}
+
+		switch (currentNet->interpolation) {
+		case GERBV_INTERPOLATION_x10 :
+		case GERBV_INTERPOLATION_LINEARx01 :
+		case GERBV_INTERPOLATION_LINEARx001 :
+		case GERBV_INTERPOLATION_LINEARx1 :
+			net_index_polygon_add_point (points, corners,
+					currentNet->stop_x, currentNet->stop_y, TRUE);
+			break;
+		case GERBV_INTERPOLATION_CW_CIRCULAR :
+		case GERBV_INTERPOLATION_CCW_CIRCULAR :
+			angleDiff = currentNet->cirseg->angle2 -
+				currentNet->cirseg->angle1;
+			steps = MAX (1, (gint) ceil (fabs (angleDiff)));
+			radius = currentNet->cirseg->width/2.0;
+			for (i = 0; i <= steps; i++) {
+				angle = DEG2RAD (currentNet->cirseg->angle1 +
+						angleDiff * i / steps);
+				net_index_polygon_add_point (points, corners,
+					currentNet->cirseg->cp_x + radius*cos (angle),
+					currentNet->cirseg->cp_y + radius*sin (angle),
+					FALSE);
+			}
+			break;
+		case GERBV_INTERPOLATION_PAREA_END :
+			closed = TRUE;
+			break;
+		default :
+			break;
+		}
+	}
+
+	/* an unterminated area was never drawn */
+	if (!closed)
+		g_array_set_size (corners, 0);
+
+	polygon->count = corners->len;
+	polygon->box.left = polygon->box.bottom = HUGE_VAL;
+	polygon->box.right = polygon->box.top = -HUGE_VAL;
+	for (i = 0; i < polygon->count; i++) {
+		gdouble x = g_array_index (points, gdouble, 2*i);
+		gdouble y = g_array_index (points, gdouble, 2*i + 1);
+
+		polygon->box.left = MIN (polygon->box.left, x);
+		polygon->box.right = MAX (polygon->box.right, x);
+		polygon->box.bottom = MIN (polygon->box.bottom, y);
+		polygon->box.top = MAX (polygon->box.top, y);
+	}
+	polygon->points = (gdouble *) g_array_free (points, FALSE);
+	polygon->corners = (guint8 *) g_array_free (corners, FALSE);
+
+	return polygon;
+}
+
+static net_index_t *
+net_index_build (gerbv_image_t *image)
+{
+	net_index_t *netIndex;
+	net_index_rows_t *netRows;
+	gerbv_net_t *net;
+	gerbv_layer_t *oldLayer = image->layers;
+	gerbv_netstate_t *oldState = image->states;
+	gboolean *inGrid;
+	gdouble minX = HUGE_VAL, minY = HUGE_VAL;
+	gdouble maxX = -HUGE_VAL, maxY = -HUGE_VAL;
+	gdouble width, height, cells;
+	guint i, c, r, col1, row1, col2, row2, gridCount = 0;
+
+	netIndex = g_new0 (net_index_t, 1);
+	/* taken first, so an edit during the build is not missed */
+	netIndex->generation = g_atomic_int_get (&netEditGeneration);
+	netIndex->refCount = 1;
+	netRows = &netIndex->netRows;
+	netIndex->alwaysNets = g_array_new (FALSE, FALSE, sizeof (guint));
+	netIndex->largeNets = g_array_new (FALSE, FALSE, sizeof (guint));
+	netIndex->lods = g_ptr_array_new ();
+
+	for (net = image->netlist->next; net != NULL;
+			net = gerbv_image_return_next_renderable_object (net))
+		netRows->count++;
+
+	netRows->nets = g_new (gerbv_net_t *, netRows->count);
+	netRows->startX = g_new (gdouble, netRows->count);
+	netRows->startY = g_new (gdouble, netRows->count);
+	netRows->stopX = g_new (gdouble, netRows->count);
+	netRows->stopY = g_new (gdouble, netRows->count);
+	netRows->apertures = g_new (gint, netRows->count);
+	netRows->apertureStates = g_new (guint8, netRows->count);
+	netRows->interpolations = g_new (guint8, netRows->count);
+	netRows->flags = g_new0 (guint8, netRows->count);
+	netRows->boxes = g_new (gerbv_render_size_t, netRows->count);
+	netRows->polygons = g_new0 (net_index_polygon_t *, netRows->count);
+	inGrid = g_new0 (gboolean, netRows->count);
+
+	for (i = 0, net = image->netlist->next; net != NULL;
+			i++, net = gerbv_image_return_next_renderable_object (net)) {
+		gerbv_step_and_repeat_t *sr = &net->layer->stepAndRepeat;
+		gerbv_render_size_t *box = &netRows->boxes[i];
+		gdouble srX = (sr->X - 1) * sr->dist_X;
+		gdouble srY = (sr->Y - 1) * sr->dist_Y;
+
+		netRows->nets[i] = net;
+		netRows->startX[i] = net->start_x;
+		netRows->startY[i] = net->start_y;
+		netRows->stopX[i] = net->stop_x;
+		netRows->stopY[i] = net->stop_y;
+		netRows->apertures[i] = net->aperture;
+		netRows->apertureStates[i] = net->aperture_state;
+		netRows->interpolations[i] = net->interpolation;
+		if ((sr->X != 1) || (sr->Y != 1))
+			netRows->flags[i] |= NET_INDEX_ROW_STEP_AND_REPEAT;
+		if (net->cirseg != NULL)
+			netRows->flags[i] |= NET_INDEX_ROW_ARC;
+		if (net->label != NULL)
+			netRows->flags[i] |= NET_INDEX_ROW_LABEL;
+		if (net->interpolation == GERBV_INTERPOLATION_PAREA_START)
+			netRows->polygons[i] = net_index_flatten_polygon (net);
+
+		*box = net->boundingBox;
+		box->left += MIN (srX, 0);
+		box->right += MAX (srX, 0);
+		box->bottom += MIN (srY, 0);
+		box->top += MAX (srY, 0);
+
+		/* the renderers apply layer and netstate changes as they walk the
+		   list, so the nets starting a new layer or netstate are always
+		   visited to keep those transitions intact */
+		if ((net->layer != oldLayer) || (net->state != oldState)) {
+			netRows->flags[i] |= NET_INDEX_ROW_NEW_LAYER_OR_STATE;
+			g_array_append_val (netIndex->alwaysNets, i);
+			oldLayer = net->layer;
+			oldState = net->state;
+			continue;
+		}
+
+		/* nets without a usable box are never visible */
+		if (!net_index_box_is_valid (box) || isinf (box->left)
+				|| isinf (box->right) || isinf (box->bottom)
+				|| isinf (box->top))
+			continue;
+
+		inGrid[i] = TRUE;
+		gridCount++;
+		minX = MIN (minX, box->left);
+		minY = MIN (minY, box->bottom);
+		maxX = MAX (maxX, box->right);
+		maxY = MAX (maxY, box->top);
+	}
+
+	/* size the grid to hold about two nets per cell, with cells of
+	   roughly the same aspect ratio as the image */
+	if (gridCount > 0) {
+		width = MAX (maxX - minX, 1e-6);
+		height = MAX (maxY - minY, 1e-6);
+		cells = CLAMP (gridCount / 2, 1, NET_INDEX_MAX_CELLS);
+		netIndex->columns = CLAMP (round (sqrt (cells * width / height)),
+					1, NET_INDEX_MAX_CELLS);
+		netIndex->rows = CLAMP (round (cells / netIndex->columns),
+					1, NET_INDEX_MAX_CELLS / netIndex->columns);
+		netIndex->minX = minX;
+		netIndex->minY = minY;
+		netIndex->cellWidth = width / netIndex->columns;
+		netIndex->cellHeight = height / netIndex->rows;
+	} else {
+		netIndex->columns = netIndex->rows = 1;
+		netIndex->cellWidth = netIndex->cellHeight = 1;
+	}
+	netIndex->cellStart = g_new0 (guint, netIndex->columns * netIndex->rows + 1);
+
+	/* first pass counts the nets of each cell... */
+	for (i = 0; i < netRows->count; i++) {
+		gerbv_render_size_t *box = &netRows->boxes[i];
+
+		if (!inGrid[i])
+			continue;
+
+		net_index_box_to_cells (netIndex, box->left, box->bottom,
+				box->right, box->top, &col1, &row1, &col2, &row2);
+		if ((col2 - col1 + 1) * (row2 - row1 + 1) > NET_INDEX_MAX_CELL_SPAN) {
+			g_array_append_val (netIndex->largeNets, i);
+			inGrid[i] = FALSE;
+			continue;
+		}
+		for (r = row1; r <= row2; r++)
+			for (c = col1; c <= col2; c++)
+				netIndex->cellStart[r * netIndex->columns + c + 1]++;
+	}
+	for (c = 1; c <= netIndex->columns * netIndex->rows; c++)
+		netIndex->cellStart[c] += netIndex->cellStart[c - 1];
+
+	/* ...and the second one fills them in netlist order */
+	netIndex->cellNets = g_new (guint,
+			netIndex->cellStart[netIndex->columns * netIndex->rows]);
+	for (i = 0; i < netRows->count; i++) {
+		gerbv_render_size_t *box = &netRows->boxes[i];
+
+		if (!inGrid[i])
+			continue;
+
+		net_index_box_to_cells (netIndex, box->left, box->bottom,
+				box->right, box->top, &col1, &row1, &col2, &row2);
+		for (r = row1; r <= row2; r++)
+			for (c = col1; c <= col2; c++)
+				netIndex->cellNets[netIndex->cellStart[r * netIndex->columns + c]++] = i;
+	}
+	/* filling advanced every start offset to the start of the next cell */
+	for (c = netIndex->columns * netIndex->rows; c > 0; c--)
+		netIndex->cellStart[c] = netIndex->cellStart[c - 1];
+	netIndex->cellStart[0] = 0;
+
+	g_free (inGrid);
+
+	dprintf ("Built net index: %u nets, %ux%u cells, %u large, %u always\n",
+			netRows->count, netIndex->columns, netIndex->rows,
+			netIndex->largeNets->len, netIndex->alwaysNets->len);
+
+	return netIndex;
+}
+
+
+/* Frees netIndex, once nobody uses it any more */
+static void
+net_index_free (net_index_t *netIndex)
+{
+	net_index_rows_t *netRows = &netIndex->netRows;
+	guint i;
+
+	for (i = 0; i < netRows->count; i++) {
+		if (netRows->polygons[i] == NULL)
+			continue;
+		g_free (netRows->polygons[i]->points);
+		g_free (netRows->polygons[i]->corners);
+		g_free (netRows->polygons[i]);
+	}
+	g_free (netRows->polygons);
+	for (i = 0; i < netIndex->lods->len; i++) {
+		net_index_lod_t *lod = g_ptr_array_index (netIndex->lods, i);
+		guint j;
+
+		for (j = 0; j < lod->runs->len; j++)
+			g_array_free (g_array_index (lod->runs,
+					net_index_lod_run_t, j).cells, TRUE);
+		g_array_free (lod->runs, TRUE);
+		g_free (lod->collapsed);
+		g_free (lod);
+	}
+	g_ptr_array_free (netIndex->lods, TRUE);
+	g_free (netRows->nets);
+	g_free (netRows->startX);
+	g_free (netRows->startY);
+	g_free (netRows->stopX);
+	g_free (netRows->stopY);
+	g_free (netRows->apertures);
+	g_free (netRows->apertureStates);
+	g_free (netRows->interpolations);
+	g_free (netRows->flags);
+	g_free (netRows->boxes);
+	g_array_free (netIndex->alwaysNets, TRUE);
+	g_array_free (netIndex->largeNets, TRUE);
+	g_free (netIndex->cellStart);
+	g_free (netIndex->cellNets);
+	g_free (netIndex);
+}
+
+
+/* Takes the index off image and returns it, or NULL.  The lock must be
+   held */
+static net_index_t *
+net_index_detach (gerbv_image_t *image)
+{
+	net_index_t *netIndex = image->netIndex;
+
+	image->netIndex = NULL;
+
+	return netIndex;
+}
+
+
+net_index_t *
+net_index_get (gerbv_image_t *image)
+{
+	net_index_t *netIndex, *oldIndex = NULL;
+
+	/* layers may be rendered from several threads at once */
+	G_LOCK (net_index);
+	if ((image->netIndex != NULL) && (image->netIndex->generation
+			!= g_atomic_int_get (&netEditGeneration)))
+		oldIndex = net_index_detach (image);
+	if (image->netIndex == NULL)
+		image->netIndex = net_index_build (image);
+	netIndex = image->netIndex;
+	g_atomic_int_inc (&netIndex->refCount);
+	G_UNLOCK (net_index);
+
+	if (oldIndex != NULL)
+		net_index_unref (oldIndex);
+
+	return netIndex;
+}
+
+
+void
+net_index_unref (net_index_t *netIndex)
+{
+	if (g_atomic_int_dec_and_test (&netIndex->refCount))
+		net_index_free (netIndex);
+}
+
+
+void
+net_index_nets_changed (void)
+{
+	g_atomic_int_inc (&netEditGeneration);
+}
+
+
+void
+net_index_invalidate (gerbv_image_t *image)
+{
+	net_index_t *netIndex;
+
+	G_LOCK (net_index);
+	netIndex = net_index_detach (image);
+	G_UNLOCK (net_index);
+
+	/* draws still using the index keep it until they are done */
+	if (netIndex != NULL)
+		net_index_unref (netIndex);
+}
+
+
+void
+net_index_net_to_box (gerbv_image_t *image, gerbv_layer_t *layer,
+		gerbv_netstate_t *state, cairo_matrix_t *matrix)
+{
+	cairo_matrix_init_identity (matrix);
+	cairo_matrix_translate (matrix, image->info->offsetA,
+			image->info->offsetB);
+	cairo_matrix_rotate (matrix, image->info->imageRotation);
+	cairo_matrix_rotate (matrix, layer->rotation);
+	cairo_matrix_scale (matrix, state->scaleA, state->scaleB);
+	cairo_matrix_translate (matrix, state->offsetA, state->offsetB);
+	switch (state->mirrorState) {
+	case GERBV_MIRROR_STATE_FLIPA:
+		cairo_matrix_scale (matrix, -1, 1);
+		break;
+	case GERBV_MIRROR_STATE_FLIPB:
+		cairo_matrix_scale (matrix, 1, -1);
+		break;
+	case GERBV_MIRROR_STATE_FLIPAB:
+		cairo_matrix_scale (matrix, -1, -1);
+		break;
+	default:
+		break;
+	}
+	if (state->axisSelect == GERBV_AXIS_SELECT_SWAPAB) {
+		cairo_matrix_rotate (matrix, M_PI + M_PI_2);
+		cairo_matrix_scale (matrix, 1, -1);
+	}
+}
+
+
+const net_index_rows_t *
+net_index_get_rows (net_index_t *netIndex)
+{
+	return &netIndex->netRows;
+}
+
+
+static net_index_lod_t *
+net_index_build_lod (net_index_t *netIndex, gint band)
+{
+	net_index_rows_t *netRows = &netIndex->netRows;
+	net_index_lod_t *lod = g_new0 (net_index_lod_t, 1);
+	net_index_lod_run_t *run = NULL;
+	gdouble halfCell;
+	guint i, collapsedCount = 0;
+
+	lod->band = band;
+	lod->cellSize = ldexp (1.0, -band);
+	lod->collapsed = g_new0 (guint8, netRows->count);
+	lod->runs = g_array_new (FALSE, FALSE, sizeof (net_index_lod_run_t));
+	halfCell = lod->cellSize / 2.0;
+
+	for (i = 0; i < netRows->count; i++) {
+		gerbv_render_size_t *box = &netRows->boxes[i];
+		gdouble x, y;
+		gint cell[2];
+
+		/* a run ends where the layer polarity may change */
+		if (netRows->flags[i] & NET_INDEX_ROW_NEW_LAYER_OR_STATE) {
+			if (run != NULL)
+				run->endRow = i;
+			run = NULL;
+		}
+
+		/* layer and netstate changes must still be walked, and repeated
+		   layers are stamped as blocks by the renderer */
+		if (netRows->flags[i] & (NET_INDEX_ROW_NEW_LAYER_OR_STATE
+				| NET_INDEX_ROW_STEP_AND_REPEAT | NET_INDEX_ROW_LABEL))
+			continue;
+		if ((netRows->interpolations[i] == GERBV_INTERPOLATION_DELETED)
+		 || ((netRows->apertureStates[i] == GERBV_APERTURE_STATE_OFF)
+		  && (netRows->interpolations[i] != GERBV_INTERPOLATION_PAREA_START)))
+			continue;
+		if (!net_index_box_is_valid (box)
+		 || (box->right - box->left >= halfCell)
+		 || (box->top - box->bottom >= halfCell))
+			continue;
+
+		x = floor ((box->left + box->right) / 2.0 / lod->cellSize);
+		y = floor ((box->bottom + box->top) / 2.0 / lod->cellSize);
+		if ((fabs (x) > G_MAXINT / 2) || (fabs (y) > G_MAXINT / 2))
+			continue;
+		cell[0] = x;
+		cell[1] = y;
+
+		if (run == NULL) {
+			net_index_lod_run_t newRun = {netRows->count,
+					cell[0], cell[1], cell[0], cell[1], NULL};
+
+			newRun.cells = g_array_new (FALSE, FALSE, sizeof (gint));
+			g_array_append_val (lod->runs, newRun);
+			run = &g_array_index (lod->runs, net_index_lod_run_t,
+					lod->runs->len - 1);
+		}
+		g_array_append_vals (run->cells, cell, 2);
+		run->left = MIN (run->left, cell[0]);
+		run->right = MAX (run->right, cell[0]);
+		run->bottom = MIN (run->bottom, cell[1]);
+		run->top = MAX (run->top, cell[1]);
+		lod->collapsed[i] = TRUE;
+		collapsedCount++;
+	}
+
+	dprintf ("Built level of detail %d: %u of %u nets collapsed into %u runs\n",
+			band, collapsedCount, netRows->count, lod->runs->len);
+
+	return lod;
+}
+
+
+const net_index_lod_t *
+net_index_get_lod (net_index_t *netIndex, gint band)
+{
+	net_index_lod_t *lod = NULL;
+	guint i;
+
+	G_LOCK (net_index);
+	for (i = 0; i < netIndex->lods->len; i++) {
+		lod = g_ptr_array_index (netIndex->lods, i);
+		if (lod->band == band)
+			break;
+		lod = NULL;
+	}
+	if (lod == NULL) {
+		lod = net_index_build_lod (netIndex, band);
+		g_ptr_array_add (netIndex->lods, lod);
+	}
+	G_UNLOCK (net_index);
+
+	return lod;
+}
+
+
+static gint
+net_index_compare (gconstpointer a, gconstpointer b)
+{
+	guint ia = *(const guint *)a, ib = *(const guint *)b;
+
+	return (ia > ib) - (ia < ib);
+}
+
+
+GArray *
+net_index_query (net_index_t *netIndex,
+		gdouble minX, gdouble minY, gdouble maxX, gdouble maxY)
+{
+	GArray *found = g_array_new (FALSE, FALSE, sizeof (guint));
+	const gerbv_render_size_t *boxes = netIndex->netRows.boxes;
+	guint i, j, c, r, col1, row1, col2, row2, last, count;
+
+#define NET_INDEX_BOX_OVERLAPS(box) \
+	(!((box)->right < minX || (box)->left > maxX \
+	|| (box)->top < minY || (box)->bottom > maxY))
+
+	g_array_append_vals (found, netIndex->alwaysNets->data,
+			netIndex->alwaysNets->len);
+
+	for (j = 0; j < netIndex->largeNets->len; j++) {
+		i = g_array_index (netIndex->largeNets, guint, j);
+		if (NET_INDEX_BOX_OVERLAPS (&boxes[i]))
+			g_array_append_val (found, i);
+	}
+
+	if ((netIndex->cellNets != NULL) && (maxX >= minX) && (maxY >= minY)) {
+		net_index_box_to_cells (netIndex, minX, minY, maxX, maxY,
+				&col1, &row1, &col2, &row2);
+		for (r = row1; r <= row2; r++) {
+			for (c = col1; c <= col2; c++) {
+				guint cell = r * netIndex->columns + c;
+
+				for (j = netIndex->cellStart[cell];
+						j < netIndex->cellStart[cell + 1]; j++) {
+					i = netIndex->cellNets[j];
+					if (NET_INDEX_BOX_OVERLAPS (&boxes[i]))
+						g_array_append_val (found, i);
+				}
+			}
+		}
+	}
+
+#undef NET_INDEX_BOX_OVERLAPS
+
+	/* restore netlist order and drop rows found in several cells */
+	g_array_sort (found, net_index_compare);
+	for (j = 0, count = 0, last = G_MAXUINT; j < found->len; j++) {
+		i = g_array_index (found, guint, j);
+		if (i == last)
+			continue;
+		g_array_index (found, guint, count++) = i;
+		last = i;
+	}
+	g_array_set_size (found, count);
+
+	return found;
+}
@@ -0,0 +1,130 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * net_index.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file net_index.h
+    \brief Header info for the spatial index over the nets of an image
+    \ingroup libgerbv
+*/
+
+#ifndef NET_INDEX_H
+#define NET_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct net_index net_index_t;
+
+/* Row flags of net_index_rows_t */
+enum {
+	NET_INDEX_ROW_NEW_LAYER_OR_STATE = 1 << 0, /* row starts a new layer or netstate */
+	NET_INDEX_ROW_STEP_AND_REPEAT = 1 << 1,	/* layer of the row is repeated */
+	NET_INDEX_ROW_ARC = 1 << 2,		/* net->cirseg is set */
+	NET_INDEX_ROW_LABEL = 1 << 3		/* net->label is set */
+};
+
+/* A polygon area flattened into one closed outline, in net coordinates.
+   Arcs are cut into steps of at most one degree */
+typedef struct {
+	guint count;			/* number of points */
+	gdouble *points;		/* x, y pairs */
+	guint8 *corners;		/* TRUE where a net ends, FALSE inside arcs */
+	gerbv_render_size_t box;	/* bounds of the points */
+} net_index_polygon_t;
+
+/* A cache of the renderable nets of an image, in netlist order, stored
+   column by column so the renderers only touch the fields they need for
+   each net.  It comes on top of the netlist, it doesn't replace it.
+   nets[] maps every row back to its gerbv_net_t for the rarely used
+   fields (arcs, labels and the selection).  Polygon areas are flattened
+   once, so redraws replay the outline instead of walking its nets */
+typedef struct {
+	guint count;
+	gerbv_net_t **nets;
+	gdouble *startX, *startY;
+	gdouble *stopX, *stopY;
+	gint *apertures;
+	guint8 *apertureStates;		/* gerbv_aperture_state_t */
+	guint8 *interpolations;		/* gerbv_interpolation_t */
+	guint8 *flags;
+	gerbv_render_size_t *boxes;	/* net boxes grown by step and repeat */
+	net_index_polygon_t **polygons;	/* outlines of the rows starting a
+					   polygon area, NULL for other rows */
+} net_index_rows_t;
+
+/* The collapsed nets of one layer and netstate, for the rows before
+   endRow */
+typedef struct {
+	guint endRow;			/* first row after the run */
+	gint left, bottom, right, top;	/* bounds of the cell numbers */
+	GArray *cells;			/* gint x, y pairs of cell numbers */
+} net_index_lod_run_t;
+
+/* Level of detail data of one zoom band.  Nets smaller than half a cell
+   can't be told apart from a dot at any scale of the band, so they are
+   drawn by filling the cell holding their center instead */
+typedef struct {
+	gint band;
+	gdouble cellSize;		/* 2^-band units, one to two pixels */
+	guint8 *collapsed;		/* TRUE for the rows drawn as a cell */
+	GArray *runs;			/* net_index_lod_run_t, in netlist order */
+} net_index_lod_t;
+
+/* Returns a reference to the spatial index of image, building it on
+   first use.  An edit of the image gives it a new index, but the one
+   returned stays valid until it is released with net_index_unref(), so
+   a draw takes it once and uses it throughout */
+net_index_t *net_index_get (gerbv_image_t *image);
+
+/* Releases a reference returned by net_index_get() */
+void net_index_unref (net_index_t *index);
+
+/* Drops the spatial index of image, if any, which is rebuilt on its
+   next use.  Must be called whenever nets are added to or deleted from
+   the image, or their bounding boxes change */
+void net_index_invalidate (gerbv_image_t *image);
+
+/* Makes every index rebuild on its next use, for edits of nets whose
+   image isn't known.  Called by gerbv_image_delete_net() */
+void net_index_nets_changed (void);
+
+/* Returns the rows of all renderable nets of the image */
+const net_index_rows_t *net_index_get_rows (net_index_t *index);
+
+/* Returns the level of detail data for device scales of 2^band to
+   2^(band+1) pixels per unit, building it on first use */
+const net_index_lod_t *net_index_get_lod (net_index_t *index, gint band);
+
+/* Sets matrix to the transformation gerber.c applies to the bounding
+   boxes of the nets of layer and state, from net to box coordinates */
+void net_index_net_to_box (gerbv_image_t *image, gerbv_layer_t *layer,
+		gerbv_netstate_t *state, cairo_matrix_t *matrix);
+
+/* Returns the rows (guint) of the renderable nets which may be visible
+   inside the given window, in netlist order.  Free the array with
+   g_array_free() */
+GArray *net_index_query (net_index_t *index,
+		gdouble minX, gdouble minY, gdouble maxX, gdouble maxY);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_INDEX_H */
@@ -33,9 +33,11 @@
 #include <locale.h>
 
 #include "gerber.h"
+#include "gerb_image.h"
 #include "common.h"
 #include "csv.h"
 #include "pick-and-place.h"
+#include "gerb_arena.h"
 
 void gerb_transf_free(gerbv_transf_t *transf)
 {
@@ -210,7 +212,10 @@ pick_and_place_parse_file(gerb_file_t *fd)
      * many locales redefine "." as "," and so on, so sscanf has problems when
      * reading Pick and Place files using %f format 
      */
-    setlocale(LC_NUMERIC, "C" );
+    /* don't switch if it is already set, since other threads may
+       be parsing with it */
+    if (g_strcmp0 (setlocale(LC_NUMERIC, NULL), "C") != 0)
+	setlocale(LC_NUMERIC, "C" );
 
     while ( fgets(buf, MAXL, fd->fd) != NULL ) {
 	int len = strlen(buf)-1;
@@ -504,6 +509,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 {
     gerbv_image_t *image = NULL;
     gerbv_net_t *curr_net = NULL;
+    gerbv_aperture_t *aperture;
     int i;
     gerbv_transf_t *tr_rot = gerb_transf_new();
     gerbv_drill_stats_t *stats;  /* Eventually replace with pick_place_stats */
@@ -555,19 +561,19 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
     image->info->max_x = -HUGE_VAL;
     image->info->max_y = -HUGE_VAL;
 
-    image->aperture[0] = (gerbv_aperture_t *)g_malloc0(sizeof(gerbv_aperture_t));
-    assert(image->aperture[0] != NULL);
-    image->aperture[0]->type = GERBV_APTYPE_CIRCLE;
-    image->aperture[0]->amacro = NULL;
-    image->aperture[0]->parameter[0] = 0.01;
-    image->aperture[0]->nuf_parameters = 1;
+    aperture = (gerbv_aperture_t *)g_malloc0(sizeof(gerbv_aperture_t));
+    assert(aperture != NULL);
+    aperture->type = GERBV_APTYPE_CIRCLE;
+    aperture->amacro = NULL;
+    aperture->parameter[0] = 0.01;
+    aperture->nuf_parameters = 1;
+    gerbv_image_set_aperture (image, 0, aperture);
 
     for (i = 0; i < parsedPickAndPlaceData->len; i++) {
 	PnpPartData partData = g_array_index(parsedPickAndPlaceData, PnpPartData, i);
 	float radius,labelOffset;  
 
-	curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	curr_net = curr_net->next;
+	curr_net = gerbv_image_append_net (image);
 	assert(curr_net != NULL);
 
 	curr_net->layer = image->layers;
@@ -614,8 +620,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    (partData.shape == PART_SHAPE_STD)) {
 	    // TODO: draw rectangle length x width taking into account rotation or pad x,y
 
-	    curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	    curr_net = curr_net->next;
+	    curr_net = gerbv_image_append_net (image);
 	    assert(curr_net != NULL);
 
 	    gerb_transf_apply(partData.length/2, partData.width/2, tr_rot, 
@@ -634,8 +639,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    curr_net->state = image->states;
 	    pick_and_place_reset_bounding_box (curr_net);
 	    
-	    curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	    curr_net = curr_net->next;
+	    curr_net = gerbv_image_append_net (image);
 	    assert(curr_net != NULL);
 
 	    gerb_transf_apply(-partData.length/2, partData.width/2, tr_rot, 
@@ -653,8 +657,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    curr_net->state = image->states;
 	    pick_and_place_reset_bounding_box (curr_net);
 
-	    curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	    curr_net = curr_net->next;
+	    curr_net = gerbv_image_append_net (image);
 	    assert(curr_net != NULL);
 
 	    gerb_transf_apply(-partData.length/2, -partData.width/2, tr_rot, 
@@ -672,8 +675,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    curr_net->state = image->states;
 	    pick_and_place_reset_bounding_box (curr_net);
 	    
-	    curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	    curr_net = curr_net->next;
+	    curr_net = gerbv_image_append_net (image);
 	    assert(curr_net != NULL);
 	    
 	    gerb_transf_apply(partData.length/2, -partData.width/2, tr_rot, 
@@ -691,8 +693,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    curr_net->state = image->states;
 	    pick_and_place_reset_bounding_box (curr_net);
 
-	    curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	    curr_net = curr_net->next;
+	    curr_net = gerbv_image_append_net (image);
 	    assert(curr_net != NULL);
 
 	    if (partData.shape == PART_SHAPE_RECTANGLE) {
@@ -716,8 +717,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 		curr_net->state = image->states;
 		pick_and_place_reset_bounding_box (curr_net);
 
-		curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-		curr_net = curr_net->next;
+		curr_net = gerbv_image_append_net (image);
 		assert(curr_net != NULL);
 
 		gerb_transf_apply(partData.length/2, partData.width/4, tr_rot, 
@@ -758,8 +758,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    curr_net->layer = image->layers;
 	    curr_net->state = image->states;
 	    
-	    curr_net->next = (gerbv_net_t *)g_malloc0(sizeof(gerbv_net_t));
-	    curr_net = curr_net->next;
+	    curr_net = gerbv_image_append_net (image);
 	    assert(curr_net != NULL);
 	    
 	    curr_net->start_x = partData.mid_x;
@@ -777,7 +776,7 @@ pick_and_place_convert_pnp_data_to_image(GArray *parsedPickAndPlaceData, gint bo
 	    curr_net->state = image->states;
 	    pick_and_place_reset_bounding_box (curr_net);
 	    
-	    curr_net->cirseg = g_new0 (gerbv_cirseg_t,1);
+	    curr_net->cirseg = gerb_arena_new0 (image->arena, gerbv_cirseg_t);
 	    curr_net->cirseg->angle1 = 0.0;
 	    curr_net->cirseg->angle2 = 360.0;
 	    curr_net->cirseg->cp_x = partData.mid_x;
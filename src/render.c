@@ -53,6 +53,7 @@
 #include "interface.h"
 #include "render.h"
 #include "selection.h"
+#include "hit_test.h"
 
 #ifdef WIN32
 # include <cairo-win32.h>
@@ -65,8 +66,71 @@
 
 #define dprintf if(DEBUG) printf
 
+/* Edge length of the cached layer tiles, in pixels */
+#define RENDER_TILE_SIZE 256
+/* Memory used by cached tiles before old ones are dropped.  Tiles needed
+   for the current screen are never dropped, so this may be exceeded */
+#define RENDER_TILE_CACHE_MAX_BYTES (256 * 1024 * 1024)
+/* Sub-pixel resolution of the tile grid alignment */
+#define RENDER_TILE_PHASE_STEPS 64
+/* Largest zoom factor between a cached tile and a tile it is scaled to
+   as a preview, until the background render of that tile is done */
+#define RENDER_TILE_PREVIEW_SCALE 4
+/* Resolution divisor of the draft rendered on the main thread where no
+   cached tile covers a new tile */
+#define RENDER_TILE_DRAFT_DIVISOR 4
+
 gerbv_render_info_t screenRenderInfo;
 
+/* A cached raster of one layer, for one zoom level and grid position */
+typedef struct {
+	gerbv_fileinfo_t *file;
+	gint64 zoomLevel;	/* quantized log of the scale factor */
+	gint phaseX, phaseY;	/* sub-pixel offset of the tile grid */
+	gint column, row;	/* grid position, counted up from the origin */
+	cairo_surface_t *surface;
+	guint lastFrame;	/* last screen refresh the tile was used in */
+	GList link;		/* position in the LRU queue */
+	gboolean preview;	/* surface holds a preview, the tile is being
+				   rendered in the background */
+	gint jobEpoch, jobView;	/* when the background render was queued */
+	gdouble scaleX, scaleY;	/* scale factors the tile was rendered at */
+	gerbv_image_t *image;	/* image of file when the tile was made */
+} render_tile_t;
+
+/* A tile rendered by the background threads */
+typedef struct {
+	render_tile_t key;
+	gerbv_render_info_t renderInfo;
+	gint epoch, view;
+	cairo_surface_t *surface;	/* NULL if the job was skipped */
+} render_tile_job_t;
+
+static GHashTable *renderTileTable = NULL;
+static GQueue renderTileQueue = { NULL, NULL, 0 };	/* most recently used first */
+/* The tiles of the screen when the cache was last cleared, which only
+   serve as previews of the tiles replacing them */
+static GQueue renderTileStaleQueue = { NULL, NULL, 0 };
+static gsize renderTileBytes = 0;
+static guint renderTileFrame = 0;
+
+/* Threads rendering the tiles of the screen in the background, so the
+   GUI stays responsive during long redraws */
+static GThreadPool *renderTilePool = NULL;
+/* Finished jobs, waiting for the main thread to pick them up */
+static GAsyncQueue *renderTileDoneQueue = NULL;
+/* Bumped whenever the layers change, so background tiles started
+   before are thrown away */
+static volatile gint renderTileEpoch = 0;
+/* Bumped whenever the view changes, so queued tiles of an earlier view
+   are skipped */
+static volatile gint renderTileView = 0;
+/* Held by the background threads while they read the layers */
+static GRWLock renderTileDataLock;
+
+static void render_composite_layers_from_tiles (void);
+static gboolean render_tile_deliver (gpointer data);
+
 /* ------------------------------------------------------ */
 void
 render_zoom_display (gint zoomType, gdouble scaleFactor, gdouble mouseX, gdouble mouseY)
@@ -127,7 +191,7 @@ render_zoom_display (gint zoomType, gdouble scaleFactor, gdouble mouseX, gdouble
 		screenRenderInfo.lowerLeftY = mouseCoordinateY - (screenRenderInfo.displayHeight - mouseY) /
 			screenRenderInfo.scaleFactorY;
 	}
-	render_refresh_rendered_image_on_screen();
+	render_refresh_view_on_screen();
 	return;
 }
 
@@ -177,7 +241,7 @@ render_calculate_zoom_from_outline(GtkWidget *widget, GdkEventButton *event)
 		screenRenderInfo.lowerLeftY = centerPointY - (screenRenderInfo.displayHeight /
 					2.0 / screenRenderInfo.scaleFactorY);
 	}
-	render_refresh_rendered_image_on_screen();
+	render_refresh_view_on_screen();
 }
 
 /* ------------------------------------------------------ */
@@ -423,7 +487,680 @@ static void render_selection (void)
 }
 
 /* ------------------------------------------------------ */
+static guint
+render_tile_hash (gconstpointer key)
+{
+	const render_tile_t *tile = key;
+
+	return g_direct_hash (tile->file) ^ (guint) tile->zoomLevel
+		^ (tile->phaseX << 6) ^ (tile->phaseY << 12)
+		^ ((guint) tile->column * 73856093U)
+		^ ((guint) tile->row * 19349663U);
+}
+
+static gboolean
+render_tile_equal (gconstpointer a, gconstpointer b)
+{
+	const render_tile_t *t1 = a, *t2 = b;
+
+	return t1->file == t2->file && t1->zoomLevel == t2->zoomLevel
+		&& t1->phaseX == t2->phaseX && t1->phaseY == t2->phaseY
+		&& t1->column == t2->column && t1->row == t2->row;
+}
+
+static void
+render_tile_free (render_tile_t *tile)
+{
+	cairo_surface_destroy (tile->surface);
+	renderTileBytes -= RENDER_TILE_SIZE * RENDER_TILE_SIZE * 4;
+	g_free (tile);
+}
+
+/* ------------------------------------------------------ */
+static void
+render_tile_stale_free (void)
+{
+	render_tile_t *tile;
+
+	while (renderTileStaleQueue.head) {
+		tile = renderTileStaleQueue.head->data;
+		g_queue_unlink (&renderTileStaleQueue, &tile->link);
+		render_tile_free (tile);
+	}
+}
+
+/* ------------------------------------------------------ */
+/** Drops all cached layer tiles.
+ *  Must be called whenever the contents or look of any layer may have
+ *  changed, since the tiles don't record what they were rendered from.
+ *  The finished tiles of the screen are kept as previews until the next
+ *  call. */
+static void
+render_tile_cache_clear (void)
+{
+	render_tile_t *tile;
+
+	g_atomic_int_inc (&renderTileEpoch);
+	if (renderTileTable)
+		g_hash_table_remove_all (renderTileTable);
+
+	render_tile_stale_free ();
+	while (renderTileQueue.head) {
+		tile = renderTileQueue.head->data;
+		g_queue_unlink (&renderTileQueue, &tile->link);
+		if ((tile->lastFrame == renderTileFrame) && !tile->preview)
+			g_queue_push_tail_link (&renderTileStaleQueue, &tile->link);
+		else
+			render_tile_free (tile);
+	}
+}
+
+/* ------------------------------------------------------ */
+/** Sets up renderInfo to render the tile of key as if it was a small
+ *  screen placed on the grid. */
+static void
+render_tile_get_render_info (const render_tile_t *key,
+		gerbv_render_info_t *renderInfo)
+{
+	*renderInfo = screenRenderInfo;
+	renderInfo->lowerLeftX = (key->column * RENDER_TILE_SIZE +
+			(gdouble) key->phaseX / RENDER_TILE_PHASE_STEPS) /
+			screenRenderInfo.scaleFactorX;
+	renderInfo->lowerLeftY = (key->row * RENDER_TILE_SIZE +
+			(gdouble) key->phaseY / RENDER_TILE_PHASE_STEPS) /
+			screenRenderInfo.scaleFactorY;
+	renderInfo->displayWidth = RENDER_TILE_SIZE;
+	renderInfo->displayHeight = RENDER_TILE_SIZE;
+	/* tiles are only shown on screen */
+	renderInfo->allowCoarseNets = TRUE;
+}
+
+/* ------------------------------------------------------ */
+/** Renders the tile of a job on a background thread, unless the layers
+ *  or the view changed since it was queued. */
+static void
+render_tile_job (gpointer data, gpointer user_data)
+{
+	render_tile_job_t *job = data;
+	cairo_t *cr;
+
+	g_rw_lock_reader_lock (&renderTileDataLock);
+	if ((job->epoch == g_atomic_int_get (&renderTileEpoch))
+			&& (job->view == g_atomic_int_get (&renderTileView))) {
+		job->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+				RENDER_TILE_SIZE, RENDER_TILE_SIZE);
+		cr = cairo_create (job->surface);
+		gerbv_render_layer_to_cairo_target (cr, job->key.file,
+				&job->renderInfo);
+		cairo_destroy (cr);
+	}
+	g_rw_lock_reader_unlock (&renderTileDataLock);
+
+	g_async_queue_push (renderTileDoneQueue, job);
+	g_idle_add (render_tile_deliver, NULL);
+}
+
+/* ------------------------------------------------------ */
+/** Replaces the previews by the finished background tiles, and redraws
+ *  the screen with them.  Runs on the main thread. */
+static gboolean
+render_tile_deliver (gpointer data)
+{
+	render_tile_job_t *job;
+	gboolean changed = FALSE;
+
+	if (!renderTileDoneQueue)
+		return FALSE;
+
+	while ((job = g_async_queue_try_pop (renderTileDoneQueue)) != NULL) {
+		render_tile_t *tile = NULL;
+
+		if (job->surface && (job->epoch == renderTileEpoch)
+				&& renderTileTable)
+			tile = g_hash_table_lookup (renderTileTable, &job->key);
+		if (tile && tile->preview) {
+			cairo_surface_destroy (tile->surface);
+			tile->surface = job->surface;
+			tile->preview = FALSE;
+			changed = TRUE;
+		} else if (job->surface) {
+			cairo_surface_destroy (job->surface);
+		}
+		g_free (job);
+	}
+
+	if (changed) {
+		render_composite_layers_from_tiles ();
+		callbacks_force_expose_event_for_screen ();
+	}
+
+	return FALSE;
+}
+
+/* ------------------------------------------------------ */
+/** Queues tile to be rendered on the background threads.  Returns FALSE
+ *  if there are no threads to render it. */
+static gboolean
+render_tile_queue_job (render_tile_t *tile)
+{
+	render_tile_job_t *job;
+
+	if (!renderTilePool) {
+		gint threadCount;
+
+		/* leave one processor to the main thread */
+		threadCount = MAX (1, (gint) g_get_num_processors () - 1);
+		renderTileDoneQueue = g_async_queue_new ();
+		renderTilePool = g_thread_pool_new (render_tile_job, NULL,
+				threadCount, FALSE, NULL);
+		if (!renderTilePool) {
+			g_async_queue_unref (renderTileDoneQueue);
+			renderTileDoneQueue = NULL;
+			return FALSE;
+		}
+	}
+
+	job = g_new0 (render_tile_job_t, 1);
+	job->key = *tile;
+	job->key.surface = NULL;
+	render_tile_get_render_info (tile, &job->renderInfo);
+	job->epoch = tile->jobEpoch = renderTileEpoch;
+	job->view = tile->jobView = renderTileView;
+	g_thread_pool_push (renderTilePool, job, NULL);
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------ */
+/** Returns the board coordinates of the lower left corner of tile. */
+static void
+render_tile_get_corner (const render_tile_t *tile, gdouble *x, gdouble *y)
+{
+	*x = (tile->column * RENDER_TILE_SIZE +
+			(gdouble) tile->phaseX / RENDER_TILE_PHASE_STEPS) / tile->scaleX;
+	*y = (tile->row * RENDER_TILE_SIZE +
+			(gdouble) tile->phaseY / RENDER_TILE_PHASE_STEPS) / tile->scaleY;
+}
+
+/* ------------------------------------------------------ */
+/** Adds the finished tiles of queue which show a part of tile, at a
+ *  zoom close enough to be scaled to it, to sources. */
+static void
+render_tile_find_sources (GQueue *queue, const render_tile_t *tile,
+		GPtrArray *sources)
+{
+	gdouble tileX, tileY, sourceX, sourceY;
+	GList *link;
+
+	render_tile_get_corner (tile, &tileX, &tileY);
+	for (link = queue->head; link; link = link->next) {
+		render_tile_t *source = link->data;
+
+		/* a stale tile of an unloaded layer must not be read, so
+		   check the image before anything else of its layer */
+		if ((source->file != tile->file) || (source->image != tile->image)
+				|| source->preview)
+			continue;
+		if ((source->scaleX * RENDER_TILE_PREVIEW_SCALE < tile->scaleX)
+		 || (tile->scaleX * RENDER_TILE_PREVIEW_SCALE < source->scaleX))
+			continue;
+
+		render_tile_get_corner (source, &sourceX, &sourceY);
+		if ((sourceX < tileX + RENDER_TILE_SIZE / tile->scaleX)
+		 && (tileX < sourceX + RENDER_TILE_SIZE / source->scaleX)
+		 && (sourceY < tileY + RENDER_TILE_SIZE / tile->scaleY)
+		 && (tileY < sourceY + RENDER_TILE_SIZE / source->scaleY))
+			g_ptr_array_add (sources, source);
+	}
+}
+
+/* Sorts the sources of a preview by falling closeness of their zoom to
+   the zoom of the previewed tile */
+static gint
+render_tile_compare_sources (gconstpointer a, gconstpointer b,
+		gpointer user_data)
+{
+	const render_tile_t *tile = user_data;
+	const render_tile_t *sourceA = *(render_tile_t * const *) a;
+	const render_tile_t *sourceB = *(render_tile_t * const *) b;
+	gdouble distanceA = fabs (log (sourceA->scaleX / tile->scaleX));
+	gdouble distanceB = fabs (log (sourceB->scaleX / tile->scaleX));
+
+	if (distanceA != distanceB)
+		return (distanceA > distanceB) ? -1 : 1;
+	return 0;
+}
+
+/* ------------------------------------------------------ */
+/** Returns TRUE if one of sources shows all of tile. */
+static gboolean
+render_tile_sources_cover (GPtrArray *sources, const render_tile_t *tile)
+{
+	gdouble tileX, tileY, sourceX, sourceY;
+	/* half a pixel of the tile */
+	gdouble slackX = 0.5 / tile->scaleX, slackY = 0.5 / tile->scaleY;
+	guint i;
+
+	render_tile_get_corner (tile, &tileX, &tileY);
+	for (i = 0; i < sources->len; i++) {
+		render_tile_t *source = g_ptr_array_index (sources, i);
+
+		render_tile_get_corner (source, &sourceX, &sourceY);
+		if ((sourceX <= tileX + slackX) && (sourceY <= tileY + slackY)
+		 && (sourceX + RENDER_TILE_SIZE / source->scaleX + slackX >=
+				tileX + RENDER_TILE_SIZE / tile->scaleX)
+		 && (sourceY + RENDER_TILE_SIZE / source->scaleY + slackY >=
+				tileY + RENDER_TILE_SIZE / tile->scaleY))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* ------------------------------------------------------ */
+/** Paints a draft of tile onto cr, rendered at a fraction of its
+ *  resolution in the fast cairo mode and scaled up.  Used where no
+ *  cached tile can stand in, so the screen is never left blank while
+ *  the background render runs. */
+static void
+render_tile_draft (cairo_t *cr, const render_tile_t *tile)
+{
+	gerbv_render_info_t draftRenderInfo;
+	cairo_surface_t *draft;
+	cairo_t *draftCr;
+
+	render_tile_get_render_info (tile, &draftRenderInfo);
+	draftRenderInfo.scaleFactorX /= RENDER_TILE_DRAFT_DIVISOR;
+	draftRenderInfo.scaleFactorY /= RENDER_TILE_DRAFT_DIVISOR;
+	draftRenderInfo.displayWidth = RENDER_TILE_SIZE / RENDER_TILE_DRAFT_DIVISOR;
+	draftRenderInfo.displayHeight = RENDER_TILE_SIZE / RENDER_TILE_DRAFT_DIVISOR;
+	draftRenderInfo.renderType = GERBV_RENDER_TYPE_CAIRO_NORMAL;
+
+	draft = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+			draftRenderInfo.displayWidth, draftRenderInfo.displayHeight);
+	draftCr = cairo_create (draft);
+	gerbv_render_layer_to_cairo_target (draftCr, tile->file,
+			&draftRenderInfo);
+	cairo_destroy (draftCr);
+
+	cairo_save (cr);
+	cairo_scale (cr, RENDER_TILE_DRAFT_DIVISOR, RENDER_TILE_DRAFT_DIVISOR);
+	cairo_set_source_surface (cr, draft, 0, 0);
+	cairo_paint (cr);
+	cairo_restore (cr);
+	cairo_surface_destroy (draft);
+}
+
+/* ------------------------------------------------------ */
+/** Fills the surface of tile with the cached tiles of other zoom levels,
+ *  or of the screen before the layers changed, scaled to it.  Where
+ *  they don't cover the tile, a low resolution draft is drawn first.
+ *  This is shown until the background render is done. */
+static void
+render_tile_preview (render_tile_t *tile)
+{
+	GPtrArray *sources = g_ptr_array_new ();
+	gdouble tileX, tileY, sourceX, sourceY, scaleX, scaleY;
+	cairo_t *cr;
+	guint i;
+
+	render_tile_find_sources (&renderTileQueue, tile, sources);
+	render_tile_find_sources (&renderTileStaleQueue, tile, sources);
+	g_ptr_array_sort_with_data (sources, render_tile_compare_sources, tile);
+
+	cr = cairo_create (tile->surface);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	if (!render_tile_sources_cover (sources, tile))
+		render_tile_draft (cr, tile);
+
+	/* the closest zoom is painted last, over the other ones */
+	render_tile_get_corner (tile, &tileX, &tileY);
+	for (i = 0; i < sources->len; i++) {
+		render_tile_t *source = g_ptr_array_index (sources, i);
+
+		render_tile_get_corner (source, &sourceX, &sourceY);
+		scaleX = tile->scaleX / source->scaleX;
+		scaleY = tile->scaleY / source->scaleY;
+
+		/* the surface y axes point down, the board y axis up */
+		cairo_save (cr);
+		cairo_translate (cr, (sourceX - tileX) * tile->scaleX,
+				RENDER_TILE_SIZE - (sourceY - tileY) * tile->scaleY
+				- RENDER_TILE_SIZE * scaleY);
+		cairo_scale (cr, scaleX, scaleY);
+		cairo_rectangle (cr, 0, 0, RENDER_TILE_SIZE, RENDER_TILE_SIZE);
+		cairo_clip (cr);
+		cairo_set_source_surface (cr, source->surface, 0, 0);
+		cairo_paint (cr);
+		cairo_restore (cr);
+	}
+	cairo_destroy (cr);
+	g_ptr_array_free (sources, TRUE);
+}
+
+/* ------------------------------------------------------ */
+/** Cancels the queued background tiles and waits for the running ones.
+ *  Must be called before the layers are changed or freed. */
+void
+render_wait_for_tile_workers (void)
+{
+	g_atomic_int_inc (&renderTileEpoch);
+	/* the running workers hold the lock until they are done */
+	g_rw_lock_writer_lock (&renderTileDataLock);
+	g_rw_lock_writer_unlock (&renderTileDataLock);
+}
+
+/* ------------------------------------------------------ */
+/** Returns the tile for the given key, rendering it if it isn't cached.
+ *  The least recently used tiles are dropped once the cache exceeds
+ *  RENDER_TILE_CACHE_MAX_BYTES. */
+static cairo_surface_t *
+render_tile_get (render_tile_t *key)
+{
+	gerbv_render_info_t tileRenderInfo;
+	render_tile_t *tile;
+	cairo_t *cr;
+
+	if (!renderTileTable)
+		renderTileTable = g_hash_table_new (render_tile_hash,
+				render_tile_equal);
+
+	tile = g_hash_table_lookup (renderTileTable, key);
+	if (tile) {
+		/* move it to the front of the LRU queue */
+		g_queue_unlink (&renderTileQueue, &tile->link);
+		g_queue_push_head_link (&renderTileQueue, &tile->link);
+		tile->lastFrame = renderTileFrame;
+		/* queue the preview again if its render was cancelled */
+		if (tile->preview && ((tile->jobEpoch != renderTileEpoch)
+				|| (tile->jobView != renderTileView)))
+			render_tile_queue_job (tile);
+		return tile->surface;
+	}
+
+	tile = g_new (render_tile_t, 1);
+	*tile = *key;
+	tile->link.data = tile;
+	tile->link.next = tile->link.prev = NULL;
+	tile->lastFrame = renderTileFrame;
+	tile->scaleX = screenRenderInfo.scaleFactorX;
+	tile->scaleY = screenRenderInfo.scaleFactorY;
+	tile->image = key->file->image;
+	tile->surface = cairo_surface_create_similar (
+			(cairo_surface_t *)screen.windowSurface,
+			CAIRO_CONTENT_COLOR_ALPHA,
+			RENDER_TILE_SIZE, RENDER_TILE_SIZE);
+
+	tile->preview = render_tile_queue_job (tile);
+	if (tile->preview) {
+		render_tile_preview (tile);
+	} else {
+		render_tile_get_render_info (key, &tileRenderInfo);
+		cr = cairo_create (tile->surface);
+		gerbv_render_layer_to_cairo_target (cr, key->file, &tileRenderInfo);
+		cairo_destroy (cr);
+	}
+
+	g_hash_table_insert (renderTileTable, tile, tile);
+	g_queue_push_head_link (&renderTileQueue, &tile->link);
+	renderTileBytes += RENDER_TILE_SIZE * RENDER_TILE_SIZE * 4;
+
+	/* drop old tiles, but never the ones on the current screen */
+	while (renderTileBytes > RENDER_TILE_CACHE_MAX_BYTES
+			&& renderTileQueue.tail) {
+		render_tile_t *oldTile = renderTileQueue.tail->data;
+
+		if (oldTile->lastFrame == renderTileFrame)
+			break;
+		g_hash_table_remove (renderTileTable, oldTile);
+		g_queue_unlink (&renderTileQueue, &oldTile->link);
+		render_tile_free (oldTile);
+	}
+
+	return tile->surface;
+}
+
+/* ------------------------------------------------------ */
+/** Sets the zoom level and grid phase of key to those of the current
+ *  screen, and returns the pixel position of the grid origin in originX
+ *  and originY. */
+static void
+render_tile_key_for_screen (render_tile_t *key,
+		gdouble *originX, gdouble *originY)
+{
+	gdouble pixelX, pixelY;
+
+	/* screen corner in pixels from the board origin */
+	pixelX = screenRenderInfo.lowerLeftX * screenRenderInfo.scaleFactorX;
+	pixelY = screenRenderInfo.lowerLeftY * screenRenderInfo.scaleFactorY;
+
+	key->zoomLevel = (gint64) floor (log (screenRenderInfo.scaleFactorX) * 1e6 + 0.5);
+	/* align the tile grid to the screen pixels, so tiles can be
+	   composited without resampling */
+	key->phaseX = (gint) floor ((pixelX - floor (pixelX)) *
+			RENDER_TILE_PHASE_STEPS + 0.5) % RENDER_TILE_PHASE_STEPS;
+	key->phaseY = (gint) floor ((pixelY - floor (pixelY)) *
+			RENDER_TILE_PHASE_STEPS + 0.5) % RENDER_TILE_PHASE_STEPS;
+	*originX = pixelX - (gdouble) key->phaseX / RENDER_TILE_PHASE_STEPS;
+	*originY = pixelY - (gdouble) key->phaseY / RENDER_TILE_PHASE_STEPS;
+}
+
+/* ------------------------------------------------------ */
+/** Paints one layer for the current screen onto cr, from cached tiles
+ *  where possible. */
+static void
+render_layer_from_tiles (cairo_t *cr, gerbv_fileinfo_t *file)
+{
+	render_tile_t key;
+	gdouble originX, originY;
+	gint column, row, firstColumn, firstRow, lastColumn, lastRow;
+
+	key.file = file;
+	render_tile_key_for_screen (&key, &originX, &originY);
+
+	firstColumn = floor (originX / RENDER_TILE_SIZE);
+	lastColumn = floor ((originX + screenRenderInfo.displayWidth) / RENDER_TILE_SIZE);
+	firstRow = floor (originY / RENDER_TILE_SIZE);
+	lastRow = floor ((originY + screenRenderInfo.displayHeight) / RENDER_TILE_SIZE);
+
+	for (row = firstRow; row <= lastRow; row++) {
+		for (column = firstColumn; column <= lastColumn; column++) {
+			cairo_surface_t *surface;
+
+			key.column = column;
+			key.row = row;
+			surface = render_tile_get (&key);
+
+			/* the screen y axis points down, the grid rows go up */
+			cairo_set_source_surface (cr, surface,
+				floor ((gdouble) column * RENDER_TILE_SIZE - originX + 0.5),
+				screenRenderInfo.displayHeight - RENDER_TILE_SIZE -
+				floor ((gdouble) row * RENDER_TILE_SIZE - originY + 0.5));
+			cairo_paint (cr);
+		}
+	}
+}
+
+/* ------------------------------------------------------ */
+/** Redraws the screen after the layers changed in any way. */
 void render_refresh_rendered_image_on_screen (void) {
+	/* the cached tiles may show outdated layers */
+	render_tile_cache_clear ();
+	render_refresh_view_on_screen ();
+}
+
+/* ------------------------------------------------------ */
+/** Adds the region net of image may draw to, including all its step
+ *  and repeat copies, to dirtyBoxes (render_dirty_box_t). */
+void
+render_dirty_boxes_add_net (GArray *dirtyBoxes, gerbv_image_t *image,
+		gerbv_net_t *net)
+{
+	gerbv_step_and_repeat_t *sr = &net->layer->stepAndRepeat;
+	render_dirty_box_t dirty;
+
+	dirty.image = image;
+	dirty.box = net->boundingBox;
+	dirty.box.left += MIN ((sr->X - 1) * sr->dist_X, 0);
+	dirty.box.right += MAX ((sr->X - 1) * sr->dist_X, 0);
+	dirty.box.bottom += MIN ((sr->Y - 1) * sr->dist_Y, 0);
+	dirty.box.top += MAX ((sr->Y - 1) * sr->dist_Y, 0);
+	g_array_append_val (dirtyBoxes, dirty);
+}
+
+/* ------------------------------------------------------ */
+/** Adds the regions of all selected nets to dirtyBoxes. */
+void
+render_dirty_boxes_add_selection (GArray *dirtyBoxes,
+		gerbv_selection_info_t *selectionInfo)
+{
+	guint i;
+
+	for (i = 0; i < selection_length (selectionInfo); i++) {
+		gerbv_selection_item_t sItem =
+			selection_get_item_by_index (selectionInfo, i);
+
+		render_dirty_boxes_add_net (dirtyBoxes, sItem.image, sItem.net);
+	}
+}
+
+/* ------------------------------------------------------ */
+/** Re-renders the pixels of a cached tile which the dirty boxes of its
+ *  layer touch, leaving the rest of the tile as it is. */
+static void
+render_tile_repair (render_tile_t *tile, GArray *dirtyBoxes)
+{
+	gerbv_render_info_t tileRenderInfo;
+	gerbv_user_transformation_t *transform = &tile->file->transform;
+	gdouble scaleX = transform->scaleX, scaleY = transform->scaleY;
+	gboolean damaged = FALSE;
+	cairo_t *cr;
+	guint i;
+	gint j;
+
+	render_tile_get_render_info (tile, &tileRenderInfo);
+	cr = cairo_create (tile->surface);
+
+	/* map the boxes to tile pixels the way draw_image_to_cairo_target()
+	   maps the nets */
+	cairo_save (cr);
+	gerbv_render_cairo_set_scale_and_translation (cr, &tileRenderInfo);
+	if (transform->mirrorAroundX)
+		scaleY *= -1;
+	if (transform->mirrorAroundY)
+		scaleX *= -1;
+	cairo_translate (cr, transform->translateX, transform->translateY);
+	cairo_scale (cr, scaleX, scaleY);
+	cairo_rotate (cr, transform->rotation);
+	cairo_translate (cr, tile->file->image->info->imageJustifyOffsetActualA,
+		 tile->file->image->info->imageJustifyOffsetActualB);
+
+	cairo_new_path (cr);
+	for (i = 0; i < dirtyBoxes->len; i++) {
+		render_dirty_box_t *dirty =
+			&g_array_index (dirtyBoxes, render_dirty_box_t, i);
+		gdouble x[4] = {dirty->box.left, dirty->box.right,
+				dirty->box.right, dirty->box.left};
+		gdouble y[4] = {dirty->box.bottom, dirty->box.bottom,
+				dirty->box.top, dirty->box.top};
+		gdouble left = HUGE_VAL, right = -HUGE_VAL;
+		gdouble top = HUGE_VAL, bottom = -HUGE_VAL;
+
+		if (dirty->image != tile->file->image)
+			continue;
+		if ((dirty->box.left > dirty->box.right)
+		 || (dirty->box.bottom > dirty->box.top)) {
+			/* an invalid box may draw anywhere */
+			left = top = 0;
+			right = bottom = RENDER_TILE_SIZE;
+		} else {
+			for (j = 0; j < 4; j++) {
+				cairo_user_to_device (cr, &x[j], &y[j]);
+				left = MIN (left, x[j]);
+				right = MAX (right, x[j]);
+				top = MIN (top, y[j]);
+				bottom = MAX (bottom, y[j]);
+			}
+		}
+
+		/* whole pixels, with room for lines widened to a pixel */
+		left = MAX (floor (left) - 2, 0);
+		top = MAX (floor (top) - 2, 0);
+		right = MIN (ceil (right) + 2, RENDER_TILE_SIZE);
+		bottom = MIN (ceil (bottom) + 2, RENDER_TILE_SIZE);
+		if ((left >= right) || (top >= bottom))
+			continue;
+
+		/* the path is kept in device space across the restore */
+		cairo_save (cr);
+		cairo_identity_matrix (cr);
+		cairo_rectangle (cr, left, top, right - left, bottom - top);
+		cairo_restore (cr);
+		damaged = TRUE;
+	}
+	cairo_restore (cr);
+
+	if (damaged) {
+		cairo_clip (cr);
+		cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+		cairo_paint (cr);
+		cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+		gerbv_render_layer_to_cairo_target (cr, tile->file, &tileRenderInfo);
+	}
+	cairo_destroy (cr);
+}
+
+/* ------------------------------------------------------ */
+/** Redraws the screen after the nets inside dirtyBoxes
+ *  (render_dirty_box_t) were edited.  Only those regions of the cached
+ *  tiles of the edited layers are rendered again. */
+void
+render_refresh_dirty_boxes_on_screen (GArray *dirtyBoxes)
+{
+	render_tile_t key;
+	gdouble originX, originY;
+	GList *link, *next;
+	guint i;
+
+	if (screenRenderInfo.renderType <= GERBV_RENDER_TYPE_GDK_XOR) {
+		render_refresh_rendered_image_on_screen ();
+		return;
+	}
+
+	/* the previews would show the nets before the edit */
+	render_tile_stale_free ();
+	render_tile_key_for_screen (&key, &originX, &originY);
+	for (link = renderTileQueue.head; link != NULL; link = next) {
+		render_tile_t *tile = link->data;
+
+		next = link->next;
+		for (i = 0; i < dirtyBoxes->len; i++) {
+			if (g_array_index (dirtyBoxes, render_dirty_box_t, i).image
+					== tile->file->image)
+				break;
+		}
+		if (i == dirtyBoxes->len)
+			continue;
+
+		if ((tile->zoomLevel == key.zoomLevel)
+				&& (tile->phaseX == key.phaseX)
+				&& (tile->phaseY == key.phaseY)) {
+			render_tile_repair (tile, dirtyBoxes);
+		} else {
+			/* tiles of other views are rendered again when needed */
+			g_hash_table_remove (renderTileTable, tile);
+			g_queue_unlink (&renderTileQueue, &tile->link);
+			render_tile_free (tile);
+		}
+	}
+
+	render_refresh_view_on_screen ();
+}
+
+/* ------------------------------------------------------ */
+/** Redraws the screen after only the view (pan, zoom, window size)
+ *  changed, reusing the cached layer tiles. */
+void render_refresh_view_on_screen (void) {
 	GdkCursor *cursor;
 	
 	dprintf("----> Entering redraw_pixmap...\n");
@@ -441,35 +1178,60 @@ void render_refresh_rendered_image_on_screen (void) {
 	    dprintf("<---- leaving redraw_pixmap.\n");
 	}
 	else{
-	    int i;
+	    static gerbv_render_info_t lastView;
+
 	    dprintf("    .... Now try rendering the drawing using cairo .... \n");
-	    /* 
-	     * This now allows drawing several layers on top of each other.
-	     * Higher layer numbers have higher priority in the Z-order.
-	     */
-	    for(i = mainProject->last_loaded; i >= 0; i--) {
-		if (mainProject->file[i]) {
-		    cairo_t *cr;
-		    if (mainProject->file[i]->privateRenderData) 
-			cairo_surface_destroy ((cairo_surface_t *) mainProject->file[i]->privateRenderData);
-		    mainProject->file[i]->privateRenderData = 
-			(gpointer) cairo_surface_create_similar ((cairo_surface_t *)screen.windowSurface,
-			CAIRO_CONTENT_COLOR_ALPHA, screenRenderInfo.displayWidth,
-			screenRenderInfo.displayHeight);
-		    cr= cairo_create(mainProject->file[i]->privateRenderData );
-		    gerbv_render_layer_to_cairo_target (cr, mainProject->file[i], &screenRenderInfo);
-		    dprintf("    .... calling render_image_to_cairo_target on layer %d...\n", i);			
-		    cairo_destroy (cr);
-		}
+	    /* tiles still queued for another view are not needed anymore */
+	    if ((lastView.lowerLeftX != screenRenderInfo.lowerLeftX)
+	     || (lastView.lowerLeftY != screenRenderInfo.lowerLeftY)
+	     || (lastView.scaleFactorX != screenRenderInfo.scaleFactorX)
+	     || (lastView.scaleFactorY != screenRenderInfo.scaleFactorY)
+	     || (lastView.displayWidth != screenRenderInfo.displayWidth)
+	     || (lastView.displayHeight != screenRenderInfo.displayHeight)) {
+		g_atomic_int_inc (&renderTileView);
+		lastView = screenRenderInfo;
 	    }
-	    
-	    render_recreate_composite_surface ();
+	    renderTileFrame++;
+	    render_composite_layers_from_tiles ();
 	}
 	/* remove watch cursor and switch back to normal cursor */
 	callbacks_switch_to_correct_cursor ();
 	callbacks_force_expose_event_for_screen();
 }
 
+/* ------------------------------------------------------ */
+/** Composites the cached tiles of every layer into the layer surfaces
+ *  of the screen, and those into the screen buffer.  Tiles which
+ *  aren't cached yet are rendered, or previewed while they are rendered
+ *  in the background. */
+static void
+render_composite_layers_from_tiles (void)
+{
+	cairo_t *cr;
+	int i;
+
+	/* 
+	 * This now allows drawing several layers on top of each other.
+	 * Higher layer numbers have higher priority in the Z-order.
+	 */
+	for(i = mainProject->last_loaded; i >= 0; i--) {
+		if (mainProject->file[i]) {
+			if (mainProject->file[i]->privateRenderData) 
+				cairo_surface_destroy ((cairo_surface_t *) mainProject->file[i]->privateRenderData);
+			mainProject->file[i]->privateRenderData = 
+				(gpointer) cairo_surface_create_similar ((cairo_surface_t *)screen.windowSurface,
+				CAIRO_CONTENT_COLOR_ALPHA, screenRenderInfo.displayWidth,
+				screenRenderInfo.displayHeight);
+			cr= cairo_create(mainProject->file[i]->privateRenderData );
+			render_layer_from_tiles (cr, mainProject->file[i]);
+			dprintf("    .... composited the tiles of layer %d...\n", i);
+			cairo_destroy (cr);
+		}
+	}
+
+	render_recreate_composite_surface ();
+}
+
 /* ------------------------------------------------------ */
 void
 render_remove_selected_objects_belonging_to_layer (
@@ -509,32 +1271,17 @@ static void
 render_find_selected_objects_and_refresh_display (gint activeFileIndex,
 		enum selection_action action)
 {
-	enum draw_mode mode = FIND_SELECTIONS;
-
 	/* clear the old selection array if desired */
 	if ((action == SELECTION_REPLACE)
 	 && (selection_length (&screen.selectionInfo) != 0))
 		selection_clear (&screen.selectionInfo);
 
-	if (action == SELECTION_TOGGLE)
-		mode = FIND_SELECTIONS_TOGGLE;
-
-	/* make sure we have a bufferSurface...if we start up in FAST mode, we may not
-	   have one yet, but we need it for selections */
-	if (!render_create_cairo_buffer_surface ())
-		return;
-
-	/* call draw_image... passing the FILL_SELECTION mode to just search for
-	   nets which match the selection, and fill the selection buffer with them */
-	cairo_t *cr = cairo_create (screen.bufferSurface);	
-	gerbv_render_cairo_set_scale_and_translation (cr, &screenRenderInfo);
-	draw_image_to_cairo_target (cr,
-			mainProject->file[activeFileIndex]->image,
-			1.0/MAX (screenRenderInfo.scaleFactorX,
-				screenRenderInfo.scaleFactorY),
-			mode, &screen.selectionInfo, &screenRenderInfo, TRUE,
-			mainProject->file[activeFileIndex]->transform, TRUE);
-	cairo_destroy (cr);
+	/* test the click or drag box against the net geometry and fill the
+	   selection buffer with the nets it hits */
+	hit_test_fill_selection (mainProject->file[activeFileIndex]->image,
+			&screen.selectionInfo, &screenRenderInfo,
+			mainProject->file[activeFileIndex]->transform,
+			(action == SELECTION_TOGGLE));
 
 	/* re-render the selection buffer layer */
 	if (screenRenderInfo.renderType <= GERBV_RENDER_TYPE_GDK_XOR) {
@@ -630,6 +1377,26 @@ void render_project_to_cairo_target (cairo_t *cr) {
 
 void
 render_free_screen_resources (void) {
+	render_tile_job_t *job;
+
+	if (renderTilePool) {
+		/* let the queued jobs skip themselves */
+		g_atomic_int_inc (&renderTileEpoch);
+		g_thread_pool_free (renderTilePool, FALSE, TRUE);
+		renderTilePool = NULL;
+		while ((job = g_async_queue_try_pop (renderTileDoneQueue)) != NULL) {
+			if (job->surface)
+				cairo_surface_destroy (job->surface);
+			g_free (job);
+		}
+		g_async_queue_unref (renderTileDoneQueue);
+		renderTileDoneQueue = NULL;
+	}
+	render_tile_cache_clear ();
+	render_tile_stale_free ();
+	if (renderTileTable)
+		g_hash_table_destroy (renderTileTable);
+	renderTileTable = NULL;
 	if (screen.selectionRenderData) 
 		cairo_surface_destroy ((cairo_surface_t *)
 			screen.selectionRenderData);
@@ -651,22 +1418,28 @@ render_free_screen_resources (void) {
 gerbv_stats_t *
 generate_gerber_analysis(void)
 {
-	int i;
+	int i, count = 0;
 	gerbv_stats_t *stats;
-	gerbv_stats_t *instats;
+	gerbv_image_t **images;
+	gint *layers;
 
-	/* Create new stats structure to hold report for whole project 
-	* (i.e. all layers together) */
-	stats = gerbv_stats_new();
+	images = g_new (gerbv_image_t *, mainProject->last_loaded + 1);
+	layers = g_new (gint, mainProject->last_loaded + 1);
 
-	/* Loop through open layers and compile statistics by accumulating reports from each layer */
+	/* Collect the open layers, their reports are accumulated into the
+	* report for the whole project (i.e. all layers together) */
 	for (i = 0; i <= mainProject->last_loaded; i++) {
 		if (mainProject->file[i] && mainProject->file[i]->isVisible &&
 				(mainProject->file[i]->image->layertype == GERBV_LAYERTYPE_RS274X) ) {
-			instats = mainProject->file[i]->image->gerbv_stats;
-			gerbv_stats_add_layer(stats, instats, i+1);
+			images[count] = mainProject->file[i]->image;
+			layers[count] = i+1;
+			count++;
 		}
 	}
+	stats = gerbv_stats_new_from_images(images, layers, count);
+
+	g_free (images);
+	g_free (layers);
 	return stats;
 }
 
@@ -678,23 +1451,29 @@ generate_gerber_analysis(void)
 gerbv_drill_stats_t *
 generate_drill_analysis(void)
 {
-	int i;
+	int i, count = 0;
 	gerbv_drill_stats_t *stats;
-	gerbv_drill_stats_t *instats;
+	gerbv_image_t **images;
+	gint *layers;
 
-	stats = gerbv_drill_stats_new();
+	images = g_new (gerbv_image_t *, mainProject->last_loaded + 1);
+	layers = g_new (gint, mainProject->last_loaded + 1);
 
-	/* Loop through open layers and compile statistics by accumulating reports from each layer */
+	/* Collect the open layers, with the layer index for error
+	* reporting */
 	for(i = mainProject->last_loaded; i >= 0; i--) {
 		if (mainProject->file[i] && 
 				mainProject->file[i]->isVisible &&
 				(mainProject->file[i]->image->layertype == GERBV_LAYERTYPE_DRILL) ) {
-			instats = mainProject->file[i]->image->drill_stats;
-			/* add this batch of stats.  Send the layer 
-			* index for error reporting */
-			gerbv_drill_stats_add_layer(stats, instats, i+1);
+			images[count] = mainProject->file[i]->image;
+			layers[count] = i+1;
+			count++;
 		}
 	}
+	stats = gerbv_drill_stats_new_from_images(images, layers, count);
+
+	g_free (images);
+	g_free (layers);
 	return stats;
 }
 
@@ -56,6 +56,27 @@ render_draw_measure_distance(void);
 
 void render_refresh_rendered_image_on_screen (void);
 
+void render_refresh_view_on_screen (void);
+
+/* A region of an image whose rendering is outdated after an edit */
+typedef struct {
+	gerbv_image_t *image;
+	gerbv_render_size_t box;	/* in the bounding box coordinates of
+					   the nets of image */
+} render_dirty_box_t;
+
+void
+render_dirty_boxes_add_net (GArray *dirtyBoxes, gerbv_image_t *image,
+		gerbv_net_t *net);
+
+void
+render_dirty_boxes_add_selection (GArray *dirtyBoxes,
+		gerbv_selection_info_t *selectionInfo);
+
+void render_refresh_dirty_boxes_on_screen (GArray *dirtyBoxes);
+
+void render_wait_for_tile_workers (void);
+
 void
 render_remove_selected_objects_belonging_to_layer (
 			gerbv_selection_info_t *sel_info, gerbv_image_t *image);
@@ -27,6 +27,54 @@
 
 #include "gerbv.h"
 
+/* selectedNodeIndexes maps every selected net to its index in
+   selectedNodeArray plus one, so looking up whether a net is selected
+   doesn't need to scan the whole selection.  It is created on first use,
+   and dropped whenever the array changes in a way it can't follow */
+
+static GHashTable *selection_get_indexes (gerbv_selection_info_t *sel_info)
+{
+	gerbv_selection_item_t *item;
+	guint i;
+
+	if (sel_info->selectedNodeIndexes == NULL) {
+		sel_info->selectedNodeIndexes =
+			g_hash_table_new (g_direct_hash, g_direct_equal);
+		for (i = 0; i < sel_info->selectedNodeArray->len; i++) {
+			item = &g_array_index (sel_info->selectedNodeArray,
+					gerbv_selection_item_t, i);
+			g_hash_table_insert (sel_info->selectedNodeIndexes,
+					item->net, GUINT_TO_POINTER (i + 1));
+		}
+	}
+
+	return sel_info->selectedNodeIndexes;
+}
+
+static void selection_drop_indexes (gerbv_selection_info_t *sel_info)
+{
+	if (sel_info->selectedNodeIndexes != NULL) {
+		g_hash_table_destroy (sel_info->selectedNodeIndexes);
+		sel_info->selectedNodeIndexes = NULL;
+	}
+}
+
+/* Returns the index of item plus one, or 0 if it isn't selected */
+static guint selection_find_item (gerbv_selection_info_t *sel_info,
+				gerbv_selection_item_t *item)
+{
+	guint position;
+
+	position = GPOINTER_TO_UINT (g_hash_table_lookup (
+				selection_get_indexes (sel_info), item->net));
+	if (position == 0 || position > sel_info->selectedNodeArray->len
+			|| g_array_index (sel_info->selectedNodeArray,
+				gerbv_selection_item_t, position - 1).image != item->image)
+		return 0;
+
+	return position;
+}
+
 GArray *selection_new_array (void)
 {
 	return g_array_new (FALSE, FALSE, sizeof (gerbv_selection_item_t));
@@ -34,6 +82,7 @@ GArray *selection_new_array (void)
 
 gchar *selection_free_array (gerbv_selection_info_t *sel_info)
 {
+	selection_drop_indexes (sel_info);
 	return g_array_free (sel_info->selectedNodeArray, FALSE);
 }
 
@@ -52,11 +101,14 @@ gerbv_selection_item_t selection_get_item_by_index (
 void selection_clear_item_by_index (
 			gerbv_selection_info_t *sel_info, guint idx)
 {
+	/* the items behind idx move down by one */
+	selection_drop_indexes (sel_info);
 	g_array_remove_index (sel_info->selectedNodeArray, idx);
 }
 
 void selection_clear (gerbv_selection_info_t *sel_info)
 {
+	selection_drop_indexes (sel_info);
 	if (selection_length(sel_info))
 		g_array_remove_range (sel_info->selectedNodeArray, 0,
 				sel_info->selectedNodeArray->len);
@@ -65,5 +117,37 @@ void selection_clear (gerbv_selection_info_t *sel_info)
 void selection_add_item (gerbv_selection_info_t *sel_info,
 				gerbv_selection_item_t *item)
 {
+	if (selection_find_item (sel_info, item))
+		return;
+
 	g_array_append_val (sel_info->selectedNodeArray, *item);
+	g_hash_table_insert (selection_get_indexes (sel_info), item->net,
+			GUINT_TO_POINTER (sel_info->selectedNodeArray->len));
+}
+
+gboolean selection_contains_item (gerbv_selection_info_t *sel_info,
+				gerbv_selection_item_t *item)
+{
+	return selection_find_item (sel_info, item) != 0;
+}
+
+gboolean selection_remove_item (gerbv_selection_info_t *sel_info,
+				gerbv_selection_item_t *item)
+{
+	GArray *array = sel_info->selectedNodeArray;
+	GHashTable *indexes = selection_get_indexes (sel_info);
+	guint position = selection_find_item (sel_info, item);
+
+	if (position == 0)
+		return FALSE;
+
+	/* the last item takes the place of the removed one */
+	g_hash_table_remove (indexes, item->net);
+	g_array_remove_index_fast (array, position - 1);
+	if (position <= array->len)
+		g_hash_table_insert (indexes, g_array_index (array,
+				gerbv_selection_item_t, position - 1).net,
+				GUINT_TO_POINTER (position));
+
+	return TRUE;
 }
@@ -34,4 +34,8 @@ gerbv_selection_item_t selection_get_item_by_index (
 void selection_clear_item_by_index (
 				gerbv_selection_info_t *sel_info, guint idx);
 void selection_clear (gerbv_selection_info_t *sel_info);
+gboolean selection_contains_item (gerbv_selection_info_t *sel_info,
+					gerbv_selection_item_t *item);
+gboolean selection_remove_item (gerbv_selection_info_t *sel_info,
+					gerbv_selection_item_t *item);
 
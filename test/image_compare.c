@@ -0,0 +1,358 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * image_compare.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file image_compare.c
+    \brief Compares parsed images in the libgerbv tests
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "image_compare.h"
+
+/* Compares one field of expected and actual, which are structures of
+   the same type */
+#define COMPARE_FIELD(what, field, format) \
+	if (expected->field != actual->field) { \
+		fprintf (stderr, "%s: %s " #field " is " format \
+				" instead of " format "\n", name, what, \
+				actual->field, expected->field); \
+		return FALSE; \
+	}
+
+#define COMPARE_STRING(what, field) \
+	if (g_strcmp0 (expected->field, actual->field) != 0) { \
+		fprintf (stderr, "%s: %s " #field " is \"%s\" instead of \"%s\"\n", \
+				name, what, \
+				actual->field ? actual->field : "(null)", \
+				expected->field ? expected->field : "(null)"); \
+		return FALSE; \
+	}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+image_compare_layer (const gchar *name, const gchar *what,
+		gerbv_layer_t *expected, gerbv_layer_t *actual)
+{
+	COMPARE_FIELD (what, stepAndRepeat.X, "%d");
+	COMPARE_FIELD (what, stepAndRepeat.Y, "%d");
+	COMPARE_FIELD (what, stepAndRepeat.dist_X, "%g");
+	COMPARE_FIELD (what, stepAndRepeat.dist_Y, "%g");
+	COMPARE_FIELD (what, knockout.firstInstance, "%d");
+	COMPARE_FIELD (what, knockout.type, "%d");
+	COMPARE_FIELD (what, knockout.polarity, "%d");
+	COMPARE_FIELD (what, knockout.lowerLeftX, "%g");
+	COMPARE_FIELD (what, knockout.lowerLeftY, "%g");
+	COMPARE_FIELD (what, knockout.width, "%g");
+	COMPARE_FIELD (what, knockout.height, "%g");
+	COMPARE_FIELD (what, knockout.border, "%g");
+	COMPARE_FIELD (what, rotation, "%g");
+	COMPARE_FIELD (what, polarity, "%d");
+	COMPARE_STRING (what, name);
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+image_compare_state (const gchar *name, const gchar *what,
+		gerbv_netstate_t *expected, gerbv_netstate_t *actual)
+{
+	COMPARE_FIELD (what, axisSelect, "%d");
+	COMPARE_FIELD (what, mirrorState, "%d");
+	COMPARE_FIELD (what, unit, "%d");
+	COMPARE_FIELD (what, offsetA, "%g");
+	COMPARE_FIELD (what, offsetB, "%g");
+	COMPARE_FIELD (what, scaleA, "%g");
+	COMPARE_FIELD (what, scaleB, "%g");
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+image_compare_aperture (const gchar *name, const gchar *what,
+		gerbv_aperture_t *expected, gerbv_aperture_t *actual)
+{
+	gerbv_simplified_amacro_t *expectedSam, *actualSam;
+	gint i;
+
+	COMPARE_FIELD (what, type, "%d");
+	COMPARE_FIELD (what, nuf_parameters, "%d");
+	COMPARE_FIELD (what, unit, "%d");
+	for (i = 0; i < APERTURE_PARAMETERS_MAX; i++)
+		COMPARE_FIELD (what, parameter[i], "%g");
+
+	expectedSam = expected->simplified;
+	actualSam = actual->simplified;
+	while ((expectedSam != NULL) && (actualSam != NULL)) {
+		gerbv_simplified_amacro_t *expected = expectedSam;
+		gerbv_simplified_amacro_t *actual = actualSam;
+
+		COMPARE_FIELD (what, type, "%d");
+		for (i = 0; i < APERTURE_PARAMETERS_MAX; i++)
+			COMPARE_FIELD (what, parameter[i], "%g");
+		expectedSam = expectedSam->next;
+		actualSam = actualSam->next;
+	}
+	if ((expectedSam != NULL) || (actualSam != NULL)) {
+		fprintf (stderr, "%s: %s has %s macro primitives\n", name, what,
+				(actualSam != NULL) ? "more" : "fewer");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+image_compare_stats (const gchar *name,
+		gerbv_stats_t *expected, gerbv_stats_t *actual)
+{
+	gerbv_error_list_t *expectedError, *actualError;
+
+	if ((expected == NULL) || (actual == NULL)) {
+		if (expected != actual) {
+			fprintf (stderr, "%s: the statistics are %s\n", name,
+					(actual != NULL) ? "not missing" : "missing");
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	/* everything after the lists is a counter */
+	if (memcmp (&expected->layer_count, &actual->layer_count,
+			sizeof (gerbv_stats_t)
+			- G_STRUCT_OFFSET (gerbv_stats_t, layer_count)) != 0) {
+		fprintf (stderr, "%s: the statistics counters differ\n", name);
+		return FALSE;
+	}
+
+	expectedError = expected->error_list;
+	actualError = actual->error_list;
+	while ((expectedError != NULL) && (actualError != NULL)) {
+		gerbv_error_list_t *expected = expectedError;
+		gerbv_error_list_t *actual = actualError;
+
+		COMPARE_FIELD ("error", type, "%d");
+		COMPARE_STRING ("error", error_text);
+		expectedError = expectedError->next;
+		actualError = actualError->next;
+	}
+	if ((expectedError != NULL) || (actualError != NULL)) {
+		fprintf (stderr, "%s: there are %s errors\n", name,
+				(actualError != NULL) ? "more" : "fewer");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+gboolean
+image_compare_without_nets (const gchar *name,
+		gerbv_image_t *expected, gerbv_image_t *actual)
+{
+	gerbv_layer_t *expectedLayer, *actualLayer;
+	gerbv_netstate_t *expectedState, *actualState;
+	gchar *what;
+	gint i;
+
+	COMPARE_FIELD ("image", layertype, "%d");
+	COMPARE_FIELD ("image", info->polarity, "%d");
+	COMPARE_FIELD ("image", info->min_x, "%g");
+	COMPARE_FIELD ("image", info->min_y, "%g");
+	COMPARE_FIELD ("image", info->max_x, "%g");
+	COMPARE_FIELD ("image", info->max_y, "%g");
+	COMPARE_FIELD ("image", info->offsetA, "%g");
+	COMPARE_FIELD ("image", info->offsetB, "%g");
+	COMPARE_FIELD ("image", info->encoding, "%d");
+	COMPARE_FIELD ("image", info->imageRotation, "%g");
+	COMPARE_FIELD ("image", info->imageJustifyTypeA, "%d");
+	COMPARE_FIELD ("image", info->imageJustifyTypeB, "%d");
+	COMPARE_FIELD ("image", info->imageJustifyOffsetA, "%g");
+	COMPARE_FIELD ("image", info->imageJustifyOffsetB, "%g");
+	COMPARE_STRING ("image", info->name);
+	COMPARE_STRING ("image", info->plotterFilm);
+	COMPARE_STRING ("image", info->type);
+
+	if ((expected->format == NULL) != (actual->format == NULL)
+			|| ((expected->format != NULL)
+			 && (memcmp (expected->format, actual->format,
+					sizeof (gerbv_format_t)) != 0))) {
+		fprintf (stderr, "%s: the formats differ\n", name);
+		return FALSE;
+	}
+
+	if (gerbv_image_get_aperture_count (expected)
+			!= gerbv_image_get_aperture_count (actual)) {
+		fprintf (stderr, "%s: there are %d apertures instead of %d\n", name,
+				gerbv_image_get_aperture_count (actual),
+				gerbv_image_get_aperture_count (expected));
+		return FALSE;
+	}
+	for (i = 0; i < gerbv_image_get_aperture_count (expected); i++) {
+		gerbv_aperture_t *expectedAperture, *actualAperture;
+		gint expectedNumber, actualNumber;
+		gboolean same;
+
+		expectedAperture = gerbv_image_get_nth_aperture (expected, i,
+				&expectedNumber);
+		actualAperture = gerbv_image_get_nth_aperture (actual, i,
+				&actualNumber);
+		if (expectedNumber != actualNumber) {
+			fprintf (stderr, "%s: aperture D%d is D%d\n", name,
+					expectedNumber, actualNumber);
+			return FALSE;
+		}
+		what = g_strdup_printf ("aperture D%d", expectedNumber);
+		same = image_compare_aperture (name, what,
+				expectedAperture, actualAperture);
+		g_free (what);
+		if (!same)
+			return FALSE;
+	}
+
+	if (gerbv_image_get_layer_count (expected)
+			!= gerbv_image_get_layer_count (actual)) {
+		fprintf (stderr, "%s: there are %d layers instead of %d\n", name,
+				gerbv_image_get_layer_count (actual),
+				gerbv_image_get_layer_count (expected));
+		return FALSE;
+	}
+	for (expectedLayer = expected->layers, actualLayer = actual->layers;
+			expectedLayer != NULL;
+			expectedLayer = expectedLayer->next,
+			actualLayer = actualLayer->next)
+		if (!image_compare_layer (name, "layer",
+				expectedLayer, actualLayer))
+			return FALSE;
+
+	if (gerbv_image_get_state_count (expected)
+			!= gerbv_image_get_state_count (actual)) {
+		fprintf (stderr, "%s: there are %d netstates instead of %d\n", name,
+				gerbv_image_get_state_count (actual),
+				gerbv_image_get_state_count (expected));
+		return FALSE;
+	}
+	for (expectedState = expected->states, actualState = actual->states;
+			expectedState != NULL;
+			expectedState = expectedState->next,
+			actualState = actualState->next)
+		if (!image_compare_state (name, "netstate",
+				expectedState, actualState))
+			return FALSE;
+
+	return image_compare_stats (name, expected->gerbv_stats,
+			actual->gerbv_stats);
+}
+
+/* ------------------------------------------------------------------ */
+gboolean
+image_compare_net (const gchar *name, gint number,
+		gerbv_net_t *expected, gerbv_net_t *actual)
+{
+	gchar what[32];
+
+	g_snprintf (what, sizeof (what), "net %d", number);
+	COMPARE_FIELD (what, start_x, "%g");
+	COMPARE_FIELD (what, start_y, "%g");
+	COMPARE_FIELD (what, stop_x, "%g");
+	COMPARE_FIELD (what, stop_y, "%g");
+	COMPARE_FIELD (what, boundingBox.left, "%g");
+	COMPARE_FIELD (what, boundingBox.right, "%g");
+	COMPARE_FIELD (what, boundingBox.bottom, "%g");
+	COMPARE_FIELD (what, boundingBox.top, "%g");
+	COMPARE_FIELD (what, aperture, "%d");
+	COMPARE_FIELD (what, aperture_state, "%d");
+	COMPARE_FIELD (what, interpolation, "%d");
+
+	if ((expected->cirseg == NULL) != (actual->cirseg == NULL)) {
+		fprintf (stderr, "%s: %s %s an arc\n", name, what,
+				(actual->cirseg != NULL) ? "is" : "is not");
+		return FALSE;
+	}
+	if (expected->cirseg != NULL) {
+		COMPARE_FIELD (what, cirseg->cp_x, "%g");
+		COMPARE_FIELD (what, cirseg->cp_y, "%g");
+		COMPARE_FIELD (what, cirseg->width, "%g");
+		COMPARE_FIELD (what, cirseg->height, "%g");
+		COMPARE_FIELD (what, cirseg->angle1, "%g");
+		COMPARE_FIELD (what, cirseg->angle2, "%g");
+	}
+
+	if ((expected->label == NULL) != (actual->label == NULL)
+			|| ((expected->label != NULL) && !g_string_equal (
+					expected->label, actual->label))) {
+		fprintf (stderr, "%s: %s has another label\n", name, what);
+		return FALSE;
+	}
+
+	if ((expected->layer == NULL) || (actual->layer == NULL)
+			|| (expected->state == NULL) || (actual->state == NULL)) {
+		if ((expected->layer != actual->layer)
+				|| (expected->state != actual->state)) {
+			fprintf (stderr, "%s: %s misses its layer or netstate\n",
+					name, what);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	return image_compare_layer (name, what, expected->layer, actual->layer)
+		&& image_compare_state (name, what, expected->state, actual->state);
+}
+
+/* ------------------------------------------------------------------ */
+gboolean
+image_compare (const gchar *name,
+		gerbv_image_t *expected, gerbv_image_t *actual)
+{
+	gerbv_net_t *expectedNet, *actualNet;
+	gint number = 0;
+
+	if (!image_compare_without_nets (name, expected, actual))
+		return FALSE;
+
+	if (gerbv_image_get_net_count (expected)
+			!= gerbv_image_get_net_count (actual)) {
+		fprintf (stderr, "%s: there are %d nets instead of %d\n", name,
+				gerbv_image_get_net_count (actual),
+				gerbv_image_get_net_count (expected));
+		return FALSE;
+	}
+	for (expectedNet = expected->netlist, actualNet = actual->netlist;
+			expectedNet != NULL;
+			expectedNet = expectedNet->next, actualNet = actualNet->next)
+		if (!image_compare_net (name, number++, expectedNet, actualNet))
+			return FALSE;
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+gchar *
+image_compare_source_file (const gchar *path)
+{
+	const gchar *srcdir = g_getenv ("srcdir");
+
+	/* make check runs the tests in test/ with srcdir set */
+	return g_build_filename (srcdir ? srcdir : ".", "..", path, NULL);
+}
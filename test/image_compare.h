@@ -0,0 +1,50 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * image_compare.h -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file image_compare.h
+    \brief Header info for comparing parsed images in the libgerbv tests
+*/
+
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include "gerbv.h"
+
+/* The compare functions print the first difference found, prefixed by
+   name, and return FALSE if there is one.  Numbers must match exactly,
+   layers and netstates are compared by value */
+
+/* Compares everything of two images but their nets */
+gboolean image_compare_without_nets (const gchar *name,
+		gerbv_image_t *expected, gerbv_image_t *actual);
+
+/* Compares the net with the given number in the netlist of two images */
+gboolean image_compare_net (const gchar *name, gint number,
+		gerbv_net_t *expected, gerbv_net_t *actual);
+
+/* Compares two images with their nets */
+gboolean image_compare (const gchar *name,
+		gerbv_image_t *expected, gerbv_image_t *actual);
+
+/* Returns the filename of a file of the source tree, below top_srcdir.
+   Free it with g_free() */
+gchar *image_compare_source_file (const gchar *path);
+
+#endif /* IMAGE_COMPARE_H */
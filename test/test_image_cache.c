@@ -0,0 +1,303 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * test_image_cache.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file test_image_cache.c
+    \brief Checks the on-disk image cache of libgerbv
+
+    Every file is parsed with the cache on, loaded again from the cache
+    file just written, and both images are compared.  The cache must be
+    used for the second load, which touches the cache file.  Then the
+    cache is filled beyond its size limit, which must remove the least
+    recently used files.
+*/
+
+#include "image_compare.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifdef WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
+
+/* RS274X files with arcs, polygons, macros, step and repeat, knockout
+   and several layers and netstates */
+static const gchar *testFiles[] = {
+	"test/inputs/test-circular-interpolation-1.gbx",
+	"test/inputs/test-polygon-fill-1.gbx",
+	"test/inputs/test-aperture-polygon-flash-1.gbx",
+	"test/inputs/test-layer-step-and_repeat-1.gbx",
+	"test/inputs/test-layer-knockout-1.gbx",
+	"test/inputs/test-layer-axis-select-1.gbx",
+	"test/inputs/test-image-polarity-1.gbx",
+	"example/am-test/am-test.gbx",
+	NULL
+};
+
+/* An old modification time, standing for a long unused cache file */
+#define TEST_OLD_MTIME 1000000000
+
+/* ------------------------------------------------------------------ */
+/* Returns the names of the cache files in directory */
+static GPtrArray *
+test_list_cache (const gchar *directory)
+{
+	GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+	GDir *dir = g_dir_open (directory, 0, NULL);
+	const gchar *name;
+
+	if (dir == NULL)
+		return names;
+	while ((name = g_dir_read_name (dir)) != NULL)
+		g_ptr_array_add (names, g_build_filename (directory, name, NULL));
+	g_dir_close (dir);
+
+	return names;
+}
+
+/* ------------------------------------------------------------------ */
+static void
+test_empty_cache (const gchar *directory)
+{
+	GPtrArray *names = test_list_cache (directory);
+	guint i;
+
+	for (i = 0; i < names->len; i++)
+		g_unlink (g_ptr_array_index (names, i));
+	g_ptr_array_free (names, TRUE);
+}
+
+/* ------------------------------------------------------------------ */
+static void
+test_set_mtime (const gchar *path, time_t mtime)
+{
+	struct utimbuf times;
+
+	times.actime = mtime;
+	times.modtime = mtime;
+	g_utime (path, &times);
+}
+
+/* ------------------------------------------------------------------ */
+static time_t
+test_get_mtime (const gchar *path)
+{
+	struct stat statinfo;
+
+	if (g_stat (path, &statinfo) != 0)
+		return 0;
+
+	return statinfo.st_mtime;
+}
+
+/* ------------------------------------------------------------------ */
+static gint64
+test_get_size (const gchar *path)
+{
+	struct stat statinfo;
+
+	if (g_stat (path, &statinfo) != 0)
+		return 0;
+
+	return statinfo.st_size;
+}
+
+/* ------------------------------------------------------------------ */
+/* Opens filename in a new project.  Returns the image, or NULL */
+static gerbv_image_t *
+test_open (gerbv_project_t **project, const gchar *filename)
+{
+	*project = gerbv_create_project ();
+	gerbv_open_layer_from_filename (*project, (gchar *) filename);
+	if ((*project)->file[0] == NULL)
+		return NULL;
+
+	return (*project)->file[0]->image;
+}
+
+/* ------------------------------------------------------------------ */
+/* Parses filename into an empty cache, loads it from the cache and
+   compares the images */
+static gboolean
+test_cached_image (const gchar *directory, const gchar *filename)
+{
+	gerbv_project_t *parsedProject, *cachedProject = NULL;
+	gerbv_image_t *parsed, *cached;
+	GPtrArray *names;
+	const gchar *cacheFile;
+	gboolean success = FALSE;
+
+	test_empty_cache (directory);
+	parsed = test_open (&parsedProject, filename);
+	names = test_list_cache (directory);
+	if (parsed == NULL) {
+		fprintf (stderr, "%s: could not be parsed\n", filename);
+	} else if (names->len != 1) {
+		fprintf (stderr, "%s: %u files were cached instead of 1\n",
+				filename, names->len);
+	} else {
+		/* a cache hit touches the cache file */
+		cacheFile = g_ptr_array_index (names, 0);
+		test_set_mtime (cacheFile, TEST_OLD_MTIME);
+		cached = test_open (&cachedProject, filename);
+		if (cached == NULL)
+			fprintf (stderr, "%s: could not be loaded again\n", filename);
+		else if (test_get_mtime (cacheFile) == TEST_OLD_MTIME)
+			fprintf (stderr, "%s: the cache was not used\n", filename);
+		else
+			success = image_compare (filename, parsed, cached);
+	}
+
+	g_ptr_array_free (names, TRUE);
+	if (cachedProject != NULL)
+		gerbv_destroy_project (cachedProject);
+	gerbv_destroy_project (parsedProject);
+
+	return success;
+}
+
+/* ------------------------------------------------------------------ */
+/* Returns the size of the cache file of filename */
+static gint64
+test_get_cache_size (const gchar *directory, const gchar *filename)
+{
+	gerbv_project_t *project;
+	GPtrArray *names;
+	gint64 size = 0;
+
+	test_empty_cache (directory);
+	test_open (&project, filename);
+	gerbv_destroy_project (project);
+	names = test_list_cache (directory);
+	if (names->len == 1)
+		size = test_get_size (g_ptr_array_index (names, 0));
+	g_ptr_array_free (names, TRUE);
+
+	return size;
+}
+
+/* ------------------------------------------------------------------ */
+/* Caches the files a, b and c, marks a and then c as used long ago and
+   caches d with a limit leaving room for b and d only */
+static gboolean
+test_size_limit (const gchar *directory, gchar **filenames)
+{
+	gerbv_project_t *project;
+	GPtrArray *names;
+	gint64 sizes[4];
+	gchar *cacheFiles[3];
+	gboolean success = TRUE;
+	gint i;
+
+	for (i = 0; i < 4; i++)
+		sizes[i] = test_get_cache_size (directory, filenames[i]);
+
+	test_empty_cache (directory);
+	for (i = 0; i < 3; i++) {
+		test_open (&project, filenames[i]);
+		gerbv_destroy_project (project);
+		names = test_list_cache (directory);
+		/* the only file newer than the files before */
+		cacheFiles[i] = NULL;
+		if (names->len == (guint) i + 1) {
+			guint j;
+
+			for (j = 0; j < names->len; j++) {
+				gchar *name = g_ptr_array_index (names, j);
+
+				if (test_get_mtime (name) > TEST_OLD_MTIME + 10)
+					cacheFiles[i] = g_strdup (name);
+			}
+		}
+		g_ptr_array_free (names, TRUE);
+		if (cacheFiles[i] == NULL) {
+			fprintf (stderr, "%s: was not cached\n", filenames[i]);
+			for (; i > 0; i--)
+				g_free (cacheFiles[i - 1]);
+			return FALSE;
+		}
+		test_set_mtime (cacheFiles[i], TEST_OLD_MTIME + 2 * i);
+	}
+	test_set_mtime (cacheFiles[2], TEST_OLD_MTIME + 1);
+
+	gerbv_set_image_cache (directory, sizes[1] + sizes[3]);
+	test_open (&project, filenames[3]);
+	gerbv_destroy_project (project);
+
+	if (g_file_test (cacheFiles[0], G_FILE_TEST_EXISTS)
+			|| g_file_test (cacheFiles[2], G_FILE_TEST_EXISTS)) {
+		fprintf (stderr, "the least recently used files were kept\n");
+		success = FALSE;
+	}
+	if (!g_file_test (cacheFiles[1], G_FILE_TEST_EXISTS)) {
+		fprintf (stderr, "a recently used file was removed\n");
+		success = FALSE;
+	}
+	names = test_list_cache (directory);
+	if (names->len != 2) {
+		fprintf (stderr, "%u files are cached instead of 2\n", names->len);
+		success = FALSE;
+	}
+	g_ptr_array_free (names, TRUE);
+
+	for (i = 0; i < 3; i++)
+		g_free (cacheFiles[i]);
+
+	return success;
+}
+
+/* ------------------------------------------------------------------ */
+int
+main (int argc, char *argv[])
+{
+	gchar *directory, *filenames[G_N_ELEMENTS (testFiles)];
+	gint i, failures = 0;
+
+	directory = g_dir_make_tmp ("gerbv-test-XXXXXX", NULL);
+	if (directory == NULL) {
+		fprintf (stderr, "can't create a cache directory\n");
+		return 1;
+	}
+	gerbv_set_image_cache (directory, 0);
+
+	for (i = 0; testFiles[i] != NULL; i++) {
+		filenames[i] = image_compare_source_file (testFiles[i]);
+		if (!test_cached_image (directory, filenames[i]))
+			failures++;
+	}
+	filenames[i] = NULL;
+
+	if (!test_size_limit (directory, filenames))
+		failures++;
+
+	gerbv_set_image_cache (NULL, 0);
+	test_empty_cache (directory);
+	g_rmdir (directory);
+	g_free (directory);
+	for (i = 0; filenames[i] != NULL; i++)
+		g_free (filenames[i]);
+
+	return (failures > 0) ? 1 : 0;
+}
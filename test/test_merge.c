@@ -0,0 +1,126 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * test_merge.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file test_merge.c
+    \brief Checks the parallel image merge of libgerbv
+
+    gerbv_image_merge_images() must give the same image as duplicating
+    the first image and copying the others into it one by one, with and
+    without transformations.
+*/
+
+#include "image_compare.h"
+
+#include <stdio.h>
+
+#define TEST_MAX_IMAGES 4
+
+typedef struct {
+	const gchar *name;
+	const gchar *files[TEST_MAX_IMAGES + 1];
+	gboolean transform;	/* give every image its own transformation */
+} test_merge_t;
+
+static const test_merge_t testMerges[] = {
+	{"single image", {"test/inputs/test-polygon-fill-1.gbx", NULL}, TRUE},
+	{"two images", {"test/inputs/test-merge-a.gbx",
+			"test/inputs/test-merge-b.gbx", NULL}, FALSE},
+	{"layers and arcs", {"test/inputs/test-layer-step-and_repeat-1.gbx",
+			"test/inputs/test-circular-interpolation-1.gbx",
+			"test/inputs/test-layer-knockout-1.gbx",
+			"example/am-test/am-test.gbx", NULL}, TRUE},
+	{"large images", {"example/ekf2/l0.grb", "example/ekf2/l1.grb",
+			"example/ekf2/pow.grb", NULL}, TRUE},
+	{NULL, {NULL}, FALSE}
+};
+
+/* The transformations given to the images in turn.  The first image
+   is merged without one */
+static gerbv_user_transformation_t testTransforms[TEST_MAX_IMAGES - 1] = {
+	{0.5, -0.25, 1, 1, 0, FALSE, FALSE, FALSE},
+	{1.0, 2.0, 1, 1, G_PI / 2, TRUE, FALSE, FALSE},
+	{-3.0, 0.125, 2, 0.5, 0.1, FALSE, TRUE, FALSE}
+};
+
+/* ------------------------------------------------------------------ */
+static gboolean
+test_merge (const test_merge_t *merge)
+{
+	gerbv_image_t *images[TEST_MAX_IMAGES];
+	gerbv_user_transformation_t *transforms[TEST_MAX_IMAGES];
+	gerbv_image_t *merged, *serial = NULL;
+	gboolean success = TRUE;
+	gint i, count;
+
+	for (count = 0; merge->files[count] != NULL; count++) {
+		gchar *filename = image_compare_source_file (merge->files[count]);
+
+		images[count] = gerbv_create_rs274x_image_from_filename (filename);
+		if (images[count] == NULL) {
+			fprintf (stderr, "%s: could not be parsed\n", filename);
+			success = FALSE;
+		}
+		transforms[count] = (merge->transform && (count > 0)) ?
+			&testTransforms[count - 1] : NULL;
+		g_free (filename);
+	}
+
+	if (success) {
+		serial = gerbv_image_duplicate_image (images[0], transforms[0]);
+		for (i = 1; i < count; i++)
+			gerbv_image_copy_image (images[i], transforms[i], serial);
+
+		merged = gerbv_image_merge_images (images,
+				merge->transform ? transforms : NULL, count);
+		if (merged == NULL) {
+			fprintf (stderr, "%s: the images were not merged\n",
+					merge->name);
+			success = FALSE;
+		} else {
+			success = image_compare (merge->name, serial, merged);
+			gerbv_destroy_image (merged);
+		}
+		gerbv_destroy_image (serial);
+	}
+
+	for (i = 0; i < count; i++)
+		if (images[i] != NULL)
+			gerbv_destroy_image (images[i]);
+
+	return success;
+}
+
+/* ------------------------------------------------------------------ */
+int
+main (int argc, char *argv[])
+{
+	gint i, failures = 0;
+
+	for (i = 0; testMerges[i].name != NULL; i++)
+		if (!test_merge (&testMerges[i]))
+			failures++;
+
+	if (gerbv_image_merge_images (NULL, NULL, 0) != NULL) {
+		fprintf (stderr, "merging no images gave an image\n");
+		failures++;
+	}
+
+	return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * gEDA - GNU Electronic Design Automation
+ *
+ * test_stream.c -- this file is a part of gerbv.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file test_stream.c
+    \brief Checks the streaming RS274X parse of libgerbv
+
+    Every file is parsed into an image and streamed with the same
+    parser context.  The streamed nets must match the netlist of the
+    parsed image one by one, and the streamed image everything else.
+*/
+
+#include "image_compare.h"
+
+#include <stdio.h>
+
+/* RS274X files with arcs, polygons, macros, step and repeat, knockout
+   and several layers and netstates */
+static const gchar *testFiles[] = {
+	"test/inputs/test-circular-interpolation-1.gbx",
+	"test/inputs/test-polygon-fill-1.gbx",
+	"test/inputs/test-aperture-polygon-flash-1.gbx",
+	"test/inputs/test-layer-step-and_repeat-1.gbx",
+	"test/inputs/test-layer-step-and_repeat-2.gbx",
+	"test/inputs/test-layer-knockout-1.gbx",
+	"test/inputs/test-layer-axis-select-1.gbx",
+	"test/inputs/test-layer-mode-1.gbx",
+	"test/inputs/test-include-file-1.gbx",
+	"example/am-test/am-test.gbx",
+	NULL
+};
+
+/* The parsed net the next streamed net must match */
+typedef struct {
+	const gchar *filename;
+	gerbv_net_t *expectedNet;
+	gint number;
+	gboolean failed;
+} test_stream_t;
+
+/* ------------------------------------------------------------------ */
+static void
+test_check_net (gerbv_image_t *image, gerbv_net_t *net, gpointer userData)
+{
+	test_stream_t *stream = userData;
+
+	if (stream->failed)
+		return;
+	if (stream->expectedNet == NULL) {
+		fprintf (stderr, "%s: more nets were streamed than parsed\n",
+				stream->filename);
+		stream->failed = TRUE;
+		return;
+	}
+	if (!image_compare_net (stream->filename, stream->number,
+				stream->expectedNet, net))
+		stream->failed = TRUE;
+	stream->expectedNet = stream->expectedNet->next;
+	stream->number++;
+}
+
+/* ------------------------------------------------------------------ */
+static gboolean
+test_stream_file (gerbv_rs274x_context_t *context, gchar *filename)
+{
+	gerbv_image_t *parsed, *streamed;
+	test_stream_t stream;
+	gboolean success;
+
+	parsed = gerbv_create_rs274x_image_from_filename_with_context (context,
+			filename);
+	if (parsed == NULL) {
+		fprintf (stderr, "%s: could not be parsed\n", filename);
+		return FALSE;
+	}
+
+	/* the empty first net of the netlist is not streamed */
+	stream.filename = filename;
+	stream.expectedNet = parsed->netlist->next;
+	stream.number = 1;
+	stream.failed = FALSE;
+	streamed = gerbv_stream_rs274x_image_from_filename (context, filename,
+			test_check_net, &stream);
+	if (streamed == NULL) {
+		fprintf (stderr, "%s: could not be streamed\n", filename);
+		gerbv_destroy_image (parsed);
+		return FALSE;
+	}
+
+	success = !stream.failed;
+	if (success && (stream.expectedNet != NULL)) {
+		fprintf (stderr, "%s: %d nets were streamed instead of %d\n",
+				filename, stream.number - 1,
+				gerbv_image_get_net_count (parsed) - 1);
+		success = FALSE;
+	}
+	if (success && (gerbv_image_get_net_count (streamed) != 1)) {
+		fprintf (stderr, "%s: the streamed image kept its nets\n",
+				filename);
+		success = FALSE;
+	}
+	if (success)
+		success = image_compare_without_nets (filename, parsed, streamed);
+
+	gerbv_destroy_image (streamed);
+	gerbv_destroy_image (parsed);
+
+	return success;
+}
+
+/* ------------------------------------------------------------------ */
+int
+main (int argc, char *argv[])
+{
+	gerbv_rs274x_context_t *context = gerbv_rs274x_context_new ();
+	gchar *filename;
+	gint i, failures = 0;
+
+	for (i = 0; testFiles[i] != NULL; i++) {
+		filename = image_compare_source_file (testFiles[i]);
+		if (!test_stream_file (context, filename))
+			failures++;
+		g_free (filename);
+	}
+	gerbv_rs274x_context_destroy (context);
+
+	return (failures > 0) ? 1 : 0;
+}